@@ -22,13 +22,6 @@
 #include <stdlib.h>
 #include <errno.h>
 
-#ifdef _WIN32
-#  include <windows.h>
-#  define sleep_ms(x) Sleep((x))
-#else
-#  include <unistd.h>
-#  define sleep_ms(x) usleep((x)*1000)
-#endif
 
 #include <ksi/ksi.h>
 #include <ksi/net.h>
@@ -282,8 +275,11 @@ int main(int argc, char **argv) {
 					break;
 				case KSI_ASYNC_REQUEST_CACHE_FULL:
 					/* The request could not be added to the cache because of unresponsed requests. */
-					/* Wait for a while to avoid busy loop. */
-					sleep_ms(10);
+					res = KSI_AsyncService_wait(as, -1);
+					if (res != KSI_OK) {
+						fprintf(stderr, "Unable to wait for async service events.\n");
+						goto cleanup;
+					}
 					break;
 				default:
 					fprintf(stderr, "Unable to add request.\n");
@@ -379,6 +375,13 @@ int main(int argc, char **argv) {
 					/* Do nothing! */
 					break;
 			}
+		} else if (req_no == nof_requests && pending) {
+			/* All the requests have been added, sleep until there is something to process. */
+			res = KSI_AsyncService_wait(as, -1);
+			if (res != KSI_OK) {
+				fprintf(stderr, "Unable to wait for async service events.\n");
+				goto cleanup;
+			}
 		}
 	} while (pending || (req_no < nof_requests));
 
@@ -25,6 +25,7 @@
 #include "net_http.h"
 #include "net_uri.h"
 #include "impl/ctx_impl.h"
+#include "impl/hash_impl.h"
 #include "pkitruststore.h"
 #include "policy.h"
 
@@ -199,6 +200,10 @@ static void initOptions(KSI_CTX *ctx) {
 	KSI_CTX_setOption(ctx, KSI_OPT_EXT_CONF_RECEIVED_CALLBACK, NULL);
 
 	KSI_CTX_setOption(ctx, KSI_OPT_PUBFILE_CACHE_TTL_SECONDS, (void*)KSI_CTX_PUBFILE_CACHE_DEFAULT_TTL);
+
+	KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE, (void*)KSI_CTX_CALENDAR_CHAIN_CACHE_DEFAULT_SIZE);
+	KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_ROOT_CACHE_SIZE, (void*)KSI_CTX_CALENDAR_ROOT_CACHE_DEFAULT_SIZE);
+	KSI_CTX_setOption(ctx, KSI_OPT_PKI_SIGNATURE_CACHE_SIZE, (void*)KSI_CTX_PKI_SIGNATURE_CACHE_DEFAULT_SIZE);
 }
 
 int KSI_CTX_new(KSI_CTX **context) {
@@ -232,6 +237,11 @@ int KSI_CTX_new(KSI_CTX **context) {
 	ctx->freeCertConstraintsArray = freeCertConstraintsArray;
 	ctx->lastFailedSignature = NULL;
 	ctx->dataHashRecycle = NULL;
+	ctx->tlvTemplateCache = NULL;
+	ctx->calendarChainCache = NULL;
+	ctx->calendarRootCache = NULL;
+	ctx->pkiSignatureCache = NULL;
+	memset(ctx->hasherCache, 0, sizeof(ctx->hasherCache));
 	KSI_ERR_clearErrors(ctx);
 
 	/* Init options. */
@@ -335,6 +345,9 @@ static void globalCleanup(KSI_CTX *ctx) {
  */
 void KSI_CTX_free(KSI_CTX *ctx) {
 	if (ctx != NULL) {
+		/* Release the cached hashers before the crypto providers are cleaned up. */
+		KSI_DataHasherCache_free(ctx);
+
 		/* Call cleanup methods. */
 		globalCleanup(ctx);
 
@@ -350,9 +363,14 @@ void KSI_CTX_free(KSI_CTX *ctx) {
 
 		freeCertConstraintsArray(ctx->certConstraints);
 		KSI_Signature_free(ctx->lastFailedSignature);
+		KSI_CalendarChainCache_free(ctx->calendarChainCache);
+		KSI_CalendarRootCache_free(ctx->calendarRootCache);
+		KSI_PKISignatureCache_free(ctx->pkiSignatureCache);
 
 		KSI_DataHashList_free(ctx->dataHashRecycle);
 
+		KSI_TlvTemplateCache_free(ctx->tlvTemplateCache);
+
 		KSI_free(ctx);
 	}
 }
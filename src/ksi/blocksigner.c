@@ -21,11 +21,27 @@
 #ifndef BLOCKSIGNER_C_
 #define BLOCKSIGNER_C_
 
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 #include "internal.h"
 #include "blocksigner.h"
 #include "tree_builder.h"
 #include "hashchain.h"
 #include "signature_builder.h"
+#include "tlv_element.h"
+#include "net_async.h"
+#include "impl/hash_impl.h"
+#include "impl/signature_builder_impl.h"
+#include "impl/tree_builder_impl.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,58 +50,116 @@ extern "C" {
 KSI_IMPLEMENT_LIST(KSI_BlockSignerHandle, KSI_BlockSignerHandle_free);
 
 
+typedef struct BlockSignerBlock_st BlockSignerBlock;
+
+/* A single aggregation tree of the block signer, shared by the handles of its leaves. */
+struct BlockSignerBlock_st {
+	size_t ref;
+	/** Sequence number of the block within the signer. */
+	size_t id;
+	KSI_FlatTreeBuilder *builder;
+	/** Signature of the root hash value, set when the block is signed. */
+	KSI_Signature *signature;
+	/** #KSI_ASYNC_NOT_FINISHED while the asynchronous signing request is in flight, or its error code. */
+	int status;
+	/** Number of leaves added to the block. */
+	size_t leafCount;
+	/** Next block waiting for the signature. */
+	BlockSignerBlock *next;
+};
+
 struct KSI_BlockSigner_st {
 	KSI_CTX *ctx;
 	size_t ref;
-	KSI_TreeBuilder *builder;
-	KSI_Signature *signature;
+	/** The block currently being built. */
+	BlockSignerBlock *block;
 	KSI_DataHash *prevLeaf;
 	KSI_DataHash *origPrevLeaf;
 	KSI_OctetString *iv;
-	KSI_MetaData *metaData;
+	KSI_HashAlgorithm algoId;
 
 	/** Common hasher object. */
 	KSI_DataHasher *hsr;
 
-	KSI_TreeBuilderLeafProcessor metaDataProcessor;
-	KSI_TreeBuilderLeafProcessor maskingProcessor;
+	/** Blocks submitted with #KSI_BlockSigner_closeAndSignAsync, waiting for the response. */
+	BlockSignerBlock *pending;
+	size_t pendingCount;
+	/** Block completion callback and its context. */
+	KSI_BlockSignerCallback callback;
+	void *callbackCtx;
+
+	/** Path prefix of the spill files of the blocks, \c NULL if the trees are kept in memory. */
+	char *spillPrefix;
+
+	/** Number of worker threads in addition to the calling thread. */
+	size_t workerCount;
+	/** Private contexts of the worker threads, as #KSI_CTX may not be shared between threads. */
+	KSI_CTX **workerCtx;
+	/** Hashers of the worker threads. */
+	KSI_DataHasher **workerHsr;
 };
 
 struct KSI_BlockSignerHandle_st {
 	KSI_CTX *ctx;
 	size_t ref;
-	KSI_TreeLeafHandle *leafHandle;
-	KSI_BlockSigner *signer;
+	size_t leafId;
+	BlockSignerBlock *block;
 };
 
-static KSI_IMPLEMENT_REF(KSI_BlockSignerHandle);
-
-void KSI_BlockSignerHandle_free(KSI_BlockSignerHandle *handle) {
-	if (handle != NULL && --handle->ref == 0) {
-		KSI_TreeLeafHandle_free(handle->leafHandle);
-		KSI_free(handle);
+static void BlockSignerBlock_free(BlockSignerBlock *block) {
+	if (block != NULL && --block->ref == 0) {
+		KSI_FlatTreeBuilder_free(block->builder);
+		KSI_Signature_free(block->signature);
+		KSI_free(block);
 	}
 }
 
-static int KSI_BlockSignerHandle_new(KSI_CTX *ctx, KSI_BlockSignerHandle **out) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_BlockSignerHandle *tmp = NULL;
+static BlockSignerBlock *BlockSignerBlock_ref(BlockSignerBlock *block) {
+	if (block != NULL) ++block->ref;
+	return block;
+}
 
-	if (out == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
+/* Releases the reference held by the request context of an async handle. */
+static void BlockSignerBlock_release(void *block) {
+	BlockSignerBlock_free(block);
+}
 
-	tmp = KSI_new(KSI_BlockSignerHandle);
+/* Enables spilling for the tree of the block, the spill file name is the prefix followed by the block id. */
+static int BlockSignerBlock_setSpill(BlockSignerBlock *block, const char *prefix) {
+	char path[1024];
+
+	/* Leave room for the separator and the id. */
+	if (strlen(prefix) + 22 > sizeof(path)) return KSI_BUFFER_OVERFLOW;
+	KSI_snprintf(path, sizeof(path), "%s.%llu", prefix, (unsigned long long)block->id);
+
+	return KSI_FlatTreeBuilder_setSpillFile(block->builder, path);
+}
+
+static int BlockSignerBlock_new(KSI_CTX *ctx, KSI_HashAlgorithm algoId, size_t id, const char *spillPrefix, BlockSignerBlock **out) {
+	int res = KSI_UNKNOWN_ERROR;
+	BlockSignerBlock *tmp = NULL;
+
+	tmp = KSI_new(BlockSignerBlock);
 	if (tmp == NULL) {
 		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
-	tmp->ctx = ctx;
-	tmp->leafHandle = NULL;
-	tmp->signer = NULL;
 	tmp->ref = 1;
+	tmp->id = id;
+	tmp->builder = NULL;
+	tmp->signature = NULL;
+	tmp->status = KSI_OK;
+	tmp->leafCount = 0;
+	tmp->next = NULL;
+
+	res = KSI_FlatTreeBuilder_new(ctx, algoId, &tmp->builder);
+	if (res != KSI_OK) goto cleanup;
+
+	if (spillPrefix != NULL) {
+		res = BlockSignerBlock_setSpill(tmp, spillPrefix);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 	*out = tmp;
 	tmp = NULL;
@@ -94,154 +168,145 @@ static int KSI_BlockSignerHandle_new(KSI_CTX *ctx, KSI_BlockSignerHandle **out)
 
 cleanup:
 
-	KSI_BlockSignerHandle_free(tmp);
+	BlockSignerBlock_free(tmp);
 
 	return res;
+}
 
+void KSI_BlockSignerHandle_free(KSI_BlockSignerHandle *handle) {
+	if (handle != NULL && --handle->ref == 0) {
+		BlockSignerBlock_free(handle->block);
+		KSI_free(handle);
+	}
 }
 
-static int metaDataProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+static int KSI_BlockSignerHandle_new(KSI_CTX *ctx, KSI_BlockSignerHandle **out) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_BlockSigner *signer = c;
-	KSI_TreeNode *tmp = NULL;
+	KSI_BlockSignerHandle *tmp = NULL;
 
-	if (in == NULL || c == NULL || out == NULL) {
+	if (out == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	if (signer->metaData != NULL) {
-		res = KSI_TreeNode_new(signer->ctx, NULL, signer->metaData, in->level, &tmp);
-		if (res != KSI_OK) goto cleanup;
-
-		*out = tmp;
-		tmp = NULL;
-	} else {
-		*out = NULL;
+	tmp = KSI_new(KSI_BlockSignerHandle);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
 	}
 
+	tmp->ctx = ctx;
+	tmp->leafId = 0;
+	tmp->block = NULL;
+	tmp->ref = 1;
+
+	*out = tmp;
+	tmp = NULL;
+
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_TreeNode_free(tmp);
+	KSI_BlockSignerHandle_free(tmp);
 
 	return res;
+
 }
 
-static int maskingProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+typedef struct {
+	KSI_BlockSigner *signer;
+	/** The hash value of the previous leaf. */
+	KSI_DataHash prevLeaf;
+} MaskingContext;
+
+/* Calculates the mask of a leaf, and updates the previous leaf hash value. */
+static int maskLeaf(void *c, const KSI_DataHash *leaf, int level, KSI_DataHash *mask) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_BlockSigner *signer = c;
-	KSI_TreeNode *tmp = NULL;
-	KSI_DataHash *mask = NULL;
-	KSI_DataHash *leafHash = NULL;
+	MaskingContext *mc = c;
+	KSI_BlockSigner *signer = mc->signer;
 	unsigned char tmpLvl;
 
-	if (in == NULL || c == NULL || out == NULL) {
-		res = KSI_INVALID_ARGUMENT;
+	/* Calculate the mask value. */
+	res = KSI_DataHasher_reset(signer->hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	KSI_ERR_clearErrors(signer->ctx);
-
-	if (signer->iv != NULL && signer->prevLeaf != NULL) {
-		/* For now only masking real hash values is supported. */
-		if (in->hash == NULL) {
-			KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "Only a tree node with a hash value may be used for masking.");
-			goto cleanup;
-		}
-
-		/* Calculate the mask value. */
-		res = KSI_DataHasher_reset(signer->builder->hsr);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		/* Change here, if there is a need, to add previous values that are not nodes containing hash values. */
-		res = KSI_DataHasher_addImprint(signer->builder->hsr, signer->prevLeaf);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		res = KSI_DataHasher_addOctetString(signer->builder->hsr, signer->iv);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		res = KSI_DataHasher_close(signer->builder->hsr, &mask);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		/* Add the mask as left link of the calculation. */
-		res = KSI_TreeNode_new(signer->ctx, mask, NULL, in->level, &tmp);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
-
-		/* Calculate the actual leaf value. */
-		res = KSI_DataHasher_reset(signer->builder->hsr);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
+	/* Change here, if there is a need, to add previous values that are not nodes containing hash values. */
+	res = KSI_DataHasher_addImprint(signer->hsr, &mc->prevLeaf);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		res = KSI_DataHasher_addImprint(signer->builder->hsr, mask);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
+	res = KSI_DataHasher_addOctetString(signer->hsr, signer->iv);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		res = KSI_DataHasher_addImprint(signer->builder->hsr, in->hash);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
+	res = KSI_DataHasher_closeExisting(signer->hsr, mask);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		if (!KSI_IS_VALID_TREE_LEVEL(in->level + 1)) {
-			KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "The tree height is too large.");
-			goto cleanup;
-		}
+	/* Calculate the actual leaf value. */
+	res = KSI_DataHasher_reset(signer->hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		tmpLvl = (unsigned char)(in->level + 1);
+	res = KSI_DataHasher_addImprint(signer->hsr, mask);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		res = KSI_DataHasher_add(signer->builder->hsr, &tmpLvl, 1);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
+	res = KSI_DataHasher_addImprint(signer->hsr, leaf);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		res = KSI_DataHasher_close(signer->builder->hsr, &leafHash);
-		if (res != KSI_OK) {
-			KSI_pushError(signer->ctx, res, NULL);
-			goto cleanup;
-		}
+	tmpLvl = (unsigned char)(level + 1);
 
-		/* Swap the previous leaf hash value. */
-		KSI_DataHash_free(signer->prevLeaf);
-		signer->prevLeaf = KSI_DataHash_ref(leafHash);
+	res = KSI_DataHasher_add(signer->hsr, &tmpLvl, 1);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		*out = tmp;
-		tmp = NULL;
-	} else {
-		*out = NULL;
+	/* Swap the previous leaf hash value. */
+	res = KSI_DataHasher_closeExisting(signer->hsr, &mc->prevLeaf);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
 	}
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_DataHash_free(mask);
-	KSI_DataHash_free(leafHash);
+	return res;
+}
+
+static void freeWorkers(KSI_BlockSigner *signer) {
+	size_t i;
+
+	for (i = 0; i < signer->workerCount; i++) {
+		if (signer->workerHsr != NULL) KSI_DataHasher_free(signer->workerHsr[i]);
+		if (signer->workerCtx != NULL) KSI_CTX_free(signer->workerCtx[i]);
+	}
 
-	KSI_TreeNode_free(tmp);
+	KSI_free(signer->workerHsr);
+	KSI_free(signer->workerCtx);
 
-	return res;
+	signer->workerHsr = NULL;
+	signer->workerCtx = NULL;
+	signer->workerCount = 0;
 }
 
 int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algoId, KSI_DataHash *prevLeaf, KSI_OctetString *initVal, KSI_BlockSigner **signer) {
@@ -268,44 +333,31 @@ int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algoId, KSI_DataHash *pr
 
 	tmp->ctx = ctx;
 	tmp->ref = 1;
-	tmp->builder = NULL;
-	tmp->signature = NULL;
+	tmp->block = NULL;
 	tmp->prevLeaf = NULL;
 	tmp->origPrevLeaf = NULL;
 	tmp->iv = NULL;
-	tmp->metaData = NULL;
+	tmp->algoId = algoId;
 	tmp->hsr = NULL;
-
-	tmp->metaDataProcessor.c = tmp;
-	tmp->metaDataProcessor.fn = metaDataProcessor;
-
-	tmp->maskingProcessor.c = tmp;
-	tmp->maskingProcessor.fn = maskingProcessor;
+	tmp->pending = NULL;
+	tmp->pendingCount = 0;
+	tmp->callback = NULL;
+	tmp->callbackCtx = NULL;
+	tmp->spillPrefix = NULL;
+	tmp->workerCount = 0;
+	tmp->workerCtx = NULL;
+	tmp->workerHsr = NULL;
 
 	res = KSI_DataHasher_open(ctx, algoId, &tmp->hsr);
 	if (res != KSI_OK) goto cleanup;
 
-	res = KSI_TreeBuilder_new(ctx, algoId, &tmp->builder);
+	res = BlockSignerBlock_new(ctx, algoId, 0, NULL, &tmp->block);
 	if (res != KSI_OK) goto cleanup;
 
 	tmp->prevLeaf = KSI_DataHash_ref(prevLeaf);
 	tmp->origPrevLeaf = KSI_DataHash_ref(prevLeaf);
 	tmp->iv = KSI_OctetString_ref(initVal);
 
-	/* Add the masking handle. */
-	res = KSI_TreeBuilderLeafProcessorList_append(tmp->builder->cbList, &tmp->maskingProcessor);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
-	/* Add the client id handle. */
-	res = KSI_TreeBuilderLeafProcessorList_append(tmp->builder->cbList, &tmp->metaDataProcessor);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
 	*signer = tmp;
 	tmp = NULL;
 
@@ -320,18 +372,28 @@ cleanup:
 
 void KSI_BlockSigner_free(KSI_BlockSigner *signer) {
 	if (signer != NULL && --signer->ref == 0) {
-		KSI_TreeBuilder_free(signer->builder);
-		KSI_Signature_free(signer->signature);
+		BlockSignerBlock_free(signer->block);
+		while (signer->pending != NULL) {
+			BlockSignerBlock *next = signer->pending->next;
+			BlockSignerBlock_free(signer->pending);
+			signer->pending = next;
+		}
 		KSI_OctetString_free(signer->iv);
 		KSI_DataHash_free(signer->prevLeaf);
 		KSI_DataHash_free(signer->origPrevLeaf);
 		KSI_DataHasher_free(signer->hsr);
+		KSI_free(signer->spillPrefix);
+		freeWorkers(signer);
 		KSI_free(signer);
 	}
 }
 
-int KSI_BlockSigner_closeAndSign(KSI_BlockSigner *signer) {
+int KSI_BlockSigner_setWorkerCount(KSI_BlockSigner *signer, size_t count) {
 	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX **ctxs = NULL;
+	KSI_DataHasher **hsrs = NULL;
+	size_t workers = count > 1 ? count - 1 : 0;
+	size_t i;
 
 	if (signer == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -340,38 +402,57 @@ int KSI_BlockSigner_closeAndSign(KSI_BlockSigner *signer) {
 
 	KSI_ERR_clearErrors(signer->ctx);
 
-	KSI_LOG_debug(signer->ctx, "Closing block signer instance.");
+	if (workers > 0) {
+		ctxs = KSI_calloc(workers, sizeof(*ctxs));
+		hsrs = KSI_calloc(workers, sizeof(*hsrs));
+		if (ctxs == NULL || hsrs == NULL) {
+			KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
 
-	/* Finalize the tree. */
-	res = KSI_TreeBuilder_close(signer->builder);
-	if (res != KSI_OK) {
-		KSI_pushError(signer->ctx, res, NULL);
-		goto cleanup;
+		for (i = 0; i < workers; i++) {
+			res = KSI_CTX_new(&ctxs[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(signer->ctx, res, "Unable to create a context for a worker thread.");
+				goto cleanup;
+			}
+
+			res = KSI_DataHasher_open(ctxs[i], signer->algoId, &hsrs[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(signer->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
 	}
 
-	KSI_LOG_debug(signer->ctx, "Signing the root hash value of the block signer.");
-	/* Sign the root hash. */
-	res = KSI_Signature_signAggregated(signer->ctx, signer->builder->rootNode->hash, signer->builder->rootNode->level, &signer->signature);
-	if (res != KSI_OK) {
-		KSI_pushError(signer->ctx, res, NULL);
-		goto cleanup;
-	}
+	freeWorkers(signer);
 
+	signer->workerCount = workers;
+	signer->workerCtx = ctxs;
+	signer->workerHsr = hsrs;
+	ctxs = NULL;
+	hsrs = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	return res;
-}
+	if (ctxs != NULL) {
+		for (i = 0; i < workers; i++) {
+			if (hsrs != NULL) KSI_DataHasher_free(hsrs[i]);
+			KSI_CTX_free(ctxs[i]);
+		}
+	}
+	KSI_free(ctxs);
+	KSI_free(hsrs);
 
-int KSI_BlockSigner_close(KSI_BlockSigner *signer, void KSI_UNUSED(*dummy)) {
-	return KSI_BlockSigner_closeAndSign(signer);
+	return res;
 }
 
-int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
+int KSI_BlockSigner_setSpillFile(KSI_BlockSigner *signer, const char *prefix) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TreeBuilder *builder = NULL;
+	char *tmp = NULL;
+	size_t len;
 
 	if (signer == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -380,119 +461,96 @@ int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
 
 	KSI_ERR_clearErrors(signer->ctx);
 
-	res = KSI_TreeBuilder_new(signer->ctx, signer->builder->algo, &builder);
-	if (res != KSI_OK) {
-		KSI_pushError(signer->ctx, res, NULL);
-		goto cleanup;
-	}
-
-	KSI_Signature_free(signer->signature);
-	signer->signature = NULL;
+	if (prefix != NULL) {
+		len = strlen(prefix) + 1;
 
-	KSI_TreeBuilder_free(signer->builder);
-	signer->builder = builder;
-	builder = NULL;
+		tmp = KSI_malloc(len);
+		if (tmp == NULL) {
+			KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		memcpy(tmp, prefix, len);
 
-	/* Add the masking handle. */
-	res = KSI_TreeBuilderLeafProcessorList_append(signer->builder->cbList, &signer->maskingProcessor);
-	if (res != KSI_OK) {
-		KSI_pushError(signer->ctx, res, NULL);
-		goto cleanup;
+		/* Fails if the current block already has leaves. */
+		res = BlockSignerBlock_setSpill(signer->block, prefix);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
 	}
 
-	/* Add the client id handle. */
-	res = KSI_TreeBuilderLeafProcessorList_append(signer->builder->cbList, &signer->metaDataProcessor);
-	if (res != KSI_OK) {
-		KSI_pushError(signer->ctx, res, NULL);
-		goto cleanup;
-	}
+	KSI_free(signer->spillPrefix);
+	signer->spillPrefix = tmp;
+	tmp = NULL;
 
-	KSI_DataHash_free(signer->prevLeaf);
-	signer->prevLeaf = KSI_DataHash_ref(signer->origPrevLeaf);
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_TreeBuilder_free(builder);
+	KSI_free(tmp);
 
 	return res;
 }
 
-int KSI_BlockSigner_addLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handle) {
+int KSI_BlockSigner_closeAndSign(KSI_BlockSigner *signer) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TreeLeafHandle *leafHandle = NULL;
-	KSI_BlockSignerHandle *tmp = NULL;
-	KSI_HashAlgorithm algoId;
+	KSI_DataHash *root = NULL;
+	int level;
 
-	if (signer == NULL || hsh == NULL) {
+	if (signer == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
 	KSI_ERR_clearErrors(signer->ctx);
 
-	/* Make sure the input hash algorithm is still trusted. */
-	res = KSI_DataHash_extract(hsh, &algoId, NULL, NULL);
+	KSI_LOG_debug(signer->ctx, "Closing block signer instance.");
+
+	/* Finalize the tree. */
+	res = KSI_FlatTreeBuilder_close(signer->block->builder);
 	if (res != KSI_OK) {
 		KSI_pushError(signer->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	if (!KSI_isHashAlgorithmTrusted(algoId)) {
-		KSI_pushError(signer->ctx, res = KSI_UNTRUSTED_HASH_ALGORITHM, "The hash algorithm is no longer trusted as a leaf hash.");
-		goto cleanup;
-	}
-
-	/* Set the pointer to the meta data value. */
-	signer->metaData = metaData;
-
-	res = KSI_TreeBuilder_addDataHash(signer->builder, hsh, level, &leafHandle);
+	res = KSI_FlatTreeBuilder_getRoot(signer->block->builder, &root, &level);
 	if (res != KSI_OK) {
 		KSI_pushError(signer->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_BlockSignerHandle_new(signer->ctx, &tmp);
+	KSI_LOG_debug(signer->ctx, "Signing the root hash value of the block signer.");
+	/* Sign the root hash. */
+	res = KSI_Signature_signAggregated(signer->ctx, root, level, &signer->block->signature);
 	if (res != KSI_OK) {
 		KSI_pushError(signer->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	tmp->leafHandle = leafHandle;
-	tmp->signer = signer;
-
-	if (handle != NULL) {
-		*handle = KSI_BlockSignerHandle_ref(tmp);
-	}
-
-	leafHandle = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	/* Cleanup the value, as this is only a pointer to a memory we do not control. */
-	if (signer != NULL) {
-		signer->metaData = NULL;
-	}
-
-	KSI_BlockSignerHandle_free(tmp);
-	KSI_TreeLeafHandle_free(leafHandle);
+	KSI_DataHash_free(root);
 
 	return res;
 }
 
-int KSI_BlockSigner_getPrevLeaf(const KSI_BlockSigner *signer, KSI_DataHash **prevLeaf) {
+int KSI_BlockSigner_close(KSI_BlockSigner *signer, void KSI_UNUSED(*dummy)) {
+	return KSI_BlockSigner_closeAndSign(signer);
+}
+
+int KSI_BlockSigner_setAsyncCallback(KSI_BlockSigner *signer, KSI_BlockSignerCallback callback, void *userCtx) {
 	int res = KSI_UNKNOWN_ERROR;
 
-	if (signer == NULL || signer->ctx == NULL || prevLeaf == NULL) {
+	if (signer == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	KSI_ERR_clearErrors(signer->ctx);
-
-	*prevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+	signer->callback = callback;
+	signer->callbackCtx = userCtx;
 
 	res = KSI_OK;
 
@@ -501,33 +559,938 @@ cleanup:
 	return res;
 }
 
-int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig) {
+int KSI_BlockSigner_closeAndSignAsync(KSI_BlockSigner *signer, KSI_AsyncService *service, size_t *blockId) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_Signature *tmp = NULL;
-	KSI_AggregationHashChain *aggr = NULL;
-	KSI_SignatureBuilder *builder = NULL;
+	BlockSignerBlock *block = NULL;
+	BlockSignerBlock *next = NULL;
+	KSI_DataHash *root = NULL;
+	KSI_AggregationReq *req = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	int level;
+
+	if (signer == NULL || service == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	block = signer->block;
+
+	KSI_LOG_debug(signer->ctx, "Closing block %llu of the block signer.", (unsigned long long)block->id);
+
+	/* Prepare the next block first, so a failure leaves the signer untouched. */
+	res = BlockSignerBlock_new(signer->ctx, signer->algoId, block->id + 1, signer->spillPrefix, &next);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FlatTreeBuilder_close(block->builder);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FlatTreeBuilder_getRoot(block->builder, &root, &level);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_createSignRequest(signer->ctx, root, level, &req);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AsyncAggregationHandle_new(signer->ctx, req, &handle);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	req = NULL;
+
+	/* The request keeps the block alive, even if the signer is freed before the response arrives. */
+	res = KSI_AsyncHandle_setRequestCtx(handle, BlockSignerBlock_ref(block), BlockSignerBlock_release);
+	if (res != KSI_OK) {
+		BlockSignerBlock_free(block);
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The caller may retry after processing the responses, if the request cache is full. */
+	res = KSI_AsyncService_addRequest(service, handle);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	handle = NULL;
+
+	block->status = KSI_ASYNC_NOT_FINISHED;
+	block->next = signer->pending;
+	signer->pending = block;
+	signer->pendingCount++;
+
+	/* Start the next block, continuing the masking chain from the last leaf of the closed block. */
+	signer->block = next;
+	next = NULL;
+
+	KSI_DataHash_free(signer->origPrevLeaf);
+	signer->origPrevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+
+	if (blockId != NULL) *blockId = block->id;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AsyncHandle_free(handle);
+	KSI_AggregationReq_free(req);
+	KSI_DataHash_free(root);
+	BlockSignerBlock_free(next);
+
+	return res;
+}
+
+/* Stores the outcome of the signing request of a pending block and notifies the user. */
+static int BlockSigner_processResponse(KSI_BlockSigner *signer, KSI_AsyncHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	BlockSignerBlock *block = NULL;
+	BlockSignerBlock **prev = NULL;
+	const void *reqCtx = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	int status = KSI_UNKNOWN_ERROR;
+
+	res = KSI_AsyncHandle_getState(handle, &state);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Configuration pushed by the server does not belong to any block. */
+	if (state == KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_AsyncHandle_getRequestCtx(handle, &reqCtx);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (prev = &signer->pending; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == reqCtx) break;
+	}
+
+	if (*prev == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_STATE, "Response to a request not made by the block signer.");
+		goto cleanup;
+	}
+
+	/* Take over the reference of the pending list. */
+	block = *prev;
+	*prev = block->next;
+	block->next = NULL;
+	signer->pendingCount--;
+
+	if (state == KSI_ASYNC_STATE_RESPONSE_RECEIVED) {
+		status = KSI_AsyncHandle_getSignature(handle, &block->signature);
+	} else {
+		res = KSI_AsyncHandle_getError(handle, &status);
+		if (res != KSI_OK) status = res;
+		if (status == KSI_OK) status = KSI_UNKNOWN_ERROR;
+	}
+
+	block->status = status;
+
+	KSI_LOG_debug(signer->ctx, "Block %llu of the block signer completed with status 0x%x.", (unsigned long long)block->id, status);
+
+	res = KSI_OK;
+
+	if (signer->callback != NULL) {
+		res = signer->callback(signer, block->id, status, signer->callbackCtx);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Block signer callback returned an error.");
+			goto cleanup;
+		}
+	}
+
+cleanup:
+
+	BlockSignerBlock_free(block);
+
+	return res;
+}
+
+int KSI_BlockSigner_runAsync(KSI_BlockSigner *signer, KSI_AsyncService *service, size_t *pending) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *handle = NULL;
+
+	if (signer == NULL || service == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	for (;;) {
+		res = KSI_AsyncService_run(service, &handle, NULL);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (handle == NULL) break;
+
+		res = BlockSigner_processResponse(signer, handle);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_AsyncHandle_free(handle);
+		handle = NULL;
+	}
+
+	if (pending != NULL) *pending = signer->pendingCount;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AsyncHandle_free(handle);
+
+	return res;
+}
+
+int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	BlockSignerBlock *block = NULL;
+
+	if (signer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	res = BlockSignerBlock_new(signer->ctx, signer->algoId, signer->block->id + 1, signer->spillPrefix, &block);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The handles of the previous block keep it alive. */
+	BlockSignerBlock_free(signer->block);
+	signer->block = block;
+	block = NULL;
+
+	KSI_DataHash_free(signer->prevLeaf);
+	signer->prevLeaf = KSI_DataHash_ref(signer->origPrevLeaf);
+	res = KSI_OK;
+
+cleanup:
+
+	BlockSignerBlock_free(block);
+
+	return res;
+}
+
+int KSI_BlockSigner_addLeaves(KSI_BlockSigner *signer, KSI_DataHash * const *hashes, size_t count, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handles) {
+	int res = KSI_UNKNOWN_ERROR;
+	MaskingContext mc;
+	KSI_DataHash *prevLeaf = NULL;
+	size_t leafId;
+	size_t *leafIds = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len;
+	KSI_HashAlgorithm algoId;
+	bool masked;
+	size_t i;
+
+	if (signer == NULL || (hashes == NULL && count > 0)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (handles != NULL) {
+		for (i = 0; i < count; i++) handles[i] = NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (hashes[i] == NULL) {
+			KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+
+		/* Make sure the input hash algorithm is still trusted. */
+		res = KSI_DataHash_extract(hashes[i], &algoId, NULL, NULL);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (!KSI_isHashAlgorithmTrusted(algoId)) {
+			KSI_pushError(signer->ctx, res = KSI_UNTRUSTED_HASH_ALGORITHM, "The hash algorithm is no longer trusted as a leaf hash.");
+			goto cleanup;
+		}
+	}
+
+	/* Masking is only performed if both the initial value and the previous leaf are known. */
+	masked = signer->iv != NULL && signer->prevLeaf != NULL;
+	if (masked) {
+		res = KSI_DataHash_getImprint(signer->prevLeaf, &imprint, &imprint_len);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		mc.signer = signer;
+		mc.prevLeaf.ctx = signer->ctx;
+		mc.prevLeaf.ref = 1;
+		memcpy(mc.prevLeaf.imprint, imprint, imprint_len);
+		mc.prevLeaf.imprint_length = imprint_len;
+	}
+
+	if (count > 1) {
+		leafIds = KSI_calloc(count, sizeof(*leafIds));
+		if (leafIds == NULL) {
+			KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_FlatTreeBuilder_addBatch(signer->block->builder, hashes, count, level, masked ? maskLeaf : NULL, &mc, metaData,
+			signer->workerHsr, signer->workerCount, count > 1 ? leafIds : &leafId);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	signer->block->leafCount += count;
+
+	if (masked && count > 0) {
+		res = KSI_DataHash_fromImprint(signer->ctx, mc.prevLeaf.imprint, mc.prevLeaf.imprint_length, &prevLeaf);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		KSI_DataHash_free(signer->prevLeaf);
+		signer->prevLeaf = prevLeaf;
+		prevLeaf = NULL;
+	}
+
+	if (handles != NULL) {
+		for (i = 0; i < count; i++) {
+			res = KSI_BlockSignerHandle_new(signer->ctx, &handles[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(signer->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			handles[i]->leafId = count > 1 ? leafIds[i] : leafId;
+			handles[i]->block = BlockSignerBlock_ref(signer->block);
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK && handles != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_BlockSignerHandle_free(handles[i]);
+			handles[i] = NULL;
+		}
+	}
+
+	KSI_DataHash_free(prevLeaf);
+	KSI_free(leafIds);
+
+	return res;
+}
+
+int KSI_BlockSigner_addLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSignerHandle *tmp = NULL;
+
+	if (signer == NULL || hsh == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_BlockSigner_addLeaves(signer, &hsh, 1, level, metaData, handle != NULL ? &tmp : NULL);
+	if (res != KSI_OK) goto cleanup;
+
+	if (handle != NULL) {
+		*handle = tmp;
+		tmp = NULL;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_BlockSignerHandle_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockSigner_getPrevLeaf(const KSI_BlockSigner *signer, KSI_DataHash **prevLeaf) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL || signer->ctx == NULL || prevLeaf == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	*prevLeaf = KSI_DataHash_ref(signer->prevLeaf);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Tags of the checkpoint file, see #KSI_BlockSigner_checkpoint. */
+#define BLOCKSIGNER_CHECKPOINT_TAG			0x0bc0
+#define BLOCKSIGNER_CHECKPOINT_ALGO			0x01
+#define BLOCKSIGNER_CHECKPOINT_BLOCK_ID		0x02
+#define BLOCKSIGNER_CHECKPOINT_LEAF_COUNT	0x03
+#define BLOCKSIGNER_CHECKPOINT_PREV_LEAF	0x04
+#define BLOCKSIGNER_CHECKPOINT_ORIG_LEAF	0x05
+#define BLOCKSIGNER_CHECKPOINT_IV			0x06
+/* Sequence of the level byte and the imprint of every frontier root. */
+#define BLOCKSIGNER_CHECKPOINT_FRONTIER		0x07
+
+static int setCheckpointInteger(KSI_CTX *ctx, KSI_TlvElement *el, unsigned tag, KSI_uint64_t value) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *tmp = NULL;
+
+	res = KSI_Integer_new(ctx, value, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_setInteger(el, tag, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(tmp);
+
+	return res;
+}
+
+static int setCheckpointBytes(KSI_CTX *ctx, KSI_TlvElement *el, unsigned tag, const unsigned char *data, size_t data_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *tmp = NULL;
+
+	res = KSI_OctetString_new(ctx, data, data_len, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_setOctetString(el, tag, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_OctetString_free(tmp);
+
+	return res;
+}
+
+static int setCheckpointHash(KSI_CTX *ctx, KSI_TlvElement *el, unsigned tag, const KSI_DataHash *hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+
+	if (hsh == NULL) return KSI_OK;
+
+	res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setCheckpointBytes(ctx, el, tag, imprint, imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int getCheckpointHash(KSI_CTX *ctx, KSI_TlvElement *el, unsigned tag, KSI_DataHash **hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *tmp = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+
+	*hsh = NULL;
+
+	res = KSI_TlvElement_getOctetString(el, ctx, tag, &tmp);
+	if (res != KSI_OK || tmp == NULL) goto cleanup;
+
+	res = KSI_OctetString_extract(tmp, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_fromImprint(ctx, imprint, imprint_len, hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_OctetString_free(tmp);
+
+	return res;
+}
+
+/* Flushes the written contents of the file to the storage device. */
+static int syncFile(FILE *f) {
+	if (fflush(f) != 0) return KSI_IO_ERROR;
+#ifdef _WIN32
+	if (_commit(_fileno(f)) != 0) return KSI_IO_ERROR;
+#else
+	if (fsync(fileno(f)) != 0) return KSI_IO_ERROR;
+#endif
+	return KSI_OK;
+}
+
+/* Flushes the directory entries of the directory containing \c path. */
+static int syncDirectory(const char *path) {
+#ifdef _WIN32
+	(void)path;
+	return KSI_OK;
+#else
+	int res = KSI_UNKNOWN_ERROR;
+	char *dir = NULL;
+	const char *sep = strrchr(path, '/');
+	size_t len = sep == NULL ? 1 : (sep == path ? 1 : (size_t)(sep - path));
+	int fd = -1;
+
+	dir = KSI_malloc(len + 1);
+	if (dir == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	if (sep == NULL) {
+		dir[0] = '.';
+	} else {
+		memcpy(dir, path, len);
+	}
+	dir[len] = '\0';
+
+	fd = open(dir, O_RDONLY);
+	if (fd < 0 || fsync(fd) != 0) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (fd >= 0) close(fd);
+	KSI_free(dir);
+
+	return res;
+#endif
+}
+
+int KSI_BlockSigner_checkpoint(const KSI_BlockSigner *signer, const char *path, KSI_BlockSignerSync sync) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TlvElement *el = NULL;
+	KSI_DataHash **roots = NULL;
+	unsigned char *frontier = NULL;
+	size_t frontier_len = 0;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	char *tmpPath = NULL;
+	size_t len;
+	FILE *f = NULL;
+	size_t i;
+
+	if (signer == NULL || path == NULL || (sync != KSI_BLOCK_SIGNER_SYNC_NONE && sync != KSI_BLOCK_SIGNER_SYNC_DATA && sync != KSI_BLOCK_SIGNER_SYNC_FULL)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	roots = KSI_calloc(KSI_TREE_BUILDER_STACK_LEN, sizeof(*roots));
+	frontier = KSI_malloc(KSI_TREE_BUILDER_STACK_LEN * (KSI_MAX_IMPRINT_LEN + 2));
+	if (roots == NULL || frontier == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_FlatTreeBuilder_getFrontier(signer->block->builder, roots);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		const unsigned char *imprint = NULL;
+		size_t imprint_len = 0;
+
+		if (roots[i] == NULL) continue;
+
+		res = KSI_DataHash_getImprint(roots[i], &imprint, &imprint_len);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		frontier[frontier_len++] = (unsigned char)i;
+		memcpy(frontier + frontier_len, imprint, imprint_len);
+		frontier_len += imprint_len;
+	}
+
+	res = KSI_TlvElement_new(&el);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
 
-	if (handle == NULL || sig == NULL) {
+	el->ftlv.tag = BLOCKSIGNER_CHECKPOINT_TAG;
+
+	res = setCheckpointInteger(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_ALGO, signer->algoId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setCheckpointInteger(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_BLOCK_ID, signer->block->id);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setCheckpointInteger(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_LEAF_COUNT, signer->block->leafCount);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setCheckpointHash(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_PREV_LEAF, signer->prevLeaf);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setCheckpointHash(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_ORIG_LEAF, signer->origPrevLeaf);
+	if (res != KSI_OK) goto cleanup;
+
+	if (signer->iv != NULL) {
+		res = KSI_TlvElement_setOctetString(el, BLOCKSIGNER_CHECKPOINT_IV, signer->iv);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (frontier_len > 0) {
+		res = setCheckpointBytes(signer->ctx, el, BLOCKSIGNER_CHECKPOINT_FRONTIER, frontier, frontier_len);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_TlvElement_serialize(el, NULL, 0, &raw_len, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	raw = KSI_malloc(raw_len);
+	if (raw == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvElement_serialize(el, raw, raw_len, &raw_len, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Write the new checkpoint next to the previous one and replace it once complete. */
+	len = strlen(path) + sizeof(".tmp");
+	tmpPath = KSI_malloc(len);
+	if (tmpPath == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	KSI_snprintf(tmpPath, len, "%s.tmp", path);
+
+	f = fopen(tmpPath, "wb");
+	if (f == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_IO_ERROR, "Unable to create the checkpoint file.");
+		goto cleanup;
+	}
+
+	if (fwrite(raw, 1, raw_len, f) != raw_len) {
+		KSI_pushError(signer->ctx, res = KSI_IO_ERROR, "Unable to write the checkpoint file.");
+		goto cleanup;
+	}
+
+	if (sync != KSI_BLOCK_SIGNER_SYNC_NONE) {
+		res = syncFile(f);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Unable to flush the checkpoint file.");
+			goto cleanup;
+		}
+	}
+
+	if (fclose(f) != 0) {
+		f = NULL;
+		KSI_pushError(signer->ctx, res = KSI_IO_ERROR, "Unable to write the checkpoint file.");
+		goto cleanup;
+	}
+	f = NULL;
+
+#ifdef _WIN32
+	if (!MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+#else
+	if (rename(tmpPath, path) != 0) {
+#endif
+		KSI_pushError(signer->ctx, res = KSI_IO_ERROR, "Unable to replace the checkpoint file.");
+		goto cleanup;
+	}
+
+	if (sync == KSI_BLOCK_SIGNER_SYNC_FULL) {
+		res = syncDirectory(path);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, "Unable to flush the checkpoint directory.");
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (f != NULL) fclose(f);
+	if (res != KSI_OK && tmpPath != NULL) remove(tmpPath);
+	if (roots != NULL) {
+		for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) KSI_DataHash_free(roots[i]);
+	}
+	KSI_free(roots);
+	KSI_free(frontier);
+	KSI_free(raw);
+	KSI_free(tmpPath);
+	KSI_TlvElement_free(el);
+
+	return res;
+}
+
+int KSI_BlockSigner_restore(KSI_CTX *ctx, const char *path, KSI_BlockSigner **signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *tmp = NULL;
+	KSI_TlvElement *el = NULL;
+	KSI_Integer *algoId = NULL;
+	KSI_Integer *blockId = NULL;
+	KSI_Integer *leafCount = NULL;
+	KSI_DataHash *prevLeaf = NULL;
+	KSI_DataHash *origPrevLeaf = NULL;
+	KSI_OctetString *iv = NULL;
+	KSI_OctetString *frontier = NULL;
+	KSI_DataHash **roots = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	const size_t raw_size = 0xffff + 4;
+	FILE *f = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || path == NULL || signer == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	raw = KSI_malloc(raw_size);
+	roots = KSI_calloc(KSI_TREE_BUILDER_STACK_LEN, sizeof(*roots));
+	if (raw == NULL || roots == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open the checkpoint file.");
+		goto cleanup;
+	}
+
+	raw_len = fread(raw, 1, raw_size, f);
+	if (raw_len == 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read the checkpoint file.");
+		goto cleanup;
+	}
+
+	if (!feof(f)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Input too long for a valid checkpoint.");
+		goto cleanup;
+	}
+
+	res = KSI_TlvElement_parse(raw, raw_len, &el);
+	if (res != KSI_OK || el->ftlv.tag != BLOCKSIGNER_CHECKPOINT_TAG) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Not a block signer checkpoint.");
+		goto cleanup;
+	}
+
+	res = KSI_TlvElement_getInteger(el, ctx, BLOCKSIGNER_CHECKPOINT_ALGO, &algoId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_getInteger(el, ctx, BLOCKSIGNER_CHECKPOINT_BLOCK_ID, &blockId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_getInteger(el, ctx, BLOCKSIGNER_CHECKPOINT_LEAF_COUNT, &leafCount);
+	if (res != KSI_OK) goto cleanup;
+
+	res = getCheckpointHash(ctx, el, BLOCKSIGNER_CHECKPOINT_PREV_LEAF, &prevLeaf);
+	if (res != KSI_OK) goto cleanup;
+
+	res = getCheckpointHash(ctx, el, BLOCKSIGNER_CHECKPOINT_ORIG_LEAF, &origPrevLeaf);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_getOctetString(el, ctx, BLOCKSIGNER_CHECKPOINT_IV, &iv);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvElement_getOctetString(el, ctx, BLOCKSIGNER_CHECKPOINT_FRONTIER, &frontier);
+	if (res != KSI_OK) goto cleanup;
+
+	if (algoId == NULL || blockId == NULL || leafCount == NULL || (iv == NULL) != (origPrevLeaf == NULL) || (prevLeaf == NULL) != (origPrevLeaf == NULL)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Incomplete block signer checkpoint.");
+		goto cleanup;
+	}
+
+	if (frontier != NULL) {
+		const unsigned char *ptr = NULL;
+		size_t len = 0;
+		size_t pos = 0;
+
+		res = KSI_OctetString_extract(frontier, &ptr, &len);
+		if (res != KSI_OK) goto cleanup;
+
+		while (pos < len) {
+			unsigned level = ptr[pos++];
+			unsigned hash_len;
+
+			if (pos == len || roots[level] != NULL || (hash_len = KSI_getHashLength(ptr[pos])) == 0 || pos + hash_len + 1 > len) {
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Invalid frontier in the block signer checkpoint.");
+				goto cleanup;
+			}
+
+			res = KSI_DataHash_fromImprint(ctx, ptr + pos, hash_len + 1, &roots[level]);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			pos += hash_len + 1;
+		}
+	}
+
+	res = KSI_BlockSigner_new(ctx, (KSI_HashAlgorithm)KSI_Integer_getUInt64(algoId), origPrevLeaf, iv, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	KSI_DataHash_free(tmp->prevLeaf);
+	tmp->prevLeaf = prevLeaf;
+	prevLeaf = NULL;
+
+	tmp->block->id = (size_t)KSI_Integer_getUInt64(blockId);
+	tmp->block->leafCount = (size_t)KSI_Integer_getUInt64(leafCount);
+
+	res = KSI_FlatTreeBuilder_setFrontier(tmp->block->builder, roots);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*signer = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (f != NULL) fclose(f);
+	if (roots != NULL) {
+		for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) KSI_DataHash_free(roots[i]);
+	}
+	KSI_free(roots);
+	KSI_TlvElement_free(el);
+	KSI_free(raw);
+	KSI_Integer_free(algoId);
+	KSI_Integer_free(blockId);
+	KSI_Integer_free(leafCount);
+	KSI_DataHash_free(prevLeaf);
+	KSI_DataHash_free(origPrevLeaf);
+	KSI_OctetString_free(iv);
+	KSI_OctetString_free(frontier);
+	KSI_BlockSigner_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockSigner_getLeafCount(const KSI_BlockSigner *signer, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (signer == NULL || count == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	KSI_ERR_clearErrors(handle->ctx);
+	*count = signer->block->leafCount;
+
+	res = KSI_OK;
+
+cleanup:
 
-	if (handle->signer->signature == NULL) {
+	return res;
+}
+
+/* Makes sure the block of the handle has been signed successfully. */
+static int checkSigned(const KSI_BlockSignerHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle->block->status == KSI_ASYNC_NOT_FINISHED) {
+		KSI_pushError(handle->ctx, res = KSI_ASYNC_NOT_FINISHED, "The signing of the block is not finished.");
+		goto cleanup;
+	}
+
+	if (handle->block->status != KSI_OK) {
+		KSI_pushError(handle->ctx, res = handle->block->status, "The signing of the block failed.");
+		goto cleanup;
+	}
+
+	if (handle->block->signature == NULL) {
 		KSI_pushError(handle->ctx, res = KSI_INVALID_STATE, "The blocksigner is not closed.");
 		goto cleanup;
 	}
 
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Signature *tmp = NULL;
+	KSI_AggregationHashChain *aggr = NULL;
+	KSI_SignatureBuilder *builder = NULL;
+
+	if (handle == NULL || sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	res = checkSigned(handle);
+	if (res != KSI_OK) goto cleanup;
+
 	/* Extract the calculated aggregation hash chain. */
-	res = KSI_TreeLeafHandle_getAggregationChain(handle->leafHandle, &aggr);
+	res = KSI_FlatTreeBuilder_getAggregationChain(handle->block->builder, handle->leafId, &aggr);
 	if (res != KSI_OK) {
 		KSI_pushError(handle->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Build a new signature with the appended aggregation hash chain. */
-	res = KSI_SignatureBuilder_openFromSignature(handle->signer->signature, &builder);
+	res = KSI_SignatureBuilder_openFromSignature(handle->block->signature, &builder);
 	if (res != KSI_OK) {
 		KSI_pushError(handle->ctx, res, NULL);
 		goto cleanup;
@@ -559,6 +1522,184 @@ cleanup:
 	return res;
 }
 
+/* Serialized signature of the block root for a given root level of the leaf chains. */
+typedef struct {
+	unsigned char *raw;
+	size_t raw_len;
+} BlockSignerBase;
+
+/* Returns the output level of the aggregation hash chain, see #KSI_AggregationHashChain_aggregate. */
+static int getChainLevel(const KSI_AggregationHashChain *aggr, int *level) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_uint64_t sum = 0;
+	size_t i;
+
+	res = KSI_AggregationHashChain_getChain(aggr, &links);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < KSI_HashChainLinkList_length(links); i++) {
+		KSI_HashChainLink *link = NULL;
+		KSI_Integer *levelCorrection = NULL;
+
+		res = KSI_HashChainLinkList_elementAt(links, i, &link);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_getLevelCorrection(link, &levelCorrection);
+		if (res != KSI_OK) goto cleanup;
+
+		sum += KSI_Integer_getUInt64(levelCorrection) + 1;
+		if (!KSI_IS_VALID_TREE_LEVEL(sum)) {
+			res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+	}
+
+	*level = (int)sum;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSignerHandle_exportSignatures(KSI_BlockSignerHandle * const *handles, size_t count, KSI_BlockSignerSignatureWriter writer, void *userCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	const BlockSignerBlock *block = NULL;
+	BlockSignerBase *bases = NULL;
+	KSI_AggregationHashChain *aggr = NULL;
+	unsigned char *chain = NULL;
+	size_t chain_len = 0;
+	unsigned char *out = NULL;
+	size_t out_size = 0;
+	size_t i;
+	size_t j;
+
+	if ((handles == NULL && count > 0) || writer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (handles[i] == NULL) {
+			res = KSI_INVALID_ARGUMENT;
+			goto cleanup;
+		}
+	}
+
+	/* The root signatures of the current block, by the root level. */
+	bases = KSI_calloc(KSI_TREE_BUILDER_STACK_LEN, sizeof(*bases));
+	if (bases == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		const KSI_BlockSignerHandle *handle = handles[i];
+		const BlockSignerBase *base = NULL;
+		int rootLevel = 0;
+		size_t len;
+
+		KSI_ERR_clearErrors(handle->ctx);
+
+		res = checkSigned(handle);
+		if (res != KSI_OK) goto cleanup;
+
+		if (handle->block != block) {
+			for (j = 0; j < KSI_TREE_BUILDER_STACK_LEN; j++) {
+				KSI_free(bases[j].raw);
+				bases[j].raw = NULL;
+			}
+			block = handle->block;
+		}
+
+		res = KSI_FlatTreeBuilder_getAggregationChain(block->builder, handle->leafId, &aggr);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = getChainLevel(aggr, &rootLevel);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		base = &bases[rootLevel];
+		if (base->raw == NULL) {
+			res = KSI_SignatureBuilder_serializeBase(block->signature, rootLevel, &bases[rootLevel].raw, &bases[rootLevel].raw_len);
+			if (res != KSI_OK) {
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			/* The signature is always encoded as a TLV16 element. */
+			if (base->raw_len < 4 || (base->raw[0] & 0x80) == 0) {
+				KSI_pushError(handle->ctx, res = KSI_INVALID_STATE, "Unexpected signature encoding.");
+				goto cleanup;
+			}
+		}
+
+		res = KSI_SignatureBuilder_serializeAggregationChain(block->signature, aggr, &chain, &chain_len);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Append the chain to the payload of the root signature. */
+		len = base->raw_len - 4 + chain_len;
+		if (len > 0xffff) {
+			KSI_pushError(handle->ctx, res = KSI_BUFFER_OVERFLOW, "Signature too long.");
+			goto cleanup;
+		}
+
+		if (out_size < len + 4) {
+			KSI_free(out);
+			out_size = 0;
+
+			out = KSI_malloc(len + 4);
+			if (out == NULL) {
+				KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			out_size = len + 4;
+		}
+
+		out[0] = base->raw[0];
+		out[1] = base->raw[1];
+		out[2] = (unsigned char)(len >> 8);
+		out[3] = (unsigned char)len;
+		memcpy(out + 4, base->raw + 4, base->raw_len - 4);
+		if (chain_len > 0) memcpy(out + base->raw_len, chain, chain_len);
+
+		res = writer(userCtx, i, out, len + 4);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, "Unable to write the signature.");
+			goto cleanup;
+		}
+
+		KSI_AggregationHashChain_free(aggr);
+		aggr = NULL;
+		KSI_free(chain);
+		chain = NULL;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (bases != NULL) {
+		for (j = 0; j < KSI_TREE_BUILDER_STACK_LEN; j++) KSI_free(bases[j].raw);
+	}
+	KSI_free(bases);
+	KSI_AggregationHashChain_free(aggr);
+	KSI_free(chain);
+	KSI_free(out);
+
+	return res;
+}
+
 
 #ifdef __cplusplus
 }
@@ -67,8 +67,58 @@ int KSI_BlockSigner_closeAndSign(KSI_BlockSigner *signer);
 KSI_FN_DEPRECATED(int KSI_BlockSigner_close(KSI_BlockSigner *signer, void *), Use #KSI_BlockSigner_closeAndSign instead.);
 
 /**
- * Resets the block signer to its initial state. This will invalidate all the
- * #KSI_BlockSignerHandle instances still remaining.
+ * Callback for the completion of a block submitted with #KSI_BlockSigner_closeAndSignAsync. When called with
+ * \c status #KSI_OK, the signatures of the leaves of the block are available via #KSI_BlockSignerHandle_getSignature.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	blockId		Id of the block, as returned by #KSI_BlockSigner_closeAndSignAsync.
+ * \param[in]	status		#KSI_OK if the block was signed, otherwise an error code.
+ * \param[in]	userCtx		User context, as set by #KSI_BlockSigner_setAsyncCallback.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+typedef int (*KSI_BlockSignerCallback)(KSI_BlockSigner *signer, size_t blockId, int status, void *userCtx);
+
+/**
+ * Sets the callback for the completion of the asynchronously signed blocks.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	callback	Completion callback, may be \c NULL.
+ * \param[in]	userCtx		User context passed to the callback.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_setAsyncCallback(KSI_BlockSigner *signer, KSI_BlockSignerCallback callback, void *userCtx);
+
+/**
+ * Finalizes the tree and adds the signing request of its root hash to the async service \c service. Unlike
+ * #KSI_BlockSigner_closeAndSign the function does not wait for the response: the signer immediately continues
+ * with a new block, linked to the closed one by the masking chain. Until the response is processed by
+ * #KSI_BlockSigner_runAsync, #KSI_BlockSignerHandle_getSignature returns #KSI_ASYNC_NOT_FINISHED for the leaves
+ * of the closed block.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	service		Signing async service.
+ * \param[out]	blockId		Id of the closed block; may be NULL.
+ * \return #KSI_OK, when operation succeeded;
+ * \return #KSI_ASYNC_REQUEST_CACHE_FULL, if the request cache of the service is full. The block stays closed and
+ *         the call may be repeated after processing the responses;
+ * \return otherwise an error code.
+ * \see #KSI_SigningAsyncService_new for creating the async service.
+ */
+int KSI_BlockSigner_closeAndSignAsync(KSI_BlockSigner *signer, KSI_AsyncService *service, size_t *blockId);
+
+/**
+ * Non-blocking worker for the blocks submitted with #KSI_BlockSigner_closeAndSignAsync. Runs the async service
+ * \c service and completes the blocks for all the received responses, calling the callback set by
+ * #KSI_BlockSigner_setAsyncCallback for each of them.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	service		Signing async service.
+ * \param[out]	pending		Number of blocks still waiting for the signature; may be NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The service \c service may only be used for the requests of the signer \c signer.
+ */
+int KSI_BlockSigner_runAsync(KSI_BlockSigner *signer, KSI_AsyncService *service, size_t *pending);
+
+/**
+ * Resets the block signer to its initial state and starts a new block. The
+ * #KSI_BlockSignerHandle instances of the previous block keep referring to it, thus
+ * the handles of an unsigned block can no longer produce a signature.
  * \param[in]	signer		Instance of the #KSI_BlockSigner.
  * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
  */
@@ -96,6 +146,96 @@ int KSI_BlockSigner_reset(KSI_BlockSigner *signer);
  */
 int KSI_BlockSigner_addLeaf(KSI_BlockSigner *signer, KSI_DataHash *hsh, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handle);
 
+/**
+ * Adds a batch of leaves to the tree. The result is the same as adding the leaves one by one with
+ * #KSI_BlockSigner_addLeaf, but the tree is built concurrently when the signer has more than one
+ * worker (see #KSI_BlockSigner_setWorkerCount). The masking values are still computed sequentially
+ * as each of them depends on the previous leaf.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	hashes		Hash values of the leaf nodes.
+ * \param[in]	count		Number of leaves.
+ * \param[in]	level		Level of the leaf nodes.
+ * \param[in]	metaData	A meta-data object to associate all the input hashes with, can be \c NULL.
+ * \param[out]	handles		Output array for the handles of the leaves (\c count elements); may be NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The function does not take ownership of \c hashes nor \c metaData, the caller is responsible
+ * for freeing the handles.
+ */
+int KSI_BlockSigner_addLeaves(KSI_BlockSigner *signer, KSI_DataHash * const *hashes, size_t count, int level, KSI_MetaData *metaData, KSI_BlockSignerHandle **handles);
+
+/**
+ * Sets the number of threads used for building the tree of a batch added with #KSI_BlockSigner_addLeaves,
+ * including the calling thread. The default is 1, i.e. everything is computed on the calling thread.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	count		Number of threads.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Every additional thread uses a private #KSI_CTX. If the library is built without thread
+ * support, the value has no effect.
+ */
+int KSI_BlockSigner_setWorkerCount(KSI_BlockSigner *signer, size_t count);
+
+/**
+ * Makes the signer keep the trees of the blocks in spill files instead of memory, so the memory
+ * usage does not grow with the size of the block (see #KSI_FlatTreeBuilder_setSpillFile). The
+ * spill file of a block is named by the \c prefix followed by a dot and the block id, and it is
+ * removed when the block is no longer referenced by the signer nor the handles of its leaves.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	prefix		Path prefix of the spill files, \c NULL to keep the trees of the next blocks in memory.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The function must be called before adding leaves to the current block.
+ */
+int KSI_BlockSigner_setSpillFile(KSI_BlockSigner *signer, const char *prefix);
+
+/**
+ * Durability of the checkpoint files written by #KSI_BlockSigner_checkpoint.
+ */
+typedef enum KSI_BlockSignerSync_en {
+	/** The file is written out by the operating system at its own pace. The checkpoint survives
+	 * a crash of the process, but not of the host. */
+	KSI_BLOCK_SIGNER_SYNC_NONE = 0,
+	/** The file contents are flushed to the storage device before the file replaces the previous checkpoint. */
+	KSI_BLOCK_SIGNER_SYNC_DATA,
+	/** As #KSI_BLOCK_SIGNER_SYNC_DATA, and the directory entry is flushed as well, so the checkpoint
+	 * also survives a power loss. On Windows, this is the same as #KSI_BLOCK_SIGNER_SYNC_DATA. */
+	KSI_BLOCK_SIGNER_SYNC_FULL
+} KSI_BlockSignerSync;
+
+/**
+ * Writes the state of the block signer into a checkpoint file, so the signer can be resumed with
+ * #KSI_BlockSigner_restore after a restart of the process. The checkpoint contains the aggregation
+ * algorithm, the initial value, the previous leaf values, the number of leaves and the roots of the
+ * complete binary trees of the current block. The file is written under a temporary name and then
+ * renamed to \c path, so an existing checkpoint is replaced atomically.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[in]	path		Path of the checkpoint file.
+ * \param[in]	sync		Durability of the checkpoint, see #KSI_BlockSignerSync.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The blocks submitted with #KSI_BlockSigner_closeAndSignAsync, the worker count, the spill file
+ * prefix and the callback are not part of the checkpoint.
+ */
+int KSI_BlockSigner_checkpoint(const KSI_BlockSigner *signer, const char *path, KSI_BlockSignerSync sync);
+
+/**
+ * Creates a new instance of #KSI_BlockSigner from a checkpoint file written by #KSI_BlockSigner_checkpoint.
+ * The leaves added to the restored signer end up in the same tree as they would have in the original
+ * signer. The leaves added before the checkpoint are part of the root hash value, but their signatures
+ * are not available.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	path		Path of the checkpoint file.
+ * \param[out]	signer		Pointer to the receiving pointer.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_restore(KSI_CTX *ctx, const char *path, KSI_BlockSigner **signer);
+
+/**
+ * Returns the number of leaves added to the current block, including the leaves added before the
+ * checkpoint the signer was restored from.
+ * \param[in]	signer		Instance of the #KSI_BlockSigner.
+ * \param[out]	count		Pointer to the receiving variable.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSigner_getLeafCount(const KSI_BlockSigner *signer, size_t *count);
+
 /**
  * Getter method for \c prevLeaf.
  * \param[in]	signer		Pointer to #KSI_BlockSigner.
@@ -110,11 +250,38 @@ int KSI_BlockSigner_getPrevLeaf(const KSI_BlockSigner *signer, KSI_DataHash **pr
  * parameter.
  * \param[in]	handle		Handle for the block signature.
  * \param[out]	sig			Pointer to the receiving pointer.
- * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \return #KSI_OK, when operation succeeded;
+ * \return #KSI_ASYNC_NOT_FINISHED, if the block was submitted with #KSI_BlockSigner_closeAndSignAsync
+ *         and the response has not been processed yet;
+ * \return otherwise an error code.
  * \see #KSI_BlockSigner_close, #KSI_BlockSigner_free, #KSI_BlockSigner_reset.
  */
 int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig);
 
+/**
+ * Output function of #KSI_BlockSignerHandle_exportSignatures.
+ * \param[in]	userCtx		User context, as passed to #KSI_BlockSignerHandle_exportSignatures.
+ * \param[in]	index		Index of the handle the signature belongs to.
+ * \param[in]	raw			The serialized signature, only valid during the call.
+ * \param[in]	raw_len		Length of the serialized signature.
+ * \return #KSI_OK to continue, otherwise an error code to abort the export.
+ */
+typedef int (*KSI_BlockSignerSignatureWriter)(void *userCtx, size_t index, const unsigned char *raw, size_t raw_len);
+
+/**
+ * Serializes the signatures of the leaves of signed blocks in a single pass, without creating a
+ * #KSI_Signature object for every leaf. The serialized signature of the block root is shared by
+ * all the leaves of the block, only the aggregation hash chain is serialized per leaf. The output
+ * is identical to serializing the signature returned by #KSI_BlockSignerHandle_getSignature with
+ * #KSI_Signature_serialize, but the signatures are not verified.
+ * \param[in]	handles		Array of handles, the handles of the same block should be adjacent.
+ * \param[in]	count		Number of handles.
+ * \param[in]	writer		Function receiving the serialized signatures in the order of the handles.
+ * \param[in]	userCtx		User context for the writer function.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_BlockSignerHandle_exportSignatures(KSI_BlockSignerHandle * const *handles, size_t count, KSI_BlockSignerSignatureWriter writer, void *userCtx);
+
 /**
  * Cleanup method for the handle.
  * \param[in]	handle		Instance of the #KSI_BlockSignerHandle
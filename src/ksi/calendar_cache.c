@@ -0,0 +1,295 @@
+/*
+ * Copyright 2013-2017 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include "internal.h"
+#include "hashchain.h"
+
+#include "impl/ctx_impl.h"
+#include "impl/calendar_cache_impl.h"
+
+#define CALENDAR_CACHE_NIL ((size_t)-1)
+
+typedef struct CalendarChainCacheEntry_st {
+	KSI_uint64_t aggrTime;
+	KSI_uint64_t pubTime;
+	KSI_CalendarHashChain *chain;
+	/* Next entry in the same hash bucket. */
+	size_t hashNext;
+	/* Neighbours in the usage order. */
+	size_t lruPrev;
+	size_t lruNext;
+} CalendarChainCacheEntry;
+
+struct KSI_CalendarChainCache_st {
+	/* Entry storage, allocated for the full capacity. */
+	CalendarChainCacheEntry *entries;
+	size_t entries_len;
+	size_t capacity;
+
+	/* Hash buckets, each holding the index of the first entry. */
+	size_t *buckets;
+	size_t bucketMask;
+
+	/* Most and least recently used entries. */
+	size_t lruHead;
+	size_t lruTail;
+
+	size_t hits;
+	size_t misses;
+};
+
+static size_t CalendarChainCache_bucket(const KSI_CalendarChainCache *cache, KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	KSI_uint64_t h = aggrTime * 0x9E3779B97F4A7C15ull;
+	h ^= pubTime + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+	return (size_t)(h ^ (h >> 32)) & cache->bucketMask;
+}
+
+static void CalendarChainCache_unlink(KSI_CalendarChainCache *cache, size_t i) {
+	CalendarChainCacheEntry *e = &cache->entries[i];
+
+	if (e->lruPrev != CALENDAR_CACHE_NIL) cache->entries[e->lruPrev].lruNext = e->lruNext;
+	else cache->lruHead = e->lruNext;
+	if (e->lruNext != CALENDAR_CACHE_NIL) cache->entries[e->lruNext].lruPrev = e->lruPrev;
+	else cache->lruTail = e->lruPrev;
+	e->lruPrev = e->lruNext = CALENDAR_CACHE_NIL;
+}
+
+static void CalendarChainCache_pushFront(KSI_CalendarChainCache *cache, size_t i) {
+	CalendarChainCacheEntry *e = &cache->entries[i];
+
+	e->lruPrev = CALENDAR_CACHE_NIL;
+	e->lruNext = cache->lruHead;
+	if (cache->lruHead != CALENDAR_CACHE_NIL) cache->entries[cache->lruHead].lruPrev = i;
+	cache->lruHead = i;
+	if (cache->lruTail == CALENDAR_CACHE_NIL) cache->lruTail = i;
+}
+
+static size_t CalendarChainCache_find(const KSI_CalendarChainCache *cache, KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	size_t i = cache->buckets[CalendarChainCache_bucket(cache, aggrTime, pubTime)];
+
+	while (i != CALENDAR_CACHE_NIL) {
+		const CalendarChainCacheEntry *e = &cache->entries[i];
+		if (e->aggrTime == aggrTime && e->pubTime == pubTime) break;
+		i = e->hashNext;
+	}
+	return i;
+}
+
+/* Removes the entry from its hash bucket. */
+static void CalendarChainCache_unhash(KSI_CalendarChainCache *cache, size_t i) {
+	size_t *p = &cache->buckets[CalendarChainCache_bucket(cache, cache->entries[i].aggrTime, cache->entries[i].pubTime)];
+
+	while (*p != i) p = &cache->entries[*p].hashNext;
+	*p = cache->entries[i].hashNext;
+}
+
+void KSI_CalendarChainCache_free(KSI_CalendarChainCache *cache) {
+	if (cache != NULL) {
+		size_t i;
+
+		for (i = 0; i < cache->entries_len; i++) {
+			KSI_CalendarHashChain_free(cache->entries[i].chain);
+		}
+		KSI_free(cache->entries);
+		KSI_free(cache->buckets);
+		KSI_free(cache);
+	}
+}
+
+static int CalendarChainCache_new(size_t capacity, KSI_CalendarChainCache **cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarChainCache *tmp = NULL;
+	size_t nofBuckets = 1;
+	size_t i;
+
+	if (capacity == 0 || capacity > KSI_CTX_CALENDAR_CHAIN_CACHE_MAX_SIZE ||
+			capacity > ((size_t)-1) / sizeof(CalendarChainCacheEntry)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Keep the load factor of the hash table at most 0.5. */
+	while (nofBuckets < capacity * 2) nofBuckets <<= 1;
+
+	tmp = KSI_new(KSI_CalendarChainCache);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->entries = NULL;
+	tmp->entries_len = 0;
+	tmp->capacity = capacity;
+	tmp->bucketMask = nofBuckets - 1;
+	tmp->lruHead = CALENDAR_CACHE_NIL;
+	tmp->lruTail = CALENDAR_CACHE_NIL;
+	tmp->hits = 0;
+	tmp->misses = 0;
+
+	tmp->entries = KSI_malloc(capacity * sizeof(CalendarChainCacheEntry));
+	tmp->buckets = KSI_malloc(nofBuckets * sizeof(size_t));
+	if (tmp->entries == NULL || tmp->buckets == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	for (i = 0; i < nofBuckets; i++) tmp->buckets[i] = CALENDAR_CACHE_NIL;
+
+	*cache = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarChainCache_free(tmp);
+
+	return res;
+}
+
+/* Returns the context cache, (re)creating it if the configured size has changed. */
+static int CalendarChainCache_prepare(KSI_CTX *ctx, KSI_CalendarChainCache **cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t capacity = ctx->options[KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE];
+
+	if (capacity > KSI_CTX_CALENDAR_CHAIN_CACHE_MAX_SIZE) capacity = KSI_CTX_CALENDAR_CHAIN_CACHE_MAX_SIZE;
+
+	if (ctx->calendarChainCache != NULL && ctx->calendarChainCache->capacity != capacity) {
+		KSI_CalendarChainCache_free(ctx->calendarChainCache);
+		ctx->calendarChainCache = NULL;
+	}
+
+	if (ctx->calendarChainCache == NULL && capacity > 0) {
+		res = CalendarChainCache_new(capacity, &ctx->calendarChainCache);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	*cache = ctx->calendarChainCache;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CalendarChainCache_get(KSI_CTX *ctx, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarChainCache *cache = NULL;
+	size_t i;
+
+	if (ctx == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*chain = NULL;
+
+	res = CalendarChainCache_prepare(ctx, &cache);
+	if (res != KSI_OK || cache == NULL) goto cleanup;
+
+	i = CalendarChainCache_find(cache, aggrTime, pubTime);
+	if (i == CALENDAR_CACHE_NIL) {
+		cache->misses++;
+		goto cleanup;
+	}
+
+	cache->hits++;
+	CalendarChainCache_unlink(cache, i);
+	CalendarChainCache_pushFront(cache, i);
+
+	*chain = KSI_CalendarHashChain_ref(cache->entries[i].chain);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CalendarChainCache_add(KSI_CTX *ctx, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, KSI_CalendarHashChain *chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarChainCache *cache = NULL;
+	CalendarChainCacheEntry *e = NULL;
+	size_t bucket;
+	size_t i;
+
+	if (ctx == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = CalendarChainCache_prepare(ctx, &cache);
+	if (res != KSI_OK || cache == NULL) goto cleanup;
+
+	i = CalendarChainCache_find(cache, aggrTime, pubTime);
+	if (i != CALENDAR_CACHE_NIL) {
+		/* Replace the existing chain. */
+		e = &cache->entries[i];
+		KSI_CalendarHashChain_free(e->chain);
+		e->chain = KSI_CalendarHashChain_ref(chain);
+		CalendarChainCache_unlink(cache, i);
+		CalendarChainCache_pushFront(cache, i);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (cache->entries_len < cache->capacity) {
+		i = cache->entries_len++;
+	} else {
+		/* Evict the least recently used chain. */
+		i = cache->lruTail;
+		CalendarChainCache_unlink(cache, i);
+		CalendarChainCache_unhash(cache, i);
+		KSI_CalendarHashChain_free(cache->entries[i].chain);
+	}
+
+	e = &cache->entries[i];
+	e->aggrTime = aggrTime;
+	e->pubTime = pubTime;
+	e->chain = KSI_CalendarHashChain_ref(chain);
+
+	bucket = CalendarChainCache_bucket(cache, aggrTime, pubTime);
+	e->hashNext = cache->buckets[bucket];
+	cache->buckets[bucket] = i;
+	CalendarChainCache_pushFront(cache, i);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CTX_getCalendarChainCacheStats(KSI_CTX *ctx, size_t *hits, size_t *misses) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL || (hits == NULL && misses == NULL)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (hits != NULL) *hits = ctx->calendarChainCache != NULL ? ctx->calendarChainCache->hits : 0;
+	if (misses != NULL) *misses = ctx->calendarChainCache != NULL ? ctx->calendarChainCache->misses : 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
@@ -18,6 +18,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "io.h"
 #include "internal.h"
@@ -239,3 +240,62 @@ cleanup:
 
 	return res;
 }
+
+int KSI_FTLV_writeHeader(unsigned tag, int isNc, int isFwd, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t dat_len;
+	size_t hdr_len = 0;
+	unsigned char *ptr = NULL;
+
+	if ((buf == NULL && buf_size != 0) || len == NULL || tag > 0x1fff) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	dat_len = *len;
+
+	if (dat_len > 0xffff) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	if ((opt & KSI_TLV_OPT_NO_HEADER) == 0) {
+		hdr_len = (tag > KSI_TLV_MASK_TLV8_TYPE || dat_len > 0xff) ? 4 : 2;
+	}
+
+	if (buf != NULL) {
+		if (buf_size < dat_len + hdr_len) {
+			res = KSI_BUFFER_OVERFLOW;
+			goto cleanup;
+		}
+
+		ptr = buf + buf_size - dat_len - hdr_len;
+
+		if (hdr_len == 4) {
+			ptr[0] = (unsigned char)(KSI_TLV_MASK_TLV16 | (tag >> 8));
+			ptr[1] = tag & 0xff;
+			ptr[2] = (dat_len >> 8) & 0xff;
+			ptr[3] = dat_len & 0xff;
+		} else if (hdr_len == 2) {
+			ptr[0] = (unsigned char)tag;
+			ptr[1] = dat_len & 0xff;
+		}
+
+		if (hdr_len != 0) {
+			if (isNc) ptr[0] |= KSI_TLV_MASK_LENIENT;
+			if (isFwd) ptr[0] |= KSI_TLV_MASK_FORWARD;
+		}
+
+		if ((opt & KSI_TLV_OPT_NO_MOVE) == 0) {
+			memmove(buf, ptr, dat_len + hdr_len);
+		}
+	}
+
+	*len = dat_len + hdr_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
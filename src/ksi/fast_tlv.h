@@ -106,6 +106,21 @@ extern "C" {
 	 */
 	int KSI_FTLV_memReadN(const unsigned char *buf, size_t buf_len, KSI_FTLV *arr, size_t arr_len, size_t *rd);
 
+	/**
+	 * Completes a TLV, whose value of \c len bytes has been written to the end of the buffer, by
+	 * writing the header in front of it. Unless #KSI_TLV_OPT_NO_MOVE is set, the TLV is moved to
+	 * the beginning of the buffer. If \c buf is \c NULL, only the length is calculated.
+	 * \param[in]		tag			TLV tag.
+	 * \param[in]		isNc		Is the TLV non-critical.
+	 * \param[in]		isFwd		Is the TLV forwardable.
+	 * \param[in]		buf			Pointer to the memory buffer (can be \c NULL).
+	 * \param[in]		buf_size	Size of the buffer (must be equal to 0, if \c buf is \c NULL).
+	 * \param[in,out]	len			Length of the value; on return the length of the TLV.
+	 * \param[in]		opt			Options (see #KSI_Serialize_Opt_en).
+	 * \return status code (\c KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FTLV_writeHeader(unsigned tag, int isNc, int isFwd, unsigned char *buf, size_t buf_size, size_t *len, int opt);
+
 
 #ifdef __cplusplus
 }
@@ -24,6 +24,7 @@
 #include "internal.h"
 #include "impl/hash_impl.h"
 #include "tlv.h"
+#include "fast_tlv.h"
 #include "impl/ctx_impl.h"
 
 #define HASH_ALGO(id, bitcount, blocksize, deprecatedFrom, obsoleteFrom) {(id), (bitcount), (blocksize), id##_names, (deprecatedFrom), (obsoleteFrom)}
@@ -365,7 +366,8 @@ int KSI_DataHash_create(KSI_CTX *ctx, const void *data, size_t data_length, KSI_
 		goto cleanup;
 	}
 
-	res = KSI_DataHasher_open(ctx, algo_id, &hsr);
+	/* Use the context's hasher, so the hashing context is not allocated for every call. */
+	res = KSI_DataHasher_openCached(ctx, algo_id, &hsr);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -393,7 +395,80 @@ int KSI_DataHash_create(KSI_CTX *ctx, const void *data, size_t data_length, KSI_
 cleanup:
 
 	KSI_DataHash_free(hsh);
-	KSI_DataHasher_free(hsr);
+	KSI_nofree(hsr);
+
+	return res;
+}
+
+int KSI_DataHash_createBatch(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const void * const *data, const size_t *data_length, size_t count, unsigned char *imprints, size_t imprints_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash hsh;
+	size_t imprint_len;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (count > 0 && (data == NULL || data_length == NULL || imprints == NULL))) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (!KSI_isHashAlgorithmSupported(algo_id)) {
+		KSI_pushError(ctx, res = KSI_UNAVAILABLE_HASH_ALGORITHM, NULL);
+		goto cleanup;
+	}
+
+	imprint_len = KSI_getHashLength(algo_id) + 1;
+	if (count > imprints_size / imprint_len) {
+		KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, "Imprint buffer too small.");
+		goto cleanup;
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_openCached(ctx, algo_id, &hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The first message uses the hasher as returned by the cache, the rest reset it in place. */
+	for (i = 0; i < count; i++) {
+		if (i > 0) {
+			res = hsr->reset(hsr);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		if (data[i] != NULL && data_length[i] > 0) {
+			res = hsr->add(hsr, data[i], data_length[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		res = hsr->closeExisting(hsr, &hsh);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		memcpy(imprints + i * imprint_len, hsh.imprint, imprint_len);
+	}
+
+	hsr->isOpen = false;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(hsr);
 
 	return res;
 }
@@ -422,6 +497,45 @@ int KSI_DataHash_equals(const KSI_DataHash *left, const KSI_DataHash *right) {
 			(left == right || (left->imprint_length == right->imprint_length && !memcmp(left->imprint, right->imprint, left->imprint_length)));
 }
 
+int KSI_DataHash_parseValue(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, int opt, KSI_DataHash **hsh) {
+	return KSI_DataHash_fromImprint(ctx, raw, raw_len, hsh);
+}
+
+int KSI_DataHash_writeTlv(KSI_CTX *ctx, const KSI_DataHash *hsh, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t tmp_len;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || hsh == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (buf != NULL) {
+		if (buf_size < hsh->imprint_length) {
+			KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, NULL);
+			goto cleanup;
+		}
+		memcpy(buf + buf_size - hsh->imprint_length, hsh->imprint, hsh->imprint_length);
+	}
+
+	tmp_len = hsh->imprint_length;
+
+	res = KSI_FTLV_writeHeader(tag, isNonCritical, isForward, buf, buf_size, &tmp_len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*len = tmp_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_DataHash_fromTlv(KSI_TLV *tlv, KSI_DataHash **hsh) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ctx = NULL;
@@ -657,6 +771,84 @@ void KSI_DataHasher_free(KSI_DataHasher *hsr) {
 	}
 }
 
+int KSI_DataHasher_openCached(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher **hasher) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || hasher == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (algo_id < 0 || algo_id >= KSI_NUMBER_OF_KNOWN_HASHALGS) {
+		KSI_pushError(ctx, res = KSI_UNAVAILABLE_HASH_ALGORITHM, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->hasherCache[algo_id] == NULL) {
+		res = KSI_DataHasher_open(ctx, algo_id, &ctx->hasherCache[algo_id]);
+	} else {
+		res = KSI_DataHasher_reset(ctx->hasherCache[algo_id]);
+	}
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*hasher = ctx->hasherCache[algo_id];
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_DataHasher_closeExisting(KSI_DataHasher *hsr, KSI_DataHash *hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (hsr == NULL || hsh == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(hsr->ctx);
+
+	if (!hsr->isOpen) {
+		KSI_pushError(hsr->ctx, res = KSI_INVALID_STATE, "Hasher is already closed.");
+		goto cleanup;
+	}
+
+	if (hsr->closeExisting == NULL) {
+		KSI_pushError(hsr->ctx, res = KSI_INVALID_STATE, "Hasher not properly initialized.");
+		goto cleanup;
+	}
+
+	res = hsr->closeExisting(hsr, hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(hsr->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	hsr->isOpen = false;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+void KSI_DataHasherCache_free(KSI_CTX *ctx) {
+	size_t i;
+
+	if (ctx == NULL) return;
+
+	for (i = 0; i < KSI_NUMBER_OF_KNOWN_HASHALGS; i++) {
+		KSI_DataHasher_free(ctx->hasherCache[i]);
+		ctx->hasherCache[i] = NULL;
+	}
+}
+
 int KSI_DataHasher_addImprint(KSI_DataHasher *hasher, const KSI_DataHash *hsh) {
 	int res = KSI_UNKNOWN_ERROR;
 	const unsigned char *imprint;
@@ -181,6 +181,25 @@ extern "C" {
 	 */
 	int KSI_DataHash_create(KSI_CTX *ctx, const void *data, size_t data_length, KSI_HashAlgorithm algo_id, KSI_DataHash **hash);
 
+	/**
+	 * Calculates the hash values of \c count independent messages using the same algorithm.
+	 * The imprints are written one after another into \c imprints, each of them taking
+	 * #KSI_getHashLength(\c algo_id) + 1 bytes. A single hashing context is reused for all
+	 * the messages and no #KSI_DataHash objects are allocated.
+	 *
+	 * \param[in]	ctx				KSI context.
+	 * \param[in]	algo_id			Hash algorithm id.
+	 * \param[in]	data			Array of \c count pointers to the input messages.
+	 * \param[in]	data_length		Array of \c count message lengths.
+	 * \param[in]	count			Number of messages.
+	 * \param[out]	imprints		Output buffer for the imprints.
+	 * \param[in]	imprints_size	Size of the output buffer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_DataHash_create, #KSI_DataHash_fromImprint
+	 */
+	int KSI_DataHash_createBatch(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, const void * const *data, const size_t *data_length, size_t count, unsigned char *imprints, size_t imprints_size);
+
 	/**
 	 * Creates a clone of the data hash.
 	 *
@@ -359,6 +378,8 @@ extern "C" {
 	int KSI_DataHash_equals(const KSI_DataHash *left, const KSI_DataHash *right);
 
 	KSI_DEFINE_FN_FROM_TLV(KSI_DataHash);
+	KSI_DEFINE_FN_PARSE_VALUE(KSI_DataHash);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_DataHash);
 	KSI_DEFINE_FN_TO_TLV(KSI_DataHash);
 
 	/**
@@ -137,6 +137,10 @@ static int ksi_DataHasher_reset(KSI_DataHasher *hasher) {
 		EVP_MD_CTX_init(context);
 
 		hasher->hashContext = context;
+	} else if (KSI_EVP_MD_CTX_md(context) != NULL) {
+		/* Reinitialize with the digest the context already holds - looking the digest up
+		 * again on every reset is expensive with OpenSSL 3. */
+		evp_md = NULL;
 	}
 
 	if (!EVP_DigestInit_ex(context, evp_md, NULL)) {
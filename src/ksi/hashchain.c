@@ -24,7 +24,9 @@
 #include "hashchain.h"
 #include "tlv.h"
 #include "tlv_template.h"
+#include "impl/ctx_impl.h"
 #include "impl/hashchain_impl.h"
+#include "impl/hash_impl.h"
 #include "impl/meta_data_element_impl.h"
 #include "compatibility.h"
 
@@ -162,11 +164,13 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 	int res = KSI_UNKNOWN_ERROR;
 	int level = startLevel;
 	KSI_DataHasher *hsr = NULL;
+	/* Intermediate link hashes are computed into this scratch value, only the result is allocated. */
+	KSI_DataHash scratch;
 	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *tmp = NULL;
 	KSI_HashChainLink *link = NULL;
 	KSI_HashAlgorithm algo_id = aggr_algo_id;
 	char chr_level;
-	char logMsg[0xff];
 	size_t i;
 
 	KSI_ERR_clearErrors(ctx);
@@ -175,6 +179,10 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 		goto cleanup;
 	}
 
+	scratch.ctx = ctx;
+	scratch.ref = 1;
+	scratch.imprint_length = 0;
+
 	/* If we are calculating the calendar chain, initialize the hash algorithm id using
 	 * the input hash. */
 	if (isCalendar) {
@@ -185,8 +193,9 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 		}
 	}
 
-	KSI_snprintf(logMsg, sizeof(logMsg), "Starting %s hash chain aggregation with input hash.", isCalendar ? "calendar": "aggregation");
-	KSI_LOG_logDataHash(ctx, KSI_LOG_DEBUG, logMsg, inputHash);
+	KSI_LOG_logDataHash(ctx, KSI_LOG_DEBUG, isCalendar ?
+			"Starting calendar hash chain aggregation with input hash." :
+			"Starting aggregation hash chain aggregation with input hash.", inputHash);
 
 	/* Loop over all the links in the chain. */
 	for (i = 0; i < KSI_HashChainLinkList_length(chain); i++) {
@@ -201,32 +210,18 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 			if (levelCorrection > 0xff || level + levelCorrection + 1 > 0xff)
 				KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Aggregation chain level out of range.");
 			level += (int)levelCorrection + 1;
-		} else {
+		} else if (link->isLeft) {
 			/* Update the hash algo id when we encounter a left link. */
-			if (link->isLeft) {
-				KSI_HashAlgorithm tmp;
-				res = KSI_DataHash_extract(link->imprint, &tmp, NULL, NULL);
-				if (res != KSI_OK) {
-					KSI_pushError(ctx, res, NULL);
-					goto cleanup;
-				}
-				/* Update hasher if algo id has changed. */
-				if (tmp != algo_id) {
-					algo_id = tmp;
-
-					KSI_DataHasher_free(hsr);
-					res = KSI_DataHasher_open(ctx, algo_id, &hsr);
-					if (res != KSI_OK) {
-						KSI_pushError(ctx, res, NULL);
-						goto cleanup;
-					}
-				}
+			res = KSI_DataHash_extract(link->imprint, &algo_id, NULL, NULL);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
 			}
 		}
 
-		/* Create or reset the hasher. */
-		if (hsr == NULL) {
-			res = KSI_DataHasher_open(ctx, algo_id, &hsr);
+		/* Get a reset hasher for the current algorithm from the context. */
+		if (hsr == NULL || hsr->algorithm != algo_id) {
+			res = KSI_DataHasher_openCached(ctx, algo_id, &hsr);
 		} else {
 			res = KSI_DataHasher_reset(hsr);
 		}
@@ -270,32 +265,38 @@ static int aggregateChain(KSI_CTX *ctx, KSI_LIST(KSI_HashChainLink) *chain, cons
 		chr_level = (char) level;
 		KSI_DataHasher_add(hsr, &chr_level, 1);
 
-		if (hsh != NULL) {
-			KSI_DataHash_free(hsh);
-			hsh = NULL;
+		/* The previous value has already been fed to the hasher, so it is safe to overwrite it. */
+		res = KSI_DataHasher_closeExisting(hsr, &scratch);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
 		}
+		hsh = &scratch;
+	}
 
-		res = KSI_DataHasher_close(hsr, &hsh);
+	KSI_LOG_logDataHash(ctx, KSI_LOG_DEBUG, isCalendar ?
+			"Finished calendar hash chain aggregation with output hash." :
+			"Finished aggregation hash chain aggregation with output hash.", hsh);
+
+	/* Materialize only the final hash. */
+	if (hsh != NULL) {
+		res = KSI_DataHash_fromImprint(ctx, hsh->imprint, hsh->imprint_length, &tmp);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
 	}
 
-	KSI_snprintf(logMsg, sizeof(logMsg), "Finished %s hash chain aggregation with output hash.", isCalendar ? "calendar": "aggregation");
-	KSI_LOG_logDataHash(ctx, KSI_LOG_DEBUG, logMsg, hsh);
-
 	if (endLevel != NULL) *endLevel = level;
-	if (outputHash != NULL) *outputHash = hsh;
-	hsh = NULL;
-
+	*outputHash = tmp;
+	tmp = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_DataHasher_free(hsr);
-	KSI_DataHash_free(hsh);
+	KSI_nofree(hsr);
+	KSI_DataHash_free(tmp);
 
 	return res;
 }
@@ -414,9 +415,165 @@ cleanup:
 KSI_IMPLEMENT_REF(KSI_CalendarHashChain);
 KSI_IMPLEMENT_WRITE_BYTES(KSI_CalendarHashChain, 0x0802, 0, 0);
 
+typedef struct CalendarRootCacheEntry_st {
+	/* Fingerprint of the key. */
+	KSI_uint64_t hash;
+	/* Input hash and links of the calendar hash chain. */
+	unsigned char *key;
+	size_t key_len;
+	/* Root hash of the calendar hash chain. */
+	KSI_DataHash *root;
+} CalendarRootCacheEntry;
+
+struct KSI_CalendarRootCache_st {
+	/* Direct mapped slots, a new root replaces the one with the same slot. */
+	CalendarRootCacheEntry *slots;
+	size_t size;
+	size_t mask;
+};
+
+void KSI_CalendarRootCache_free(KSI_CalendarRootCache *cache) {
+	if (cache != NULL) {
+		size_t i;
+
+		for (i = 0; i <= cache->mask; i++) {
+			KSI_free(cache->slots[i].key);
+			KSI_DataHash_free(cache->slots[i].root);
+		}
+		KSI_free(cache->slots);
+		KSI_free(cache);
+	}
+}
+
+/* Returns the context memo table, (re)creating it if the configured size has changed. */
+static int calendarRootCache_prepare(KSI_CTX *ctx, KSI_CalendarRootCache **cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarRootCache *tmp = NULL;
+	size_t size = ctx->options[KSI_OPT_CALENDAR_ROOT_CACHE_SIZE];
+	size_t nofSlots = 1;
+
+	if (size > KSI_CTX_CALENDAR_ROOT_CACHE_MAX_SIZE) size = KSI_CTX_CALENDAR_ROOT_CACHE_MAX_SIZE;
+
+	if (ctx->calendarRootCache != NULL && ctx->calendarRootCache->size != size) {
+		KSI_CalendarRootCache_free(ctx->calendarRootCache);
+		ctx->calendarRootCache = NULL;
+	}
+
+	if (ctx->calendarRootCache == NULL && size > 0) {
+		while (nofSlots < size) nofSlots <<= 1;
+
+		if (nofSlots > ((size_t)-1) / sizeof(CalendarRootCacheEntry)) {
+			res = KSI_INVALID_ARGUMENT;
+			goto cleanup;
+		}
+
+		tmp = KSI_new(KSI_CalendarRootCache);
+		if (tmp == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		tmp->size = size;
+		tmp->mask = nofSlots - 1;
+		tmp->slots = KSI_calloc(nofSlots, sizeof(CalendarRootCacheEntry));
+		if (tmp->slots == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		ctx->calendarRootCache = tmp;
+		tmp = NULL;
+	}
+
+	*cache = ctx->calendarRootCache;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) {
+		KSI_free(tmp->slots);
+		KSI_free(tmp);
+	}
+
+	return res;
+}
+
+/**
+ * Serializes the content the root hash depends on: the input hash and the direction and imprint
+ * of every link. Returns #KSI_OK with \c key set to \c NULL, if the chain can not be memoized.
+ */
+static int calendarRootCache_makeKey(const KSI_CalendarHashChain *chain, unsigned char **key, size_t *key_len, KSI_uint64_t *hash) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *tmp = NULL;
+	size_t len = 0;
+	size_t size;
+	KSI_uint64_t h = 0xcbf29ce484222325ull;
+	size_t i;
+
+	*key = NULL;
+
+	if (chain->inputHash == NULL || chain->hashChain == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	size = 1 + chain->inputHash->imprint_length + KSI_HashChainLinkList_length(chain->hashChain) * (2 + KSI_MAX_IMPRINT_LEN);
+	tmp = KSI_malloc(size);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp[len++] = (unsigned char)chain->inputHash->imprint_length;
+	memcpy(tmp + len, chain->inputHash->imprint, chain->inputHash->imprint_length);
+	len += chain->inputHash->imprint_length;
+
+	for (i = 0; i < KSI_HashChainLinkList_length(chain->hashChain); i++) {
+		KSI_HashChainLink *link = NULL;
+
+		res = KSI_HashChainLinkList_elementAt(chain->hashChain, i, &link);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Only the plain imprint links of a calendar hash chain are memoized. */
+		if (link == NULL || link->imprint == NULL || link->legacyId != NULL || link->metaData != NULL) {
+			res = KSI_OK;
+			goto cleanup;
+		}
+
+		tmp[len++] = (unsigned char)(link->isLeft ? 1 : 0);
+		tmp[len++] = (unsigned char)link->imprint->imprint_length;
+		memcpy(tmp + len, link->imprint->imprint, link->imprint->imprint_length);
+		len += link->imprint->imprint_length;
+	}
+
+	/* FNV-1a. */
+	for (i = 0; i < len; i++) {
+		h ^= tmp[i];
+		h *= 0x100000001b3ull;
+	}
+
+	*key = tmp;
+	*key_len = len;
+	*hash = h;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
 int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash **hsh) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_DataHash *tmp = NULL;
+	KSI_CalendarRootCache *cache = NULL;
+	CalendarRootCacheEntry *slot = NULL;
+	unsigned char *key = NULL;
+	size_t key_len = 0;
+	KSI_uint64_t key_hash = 0;
 
 	if (chain == NULL || hsh == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -424,6 +581,29 @@ int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash *
 	}
 	KSI_ERR_clearErrors(chain->ctx);
 
+	if (chain->outputHash == NULL) {
+		res = calendarRootCache_prepare(chain->ctx, &cache);
+		if (res != KSI_OK) {
+			KSI_pushError(chain->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (cache != NULL) {
+			res = calendarRootCache_makeKey(chain, &key, &key_len, &key_hash);
+			if (res != KSI_OK) {
+				KSI_pushError(chain->ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		if (key != NULL) {
+			slot = &cache->slots[key_hash & cache->mask];
+			if (slot->root != NULL && slot->hash == key_hash && slot->key_len == key_len && memcmp(slot->key, key, key_len) == 0) {
+				chain->outputHash = KSI_DataHash_ref(slot->root);
+			}
+		}
+	}
+
 	if (chain->outputHash == NULL) {
 		res = KSI_HashChain_aggregateCalendar(chain->ctx, chain->hashChain, chain->inputHash, &tmp);
 		if (res != KSI_OK) {
@@ -433,6 +613,17 @@ int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash *
 
 		chain->outputHash = tmp;
 		tmp = NULL;
+
+		/* Remember the root for the other copies of the chain. */
+		if (slot != NULL) {
+			KSI_free(slot->key);
+			KSI_DataHash_free(slot->root);
+			slot->hash = key_hash;
+			slot->key = key;
+			slot->key_len = key_len;
+			slot->root = KSI_DataHash_ref(chain->outputHash);
+			key = NULL;
+		}
 	}
 
 	*hsh = KSI_DataHash_ref(chain->outputHash);
@@ -441,6 +632,7 @@ int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash *
 
 cleanup:
 
+	KSI_free(key);
 	KSI_DataHash_free(tmp);
 
 	return res;
@@ -617,6 +809,26 @@ cleanup:
 	return res;
 }
 
+int KSI_CalendarHashChainLink_writeTlv(KSI_CTX *ctx, const KSI_CalendarHashChainLink *link, unsigned KSI_UNUSED(tag), int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || link == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_writeTlv(ctx, link->imprint, link->isLeft ? 0x07 : 0x08, isNonCritical, isForward, buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 int KSI_HashChainLink_fromTlv(KSI_TLV *tlv, KSI_HashChainLink **link) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_HashChainLink *tmp = NULL;
@@ -709,6 +921,26 @@ cleanup:
 	return res;
 }
 
+int KSI_HashChainLink_writeTlv(KSI_CTX *ctx, const KSI_HashChainLink *link, unsigned KSI_UNUSED(tag), int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || link == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_writeBytes(ctx, link, link->isLeft ? 0x07 : 0x08, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_HashChainLink), buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 KSI_IMPLEMENT_GETTER(KSI_HashChainLink, int, isLeft, IsLeft)
 KSI_IMPLEMENT_GETTER(KSI_HashChainLink, KSI_Integer*, levelCorrection, LevelCorrection)
 KSI_IMPLEMENT_GETTER(KSI_HashChainLink, KSI_OctetString*, legacyId, LegacyId)
@@ -826,6 +1058,10 @@ int KSI_HashChainLink_LegacyId_toTlv(KSI_CTX *ctx, const KSI_OctetString *legacy
 	return KSI_OctetString_toTlv(ctx, legacyId, tag, isNonCritical, isForward, tlv);
 }
 
+int KSI_HashChainLink_LegacyId_writeTlv(KSI_CTX *ctx, const KSI_OctetString *legacyId, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	return KSI_OctetString_writeTlv(ctx, legacyId, tag, isNonCritical, isForward, buf, buf_size, len, opt);
+}
+
 void KSI_HashChainLinkIdentity_free(KSI_HashChainLinkIdentity *identity) {
 	if (identity != NULL && --identity->ref == 0) {
 		KSI_Utf8String_free(identity->clientId);
@@ -182,12 +182,15 @@ extern "C" {
 
 	KSI_DEFINE_FN_FROM_TLV(KSI_HashChainLink);
 	KSI_DEFINE_FN_TO_TLV(KSI_HashChainLink);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_HashChainLink);
 
 	int KSI_HashChainLink_LegacyId_fromTlv(KSI_TLV *tlv, KSI_OctetString **legacyId);
 	int KSI_HashChainLink_LegacyId_toTlv(KSI_CTX *ctx, const KSI_OctetString *legacyId, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+	int KSI_HashChainLink_LegacyId_writeTlv(KSI_CTX *ctx, const KSI_OctetString *legacyId, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt);
 
 	KSI_DEFINE_FN_FROM_TLV(KSI_CalendarHashChainLink);
 	KSI_DEFINE_FN_TO_TLV(KSI_CalendarHashChainLink);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_CalendarHashChainLink);
 
 	/**
 	 * KSI_CalendarHashChain
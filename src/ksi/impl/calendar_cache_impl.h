@@ -0,0 +1,96 @@
+/*
+ * Copyright 2013-2017 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef CALENDAR_CACHE_IMPL_H_
+#define CALENDAR_CACHE_IMPL_H_
+
+#include "../types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * Per-context LRU cache of extended calendar hash chains, keyed by the aggregation time
+	 * and the publication time the chain was extended to. The size of the cache is controlled
+	 * by #KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE.
+	 */
+	typedef struct KSI_CalendarChainCache_st KSI_CalendarChainCache;
+
+	/**
+	 * Looks up an extended calendar hash chain.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	aggrTime	Aggregation time of the signature.
+	 * \param[in]	pubTime		Publication time the chain has been extended to.
+	 * \param[out]	chain		Pointer to the receiving pointer. Set to \c NULL, if the chain is not cached.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The caller is responsible for freeing the returned chain.
+	 */
+	int KSI_CalendarChainCache_get(KSI_CTX *ctx, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Adds an extended calendar hash chain to the cache. If the cache is full, the least recently
+	 * used chain is evicted.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	aggrTime	Aggregation time of the signature.
+	 * \param[in]	pubTime		Publication time the chain has been extended to.
+	 * \param[in]	chain		Extended calendar hash chain. The cache keeps its own reference.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarChainCache_add(KSI_CTX *ctx, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, KSI_CalendarHashChain *chain);
+
+	/**
+	 * Frees the calendar hash chain cache.
+	 * \param[in]	cache		The cache.
+	 */
+	void KSI_CalendarChainCache_free(KSI_CalendarChainCache *cache);
+
+	/**
+	 * Per-context memo table of calendar hash chain root hashes, keyed by the content of the
+	 * chain (input hash and links). The signatures of the same round share the calendar hash
+	 * chain, so the root is computed only once for all of them. The size of the table is
+	 * controlled by #KSI_OPT_CALENDAR_ROOT_CACHE_SIZE.
+	 */
+	typedef struct KSI_CalendarRootCache_st KSI_CalendarRootCache;
+
+	/**
+	 * Frees the calendar root hash memo table.
+	 * \param[in]	cache		The memo table.
+	 */
+	void KSI_CalendarRootCache_free(KSI_CalendarRootCache *cache);
+
+	/**
+	 * Per-context cache of successfully verified calendar authentication record signatures, keyed
+	 * by the signed data, the signature value, the signature algorithm and the certificate. Failed
+	 * verifications are never cached. The size of the cache is controlled by
+	 * #KSI_OPT_PKI_SIGNATURE_CACHE_SIZE.
+	 */
+	typedef struct KSI_PKISignatureCache_st KSI_PKISignatureCache;
+
+	/**
+	 * Frees the calendar authentication record signature cache.
+	 * \param[in]	cache		The cache.
+	 */
+	void KSI_PKISignatureCache_free(KSI_PKISignatureCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CALENDAR_CACHE_IMPL_H_ */
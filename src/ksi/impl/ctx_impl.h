@@ -22,6 +22,8 @@
 
 #include "../types.h"
 #include "../hash.h"
+#include "tlv_template_impl.h"
+#include "calendar_cache_impl.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -103,6 +105,21 @@ extern "C" {
 		size_t dataHashRecycle_maxSize;
 		/* This list is used to recycle #KSI_DataHash objects to reduce the number of allocs. */
 		KSI_LIST(KSI_DataHash) *dataHashRecycle;
+
+		/** Templates compiled into tag lookup tables, created lazily by the template parser. */
+		KSI_TlvTemplateCache *tlvTemplateCache;
+
+		/** Hashers reused by the hash chain evaluation, indexed by the hash algorithm id. */
+		KSI_DataHasher *hasherCache[KSI_NUMBER_OF_KNOWN_HASHALGS];
+
+		/** Extended calendar hash chains shared between signature verifications, created lazily. */
+		KSI_CalendarChainCache *calendarChainCache;
+
+		/** Calendar hash chain root hashes shared between the signatures of the same round, created lazily. */
+		KSI_CalendarRootCache *calendarRootCache;
+
+		/** Verified calendar authentication record signatures, created lazily. */
+		KSI_PKISignatureCache *pkiSignatureCache;
 	};
 
 #ifdef __cplusplus
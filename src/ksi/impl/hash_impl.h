@@ -77,6 +77,32 @@ extern "C" {
 		int (*close)(KSI_DataHasher *, KSI_DataHash **);
 	};
 
+	/**
+	 * Returns a reset data hasher for the given algorithm from the per-context hasher cache,
+	 * opening it on first use. The hasher remains owned by the context and must not be freed
+	 * by the caller; it is only valid until the next call with the same algorithm.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	algo_id		Hash algorithm id.
+	 * \param[out]	hasher		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_DataHasher_openCached(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_DataHasher **hasher);
+
+	/**
+	 * Same as #KSI_DataHasher_close, but writes the result into an existing caller-owned
+	 * #KSI_DataHash (e.g. a stack scratch value) instead of allocating a new one.
+	 * \param[in]	hsr			Opened data hasher.
+	 * \param[in]	hsh			Data hash to be overwritten.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_DataHasher_closeExisting(KSI_DataHasher *hsr, KSI_DataHash *hsh);
+
+	/**
+	 * Frees all the hashers in the context hasher cache.
+	 * \param[in]	ctx			KSI context.
+	 */
+	void KSI_DataHasherCache_free(KSI_CTX *ctx);
+
 #ifdef __cplusplus
 }
 #endif
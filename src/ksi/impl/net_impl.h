@@ -112,6 +112,12 @@ extern "C" {
 		int (*status)(KSI_RequestHandle *);
 	};
 
+	/** Intrusive FIFO of async handles, linked through the handles themselves. */
+	typedef struct KSI_AsyncHandleQueue_st {
+		KSI_AsyncHandle *head;
+		KSI_AsyncHandle *tail;
+	} KSI_AsyncHandleQueue;
+
 	struct KSI_AsyncHandle_st {
 		KSI_CTX *ctx;
 		size_t ref;
@@ -122,6 +128,8 @@ extern "C" {
 		/** Application layer request context. */
 		KSI_AggregationReq *aggrReq;
 		KSI_ExtendReq *extReq;
+		/** Signature to be extended with the extension response (\c NULL if not set). */
+		KSI_Signature *extSig;
 
 		/** Application layer response context. */
 		void *respCtx;
@@ -150,8 +158,56 @@ extern "C" {
 		time_t sndTime;
 		/** Time when the response has been reeived. */
 		time_t rcvTime;
+
+		/** Async client which request cache holds the handle (\c NULL if not cached). */
+		KSI_AsyncClient *client;
+		/** Client queue the handle is linked into (\c NULL if none). */
+		KSI_AsyncHandleQueue *queue;
+		KSI_AsyncHandle *prev;
+		KSI_AsyncHandle *next;
+
+		/** Set while a multi endpoint client keeps track of the request. */
+		bool routed;
 	};
 
+	/**
+	 * Updates the handle state. Transport implementations must use this function instead of
+	 * assigning the state directly, as the async client keeps track of the handles waiting for
+	 * a response and of the handles ready to be returned to the user.
+	 * \param[in]	h			Async handle.
+	 * \param[in]	state		New state (see #KSI_AsyncHandleState).
+	 */
+	void KSI_AsyncHandle_setState(KSI_AsyncHandle *h, int state);
+
+	/**
+	 * Lowers the \c timeout so that it does not exceed the time left until the \c deadline.
+	 * \param[in,out]	timeout		Timeout in milliseconds, negative if not set.
+	 * \param[in]		deadline	Absolute deadline.
+	 */
+	void KSI_AsyncTimeout_update(long *timeout, time_t deadline);
+
+	/**
+	 * Creates a new async client distributing the requests between several endpoint transports.
+	 * Each request is routed to the endpoint with the lowest round-trip time (exponentially weighted
+	 * moving average), weighted by the number of requests the endpoint is busy with. A request that
+	 * fails on connection level is resubmitted to another endpoint, while the failed endpoint is avoided
+	 * for a backoff interval.
+	 * \param[in]	ctx			KSI context.
+	 * \param[out]	c			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_MultiAsyncClient_addEndpoint
+	 */
+	int KSI_MultiAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c);
+
+	/**
+	 * Adds an endpoint transport to the multi endpoint client.
+	 * \param[in]	c			Multi endpoint async client.
+	 * \param[in]	endpoint	Endpoint transport, the ownership is taken on success.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note All of the endpoints must use the same credentials, as the requests are only signed once.
+	 */
+	int KSI_MultiAsyncClient_addEndpoint(KSI_AsyncClient *c, KSI_AsyncClient *endpoint);
+
 	enum KSI_AsyncPrivateOption_en {
 		__KSI_ASYNC_PRIVOPT_OFFSET = __KSI_ASYNC_OPT_COUNT,
 
@@ -162,6 +218,19 @@ extern "C" {
 		 */
 		KSI_ASYNC_PRIVOPT_ROUND_DURATION,
 
+		/**
+		 * Number of send system calls made by the transport. The counter can be reset by setting it to 0.
+		 * \param[in]		count			Paramer of type size_t.
+		 */
+		KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT,
+
+		/**
+		 * Number of requests completely written by the transport. Together with #KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT
+		 * gives the average number of requests written per system call.
+		 * \param[in]		count			Paramer of type size_t.
+		 */
+		KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT,
+
 		__NOF_KSI_ASYNC_OPT
 	};
 
@@ -175,6 +244,10 @@ extern "C" {
 		int (*getResponse)(void *, KSI_OctetString **, size_t *);
 		int (*getCredentials)(void *, const char **, const char **);
 		int (*dispatch)(void *);
+		/** Optional, see #KSI_AsyncService_getPollFds. */
+		int (*getPollFds)(void *, KSI_AsyncPollFd *, size_t, size_t *);
+		/** Optional, timeout of the transport layer (see #KSI_AsyncService_getTimeout). */
+		int (*getTimeout)(void *, long *);
 
 		KSI_uint64_t instanceId;
 		KSI_uint64_t messageId;
@@ -183,7 +256,11 @@ extern "C" {
 		size_t requestCount; /**< Request cache position of the last allocated handle. */
 
 		KSI_AsyncHandle **reqCache; /**< Request cache. */
-		size_t tail; /**< Request cache position of the last handle that was returned to the used. */
+		size_t *freeSlots; /**< Circular FIFO of free request cache positions. */
+		size_t freeHead; /**< Position of the next free slot in \c freeSlots. */
+		size_t freeCount; /**< Nof free request cache positions. */
+		KSI_AsyncHandleQueue waitQueue; /**< Requests waiting for a response, in send order. */
+		KSI_AsyncHandleQueue readyQueue; /**< Finalized requests to be returned to the user. */
 		size_t pending; /**< Nof pending requests (including in error state). */
 		size_t received; /**< Nof received valid responses. */
 
@@ -205,6 +282,9 @@ extern "C" {
 		int (*getPendingCount)(void *, size_t *);
 		int (*getReceivedCount)(void *, size_t *);
 
+		int (*getPollFds)(void *, KSI_AsyncPollFd *, size_t, size_t *);
+		int (*getTimeout)(void *, long *);
+
 		int (*setOption)(void *, int, void *);
 		int (*getOption)(void *, int, void *);
 
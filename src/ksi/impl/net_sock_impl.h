@@ -35,6 +35,7 @@
 #    include <unistd.h>
 #  endif
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #  include <sys/ioctl.h>
 #  include <netinet/in.h>
 #  include <netinet/tcp.h>
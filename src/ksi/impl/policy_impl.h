@@ -36,6 +36,12 @@ struct KSI_Policy_st {
 	const char *policyName;
 };
 
+typedef struct VerificationBatchData_st {
+
+	/** Publications file received and verified once for all of the signatures of the batch. */
+	KSI_PublicationsFile *publicationsFile;
+} VerificationBatchData;
+
 typedef struct VerificationTempData_st {
 
 	/** Temporary extended signature calendar hash chain. */
@@ -46,6 +52,9 @@ typedef struct VerificationTempData_st {
 
 	/** Signature aggregation output hash (calendar chain input hash). */
 	KSI_DataHash *aggregationOutputHash;
+
+	/** Data shared between the signatures verified with #KSI_SignatureVerifier_verifyBatch, \c NULL otherwise. */
+	VerificationBatchData *batch;
 } VerificationTempData;
 
 
@@ -33,6 +33,29 @@ extern "C" {
 		KSI_Signature *sig;
 	};
 
+	/**
+	 * Serializes the signature as #KSI_SignatureBuilder_appendAggregationChain leaves it before
+	 * appending an aggregation hash chain with the given root level. The signature of a leaf is the
+	 * output extended with the chain returned by #KSI_SignatureBuilder_serializeAggregationChain.
+	 * \param[in]	sig			The signature of the aggregation tree root.
+	 * \param[in]	rootLevel	Output level of the aggregation hash chain of the leaf.
+	 * \param[out]	raw			Pointer to the receiving pointer of the serialized signature.
+	 * \param[out]	raw_len		Length of the serialized signature.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureBuilder_serializeBase(const KSI_Signature *sig, int rootLevel, unsigned char **raw, size_t *raw_len);
+
+	/**
+	 * Updates the aggregation time and the chain index of the aggregation hash chain of a leaf as
+	 * #KSI_SignatureBuilder_appendAggregationChain does, and serializes the chain. An empty chain
+	 * is not appended to the signature, so the output is \c NULL for it.
+	 * \param[in]	sig			The signature of the aggregation tree root.
+	 * \param[in]	aggr		Aggregation hash chain from the leaf to the root of the tree.
+	 * \param[out]	raw			Pointer to the receiving pointer of the serialized chain.
+	 * \param[out]	raw_len		Length of the serialized chain.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureBuilder_serializeAggregationChain(const KSI_Signature *sig, KSI_AggregationHashChain *aggr, unsigned char **raw, size_t *raw_len);
 
 #ifdef __cplusplus
 }
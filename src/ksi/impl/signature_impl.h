@@ -99,6 +99,18 @@ extern "C" {
 	};
 
 
+	/**
+	 * Creates an extended copy of the signature \c sig by replacing its calendar hash chain with the one
+	 * from the extension response \c resp. The calendar authentication record and the publication record
+	 * are removed. The response is verified against the request \c req, but the returned signature is not.
+	 * \param[in]	sig			Signature to be extended.
+	 * \param[in]	req			Extension request \c resp is a response to.
+	 * \param[in]	resp		Extension response.
+	 * \param[out]	extended	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Signature_extendWithResponse(const KSI_Signature *sig, const KSI_ExtendReq *req, const KSI_ExtendResp *resp, KSI_Signature **extended);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef TLV_TEMPLATE_IMPL_H_
+#define TLV_TEMPLATE_IMPL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * Per-context cache of compiled templates. Every template is compiled on
+	 * first use into a tag lookup table, so parsing does not have to scan the
+	 * template for every element.
+	 */
+	typedef struct KSI_TlvTemplateCache_st KSI_TlvTemplateCache;
+
+	/**
+	 * Frees the compiled template cache.
+	 * \param[in]	cache		The cache.
+	 */
+	void KSI_TlvTemplateCache_free(KSI_TlvTemplateCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TLV_TEMPLATE_IMPL_H_ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef TREE_BUILDER_IMPL_H_
+#define TREE_BUILDER_IMPL_H_
+
+#include "../internal.h"
+#include "../tree_builder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * Computes the mask value of a batch leaf, see #KSI_FlatTreeBuilder_addBatch. The function
+	 * is called for every leaf in the order of the leaves, always on the calling thread.
+	 * \param[in]	c			Context of the function.
+	 * \param[in]	leaf		Hash value of the leaf.
+	 * \param[in]	level		Level of the leaf.
+	 * \param[out]	mask		The mask value, the imprint may not be longer than the imprints of the tree.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	typedef int (*KSI_FlatTreeMaskFn)(void *c, const KSI_DataHash *leaf, int level, KSI_DataHash *mask);
+
+	/**
+	 * Adds a batch of leaves to the tree. Every leaf is first joined with its mask (as the right
+	 * sibling) and then with the meta-data node, if given, exactly as the leaf processors of
+	 * #KSI_BlockSigner would do. The masks are computed on the calling thread, while the
+	 * complete binary subtrees of the batch are built concurrently by the workers. The
+	 * resulting tree is identical to the one built by adding the leaves one by one.
+	 * \param[in]	builder		The builder, may not have any leaf processors.
+	 * \param[in]	hashes		The hash values of the leaves.
+	 * \param[in]	count		Number of leaves.
+	 * \param[in]	level		Level of the leaves.
+	 * \param[in]	maskFn		Mask function, or \c NULL if the leaves are not masked.
+	 * \param[in]	maskCtx		Context of the mask function.
+	 * \param[in]	metaData	Meta-data joined with every leaf, may be \c NULL.
+	 * \param[in]	workers		Hashers for the worker threads, each opened with a private context
+	 * 							and the algorithm of the tree.
+	 * \param[in]	workerCount	Number of worker threads in addition to the calling thread.
+	 * \param[out]	leafIds		Output array for the leaf indices, \c count elements, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Without thread support, the whole batch is processed on the calling thread.
+	 * \note With a spill file (see #KSI_FlatTreeBuilder_setSpillFile), the batch is added in parts
+	 * of at most a spill window of nodes. If a part fails, the leaves of the preceding parts stay in the tree.
+	 */
+	int KSI_FlatTreeBuilder_addBatch(KSI_FlatTreeBuilder *builder, KSI_DataHash * const *hashes, size_t count, int level,
+			KSI_FlatTreeMaskFn maskFn, void *maskCtx, KSI_MetaData *metaData, KSI_DataHasher **workers, size_t workerCount, size_t *leafIds);
+
+	/**
+	 * Returns the roots of the complete binary trees of an unfinished tree, i.e. the frontier the
+	 * rest of the tree is built upon. The root at level \c i, if any, is stored at \c roots[i].
+	 * \param[in]	builder		The builder.
+	 * \param[out]	roots		Output array of #KSI_TREE_BUILDER_STACK_LEN elements, the caller is
+	 * 							responsible for freeing the values.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Fails with #KSI_INVALID_STATE if the tree is closed or a root is a meta-data value.
+	 * \see #KSI_FlatTreeBuilder_setFrontier
+	 */
+	int KSI_FlatTreeBuilder_getFrontier(const KSI_FlatTreeBuilder *builder, KSI_DataHash **roots);
+
+	/**
+	 * Initializes an empty builder with the frontier returned by #KSI_FlatTreeBuilder_getFrontier,
+	 * so the leaves added after this call end up in the same tree as they would in the original
+	 * builder. The hash chains are only available for the leaves added after this call.
+	 * \param[in]	builder		The builder, may not have any nodes.
+	 * \param[in]	roots		Array of #KSI_TREE_BUILDER_STACK_LEN elements, \c NULL for the missing roots.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FlatTreeBuilder_setFrontier(KSI_FlatTreeBuilder *builder, KSI_DataHash * const *roots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TREE_BUILDER_IMPL_H_ */
@@ -186,6 +186,23 @@ cleanup: \
 	return res; \
 }
 
+#define KSI_IMPLEMENT_WRITE_TLV(type) \
+int type##_writeTlv(KSI_CTX *ctx, const type *data, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) { \
+	int res; \
+	\
+	KSI_ERR_clearErrors(ctx);\
+	\
+	res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(type), buf, buf_size, len, opt); \
+	if (res != KSI_OK) { \
+		KSI_pushError(ctx, res, NULL); \
+		goto cleanup; \
+	} \
+	\
+cleanup: \
+	\
+	return res; \
+}
+
 #define KSI_IMPLEMENT_FROMTLV(type, tag, addon) \
 int type##_fromTlv(KSI_TLV *tlv, type **data) { \
 	int res; \
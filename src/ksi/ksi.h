@@ -334,6 +334,11 @@ enum KSI_StatusCode {
 #define KSI_PDU_VERSION_2		2
 
 #define KSI_CTX_PUBFILE_CACHE_DEFAULT_TTL (8 * 60 * 60)
+#define KSI_CTX_CALENDAR_CHAIN_CACHE_DEFAULT_SIZE 0
+#define KSI_CTX_CALENDAR_CHAIN_CACHE_MAX_SIZE (1 << 20)
+#define KSI_CTX_CALENDAR_ROOT_CACHE_DEFAULT_SIZE 256
+#define KSI_CTX_CALENDAR_ROOT_CACHE_MAX_SIZE (1 << 20)
+#define KSI_CTX_PKI_SIGNATURE_CACHE_DEFAULT_SIZE 64
 
 /**
  * Service configuration receive callback.
@@ -398,6 +403,39 @@ typedef enum KSI_Option_en {
 	 */
 	KSI_OPT_PUBFILE_CACHE_TTL_SECONDS,
 
+	/**
+	 * Maximum number of extended calendar hash chains kept by the context. The signatures aggregated
+	 * in the same second and verified against the same publication share the extended calendar hash
+	 * chain, thus only the first of them needs to be extended by the extender. Once the cache is full,
+	 * the least recently used chain is dropped.
+	 * \param		count		Cache size. Paramer of type size_t.
+	 * \see			#KSI_CTX_getCalendarChainCacheStats
+	 * \note		The cache is disabled by default (size 0). Changing the size flushes the cache. Sizes
+	 *				larger than #KSI_CTX_CALENDAR_CHAIN_CACHE_MAX_SIZE are truncated.
+	 */
+	KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE,
+
+	/**
+	 * Number of calendar hash chain root hashes remembered by the context. The root hash is looked
+	 * up by the content of the calendar hash chain, thus the signatures of the same round, each with
+	 * its own copy of the chain, need to compute it only once.
+	 * \param		count		Cache size. Paramer of type size_t.
+	 * \note		Setting the size to 0 disables the cache. Changing the size flushes the cache. Sizes
+	 *				larger than #KSI_CTX_CALENDAR_ROOT_CACHE_MAX_SIZE are truncated.
+	 */
+	KSI_OPT_CALENDAR_ROOT_CACHE_SIZE,
+
+	/**
+	 * Number of successfully verified calendar authentication record signatures remembered by the
+	 * context. The signatures of the same round share the authentication record, thus the PKI
+	 * signature of the record needs to be verified only once. A result is looked up by the signed
+	 * data, the signature value, the signature algorithm and the certificate used for verification.
+	 * \param		count		Cache size. Paramer of type size_t.
+	 * \see			#KSI_CTX_getPKISignatureCacheStats
+	 * \note		Setting the size to 0 disables the cache. Changing the size flushes the cache.
+	 */
+	KSI_OPT_PKI_SIGNATURE_CACHE_SIZE,
+
 	__KSI_NUMBER_OF_OPTIONS,
 } KSI_Option;
 
@@ -827,6 +865,28 @@ int KSI_CTX_getPublicationCertEmail(KSI_CTX *ctx, const char **address);
  */
 int KSI_CTX_getLastFailedSignature(KSI_CTX *ctx, KSI_Signature **lastFailedSignature);
 
+/**
+ * Getter for the extended calendar hash chain cache statistics.
+ * \param[in]	ctx						Pointer to #KSI_CTX.
+ * \param[out]	hits					Number of extensions served from the cache, may be \c NULL.
+ * \param[out]	misses					Number of extensions that had to be sent to the extender, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE
+ * \note The counters are reset when the cache size is changed.
+ */
+int KSI_CTX_getCalendarChainCacheStats(KSI_CTX *ctx, size_t *hits, size_t *misses);
+
+/**
+ * Getter for the calendar authentication record signature cache statistics.
+ * \param[in]	ctx						Pointer to #KSI_CTX.
+ * \param[out]	hits					Number of PKI signatures found in the cache, may be \c NULL.
+ * \param[out]	misses					Number of PKI signatures that had to be verified, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_OPT_PKI_SIGNATURE_CACHE_SIZE
+ * \note The counters are reset when the cache size is changed.
+ */
+int KSI_CTX_getPKISignatureCacheStats(KSI_CTX *ctx, size_t *hits, size_t *misses);
+
 /**
  * @}
  */
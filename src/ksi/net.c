@@ -1302,6 +1302,8 @@ int KSI_AbstractAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
 	tmp->run = NULL;
 	tmp->getPendingCount = NULL;
 	tmp->getReceivedCount = NULL;
+	tmp->getPollFds = NULL;
+	tmp->getTimeout = NULL;
 	tmp->setOption = NULL;
 
 	tmp->uriSplit = uriSplit;
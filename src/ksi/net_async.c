@@ -24,7 +24,9 @@
 #include "internal.h"
 #include "signature_builder.h"
 #include "impl/signature_builder_impl.h"
+#include "impl/signature_impl.h"
 #include "impl/net_impl.h"
+#include "impl/net_sock_impl.h"
 #include "impl/ctx_impl.h"
 
 #define KSI_ASYNC_REQUEST_ID_OFFSET 32
@@ -35,13 +37,19 @@
 #define KSI_ASYNC_DEFAULT_ROUND_MAX_COUNT 1
 #define KSI_ASYNC_DEFAULT_REQUEST_CACHE_SIZE 1
 #define KSI_ASYNC_DEFAULT_TIMEOUT_SEC 10
+#define KSI_ASYNC_DEFAULT_CONNECTION_COUNT 1
 #define KSI_ASYNC_ROUND_DURATION_SEC 1
 
 #define KSI_ASYNC_CACHE_START_POS 1
 
+/* Nof descriptors #KSI_AsyncService_wait handles without allocating memory. */
+#define KSI_ASYNC_WAIT_FDS_LEN 8
+
 void KSI_AsyncHandle_free(KSI_AsyncHandle *o) {
 	if (o != NULL && --o->ref == 0) {
 		KSI_AggregationReq_free(o->aggrReq);
+		KSI_ExtendReq_free(o->extReq);
+		KSI_Signature_free(o->extSig);
 		if (o->respCtx_free) o->respCtx_free(o->respCtx);
 		if (o->userCtx_free) o->userCtx_free(o->userCtx);
 		KSI_free(o->raw);
@@ -77,6 +85,7 @@ static int KSI_AbstractAsyncHandle_new(KSI_CTX *ctx, KSI_AsyncHandle **o) {
 
 	tmp->aggrReq = NULL;
 	tmp->extReq = NULL;
+	tmp->extSig = NULL;
 
 	tmp->respCtx = NULL;
 	tmp->respCtx_free = NULL;
@@ -94,6 +103,12 @@ static int KSI_AbstractAsyncHandle_new(KSI_CTX *ctx, KSI_AsyncHandle **o) {
 	tmp->errExt = 0L;
 	tmp->errMsg = NULL;
 
+	tmp->client = NULL;
+	tmp->queue = NULL;
+	tmp->routed = false;
+	tmp->prev = NULL;
+	tmp->next = NULL;
+
 	*o = tmp;
 	tmp = NULL;
 
@@ -120,6 +135,67 @@ cleanup:
 	return res;
 }
 
+int KSI_AsyncExtendHandle_new(KSI_CTX *ctx, KSI_ExtendReq *req, KSI_AsyncHandle **o) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL || req == NULL || o == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_AbstractAsyncHandle_new(ctx, o);
+	if (res != KSI_OK) goto cleanup;
+
+	(*o)->extReq = req;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+int KSI_AsyncSignatureExtendHandle_new(KSI_CTX *ctx, KSI_Signature *sig, KSI_Integer *pubTime, KSI_AsyncHandle **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *signTime = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_AsyncHandle *tmp = NULL;
+
+	if (ctx == NULL || sig == NULL || o == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(ctx);
+
+	/* Request the calendar hash chain from the signing time on. */
+	res = KSI_Signature_getSigningTime(sig, &signTime);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_createExtendRequest(ctx, signTime, pubTime, &req);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AsyncExtendHandle_new(ctx, req, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	req = NULL;
+
+	tmp->extSig = KSI_Signature_ref(sig);
+
+	*o = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_ExtendReq_free(req);
+	KSI_AsyncHandle_free(tmp);
+	return res;
+}
+
 KSI_IMPLEMENT_REF(KSI_AsyncHandle)
 
 KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, int, state, State)
@@ -129,6 +205,7 @@ KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, KSI_Utf8String *, errMsg, ErrorMessage)
 KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, const void *, userCtx, RequestCtx)
 KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, KSI_uint64_t, id, RequestId)
 KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, KSI_AggregationReq *, aggrReq, AggregationReq)
+KSI_IMPLEMENT_GETTER(KSI_AsyncHandle, KSI_ExtendReq *, extReq, ExtendReq)
 
 int KSI_AsyncHandle_getAggregationResp(const KSI_AsyncHandle *h, KSI_AggregationResp **resp) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -147,6 +224,23 @@ cleanup:
 	return res;
 }
 
+int KSI_AsyncHandle_getExtendResp(const KSI_AsyncHandle *h, KSI_ExtendResp **resp) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (h == NULL || resp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	if (h->extReq == NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+	*resp = (KSI_ExtendResp*)h->respCtx;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int createSignature(const KSI_AsyncHandle *h, KSI_Signature **sig) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Signature *tmp = NULL;
@@ -209,6 +303,47 @@ cleanup:
 	return res;
 }
 
+static int createExtendedSignature(const KSI_AsyncHandle *h, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Signature *tmp = NULL;
+
+	if (h == NULL || sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(h->ctx);
+
+	if (h->extReq == NULL || h->respCtx == NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	if (h->extSig == NULL) {
+		KSI_pushError(h->ctx, res = KSI_INVALID_STATE, "Signature to be extended is missing.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_extendWithResponse(h->extSig, h->extReq, (KSI_ExtendResp *)h->respCtx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_verifyWithPolicy(tmp, NULL, 0, KSI_VERIFICATION_POLICY_INTERNAL, NULL);
+	if (res != KSI_OK) {
+		KSI_pushError(h->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_Signature_free(tmp);
+	return res;
+}
+
 int KSI_AsyncHandle_getSignature(const KSI_AsyncHandle *h, KSI_Signature **signature) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -225,8 +360,11 @@ int KSI_AsyncHandle_getSignature(const KSI_AsyncHandle *h, KSI_Signature **signa
 			goto cleanup;
 		}
 	} else if (h->extReq != NULL) {
-		KSI_pushError(h->ctx, res = KSI_INVALID_STATE, "Not implemented.");
-		goto cleanup;
+		res = createExtendedSignature(h, signature);
+		if (res != KSI_OK) {
+			KSI_pushError(h->ctx, res, NULL);
+			goto cleanup;
+		}
 	} else {
 		KSI_pushError(h->ctx, res = KSI_INVALID_STATE, "Request is missing.");
 		goto cleanup;
@@ -271,25 +409,96 @@ cleanup:
 }
 
 
+static void asyncHandleQueue_remove(KSI_AsyncHandle *h) {
+	KSI_AsyncHandleQueue *q = h->queue;
+
+	if (q == NULL) return;
+
+	if (h->prev != NULL) h->prev->next = h->next;
+	else q->head = h->next;
+	if (h->next != NULL) h->next->prev = h->prev;
+	else q->tail = h->prev;
+
+	h->queue = NULL;
+	h->prev = NULL;
+	h->next = NULL;
+}
+
+static void asyncHandleQueue_append(KSI_AsyncHandleQueue *q, KSI_AsyncHandle *h) {
+	asyncHandleQueue_remove(h);
+
+	h->queue = q;
+	h->prev = q->tail;
+	h->next = NULL;
+	if (q->tail != NULL) q->tail->next = h;
+	else q->head = h;
+	q->tail = h;
+}
+
+void KSI_AsyncHandle_setState(KSI_AsyncHandle *h, int state) {
+	KSI_AsyncClient *c = NULL;
+
+	if (h == NULL) return;
+
+	h->state = state;
+
+	c = h->client;
+	if (c == NULL) return;
+
+	switch (state) {
+		case KSI_ASYNC_STATE_WAITING_FOR_RESPONSE:
+			/* The requests are sent in order, thus the oldest request is always at the head. */
+			asyncHandleQueue_append(&c->waitQueue, h);
+			break;
+
+		case KSI_ASYNC_STATE_ERROR:
+		case KSI_ASYNC_STATE_RESPONSE_RECEIVED:
+		case KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED:
+			if (h->queue != &c->readyQueue) asyncHandleQueue_append(&c->readyQueue, h);
+			break;
+
+		default:
+			asyncHandleQueue_remove(h);
+			break;
+	}
+}
+
+void KSI_AsyncTimeout_update(long *timeout, time_t deadline) {
+	double left;
+	long ms;
+
+	if (timeout == NULL) return;
+
+	left = difftime(deadline, time(NULL));
+	ms = left > 0 ? (long)(left * 1000) : 0;
+	if (*timeout < 0 || ms < *timeout) *timeout = ms;
+}
+
 static int asyncClient_calculateRequestId(KSI_AsyncClient *c, KSI_uint64_t *id, KSI_uint64_t *offset) {
 	int res = KSI_UNKNOWN_ERROR;
+	size_t slot;
 
-	if (c == NULL || c->reqCache == NULL || id == NULL || offset == NULL) {
+	if (c == NULL || c->reqCache == NULL || c->freeSlots == NULL || id == NULL || offset == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	do {
-		/* Check if the cache is full. */
-		if ((c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]) == (c->pending + c->received + 1)) {
-			res = KSI_ASYNC_REQUEST_CACHE_FULL;
-			goto cleanup;
-		}
-		if (++c->requestCount == c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]) {
-			c->requestCountOffset =  (c->requestCountOffset + 1) % KSI_ASYNC_REQUEST_ID_OFFSET_MAX;
-			c->requestCount = KSI_ASYNC_CACHE_START_POS;
-		}
-	} while (c->reqCache[c->requestCount] != NULL);
+	/* Check if the cache is full. */
+	if ((c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]) == (c->pending + c->received + 1) || c->freeCount == 0) {
+		res = KSI_ASYNC_REQUEST_CACHE_FULL;
+		goto cleanup;
+	}
+
+	/* Take the slot that has been free for the longest time. */
+	slot = c->freeSlots[c->freeHead];
+	c->freeHead = (c->freeHead + 1) % (c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] - KSI_ASYNC_CACHE_START_POS);
+	c->freeCount--;
+
+	/* Increase the request id entropy each time the slots wrap around. */
+	if (slot <= c->requestCount) {
+		c->requestCountOffset = (c->requestCountOffset + 1) % KSI_ASYNC_REQUEST_ID_OFFSET_MAX;
+	}
+	c->requestCount = slot;
 
 	*id = c->requestCount;
 	*offset = c->requestCountOffset;
@@ -298,6 +507,53 @@ cleanup:
 	return res;
 }
 
+static void asyncClient_releaseRequestId(KSI_AsyncClient *c, size_t slot) {
+	size_t size = c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] - KSI_ASYNC_CACHE_START_POS;
+
+	c->freeSlots[(c->freeHead + c->freeCount) % size] = slot;
+	c->freeCount++;
+}
+
+static int asyncClient_resizeFreeSlots(KSI_AsyncClient *c, size_t count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t *tmp = NULL;
+	size_t size = 0;
+	size_t i;
+	size_t n = 0;
+
+	tmp = KSI_calloc(count - KSI_ASYNC_CACHE_START_POS, sizeof(size_t));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	/* Keep the order of the slots that are already free. */
+	if (c->freeSlots != NULL) {
+		size = c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] - KSI_ASYNC_CACHE_START_POS;
+		for (i = 0; i < c->freeCount; i++) {
+			tmp[n++] = c->freeSlots[(c->freeHead + i) % size];
+		}
+		size += KSI_ASYNC_CACHE_START_POS;
+	} else {
+		size = KSI_ASYNC_CACHE_START_POS;
+	}
+
+	for (i = size; i < count; i++) {
+		tmp[n++] = i;
+	}
+
+	KSI_free(c->freeSlots);
+	c->freeSlots = tmp;
+	tmp = NULL;
+	c->freeHead = 0;
+	c->freeCount = n;
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(tmp);
+	return res;
+}
+
 static int asyncClient_composeRequestHeader(KSI_AsyncClient *c, KSI_Header **hdr) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Header *tmp = NULL;
@@ -465,6 +721,11 @@ static int asyncClient_addAggregatorRequest(KSI_AsyncClient *c, KSI_AsyncHandle
 	if (reqHsh != NULL) {
 		c->reqCache[id] = handle;
 		c->pending++;
+
+		/* The state may already have been updated by the transport. */
+		handle->client = c;
+		KSI_AsyncHandle_setState(handle, handle->state);
+		id = 0;
 	}
 
 	/* Cache the config request separatelly, as the response can not be assigned to any request in the common cache. */
@@ -502,6 +763,9 @@ static int asyncClient_addAggregatorRequest(KSI_AsyncClient *c, KSI_AsyncHandle
 
 	res = KSI_OK;
 cleanup:
+	/* Return the request id if the request was not cached. */
+	if (id != 0) asyncClient_releaseRequestId(c, (size_t)id);
+
 	KSI_AggregationReq_free(tmpReq);
 	KSI_AsyncHandle_free(confHandle);
 	KSI_Header_free(hdr);
@@ -512,18 +776,180 @@ cleanup:
 	return res;
 }
 
-static void asyncClient_setResponseError(KSI_AsyncClient *c, int state, int err, long extErr, KSI_Utf8String *errMsg) {
-	size_t i;
+static int asyncClient_addExtenderRequest(KSI_AsyncClient *c, KSI_AsyncHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_ExtendReq *reqRef = NULL;
+	KSI_ExtendPdu *pdu = NULL;
+	unsigned char *raw = NULL;
+	size_t len;
+	KSI_AsyncHandle *hndlRef = NULL;
+	KSI_Integer *reqId = NULL;
+	const char *pass = NULL;
+	KSI_uint64_t id = 0;
+	KSI_uint64_t idOffset = 0;
+	KSI_uint64_t requestId = 0;
+	void *impl = NULL;
+	KSI_ExtendReq *extReq = NULL;
+	KSI_Header *hdr = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Config *reqConf = NULL;
+	KSI_AsyncHandle *confHandle = NULL;
+	KSI_ExtendReq *tmpReq = NULL;
 
-	if (c == NULL) return;
+	if (c == NULL || handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (handle->extReq == NULL ||
+			c->clientImpl == NULL || c->addRequest == NULL || c->getCredentials == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not initialized properly.");
+		goto cleanup;
+	}
+	impl = c->clientImpl;
+	extReq = handle->extReq;
+
+	/* Cleanup the handle in case it has been added repeteadly. */
+	KSI_free(handle->raw);
+	handle->raw = NULL;
+	KSI_Utf8String_free(handle->errMsg);
+	handle->errMsg = NULL;
+	if (handle->respCtx_free) handle->respCtx_free(handle->respCtx);
+	handle->respCtx = NULL;
+	handle->respCtx_free = NULL;
+	handle->id = 0;
+
+	res = KSI_ExtendReq_getAggregationTime(extReq, &aggrTime);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_getConfig(extReq, &reqConf);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Update request id only in case of extension request. */
+	if (aggrTime != NULL) {
+		res = KSI_ExtendReq_getRequestId(extReq, &reqId);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Clear the request id that was set. */
+		if (reqId != NULL) {
+			KSI_Integer_free(reqId);
+			res = KSI_ExtendReq_setRequestId(extReq, (reqId = NULL));
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		/* Verify if there is spare place in the request cache and get the request id. */
+		res = asyncClient_calculateRequestId(c, &id, &idOffset);
+		if (res != KSI_OK) goto cleanup;
+
+		requestId = (idOffset << KSI_ASYNC_REQUEST_ID_OFFSET) | id;
+		res = KSI_Integer_new(c->ctx, requestId, &reqId);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendReq_setRequestId(extReq, reqId);
+		if (res != KSI_OK) goto cleanup;
+		reqId = NULL;
+	}
+
+	res = c->getCredentials(impl, NULL, &pass);
+	if (res != KSI_OK) goto cleanup;
+
+	res = asyncClient_composeRequestHeader(c, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_encloseWithHeader((reqRef = KSI_ExtendReq_ref(extReq)), hdr, pass, &pdu);
+	if (res != KSI_OK) {
+		KSI_ExtendReq_free(reqRef);
+		goto cleanup;
+	}
+	hdr = NULL;
+
+	res = KSI_ExtendPdu_serialize(pdu, &raw, &len);
+	if (res != KSI_OK) goto cleanup;
+
+	handle->id = requestId;
+	handle->raw = raw;
+	raw = NULL;
+	handle->len = len;
+	handle->sentCount = 0;
+
+	/* Add request to the impl output queue. The query might fail if the queue is full. */
+	res = c->addRequest(impl, (hndlRef = KSI_AsyncHandle_ref(handle)));
+	if (res != KSI_OK) {
+		KSI_AsyncHandle_free(hndlRef);
+		goto cleanup;
+	}
+
+	/* Set extension request into local cache. */
+	if (aggrTime != NULL) {
+		c->reqCache[id] = handle;
+		c->pending++;
+
+		/* The state may already have been updated by the transport. */
+		handle->client = c;
+		KSI_AsyncHandle_setState(handle, handle->state);
+		id = 0;
+	}
+
+	/* Cache the config request separatelly, as the response can not be assigned to any request in the common cache. */
+	if (reqConf != NULL) {
+		/* Check if this is a multy-payload request. */
+		if (aggrTime != NULL) {
+			KSI_Config *confRef = NULL;
+
+			/* Create a separate conf request handle. */
+			res = KSI_ExtendReq_new(c->ctx, &tmpReq);
+			if (res != KSI_OK) goto cleanup;
+
+			res = KSI_ExtendReq_setConfig(tmpReq, (confRef = KSI_Config_ref(reqConf)));
+			if (res != KSI_OK) {
+				KSI_Config_free(confRef);
+				goto cleanup;
+			}
 
-	for (i = KSI_ASYNC_CACHE_START_POS; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
-		if (c->reqCache[i] != NULL && c->reqCache[i]->state == state) {
-			c->reqCache[i]->state = KSI_ASYNC_STATE_ERROR;
-			c->reqCache[i]->err = err;
-			c->reqCache[i]->errExt = extErr;
-			c->reqCache[i]->errMsg = KSI_Utf8String_ref(errMsg);
+			res = KSI_AsyncExtendHandle_new(c->ctx, tmpReq, &confHandle);
+			if (res != KSI_OK) goto cleanup;
+			tmpReq = NULL;
+
+			/* Copy the send state from the initial handle. */
+			confHandle->state = handle->state;
+			confHandle->reqTime = handle->reqTime;
+		} else {
+			/* This is a server conf request. */
+			confHandle = handle;
 		}
+
+		c->serverConf = confHandle;
+		confHandle = NULL;
+		c->pending++;
+	}
+
+	res = KSI_OK;
+cleanup:
+	/* Return the request id if the request was not cached. */
+	if (id != 0) asyncClient_releaseRequestId(c, (size_t)id);
+
+	KSI_ExtendReq_free(tmpReq);
+	KSI_AsyncHandle_free(confHandle);
+	KSI_Header_free(hdr);
+	KSI_free(raw);
+	KSI_Integer_free(reqId);
+	KSI_ExtendPdu_free(pdu);
+
+	return res;
+}
+
+static void asyncClient_setResponseError(KSI_AsyncClient *c, int err, long extErr, KSI_Utf8String *errMsg) {
+	KSI_AsyncHandle *h = NULL;
+
+	if (c == NULL) return;
+
+	/* All the handles in the wait queue are in the response wait state. */
+	while ((h = c->waitQueue.head) != NULL) {
+		h->err = err;
+		h->errExt = extErr;
+		h->errMsg = KSI_Utf8String_ref(errMsg);
+		KSI_AsyncHandle_setState(h, KSI_ASYNC_STATE_ERROR);
 	}
 }
 
@@ -588,92 +1014,313 @@ static int asyncClient_handleAggregationResp(KSI_AsyncClient *c, KSI_Aggregation
 			KSI_AggregationResp_getErrorMsg(resp, &errorMsg);
 			KSI_LOG_error(c->ctx, "Async aggregation request failed: [%llx] %s", (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
 
-			handle->state = KSI_ASYNC_STATE_ERROR;
-			handle->err = res;
-			handle->errExt = (long)KSI_Integer_getUInt64(status);
-			handle->errMsg = KSI_Utf8String_ref(errorMsg);
-		} else {
-			res = KSI_AggregationPdu_setResponse(pdu, NULL);
+			handle->err = res;
+			handle->errExt = (long)KSI_Integer_getUInt64(status);
+			handle->errMsg = KSI_Utf8String_ref(errorMsg);
+			KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
+		} else {
+			res = KSI_AggregationPdu_setResponse(pdu, NULL);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+			handle->respCtx = (void*)resp;
+			handle->respCtx_free = (void (*)(void*))KSI_AggregationResp_free;
+
+			KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+			c->pending--;
+			c->received++;
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_handleExtendResp(KSI_AsyncClient *c, KSI_ExtendPdu *pdu) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *reqId = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_uint64_t id = 0;
+	KSI_ExtendResp *resp = NULL;
+
+	if (c == NULL || pdu == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(c->ctx);
+
+	/* Get response object. */
+	res = KSI_ExtendPdu_getResponse(pdu, &resp);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (resp == NULL) {
+		/* The response PDU does not include extension response. */
+		goto cleanup;
+	}
+
+	res = KSI_ExtendResp_getRequestId(resp, &reqId);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res , NULL);
+		goto cleanup;
+	}
+
+	id = KSI_Integer_getUInt64(reqId) & KSI_ASYNC_REQUEST_ID_MASK;
+	if (c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE] <= id ||
+			(handle = c->reqCache[id]) == NULL || handle->id != KSI_Integer_getUInt64(reqId)) {
+		KSI_LOG_warn(c->ctx, "Unexpected async extension response received.");
+		goto cleanup;
+	}
+
+	if (handle->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
+		KSI_Integer *status = NULL;
+
+		/* Verify response status. */
+		res = KSI_ExtendResp_getStatus(resp, &status);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_convertExtenderStatusCode(status);
+		if (res != KSI_OK) {
+			KSI_Utf8String *errorMsg = NULL;
+
+			KSI_ExtendResp_getErrorMsg(resp, &errorMsg);
+			KSI_LOG_error(c->ctx, "Async extension request failed: [%llx] %s", (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
+
+			handle->err = res;
+			handle->errExt = (long)KSI_Integer_getUInt64(status);
+			handle->errMsg = KSI_Utf8String_ref(errorMsg);
+			KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
+		} else {
+			res = KSI_ExtendResp_verifyWithRequest(resp, handle->extReq);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = KSI_ExtendPdu_setResponse(pdu, NULL);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+			handle->respCtx = (void*)resp;
+			handle->respCtx_free = (void (*)(void*))KSI_ExtendResp_free;
+
+			KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+			c->pending--;
+			c->received++;
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int asyncClient_handleServerConfig(KSI_AsyncClient *c, KSI_Config *config, int confCallbackOpt) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *confHandle = NULL;
+
+	if (c == NULL || config == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (c->serverConf != NULL) {
+		c->serverConf->state = KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED;
+		/* Update internal state if the request has been requested. */
+		if ((c->serverConf->aggrReq != NULL || c->serverConf->extReq != NULL) && c->serverConf->respCtx == NULL) {
+			c->pending--;
+			c->received++;
+		}
+		/* Clear previoous response if present, as it will be renewed. */
+		if (c->serverConf->respCtx != NULL) c->serverConf->respCtx_free(c->serverConf->respCtx);
+		/* Set received config. */
+		c->serverConf->respCtx = (void*)KSI_Config_ref(config);
+		c->serverConf->respCtx_free = (void (*)(void*))KSI_Config_free;
+	} else {
+		KSI_Config_Callback confCallback = (KSI_Config_Callback)(c->ctx->options[confCallbackOpt]);
+
+		/* It is push conf which was not explicitly requested. Invoke the user conf receive callback. */
+		if (confCallback != NULL) {
+			res = confCallback(c->ctx, config);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+		} else {
+			/* Create an empty handle. */
+			res = KSI_AbstractAsyncHandle_new(c->ctx, &confHandle);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			confHandle->respCtx = (void*)KSI_Config_ref(config);
+			confHandle->respCtx_free = (void (*)(void*))KSI_Config_free;
+
+			confHandle->state = KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED;
+			c->received++;
+
+			c->serverConf = confHandle;
+			confHandle = NULL;
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncHandle_free(confHandle);
+
+	return res;
+}
+
+static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *resp = NULL;
+	KSI_AggregationPdu *pdu = NULL;
+	void *impl = NULL;
+	size_t left = 0;
+	KSI_ErrorPdu *errPdu = NULL;
+
+	if (c == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (c->clientImpl == NULL || c->getResponse == NULL || c->getCredentials == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_STATE, "Async client is not properly initialized.");
+		goto cleanup;
+	}
+	impl = c->clientImpl;
+
+	do {
+		/* Cleanup leftovers from previous cycle. */
+		KSI_OctetString_free(resp);
+		resp = NULL;
+		KSI_AggregationPdu_free(pdu);
+		pdu = NULL;
+
+		res = c->getResponse(impl, &resp, &left);
+		if (res != KSI_OK) {
+			KSI_pushError(c->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (resp != NULL) {
+			KSI_ErrorPdu *error = NULL;
+			KSI_Config *tmpConf = NULL;
+			const char *pass = NULL;
+			const unsigned char *raw = NULL;
+			size_t len = 0;
+
+			res = KSI_OctetString_extract(resp, &raw, &len);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			KSI_LOG_logBlob(c->ctx, KSI_LOG_DEBUG, "Parsing aggregation response", raw, len);
+
+			/* Get PDU object. */
+			res = KSI_AggregationPdu_parse(c->ctx, raw, len, &pdu);
+			if(res != KSI_OK){
+				KSI_LOG_logBlob(c->ctx, KSI_LOG_ERROR, "Parsing aggregation response failed", raw, len);
+				KSI_pushError(c->ctx, res, "Unable to parse aggregation pdu.");
+				goto cleanup;
+			}
+
+			/* Check for error PDU. */
+			res = KSI_AggregationPdu_getError(pdu, &error);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
 			}
-			handle->respCtx = (void*)resp;
-			handle->respCtx_free = (void (*)(void*))KSI_AggregationResp_free;
-
-			handle->state = KSI_ASYNC_STATE_RESPONSE_RECEIVED;
-			c->pending--;
-			c->received++;
-		}
-	}
-
-	res = KSI_OK;
-cleanup:
-	return res;
-}
-
-static int asyncClient_handleServerConfig(KSI_AsyncClient *c, KSI_Config *config) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_AsyncHandle *confHandle = NULL;
-
-	if (c == NULL || config == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-	KSI_ERR_clearErrors(c->ctx);
+			if (error != NULL) {
+				res = KSI_AggregationPdu_setError(pdu, NULL);
+				if (res != KSI_OK) {
+					KSI_pushError(c->ctx, res, NULL);
+					goto cleanup;
+				}
+				KSI_ErrorPdu_free(errPdu);
+				/* Keep the error until all responses have been processed. */
+				errPdu = error;
 
-	if (c->serverConf != NULL) {
-		c->serverConf->state = KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED;
-		/* Update internal state if the request has been requested. */
-		if (c->serverConf->aggrReq != NULL && c->serverConf->respCtx == NULL) {
-			c->pending--;
-			c->received++;
-		}
-		/* Clear previoous response if present, as it will be renewed. */
-		if (c->serverConf->respCtx != NULL) c->serverConf->respCtx_free(c->serverConf->respCtx);
-		/* Set received config. */
-		c->serverConf->respCtx = (void*)KSI_Config_ref(config);
-		c->serverConf->respCtx_free = (void (*)(void*))KSI_Config_free;
-	} else {
-		KSI_Config_Callback confCallback = (KSI_Config_Callback)(c->ctx->options[KSI_OPT_AGGR_CONF_RECEIVED_CALLBACK]);
+				continue;
+			}
 
-		/* It is push conf which was not explicitly requested. Invoke the user conf receive callback. */
-		if (confCallback != NULL) {
-			res = confCallback(c->ctx, config);
+			res = c->getCredentials(impl, NULL, &pass);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
 			}
-		} else {
-			/* Create an empty handle. */
-			res = KSI_AbstractAsyncHandle_new(c->ctx, &confHandle);
+
+			res = KSI_AggregationPdu_verify(pdu, pass);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
 			}
 
-			confHandle->respCtx = (void*)KSI_Config_ref(config);
-			confHandle->respCtx_free = (void (*)(void*))KSI_Config_free;
+			res = KSI_AggregationPdu_getConfResponse(pdu, &tmpConf);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res, NULL);
+				goto cleanup;
+			}
 
-			confHandle->state = KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED;
-			c->received++;
+			/* Handle push config. */
+			if (tmpConf != NULL) {
+				res = asyncClient_handleServerConfig(c, tmpConf, KSI_OPT_AGGR_CONF_RECEIVED_CALLBACK);
+				if (res != KSI_OK) {
+					KSI_pushError(c->ctx, res , NULL);
+					goto cleanup;
+				}
+			}
 
-			c->serverConf = confHandle;
-			confHandle = NULL;
+			res = asyncClient_handleAggregationResp(c, pdu);
+			if (res != KSI_OK) {
+				KSI_pushError(c->ctx, res , NULL);
+				goto cleanup;
+			}
 		}
+	} while (left != 0);
+
+	/* Handle error PDU. */
+	if (errPdu != NULL) {
+		KSI_Utf8String *errorMsg = NULL;
+		KSI_Integer *status = NULL;
+
+		KSI_ErrorPdu_getErrorMessage(errPdu, &errorMsg);
+		KSI_ErrorPdu_getStatus(errPdu, &status);
+
+		KSI_LOG_error(c->ctx, "Async received error PDU: [%x:%llx] %s",
+				(unsigned)KSI_convertAggregatorStatusCode(status), (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
+
+		/* Set all handles that are still in response wait state into error state. */
+		asyncClient_setResponseError(c,
+				KSI_convertAggregatorStatusCode(status), (long)KSI_Integer_getUInt64(status), errorMsg);
 	}
 
 	res = KSI_OK;
 cleanup:
-	KSI_AsyncHandle_free(confHandle);
+	KSI_ErrorPdu_free(errPdu);
+	KSI_OctetString_free(resp);
+	KSI_AggregationPdu_free(pdu);
 
 	return res;
 }
 
-static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
+static int asyncClient_processExtenderResponseQueue(KSI_AsyncClient *c) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_OctetString *resp = NULL;
-	KSI_AggregationPdu *pdu = NULL;
+	KSI_ExtendPdu *pdu = NULL;
 	void *impl = NULL;
 	size_t left = 0;
 	KSI_ErrorPdu *errPdu = NULL;
@@ -695,7 +1342,7 @@ static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
 		/* Cleanup leftovers from previous cycle. */
 		KSI_OctetString_free(resp);
 		resp = NULL;
-		KSI_AggregationPdu_free(pdu);
+		KSI_ExtendPdu_free(pdu);
 		pdu = NULL;
 
 		res = c->getResponse(impl, &resp, &left);
@@ -717,24 +1364,24 @@ static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
 				goto cleanup;
 			}
 
-			KSI_LOG_logBlob(c->ctx, KSI_LOG_DEBUG, "Parsing aggregation response", raw, len);
+			KSI_LOG_logBlob(c->ctx, KSI_LOG_DEBUG, "Parsing extension response", raw, len);
 
 			/* Get PDU object. */
-			res = KSI_AggregationPdu_parse(c->ctx, raw, len, &pdu);
+			res = KSI_ExtendPdu_parse(c->ctx, raw, len, &pdu);
 			if(res != KSI_OK){
-				KSI_LOG_logBlob(c->ctx, KSI_LOG_ERROR, "Parsing aggregation response failed", raw, len);
-				KSI_pushError(c->ctx, res, "Unable to parse aggregation pdu.");
+				KSI_LOG_logBlob(c->ctx, KSI_LOG_ERROR, "Parsing extension response failed", raw, len);
+				KSI_pushError(c->ctx, res, "Unable to parse extension pdu.");
 				goto cleanup;
 			}
 
 			/* Check for error PDU. */
-			res = KSI_AggregationPdu_getError(pdu, &error);
+			res = KSI_ExtendPdu_getError(pdu, &error);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
 			}
 			if (error != NULL) {
-				res = KSI_AggregationPdu_setError(pdu, NULL);
+				res = KSI_ExtendPdu_setError(pdu, NULL);
 				if (res != KSI_OK) {
 					KSI_pushError(c->ctx, res, NULL);
 					goto cleanup;
@@ -752,13 +1399,13 @@ static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
 				goto cleanup;
 			}
 
-			res = KSI_AggregationPdu_verify(pdu, pass);
+			res = KSI_ExtendPdu_verify(pdu, pass);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
 			}
 
-			res = KSI_AggregationPdu_getConfResponse(pdu, &tmpConf);
+			res = KSI_ExtendPdu_getConfResponse(pdu, &tmpConf);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res, NULL);
 				goto cleanup;
@@ -766,14 +1413,14 @@ static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
 
 			/* Handle push config. */
 			if (tmpConf != NULL) {
-				res = asyncClient_handleServerConfig(c, tmpConf);
+				res = asyncClient_handleServerConfig(c, tmpConf, KSI_OPT_EXT_CONF_RECEIVED_CALLBACK);
 				if (res != KSI_OK) {
 					KSI_pushError(c->ctx, res , NULL);
 					goto cleanup;
 				}
 			}
 
-			res = asyncClient_handleAggregationResp(c, pdu);
+			res = asyncClient_handleExtendResp(c, pdu);
 			if (res != KSI_OK) {
 				KSI_pushError(c->ctx, res , NULL);
 				goto cleanup;
@@ -790,18 +1437,18 @@ static int asyncClient_processAggregationResponseQueue(KSI_AsyncClient *c) {
 		KSI_ErrorPdu_getStatus(errPdu, &status);
 
 		KSI_LOG_error(c->ctx, "Async received error PDU: [%x:%llx] %s",
-				(unsigned)KSI_convertAggregatorStatusCode(status), (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
+				(unsigned)KSI_convertExtenderStatusCode(status), (unsigned long long)KSI_Integer_getUInt64(status), KSI_Utf8String_cstr(errorMsg));
 
 		/* Set all handles that are still in response wait state into error state. */
-		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE,
-				KSI_convertAggregatorStatusCode(status), (long)KSI_Integer_getUInt64(status), errorMsg);
+		asyncClient_setResponseError(c,
+				KSI_convertExtenderStatusCode(status), (long)KSI_Integer_getUInt64(status), errorMsg);
 	}
 
 	res = KSI_OK;
 cleanup:
 	KSI_ErrorPdu_free(errPdu);
 	KSI_OctetString_free(resp);
-	KSI_AggregationPdu_free(pdu);
+	KSI_ExtendPdu_free(pdu);
 
 	return res;
 }
@@ -815,8 +1462,8 @@ static bool asyncClient_finalizeRequest(KSI_AsyncClient *c, KSI_AsyncHandle *han
 			if (c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] == 0 ||
 				difftime(time(NULL), handle->sndTime) > c->options[KSI_ASYNC_OPT_RCV_TIMEOUT]) {
 				/* Set handle into error state and return it. */
-				handle->state = KSI_ASYNC_STATE_ERROR;
 				handle->err = KSI_NETWORK_RECIEVE_TIMEOUT;
+				KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 				c->pending--;
 				return true;
 			}
@@ -838,7 +1485,8 @@ static bool asyncClient_finalizeRequest(KSI_AsyncClient *c, KSI_AsyncHandle *han
 
 static int asyncClient_findNextResponse(KSI_AsyncClient *c, KSI_AsyncHandle **handle) {
 	int res;
-	size_t last;
+	KSI_AsyncHandle *tmp = NULL;
+	time_t curTime = 0;
 
 	if (c == NULL || handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -866,22 +1514,31 @@ static int asyncClient_findNextResponse(KSI_AsyncClient *c, KSI_AsyncHandle **ha
 		goto cleanup;
 	}
 
-	/* Search cache for finalized requests. */
-	last = c->tail;
-	for (;;) {
-		if (asyncClient_finalizeRequest(c, c->reqCache[c->tail]) == true) {
-			*handle = c->reqCache[c->tail];
-			c->reqCache[c->tail] = NULL;
-			res = KSI_OK;
-			goto cleanup;
-		}
+	/* Expire the requests that have been waiting for a response for too long. As the wait queue
+	 * is in send order, only the requests at the head of the queue need to be checked. */
+	time(&curTime);
+	while ((tmp = c->waitQueue.head) != NULL) {
+		if (c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] != 0 &&
+				difftime(curTime, tmp->sndTime) <= c->options[KSI_ASYNC_OPT_RCV_TIMEOUT]) break;
 
-		if (++c->tail == c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]) c->tail = KSI_ASYNC_CACHE_START_POS;
-		if (c->tail == last) {
-			/* We are back at where we began the search. There are no finalized requests to return yet. */
-			break;
-		}
+		tmp->err = KSI_NETWORK_RECIEVE_TIMEOUT;
+		KSI_AsyncHandle_setState(tmp, KSI_ASYNC_STATE_ERROR);
+	}
+
+	/* Return the oldest finalized request. */
+	if ((tmp = c->readyQueue.head) != NULL && asyncClient_finalizeRequest(c, tmp) == true) {
+		size_t slot = (size_t)(tmp->id & KSI_ASYNC_REQUEST_ID_MASK);
+
+		asyncHandleQueue_remove(tmp);
+		tmp->client = NULL;
+		c->reqCache[slot] = NULL;
+		asyncClient_releaseRequestId(c, slot);
+
+		*handle = tmp;
+		res = KSI_OK;
+		goto cleanup;
 	}
+
 	/* Nothing to return. */
 	*handle = NULL;
 	res = KSI_OK;
@@ -911,7 +1568,7 @@ static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient
 	} else if (res != KSI_OK) {
 		KSI_pushError(c->ctx, res, "Async client impl returned error.");
 		KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
-		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE, res, 0L, NULL);
+		asyncClient_setResponseError(c, res, 0L, NULL);
 	}
 
 	/* Handle responses. */
@@ -920,13 +1577,13 @@ static int asyncClient_run(KSI_AsyncClient *c, int (*handleResp)(KSI_AsyncClient
 	if (res != KSI_OK) {
 		KSI_pushError(c->ctx, res, "Async client failed to process responses.");
 		KSI_LOG_logCtxError(c->ctx, KSI_LOG_ERROR);
-		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE, res, 0L, NULL);
+		asyncClient_setResponseError(c, res, 0L, NULL);
 	}
 
 	/* Update request state if connection has been closed remotely. */
 	if (connClosed) {
 		/* Set all handles that are still in response wait state into error state. */
-		asyncClient_setResponseError(c, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE,
+		asyncClient_setResponseError(c,
 				KSI_ASYNC_CONNECTION_CLOSED, 0L, NULL);
 	}
 
@@ -945,6 +1602,66 @@ cleanup:
 	return res;
 }
 
+static int asyncClient_getPollFds(KSI_AsyncClient *c, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (c == NULL || (fds == NULL && fds_len != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (c->getPollFds == NULL) {
+		/* The transport does not expose any descriptors. */
+		*count = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = c->getPollFds(c->clientImpl, fds, fds_len, count);
+cleanup:
+	return res;
+}
+
+static int asyncClient_getTimeout(KSI_AsyncClient *c, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	long tmp = -1;
+	long implTimeout = -1;
+
+	if (c == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Finalized requests can be returned right away. */
+	if (c->readyQueue.head != NULL || (c->serverConf != NULL &&
+			(c->serverConf->state == KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED || c->serverConf->state == KSI_ASYNC_STATE_ERROR))) {
+		*timeout = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* The oldest request in the wait queue is the first one to expire. */
+	if (c->waitQueue.head != NULL) {
+		KSI_AsyncTimeout_update(&tmp, c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] == 0 ? 0 :
+				c->waitQueue.head->sndTime + (time_t)c->options[KSI_ASYNC_OPT_RCV_TIMEOUT] + 1);
+	}
+
+	if (c->getTimeout != NULL) {
+		res = c->getTimeout(c->clientImpl, &implTimeout);
+		if (res != KSI_OK) goto cleanup;
+
+		if (implTimeout >= 0 && (tmp < 0 || implTimeout < tmp)) tmp = implTimeout;
+	} else if (c->pending + c->received > 0) {
+		/* The transport can not be waited on. */
+		tmp = 0;
+	}
+
+	*timeout = tmp;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 int asyncClient_getPendingCount(KSI_AsyncClient *c, size_t *count) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -1006,6 +1723,10 @@ static int asyncClient_setOption(KSI_AsyncClient *c, int opt, void *param) {
 						for (i = 0; i < c->options[opt]; i++) {
 							tmpCache[i] = c->reqCache[i];
 						}
+
+						res = asyncClient_resizeFreeSlots(c, count);
+						if (res != KSI_OK) goto cleanup;
+
 						KSI_free(c->reqCache);
 						c->reqCache = tmpCache;
 						tmpCache = NULL;
@@ -1022,7 +1743,17 @@ static int asyncClient_setOption(KSI_AsyncClient *c, int opt, void *param) {
 			c->options[opt] = (size_t)param;
 			break;
 
+		case KSI_ASYNC_OPT_CONNECTION_COUNT:
+			if ((size_t)param == 0 || (size_t)param < c->options[opt]) {
+				KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, "Connection count may not be decreased.");
+				goto cleanup;
+			}
+			c->options[opt] = (size_t)param;
+			break;
+
 		case KSI_ASYNC_PRIVOPT_ROUND_DURATION:
+		case KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT:
+		case KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT:
 			c->options[opt] = (size_t)param;
 			break;
 
@@ -1055,8 +1786,11 @@ static int asyncClient_getOption(KSI_AsyncClient *c, int opt, void *param) {
 		case KSI_ASYNC_OPT_RCV_TIMEOUT:
 		case KSI_ASYNC_OPT_SND_TIMEOUT:
 		case KSI_ASYNC_OPT_MAX_REQUEST_COUNT:
+		case KSI_ASYNC_OPT_CONNECTION_COUNT:
 		/* Private options. */
 		case KSI_ASYNC_PRIVOPT_ROUND_DURATION:
+		case KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT:
+		case KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT:
 			*(size_t*)param = c->options[opt];
 			break;
 		case KSI_ASYNC_OPT_REQUEST_CACHE_SIZE:
@@ -1083,6 +1817,7 @@ static int asyncClient_setDefaultOptions(KSI_AsyncClient *c) {
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_SND_TIMEOUT, (void *)KSI_ASYNC_DEFAULT_TIMEOUT_SEC)) != KSI_OK) goto cleanup;
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)KSI_ASYNC_DEFAULT_REQUEST_CACHE_SIZE)) != KSI_OK) goto cleanup;
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)KSI_ASYNC_DEFAULT_ROUND_MAX_COUNT)) != KSI_OK) goto cleanup;
+	if ((res = asyncClient_setOption(c, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)KSI_ASYNC_DEFAULT_CONNECTION_COUNT)) != KSI_OK) goto cleanup;
 	/* Private options. */
 	if ((res = asyncClient_setOption(c, KSI_ASYNC_PRIVOPT_ROUND_DURATION, (void *)KSI_ASYNC_ROUND_DURATION_SEC)) != KSI_OK) goto cleanup;
 cleanup:
@@ -1096,9 +1831,15 @@ void KSI_AsyncClient_free(KSI_AsyncClient *c) {
 		/* Clear cached handles. */
 		if (c->reqCache != NULL) {
 			size_t i;
-			for (i = 0; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) KSI_AsyncHandle_free(c->reqCache[i]);
+			for (i = 0; i < c->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]; i++) {
+				if (c->reqCache[i] == NULL) continue;
+				asyncHandleQueue_remove(c->reqCache[i]);
+				c->reqCache[i]->client = NULL;
+				KSI_AsyncHandle_free(c->reqCache[i]);
+			}
 			KSI_free(c->reqCache);
 		}
+		KSI_free(c->freeSlots);
 		KSI_AsyncHandle_free(c->serverConf);
 
 		KSI_free(c);
@@ -1125,9 +1866,15 @@ int KSI_AbstractAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 
 	tmp->requestCountOffset = 0;
 	tmp->requestCount = 0;
-	tmp->tail = 1;
 
 	tmp->reqCache = NULL;
+	tmp->freeSlots = NULL;
+	tmp->freeHead = 0;
+	tmp->freeCount = 0;
+	tmp->waitQueue.head = NULL;
+	tmp->waitQueue.tail = NULL;
+	tmp->readyQueue.head = NULL;
+	tmp->readyQueue.tail = NULL;
 	tmp->pending = 0;
 	tmp->received = 0;
 	tmp->serverConf = NULL;
@@ -1136,10 +1883,13 @@ int KSI_AbstractAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	tmp->getResponse = NULL;
 	tmp->dispatch = NULL;
 	tmp->getCredentials = NULL;
+	tmp->getPollFds = NULL;
+	tmp->getTimeout = NULL;
 
 	tmp->instanceId = time(NULL);
 	tmp->messageId = 0;
 
+	memset(tmp->options, 0, sizeof(tmp->options));
 	res = asyncClient_setDefaultOptions(tmp);
 	if (res != KSI_OK) goto cleanup;
 
@@ -1149,6 +1899,9 @@ int KSI_AbstractAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 		goto cleanup;
 	}
 
+	res = asyncClient_resizeFreeSlots(tmp, tmp->options[KSI_ASYNC_OPT_REQUEST_CACHE_SIZE]);
+	if (res != KSI_OK) goto cleanup;
+
 	*c = tmp;
 	tmp = NULL;
 	res = KSI_OK;
@@ -1237,6 +1990,47 @@ int KSI_SigningAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
 	tmp->getPendingCount = (int (*)(void *, size_t *))asyncClient_getPendingCount;
 	tmp->getReceivedCount = (int (*)(void *, size_t *))asyncClient_getReceivedCount;
 
+	tmp->getPollFds = (int (*)(void *, KSI_AsyncPollFd *, size_t, size_t *))asyncClient_getPollFds;
+	tmp->getTimeout = (int (*)(void *, long *))asyncClient_getTimeout;
+
+	tmp->setOption = (int (*)(void *, int, void *))asyncClient_setOption;
+	tmp->getOption = (int (*)(void *, int, void *))asyncClient_getOption;
+
+	*service = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncService_free(tmp);
+	return res;
+}
+
+int KSI_ExtendingAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncService *tmp = NULL;
+
+	if (ctx == NULL || service == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_AbstractAsyncService_new(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))asyncClient_addExtenderRequest;
+	tmp->responseHandler = (int (*)(void *))asyncClient_processExtenderResponseQueue;
+	tmp->run = (int (*)(void *, int (*)(void *), KSI_AsyncHandle **, size_t *))asyncClient_run;
+
+	tmp->getPendingCount = (int (*)(void *, size_t *))asyncClient_getPendingCount;
+	tmp->getReceivedCount = (int (*)(void *, size_t *))asyncClient_getReceivedCount;
+
+	tmp->getPollFds = (int (*)(void *, KSI_AsyncPollFd *, size_t, size_t *))asyncClient_getPollFds;
+	tmp->getTimeout = (int (*)(void *, long *))asyncClient_getTimeout;
+
 	tmp->setOption = (int (*)(void *, int, void *))asyncClient_setOption;
 	tmp->getOption = (int (*)(void *, int, void *))asyncClient_getOption;
 
@@ -1259,6 +2053,101 @@ int KSI_AsyncService_getReceivedCount(KSI_AsyncService *s, size_t *count) {
 	return s->getReceivedCount(s->impl, count);
 }
 
+int KSI_AsyncService_getPollFds(KSI_AsyncService *s, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count) {
+	if (s == NULL || s->impl == NULL || s->getPollFds == NULL) return KSI_INVALID_ARGUMENT;
+	return s->getPollFds(s->impl, fds, fds_len, count);
+}
+
+int KSI_AsyncService_getTimeout(KSI_AsyncService *s, long *timeout) {
+	if (s == NULL || s->impl == NULL || s->getTimeout == NULL) return KSI_INVALID_ARGUMENT;
+	return s->getTimeout(s->impl, timeout);
+}
+
+int KSI_AsyncService_wait(KSI_AsyncService *s, long timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncPollFd fdsBuf[KSI_ASYNC_WAIT_FDS_LEN];
+	struct pollfd pfdsBuf[KSI_ASYNC_WAIT_FDS_LEN];
+	KSI_AsyncPollFd *fds = fdsBuf;
+	struct pollfd *pfds = pfdsBuf;
+	size_t fds_len = KSI_ASYNC_WAIT_FDS_LEN;
+	size_t count = 0;
+	long srvTimeout = -1;
+	size_t i;
+
+	if (s == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(s->ctx);
+
+	res = KSI_AsyncService_getTimeout(s, &srvTimeout);
+	if (res != KSI_OK) {
+		KSI_pushError(s->ctx, res, NULL);
+		goto cleanup;
+	}
+	if (srvTimeout >= 0 && (timeout < 0 || srvTimeout < timeout)) timeout = srvTimeout;
+
+	/* There is something to process right away. */
+	if (timeout == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	while ((res = KSI_AsyncService_getPollFds(s, fds, fds_len, &count)) == KSI_BUFFER_OVERFLOW) {
+		if (fds != fdsBuf) KSI_free(fds);
+		if (pfds != pfdsBuf) KSI_free(pfds);
+		fds = NULL;
+		pfds = NULL;
+
+		fds = KSI_malloc(sizeof(KSI_AsyncPollFd) * count);
+		pfds = KSI_malloc(sizeof(struct pollfd) * count);
+		if (fds == NULL || pfds == NULL) {
+			KSI_pushError(s->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		fds_len = count;
+	}
+	if (res != KSI_OK) {
+		KSI_pushError(s->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Do not block forever if there is nothing in process. */
+	if (count == 0 && timeout < 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+	if (timeout > INT_MAX) timeout = INT_MAX;
+
+	if (count == 0) {
+#ifdef _WIN32
+		Sleep((DWORD)timeout);
+#else
+		poll(NULL, 0, (int)timeout);
+#endif
+	} else {
+		for (i = 0; i < count; i++) {
+			pfds[i].fd = fds[i].fd;
+			pfds[i].events = 0;
+			pfds[i].revents = 0;
+			if (fds[i].events & KSI_ASYNC_EVENT_READ) pfds[i].events |= POLLIN;
+			if (fds[i].events & KSI_ASYNC_EVENT_WRITE) pfds[i].events |= POLLOUT;
+		}
+
+		if (poll(pfds, count, timeout < 0 ? -1 : (int)timeout) == KSI_SCK_SOCKET_ERROR && KSI_SCK_errno != KSI_SCK_EINTR) {
+			KSI_ERR_push(s->ctx, res = KSI_IO_ERROR, KSI_SCK_errno, __FILE__, __LINE__, "Async service unable to poll.");
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	if (fds != fdsBuf) KSI_free(fds);
+	if (pfds != pfdsBuf) KSI_free(pfds);
+
+	return res;
+}
+
 int KSI_AsyncService_setOption(KSI_AsyncService *s, const KSI_AsyncOption option, void *value) {
 	if ((s == NULL || s->impl == NULL || s->setOption == NULL) || option >= __KSI_ASYNC_OPT_COUNT) return KSI_INVALID_ARGUMENT;
 	return s->setOption(s->impl, option, value);
@@ -59,6 +59,31 @@ extern "C" {
 	 */
 	int KSI_AsyncAggregationHandle_new(KSI_CTX *ctx, KSI_AggregationReq *req, KSI_AsyncHandle **o);
 
+	/**
+	 * Constructor for the async extension handle object.
+	 * \param[in]		ctx				KSI context.
+	 * \param[in]		req				Extension request.
+	 * \param[out]		o				Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The handle takes ownership of the \c req resource, thus it may not be freed after a successful
+	 * call to this function.
+	 * \see #KSI_AsyncSignatureExtendHandle_new for extending a signature.
+	 */
+	int KSI_AsyncExtendHandle_new(KSI_CTX *ctx, KSI_ExtendReq *req, KSI_AsyncHandle **o);
+
+	/**
+	 * Constructor for the async extension handle object, which extends the signature \c sig to the
+	 * publication time \c pubTime. The extended signature can be read with #KSI_AsyncHandle_getSignature
+	 * after the response has been received.
+	 * \param[in]		ctx				KSI context.
+	 * \param[in]		sig				Signature to be extended.
+	 * \param[in]		pubTime			Publication time, or \c NULL to extend to the head of the calendar.
+	 * \param[out]		o				Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The handle keeps a reference to \c sig, the ownership of \c sig and \c pubTime stays with the caller.
+	 */
+	int KSI_AsyncSignatureExtendHandle_new(KSI_CTX *ctx, KSI_Signature *sig, KSI_Integer *pubTime, KSI_AsyncHandle **o);
+
 	KSI_DEFINE_REF(KSI_AsyncHandle);
 
 	/**
@@ -145,7 +170,25 @@ extern "C" {
 	int KSI_AsyncHandle_getAggregationResp(const KSI_AsyncHandle *h, KSI_AggregationResp **resp);
 
 	/**
-	 * KSI signature getter. The returned signature is verified internally.
+	 * Getter for the extension request.
+	 * \param[in]		h				Async handle.
+	 * \param[out]		req				Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_AsyncHandle_getExtendReq(const KSI_AsyncHandle *h, KSI_ExtendReq **req);
+
+	/**
+	 * Getter for the extension response.
+	 * \param[in]		h				Async handle.
+	 * \param[out]		resp			Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_AsyncHandle_getSignature for getting a verified extended signature.
+	 */
+	int KSI_AsyncHandle_getExtendResp(const KSI_AsyncHandle *h, KSI_ExtendResp **resp);
+
+	/**
+	 * KSI signature getter. The returned signature is verified internally. For an extension handle the
+	 * signature is only available if the handle was created with #KSI_AsyncSignatureExtendHandle_new.
 	 * \param[in]		h				Async handle.
 	 * \param[out]		signature		Pointer to the receiving pointer.
 	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
@@ -201,7 +244,17 @@ extern "C" {
 	int KSI_SigningAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service);
 
 	/**
-	 * Non-blocking aggregation request setter. All request are put into output queue untill, they are sent
+	 * Creates and initalizes a concrete async service object to be used to interract with extender endpoint.
+	 * \param[in]		ctx				KSI context.
+	 * \param[out]		service			Pointer to the receiving pointer.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_AsyncService_free
+	 * \see #KSI_AsyncExtendHandle_new for creating a new async extension request instance.
+	 */
+	int KSI_ExtendingAsyncService_new(KSI_CTX *ctx, KSI_AsyncService **service);
+
+	/**
+	 * Non-blocking request setter. All request are put into output queue untill, they are sent
 	 * during #KSI_AsyncService_run call.
 	 * \param[in]		s				Async service instance.
 	 * \param[out]		handle			Async handle associated with the request.
@@ -212,7 +265,9 @@ extern "C" {
 	 * \note The async service \c s takes ownership of \c req request on a successful call to this function, thus
 	 *       the caller may not clear the memory.
 	 * \see #KSI_SigningAsyncService_new for creating a new signing async service instance.
+	 * \see #KSI_ExtendingAsyncService_new for creating a new extending async service instance.
 	 * \see #KSI_AsyncAggregationHandle_new for creating a new async request instance.
+	 * \see #KSI_AsyncExtendHandle_new for creating a new async extension request instance.
 	 * \see #KSI_AsyncHandle_free for cleaning up resources in case of a failure.
 	 * \see #KSI_AsyncService_run for handling communication towards service endpoint.
 	 * \see #KSI_ASYNC_OPT_REQUEST_CACHE_SIZE for increasing the cache size.
@@ -236,6 +291,64 @@ extern "C" {
 	 */
 	int KSI_AsyncService_run(KSI_AsyncService *service, KSI_AsyncHandle **handle, size_t *waiting);
 
+	/** The socket is waited to become readable. */
+#define KSI_ASYNC_EVENT_READ	0x01
+	/** The socket is waited to become writable. */
+#define KSI_ASYNC_EVENT_WRITE	0x02
+
+	/**
+	 * Socket descriptor of an async service with the events it is waiting for.
+	 * \see #KSI_AsyncService_getPollFds
+	 */
+	typedef struct KSI_AsyncPollFd_st {
+		/** Socket descriptor. */
+		int fd;
+		/** Events of interest, a combination of #KSI_ASYNC_EVENT_READ and #KSI_ASYNC_EVENT_WRITE. */
+		int events;
+	} KSI_AsyncPollFd;
+
+	/**
+	 * Returns the socket descriptors the async service \c s is currently waiting on, so the service can
+	 * be embedded into an external event loop (e.g. \c poll, \c epoll, libevent). The application should
+	 * wait until any of the descriptors is ready or the timeout returned by #KSI_AsyncService_getTimeout
+	 * elapses, and then call #KSI_AsyncService_run to process the events. As the descriptors may change
+	 * with each #KSI_AsyncService_run call, they must be re-read after each call.
+	 * \param[in]		s				Async service instance.
+	 * \param[out]		fds				Array receiving the descriptors, may be \c NULL if \c fds_len is 0.
+	 * \param[in]		fds_len			Capacity of the array \c fds.
+	 * \param[out]		count			Number of descriptors.
+	 * \return #KSI_OK, when operation succeeded;
+	 * \return #KSI_BUFFER_OVERFLOW, if \c fds is too small. In this case \c count is set to the required size;
+	 * \return otherwise an error code.
+	 * \note Transports that do not expose socket descriptors (e.g. WinHTTP) return no descriptors. In this
+	 *       case #KSI_AsyncService_getTimeout returns 0 while there are requests in process.
+	 * \see #KSI_AsyncService_getTimeout
+	 */
+	int KSI_AsyncService_getPollFds(KSI_AsyncService *s, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count);
+
+	/**
+	 * Returns the time after which #KSI_AsyncService_run has to be called even if none of the descriptors
+	 * returned by #KSI_AsyncService_getPollFds has become ready, e.g. to connect, to expire a request or to
+	 * return an already finalized request.
+	 * \param[in]		s				Async service instance.
+	 * \param[out]		timeout			Timeout in milliseconds, or -1 if there is nothing to wait for.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_AsyncService_getPollFds
+	 */
+	int KSI_AsyncService_getTimeout(KSI_AsyncService *s, long *timeout);
+
+	/**
+	 * Blocks until the async service \c s has events to process: any of its sockets becomes ready, a
+	 * response has already been finalized, or a deadline of the service (see #KSI_AsyncService_getTimeout)
+	 * expires. The function returns immediately if there are no requests in process. After it returns,
+	 * #KSI_AsyncService_run should be called to process the events.
+	 * \param[in]		s				Async service instance.
+	 * \param[in]		timeout			Maximum time to wait in milliseconds, or -1 to wait without a limit.
+	 * \return Status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_AsyncService_run
+	 */
+	int KSI_AsyncService_wait(KSI_AsyncService *s, long timeout);
+
 	/**
 	 * Enum defining async handle state.
 	 */
@@ -346,6 +459,17 @@ extern "C" {
 		 */
 		KSI_ASYNC_OPT_MAX_REQUEST_COUNT,
 
+		/**
+		 * Number of parallel connections opened to the service endpoint. The requests are distributed between
+		 * the connections, preferring the one with the least requests waiting for a response. A failed
+		 * connection is reopened after a backoff interval, while its pending requests are completed with
+		 * error #KSI_ASYNC_CONNECTION_CLOSED. New value may not be less than the allready set value.
+		 * Default setting is 1.
+		 * \param		count			Paramer of type size_t.
+		 * \note Only applicable to TCP connections.
+		 */
+		KSI_ASYNC_OPT_CONNECTION_COUNT,
+
 		__KSI_ASYNC_OPT_COUNT
 	} KSI_AsyncOption;
 
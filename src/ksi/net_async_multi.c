@@ -0,0 +1,636 @@
+/*
+ * Copyright 2013-2017 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include "internal.h"
+#include "net_async.h"
+
+#include "impl/net_impl.h"
+
+/* Upper limit of the time a failed endpoint is avoided. */
+#define MULTI_ENDPOINT_BACKOFF_MAX_SEC 32
+/* Polling interval for the endpoints that can not be waited on. */
+#define MULTI_ENDPOINT_POLL_INTERVAL_MS 10
+
+typedef struct MultiAsyncEndpoint_st {
+	/* Transport of the endpoint. */
+	KSI_AsyncClient *client;
+
+	/* Exponentially weighted moving average of the round-trip time in milliseconds (0 if not measured yet). */
+	double rtt;
+	/* Time of the last response read from the endpoint. */
+	KSI_uint64_t respAt;
+	/* Number of requests routed to the endpoint and not finalized yet. */
+	size_t inFlight;
+
+	/* Failure backoff. */
+	size_t failCount;
+	time_t downUntil;
+} MultiAsyncEndpoint;
+
+typedef struct MultiAsyncRoute_st {
+	KSI_AsyncHandle *handle;
+	/* Serialized request to be resubmitted on failure. */
+	unsigned char *raw;
+	size_t len;
+	/* Endpoint the request has been routed to. */
+	size_t endpoint;
+	/* Time the request has been routed. */
+	KSI_uint64_t routedAt;
+	/* Number of endpoints the request has been routed to. */
+	size_t attempts;
+} MultiAsyncRoute;
+
+typedef struct MultiAsyncCtx_st {
+	KSI_CTX *ctx;
+
+	MultiAsyncEndpoint *endpoints;
+	size_t endpointCount;
+
+	/* Requests in process. */
+	MultiAsyncRoute *routes;
+	size_t routeCount;
+	size_t routeSize;
+
+	/* Endpoint the responses are read from. */
+	size_t respCursor;
+
+	/* Pointer to the async options. */
+	size_t *options;
+} MultiAsyncCtx;
+
+static KSI_uint64_t getTimeMs(void) {
+#ifdef _WIN32
+	return (KSI_uint64_t)GetTickCount64();
+#else
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return (KSI_uint64_t)time(NULL) * 1000;
+	return (KSI_uint64_t)ts.tv_sec * 1000 + (KSI_uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+static bool isStatOption(size_t opt) {
+	return opt == KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT || opt == KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT;
+}
+
+/* Propagates the async options to the endpoint transport. The request cache is kept by the parent client only. */
+static void syncOptions(MultiAsyncCtx *multiCtx, KSI_AsyncClient *client) {
+	size_t i;
+
+	for (i = 0; i < __NOF_KSI_ASYNC_OPT; i++) {
+		if (i == KSI_ASYNC_OPT_REQUEST_CACHE_SIZE || isStatOption(i)) continue;
+		client->options[i] = multiCtx->options[i];
+	}
+}
+
+/* Moves the statistics counted by the endpoint transport over to the parent client. */
+static void collectStats(MultiAsyncCtx *multiCtx, KSI_AsyncClient *client) {
+	size_t i;
+
+	for (i = 0; i < __NOF_KSI_ASYNC_OPT; i++) {
+		if (!isStatOption(i)) continue;
+		multiCtx->options[i] += client->options[i];
+		client->options[i] = 0;
+	}
+}
+
+static bool isFailoverError(int err) {
+	switch (err) {
+		case KSI_ASYNC_CONNECTION_CLOSED:
+		case KSI_NETWORK_ERROR:
+		case KSI_NETWORK_CONNECTION_TIMEOUT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static void endpoint_setFailed(MultiAsyncEndpoint *ep) {
+	time_t backoff = MULTI_ENDPOINT_BACKOFF_MAX_SEC;
+
+	if (ep->failCount < 6) backoff = (time_t)1 << ep->failCount;
+	if (backoff > MULTI_ENDPOINT_BACKOFF_MAX_SEC) backoff = MULTI_ENDPOINT_BACKOFF_MAX_SEC;
+	ep->failCount++;
+	ep->downUntil = time(NULL) + backoff;
+}
+
+/**
+ * Picks the endpoint with the lowest expected latency, weighted by the number of requests it is already
+ * busy with. The endpoints that have failed recently are only used if there are no healthy ones. The
+ * endpoint \c exclude is skipped, unless it is the only one.
+ */
+static size_t selectEndpoint(MultiAsyncCtx *multiCtx, size_t exclude) {
+	size_t i;
+	size_t best = multiCtx->endpointCount;
+	double bestScore = 0;
+	bool bestDown = true;
+	time_t curTime = time(NULL);
+
+	for (i = 0; i < multiCtx->endpointCount; i++) {
+		MultiAsyncEndpoint *ep = &multiCtx->endpoints[i];
+		bool down = ep->downUntil > curTime;
+		double score = (ep->rtt + 1) * (double)(ep->inFlight + 1);
+
+		if (i == exclude && multiCtx->endpointCount > 1) continue;
+
+		if (best == multiCtx->endpointCount ||
+				(bestDown && !down) ||
+				(bestDown == down && (down ? ep->downUntil < multiCtx->endpoints[best].downUntil : score < bestScore))) {
+			best = i;
+			bestScore = score;
+			bestDown = down;
+		}
+	}
+	return best;
+}
+
+static int routeRequest(MultiAsyncCtx *multiCtx, MultiAsyncRoute *route, size_t endpoint) {
+	int res = KSI_UNKNOWN_ERROR;
+	MultiAsyncEndpoint *ep = &multiCtx->endpoints[endpoint];
+	KSI_AsyncHandle *handle = route->handle;
+	KSI_AsyncHandle *hndlRef = NULL;
+	unsigned char *raw = NULL;
+
+	/* The transport releases the payload once it has been sent out. */
+	if (handle->raw == NULL) {
+		raw = KSI_malloc(route->len);
+		if (raw == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		memcpy(raw, route->raw, route->len);
+
+		handle->raw = raw;
+		handle->len = route->len;
+		raw = NULL;
+	}
+	handle->sentCount = 0;
+	handle->err = KSI_OK;
+	handle->errExt = 0;
+
+	syncOptions(multiCtx, ep->client);
+	res = ep->client->addRequest(ep->client->clientImpl, (hndlRef = KSI_AsyncHandle_ref(handle)));
+	if (res != KSI_OK) {
+		KSI_AsyncHandle_free(hndlRef);
+		goto cleanup;
+	}
+
+	route->endpoint = endpoint;
+	route->routedAt = getTimeMs();
+	route->attempts++;
+	ep->inFlight++;
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(raw);
+	return res;
+}
+
+static void route_release(MultiAsyncRoute *route) {
+	route->handle->routed = false;
+	KSI_AsyncHandle_free(route->handle);
+	KSI_free(route->raw);
+}
+
+static int addRequest(MultiAsyncCtx *multiCtx, KSI_AsyncHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	MultiAsyncRoute *route = NULL;
+	unsigned char *raw = NULL;
+	size_t i;
+
+	if (multiCtx == NULL || handle == NULL || handle->raw == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (multiCtx->endpointCount == 0) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	raw = KSI_malloc(handle->len);
+	if (raw == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	memcpy(raw, handle->raw, handle->len);
+
+	/* The handle may have been added repeatedly before its previous route has been finalized. */
+	if (handle->routed) {
+		for (i = 0; i < multiCtx->routeCount; i++) {
+			if (multiCtx->routes[i].handle == handle) {
+				route = &multiCtx->routes[i];
+				multiCtx->endpoints[route->endpoint].inFlight--;
+				KSI_free(route->raw);
+				/* Release the reference to the handle. */
+				KSI_AsyncHandle_free(handle);
+				break;
+			}
+		}
+	}
+
+	if (route == NULL) {
+		if (multiCtx->routeCount == multiCtx->routeSize) {
+			size_t size = multiCtx->routeSize ? multiCtx->routeSize * 2 : 16;
+			MultiAsyncRoute *tmp = KSI_malloc(size * sizeof(MultiAsyncRoute));
+
+			if (tmp == NULL) {
+				res = KSI_OUT_OF_MEMORY;
+				goto cleanup;
+			}
+			if (multiCtx->routeCount) memcpy(tmp, multiCtx->routes, multiCtx->routeCount * sizeof(MultiAsyncRoute));
+			KSI_free(multiCtx->routes);
+			multiCtx->routes = tmp;
+			multiCtx->routeSize = size;
+		}
+		route = &multiCtx->routes[multiCtx->routeCount++];
+	}
+
+	/* The route takes over the reference passed to the transport. */
+	route->handle = handle;
+	route->raw = raw;
+	route->len = handle->len;
+	route->attempts = 0;
+	handle->routed = true;
+	raw = NULL;
+
+	res = routeRequest(multiCtx, route, selectEndpoint(multiCtx, multiCtx->endpointCount));
+	if (res != KSI_OK) {
+		/* Drop the route. The reference is released by the caller on failure. */
+		handle->routed = false;
+		KSI_free(route->raw);
+		*route = multiCtx->routes[--multiCtx->routeCount];
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(raw);
+	return res;
+}
+
+/* Updates the endpoint statistics of the finalized requests and resubmits the ones that failed on connection level. */
+static void processRoutes(MultiAsyncCtx *multiCtx) {
+	size_t i = 0;
+
+	while (i < multiCtx->routeCount) {
+		MultiAsyncRoute *route = &multiCtx->routes[i];
+		MultiAsyncEndpoint *ep = &multiCtx->endpoints[route->endpoint];
+		KSI_AsyncHandle *handle = route->handle;
+
+		switch (handle->state) {
+			case KSI_ASYNC_STATE_WAITING_FOR_DISPATCH:
+			case KSI_ASYNC_STATE_WAITING_FOR_RESPONSE:
+				/* Still in process. */
+				i++;
+				continue;
+
+			case KSI_ASYNC_STATE_RESPONSE_RECEIVED:
+			case KSI_ASYNC_STATE_PUSH_CONFIG_RECEIVED:
+				if (ep->respAt >= route->routedAt) {
+					double sample = (double)(ep->respAt - route->routedAt);
+
+					ep->rtt = (ep->rtt == 0) ? sample : (ep->rtt * 7 + sample) / 8;
+				}
+				ep->failCount = 0;
+				ep->downUntil = 0;
+				break;
+
+			case KSI_ASYNC_STATE_ERROR:
+				if (isFailoverError(handle->err)) {
+					int err = handle->err;
+
+					KSI_LOG_info(multiCtx->ctx, "Async endpoint %llu failed with error 0x%x.", (unsigned long long)route->endpoint, err);
+					if (ep->downUntil <= time(NULL)) endpoint_setFailed(ep);
+
+					if (route->attempts < multiCtx->endpointCount) {
+						size_t next = selectEndpoint(multiCtx, route->endpoint);
+
+						ep->inFlight--;
+						if (routeRequest(multiCtx, route, next) == KSI_OK) {
+							KSI_LOG_debug(multiCtx->ctx, "Async request resubmitted to endpoint %llu.", (unsigned long long)next);
+							i++;
+							continue;
+						}
+						ep->inFlight++;
+
+						/* Restore the original error. */
+						handle->err = err;
+						KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
+					}
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		/* The request has been finalized. */
+		ep->inFlight--;
+		route_release(route);
+		*route = multiCtx->routes[--multiCtx->routeCount];
+	}
+}
+
+static int dispatch(MultiAsyncCtx *multiCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+
+	if (multiCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < multiCtx->endpointCount; i++) {
+		MultiAsyncEndpoint *ep = &multiCtx->endpoints[i];
+
+		syncOptions(multiCtx, ep->client);
+		res = ep->client->dispatch(ep->client->clientImpl);
+		collectStats(multiCtx, ep->client);
+		if (res != KSI_OK) {
+			/* The failed requests will be resubmitted to the other endpoints. */
+			KSI_LOG_info(multiCtx->ctx, "Async endpoint %llu dispatch failed with error 0x%x.", (unsigned long long)i, res);
+			if (ep->downUntil <= time(NULL)) endpoint_setFailed(ep);
+		}
+	}
+
+	processRoutes(multiCtx);
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getResponse(MultiAsyncCtx *multiCtx, KSI_OctetString **response, size_t *left) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *tmp = NULL;
+
+	if (multiCtx == NULL || response == NULL || left == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (; multiCtx->respCursor < multiCtx->endpointCount; multiCtx->respCursor++) {
+		MultiAsyncEndpoint *ep = &multiCtx->endpoints[multiCtx->respCursor];
+		size_t epLeft = 0;
+
+		res = ep->client->getResponse(ep->client->clientImpl, &tmp, &epLeft);
+		if (res != KSI_OK) goto cleanup;
+
+		if (tmp != NULL) {
+			ep->respAt = getTimeMs();
+			if (epLeft == 0) multiCtx->respCursor++;
+			break;
+		}
+	}
+
+	/* Report pending input until all of the endpoints have been read out. */
+	if (multiCtx->respCursor < multiCtx->endpointCount) {
+		*left = 1;
+	} else {
+		multiCtx->respCursor = 0;
+		*left = 0;
+	}
+	*response = tmp;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getCredentials(MultiAsyncCtx *multiCtx, const char **user, const char **pass) {
+	KSI_AsyncClient *client = NULL;
+
+	if (multiCtx == NULL) return KSI_INVALID_ARGUMENT;
+	if (multiCtx->endpointCount == 0) return KSI_INVALID_STATE;
+
+	/* All of the endpoints share the same credentials. */
+	client = multiCtx->endpoints[0].client;
+	return client->getCredentials(client->clientImpl, user, pass);
+}
+
+static int getPollFds(MultiAsyncCtx *multiCtx, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+	size_t total = 0;
+	bool overflow = false;
+
+	if (multiCtx == NULL || (fds == NULL && fds_len != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < multiCtx->endpointCount; i++) {
+		KSI_AsyncClient *client = multiCtx->endpoints[i].client;
+		size_t n = 0;
+		size_t avail = (fds_len > total) ? fds_len - total : 0;
+
+		if (client->getPollFds == NULL) continue;
+
+		syncOptions(multiCtx, client);
+		res = client->getPollFds(client->clientImpl, avail ? fds + total : NULL, avail, &n);
+		if (res == KSI_BUFFER_OVERFLOW) {
+			overflow = true;
+		} else if (res != KSI_OK) {
+			goto cleanup;
+		}
+		total += n;
+	}
+
+	*count = total;
+	res = overflow ? KSI_BUFFER_OVERFLOW : KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getTimeout(MultiAsyncCtx *multiCtx, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	long tmp = -1;
+	size_t i;
+
+	if (multiCtx == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < multiCtx->endpointCount; i++) {
+		MultiAsyncEndpoint *ep = &multiCtx->endpoints[i];
+		long epTimeout = -1;
+
+		if (ep->client->getTimeout != NULL) {
+			syncOptions(multiCtx, ep->client);
+			res = ep->client->getTimeout(ep->client->clientImpl, &epTimeout);
+			if (res != KSI_OK) goto cleanup;
+		} else if (ep->inFlight > 0) {
+			/* The transport can not be waited on, it has to be polled. */
+			epTimeout = MULTI_ENDPOINT_POLL_INTERVAL_MS;
+		}
+
+		if (epTimeout >= 0 && (tmp < 0 || epTimeout < tmp)) tmp = epTimeout;
+	}
+
+	*timeout = tmp;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static void MultiAsyncCtx_free(MultiAsyncCtx *t) {
+	if (t != NULL) {
+		size_t i;
+
+		for (i = 0; i < t->routeCount; i++) route_release(&t->routes[i]);
+		KSI_free(t->routes);
+		for (i = 0; i < t->endpointCount; i++) KSI_AsyncClient_free(t->endpoints[i].client);
+		KSI_free(t->endpoints);
+
+		KSI_free(t);
+	}
+}
+
+static int MultiAsyncCtx_new(KSI_CTX *ctx, MultiAsyncCtx **multiCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	MultiAsyncCtx *tmp = NULL;
+
+	if (ctx == NULL || multiCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tmp = KSI_malloc(sizeof(MultiAsyncCtx));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	tmp->ctx = ctx;
+	tmp->endpoints = NULL;
+	tmp->endpointCount = 0;
+	tmp->routes = NULL;
+	tmp->routeCount = 0;
+	tmp->routeSize = 0;
+	tmp->respCursor = 0;
+	tmp->options = NULL;
+
+	*multiCtx = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	MultiAsyncCtx_free(tmp);
+	return res;
+}
+
+static int addEndpoint(MultiAsyncCtx *multiCtx, KSI_AsyncClient *endpoint) {
+	int res = KSI_UNKNOWN_ERROR;
+	MultiAsyncEndpoint *tmp = NULL;
+
+	if (multiCtx == NULL || endpoint == NULL || endpoint->clientImpl == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* The requests are signed once, thus all of the endpoints have to accept the same credentials. */
+	if (multiCtx->endpointCount > 0) {
+		const char *user = NULL;
+		const char *pass = NULL;
+		const char *epUser = NULL;
+		const char *epPass = NULL;
+
+		res = getCredentials(multiCtx, &user, &pass);
+		if (res != KSI_OK) goto cleanup;
+
+		res = endpoint->getCredentials(endpoint->clientImpl, &epUser, &epPass);
+		if (res != KSI_OK) goto cleanup;
+
+		if (user == NULL || pass == NULL || epUser == NULL || epPass == NULL ||
+				strcmp(user, epUser) != 0 || strcmp(pass, epPass) != 0) {
+			res = KSI_INVALID_ARGUMENT;
+			goto cleanup;
+		}
+	}
+
+	tmp = KSI_calloc(multiCtx->endpointCount + 1, sizeof(MultiAsyncEndpoint));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	if (multiCtx->endpointCount) memcpy(tmp, multiCtx->endpoints, multiCtx->endpointCount * sizeof(MultiAsyncEndpoint));
+
+	tmp[multiCtx->endpointCount].client = endpoint;
+
+	KSI_free(multiCtx->endpoints);
+	multiCtx->endpoints = tmp;
+	multiCtx->endpointCount++;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+int KSI_MultiAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncClient *tmp = NULL;
+	MultiAsyncCtx *netImpl = NULL;
+
+	if (ctx == NULL || c == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_AbstractAsyncClient_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->addRequest = (int (*)(void *, KSI_AsyncHandle *))addRequest;
+	tmp->getResponse = (int (*)(void *, KSI_OctetString **, size_t *))getResponse;
+	tmp->dispatch = (int (*)(void *))dispatch;
+	tmp->getCredentials = (int (*)(void *, const char **, const char **))getCredentials;
+	tmp->getPollFds = (int (*)(void *, KSI_AsyncPollFd *, size_t, size_t *))getPollFds;
+	tmp->getTimeout = (int (*)(void *, long *))getTimeout;
+
+	res = MultiAsyncCtx_new(ctx, &netImpl);
+	if (res != KSI_OK) goto cleanup;
+
+	netImpl->options = tmp->options;
+
+	tmp->clientImpl_free = (void (*)(void*))MultiAsyncCtx_free;
+	tmp->clientImpl = netImpl;
+	netImpl = NULL;
+
+	*c = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+cleanup:
+	MultiAsyncCtx_free(netImpl);
+	KSI_AsyncClient_free(tmp);
+
+	return res;
+}
+
+int KSI_MultiAsyncClient_addEndpoint(KSI_AsyncClient *c, KSI_AsyncClient *endpoint) {
+	if (c == NULL || c->clientImpl == NULL) return KSI_INVALID_ARGUMENT;
+	return addEndpoint(c->clientImpl, endpoint);
+}
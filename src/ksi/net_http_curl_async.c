@@ -172,7 +172,7 @@ static void reqQueue_clearWithError(KSI_AsyncHandleList *reqQueue, int err, long
 		if (res != KSI_OK || req == NULL) return;
 
 		/* Update request state. */
-		req->state = KSI_ASYNC_STATE_ERROR;
+		KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 		req->err = err;
 		req->errExt = ext;
 
@@ -241,7 +241,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 			if (clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
 						(difftime(curTime, req->reqTime) > clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
 				/* Set error. */
-				req->state = KSI_ASYNC_STATE_ERROR;
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 				req->err = KSI_NETWORK_SEND_TIMEOUT;
 				/* Just remove the request from the request queue. */
 				KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
@@ -308,7 +308,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 				clientCtx->roundCount++;
 
 				/* Update state. */
-				req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
 				/* Start receive timeout. */
 				req->sndTime = curTime;
 				/* The request has been successfully dispatched. Remove it from the request queue. */
@@ -353,7 +353,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 					if (curlMsg->data.result != CURLE_OK) {
 						size_t len = strlen(curlResponse->errMsg);
 						KSI_LOG_error(clientCtx->ctx, "Async Curl HTTP: error result %d (%s).", curlMsg->data.result, curlResponse->errMsg);
-						handle->state = KSI_ASYNC_STATE_ERROR;
+						KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 						handle->err = KSI_NETWORK_ERROR;
 						handle->errExt = curlMsg->data.result;
 						if (len) KSI_Utf8String_new(clientCtx->ctx, curlResponse->errMsg, len + 1, &handle->errMsg);
@@ -367,7 +367,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 						if (httpCode >= 400 && httpCode < 600) {
 							size_t len = strlen(curlResponse->errMsg);
 							KSI_LOG_debug(clientCtx->ctx, "Async Curl HTTP: received HTTP code %ld. Curl error '%s'.", httpCode, curlResponse->errMsg);
-							handle->state = KSI_ASYNC_STATE_ERROR;
+							KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 							handle->err = KSI_HTTP_ERROR;
 							handle->errExt = httpCode;
 							if (len) KSI_Utf8String_new(clientCtx->ctx, curlResponse->errMsg, len + 1, &handle->errMsg);
@@ -387,7 +387,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 									KSI_LOG_logBlob(clientCtx->ctx, KSI_LOG_ERROR,
 											"Async Curl HTTP: Unable to extract TLV from input stream",
 											curlResponse->raw, curlResponse->len);
-									handle->state = KSI_ASYNC_STATE_ERROR;
+									KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 									handle->err = KSI_NETWORK_ERROR;
 									break;
 								}
@@ -436,6 +436,104 @@ cleanup:
 	return res;
 }
 
+static bool isRoundFull(HttpAsyncCtx *clientCtx, time_t curTime) {
+	return difftime(curTime, clientCtx->roundStartAt) < clientCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION] &&
+			!(clientCtx->roundCount < clientCtx->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT]);
+}
+
+static int getPollFds(HttpAsyncCtx *clientCtx, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	fd_set fdRead;
+	fd_set fdWrite;
+	fd_set fdExcep;
+	int maxFd = -1;
+	int fd;
+	size_t n = 0;
+	CURLMcode curlmCode;
+
+	if (clientCtx == NULL || (fds == NULL && fds_len != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (clientCtx->curl != NULL) {
+		FD_ZERO(&fdRead);
+		FD_ZERO(&fdWrite);
+		FD_ZERO(&fdExcep);
+
+		curlmCode = curl_multi_fdset(clientCtx->curl, &fdRead, &fdWrite, &fdExcep, &maxFd);
+		if (curlmCode != CURLM_OK) {
+			KSI_pushError(clientCtx->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(curlmCode));
+			goto cleanup;
+		}
+
+		/* A negative value means that curl is not waiting on any descriptors (see curl_multi_timeout). */
+		for (fd = 0; fd <= maxFd; fd++) {
+			int events = 0;
+
+			if (FD_ISSET(fd, &fdRead) || FD_ISSET(fd, &fdExcep)) events |= KSI_ASYNC_EVENT_READ;
+			if (FD_ISSET(fd, &fdWrite)) events |= KSI_ASYNC_EVENT_WRITE;
+			if (events == 0) continue;
+
+			if (n < fds_len) {
+				fds[n].fd = fd;
+				fds[n].events = events;
+			}
+			n++;
+		}
+	}
+
+	*count = n;
+	res = (n > fds_len) ? KSI_BUFFER_OVERFLOW : KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getTimeout(HttpAsyncCtx *clientCtx, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *req = NULL;
+	long tmp = -1;
+	CURLMcode curlmCode;
+
+	if (clientCtx == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (KSI_AsyncHandleList_length(clientCtx->reqQueue) > 0) {
+		res = KSI_AsyncHandleList_elementAt(clientCtx->reqQueue, 0, &req);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Unless the round is full, the requests are handed over to curl during dispatch. */
+		if (clientCtx->curl == NULL || req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH || !isRoundFull(clientCtx, time(NULL))) {
+			*timeout = 0;
+			res = KSI_OK;
+			goto cleanup;
+		}
+
+		KSI_AsyncTimeout_update(&tmp, clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ? 0 :
+				req->reqTime + (time_t)clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] + 1);
+		KSI_AsyncTimeout_update(&tmp, clientCtx->roundStartAt + (time_t)clientCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]);
+	}
+
+	if (clientCtx->curl != NULL) {
+		long curlTimeout = -1;
+
+		curlmCode = curl_multi_timeout(clientCtx->curl, &curlTimeout);
+		if (curlmCode != CURLM_OK) {
+			KSI_pushError(clientCtx->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(curlmCode));
+			goto cleanup;
+		}
+
+		if (curlTimeout >= 0 && (tmp < 0 || curlTimeout < tmp)) tmp = curlTimeout;
+	}
+
+	*timeout = tmp;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int addToSendQueue(HttpAsyncCtx *clientCtx, KSI_AsyncHandle *request) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -444,7 +542,7 @@ static int addToSendQueue(HttpAsyncCtx *clientCtx, KSI_AsyncHandle *request) {
 		goto cleanup;
 	}
 
-	request->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
+	KSI_AsyncHandle_setState(request, KSI_ASYNC_STATE_WAITING_FOR_DISPATCH);
 	/* Start send timeout. */
 	time(&request->reqTime);
 
@@ -646,6 +744,8 @@ int KSI_HttpAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	tmp->getResponse = (int (*)(void *, KSI_OctetString **, size_t *))getResponse;
 	tmp->dispatch = (int (*)(void *))dispatch;
 	tmp->getCredentials = (int (*)(void *, const char **, const char **))getCredentials;
+	tmp->getPollFds = (int (*)(void *, KSI_AsyncPollFd *, size_t, size_t *))getPollFds;
+	tmp->getTimeout = (int (*)(void *, long *))getTimeout;
 
 	res = HttpAsyncCtx_new(ctx, &netImpl);
 	if (res != KSI_OK) goto cleanup;
@@ -357,7 +357,7 @@ static void reqQueue_clearWithError(KSI_AsyncHandleList *reqQueue, int err, long
 		if (res != KSI_OK || req == NULL) return;
 
 		/* Update request state. */
-		req->state = KSI_ASYNC_STATE_ERROR;
+		KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 		req->err = err;
 		req->errExt = ext;
 
@@ -558,7 +558,7 @@ static int WinHTTP_handleResponse(HttpAsyncCtx *clientCtx) {
 
 		if (httpReq->status != KSI_OK) {
 			KSI_LOG_debug(clientCtx->ctx, "Async WinHTTP: error result %x:%d.", httpReq->status, httpReq->errExt);
-			handle->state = KSI_ASYNC_STATE_ERROR;
+			KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 			handle->err = httpReq->status;
 			handle->errExt = httpReq->errExt;
 		} else {
@@ -577,7 +577,7 @@ static int WinHTTP_handleResponse(HttpAsyncCtx *clientCtx) {
 					KSI_LOG_logBlob(clientCtx->ctx, KSI_LOG_ERROR,
 							"Async WinHTTP: Unable to extract TLV from input stream",
 							httpReq->raw, httpReq->len);
-					handle->state = KSI_ASYNC_STATE_ERROR;
+					KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_ERROR);
 					handle->err = KSI_NETWORK_ERROR;
 					break;
 				}
@@ -666,7 +666,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 			if (clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
 						(difftime(curTime, req->reqTime) > clientCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
 				/* Set error. */
-				req->state = KSI_ASYNC_STATE_ERROR;
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 				req->err = KSI_NETWORK_SEND_TIMEOUT;
 				/* Just remove the request from the request queue. */
 				KSI_AsyncHandleList_remove(clientCtx->reqQueue, 0, NULL);
@@ -678,7 +678,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 					KSI_LOG_debug(clientCtx->ctx, "Async WinHTTP: Failed to send request. Error %x.", res);
 					KSI_pushError(clientCtx->ctx, res, "Failed to send request.");
 					/* Set error. */
-					req->state = KSI_ASYNC_STATE_ERROR;
+					KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 					req->err = res;
 					req->errExt = GetLastError();
 					/* Just remove the request from the request queue. */
@@ -688,7 +688,7 @@ static int dispatch(HttpAsyncCtx *clientCtx) {
 				}
 
 				/* Update state. */
-				req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
 				/* Start receive timeout. */
 				req->sndTime = curTime;
 
@@ -725,7 +725,7 @@ static int addToSendQueue(HttpAsyncCtx *clientCtx, KSI_AsyncHandle *request) {
 		goto cleanup;
 	}
 
-	request->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
+	KSI_AsyncHandle_setState(request, KSI_ASYNC_STATE_WAITING_FOR_DISPATCH);
 	/* Start send timeout. */
 	time(&request->reqTime);
 
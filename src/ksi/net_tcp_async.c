@@ -36,26 +36,54 @@
 #define TCP_INVALID_SOCKET_FD (-1)
 #define KSI_TLV_MAX_SIZE (0xffff + 4)
 
-typedef struct TcpClientCtx_st {
-	KSI_CTX *ctx;
+/* Upper limit of the reconnect backoff of a failed connection. */
+#define TCP_RECONNECT_BACKOFF_MAX_SEC 32
+/* Maximum number of requests written to a connection with a single system call. */
+#define TCP_SEND_BATCH_MAX 64
+
+typedef struct TcpAsyncConn_st {
 	/* Socket descriptor. */
 	int sockfd;
+	/* Input read buffer. */
+	unsigned char inBuf[KSI_TLV_MAX_SIZE * 2];
+	size_t inLen;
+
+	/* Connect timeout. */
+	time_t connectedAt;
+	bool socketReady;
+	/* Socket events returned by the last poll. */
+	short revents;
+
+	/* Requests assigned to the connection, but not completely written yet. Only the first one may be partially written. */
+	KSI_AsyncHandle **out;
+	size_t outLen;
+	size_t outSize;
+	/* Requests that have been sent over the connection. */
+	KSI_AsyncHandle **sent;
+	size_t sentLen;
+	size_t sentSize;
+
+	/* Reconnect backoff. */
+	size_t failCount;
+	time_t retryAt;
+} TcpAsyncConn;
+
+typedef struct TcpClientCtx_st {
+	KSI_CTX *ctx;
+	/* Connection pool. */
+	TcpAsyncConn **conns;
+	size_t connCount;
+	/* Poll set of the connection pool. */
+	struct pollfd *pfds;
 	/* Output queue. */
 	KSI_LIST(KSI_AsyncHandle) *reqQueue;
 	/* Input queue. */
 	KSI_LIST(KSI_OctetString) *respQueue;
-	/* Input read buffer. */
-	unsigned char inBuf[KSI_TLV_MAX_SIZE * 2];
-	size_t inLen;
 
 	/* Round throttling. */
 	time_t roundStartAt;
 	size_t roundCount;
 
-	/* Connect timeout. */
-	time_t connectedAt;
-	bool socketReady;
-
 	/* Poiter to the async options. */
 	size_t *options;
 
@@ -67,7 +95,7 @@ typedef struct TcpClientCtx_st {
 } TcpAsyncCtx;
 
 
-static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
+static int openSocket(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn) {
 	int res;
 	int tmpfd = TCP_INVALID_SOCKET_FD;
 	struct addrinfo hints;
@@ -75,7 +103,7 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 	struct addrinfo *pr = NULL;
 	char portStr[6];
 
-	if (tcpCtx == NULL || sockfd == NULL) {
+	if (tcpCtx == NULL || conn == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
@@ -124,7 +152,7 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 				goto cleanup;
 			}
 		}
-		time(&tcpCtx->connectedAt);
+		time(&conn->connectedAt);
 
 		/* Succeedded to connect. */
 		break;
@@ -134,7 +162,7 @@ static int openSocket(TcpAsyncCtx *tcpCtx, int *sockfd) {
 		goto cleanup;
 	}
 
-	*sockfd = tmpfd;
+	conn->sockfd = tmpfd;
 	tmpfd = TCP_INVALID_SOCKET_FD;
 
 	res = KSI_OK;
@@ -146,19 +174,6 @@ cleanup:
 	return res;
 }
 
-static void closeSocket(TcpAsyncCtx *tcpCtx, unsigned int lineNr) {
-	if (tcpCtx != NULL) {
-		KSI_LOG_debug(tcpCtx->ctx, "Async TCP close socket at: L%u", lineNr);
-
-		/* Close socket. */
-		if (tcpCtx->sockfd != TCP_INVALID_SOCKET_FD) close(tcpCtx->sockfd);
-		tcpCtx->sockfd = TCP_INVALID_SOCKET_FD;
-		tcpCtx->socketReady = false;
-		/* Clear input buffer. */
-		tcpCtx->inLen = 0;
-	}
-}
-
 static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err, long ext) {
 	size_t size = 0;
 
@@ -172,127 +187,271 @@ static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err
 		if (res != KSI_OK || req == NULL) return;
 
 		/* Update request state. */
-		req->state = KSI_ASYNC_STATE_ERROR;
+		KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 		req->err = err;
 		req->errExt = ext;
 
-		KSI_AsyncHandle_free(req);
+		KSI_AsyncHandleList_remove(reqQueue, size - 1, NULL);
 	}
 }
 
-static int dispatch(TcpAsyncCtx *tcpCtx) {
-	int res = KSI_UNKNOWN_ERROR;
-	struct pollfd pfd;
-	KSI_AsyncHandle *req = NULL;
-	KSI_OctetString *resp = NULL;
-	bool inputProcessed = true;
+/* Releases the sent requests that are not waiting for a response anymore. */
+static void conn_pruneSent(TcpAsyncConn *conn) {
+	size_t i;
+	size_t n = 0;
 
-	if (tcpCtx == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
+	for (i = 0; i < conn->sentLen; i++) {
+		if (conn->sent[i]->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
+			conn->sent[n++] = conn->sent[i];
+		} else {
+			KSI_AsyncHandle_free(conn->sent[i]);
+		}
 	}
-	KSI_ERR_clearErrors(tcpCtx->ctx);
+	conn->sentLen = n;
+}
 
-	/* Check connection. */
-	if (tcpCtx->sockfd == TCP_INVALID_SOCKET_FD) {
-		/* Only open connection if there is anything in request queue. */
-		if (KSI_AsyncHandleList_length(tcpCtx->reqQueue) == 0) {
-			KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection not ready.");
-			res = KSI_OK;
-			goto cleanup;
+/**
+ * Fails the requests assigned to the connection, whose send timeout has elapsed. The partially written request
+ * is kept, as the rest of it has to be written to keep the stream intact.
+ */
+static void conn_pruneOut(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn, time_t curTime) {
+	size_t i;
+	size_t n = 0;
+
+	for (i = 0; i < conn->outLen; i++) {
+		KSI_AsyncHandle *req = conn->out[i];
+
+		if (req->sentCount == 0) {
+			if (req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
+				/* The state could have been changed in application layer. */
+				KSI_AsyncHandle_free(req);
+				continue;
+			}
+			if (tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
+					(difftime(curTime, req->reqTime) > tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
+				req->err = KSI_NETWORK_SEND_TIMEOUT;
+				KSI_AsyncHandle_free(req);
+				continue;
+			}
 		}
+		conn->out[n++] = req;
+	}
+	conn->outLen = n;
+}
 
-		res = openSocket(tcpCtx, &tcpCtx->sockfd);
-		if (res != KSI_OK) {
-			reqQueue_clearWithError(tcpCtx->reqQueue, res, KSI_SCK_errno);
-			closeSocket(tcpCtx, __LINE__);
-			res = KSI_OK;
-			goto cleanup;
-		}
+/* Number of requests the connection is busy with. */
+static size_t conn_getLoad(const TcpAsyncConn *conn) {
+	return conn->sentLen + conn->outLen;
+}
+
+static int handleArray_append(KSI_AsyncHandle ***arr, size_t *len, size_t *size, KSI_AsyncHandle *req) {
+	if (*len == *size) {
+		size_t newSize = *size ? *size * 2 : 16;
+		KSI_AsyncHandle **tmp = KSI_malloc(newSize * sizeof(KSI_AsyncHandle *));
+
+		if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+		if (*len) memcpy(tmp, *arr, *len * sizeof(KSI_AsyncHandle *));
+		KSI_free(*arr);
+		*arr = tmp;
+		*size = newSize;
 	}
+	(*arr)[(*len)++] = req;
+	return KSI_OK;
+}
 
-	pfd.fd = tcpCtx->sockfd;
-	pfd.events = POLLIN | POLLOUT;
-	pfd.revents = 0;
+/**
+ * Closes the connection. The requests that have been sent over the connection, but have not been responded yet,
+ * are set into error state, while the requests that have not been completely written are returned to the head of
+ * the output queue, so they could be sent over another connection. If \c failed is set, reconnecting is delayed by an exponential backoff.
+ */
+static void closeConnection(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn, bool failed, int err, unsigned int lineNr) {
+	size_t i;
+
+	if (tcpCtx == NULL || conn == NULL) return;
+
+	KSI_LOG_debug(tcpCtx->ctx, "Async TCP close socket at: L%u", lineNr);
+
+	/* Close socket. */
+	if (conn->sockfd != TCP_INVALID_SOCKET_FD) close(conn->sockfd);
+	conn->sockfd = TCP_INVALID_SOCKET_FD;
+	conn->socketReady = false;
+	conn->revents = 0;
+	/* Clear input buffer. */
+	conn->inLen = 0;
+
+	/* Return the unsent requests to the output queue in the original order. */
+	for (i = 0; i < conn->outLen; i++) {
+		KSI_AsyncHandle *req = conn->out[i];
+
+		req->sentCount = 0;
+		if (KSI_AsyncHandleList_insertAt(tcpCtx->reqQueue, i, req) != KSI_OK) {
+			KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
+			req->err = err;
+			KSI_AsyncHandle_free(req);
+		}
+	}
+	conn->outLen = 0;
 
-	res = poll(&pfd, 1, 0);
-	if (res == 0) {
-		if (!tcpCtx->socketReady &&
-					(tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT] == 0 ||
-					(difftime(time(NULL), tcpCtx->connectedAt) > tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT]))) {
-			closeSocket(tcpCtx, __LINE__);
-			KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection timeout.");
-			reqQueue_clearWithError(tcpCtx->reqQueue, KSI_NETWORK_CONNECTION_TIMEOUT, 0);
-			res = KSI_OK;
-		} else {
-			KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection not ready.");
-			res = KSI_OK;
+	for (i = 0; i < conn->sentLen; i++) {
+		if (conn->sent[i]->state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) {
+			conn->sent[i]->err = err;
+			KSI_AsyncHandle_setState(conn->sent[i], KSI_ASYNC_STATE_ERROR);
 		}
+		KSI_AsyncHandle_free(conn->sent[i]);
+	}
+	conn->sentLen = 0;
+
+	if (failed) {
+		time_t backoff = TCP_RECONNECT_BACKOFF_MAX_SEC;
+
+		if (conn->failCount < 6) backoff = (time_t)1 << conn->failCount;
+		if (backoff > TCP_RECONNECT_BACKOFF_MAX_SEC) backoff = TCP_RECONNECT_BACKOFF_MAX_SEC;
+		conn->failCount++;
+		conn->retryAt = time(NULL) + backoff;
+	} else {
+		conn->failCount = 0;
+		conn->retryAt = 0;
+	}
+}
+
+static void TcpAsyncConn_free(TcpAsyncConn *conn) {
+	if (conn != NULL) {
+		size_t i;
+
+		if (conn->sockfd != TCP_INVALID_SOCKET_FD) close(conn->sockfd);
+		for (i = 0; i < conn->outLen; i++) KSI_AsyncHandle_free(conn->out[i]);
+		KSI_free(conn->out);
+		for (i = 0; i < conn->sentLen; i++) KSI_AsyncHandle_free(conn->sent[i]);
+		KSI_free(conn->sent);
+
+		KSI_free(conn);
+	}
+}
+
+static int TcpAsyncConn_new(TcpAsyncConn **conn) {
+	TcpAsyncConn *tmp = NULL;
+
+	if (conn == NULL) return KSI_INVALID_ARGUMENT;
+
+	tmp = KSI_malloc(sizeof(TcpAsyncConn));
+	if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+	tmp->sockfd = TCP_INVALID_SOCKET_FD;
+	tmp->inLen = 0;
+	tmp->connectedAt = 0;
+	tmp->socketReady = false;
+	tmp->revents = 0;
+	tmp->out = NULL;
+	tmp->outLen = 0;
+	tmp->outSize = 0;
+	tmp->sent = NULL;
+	tmp->sentLen = 0;
+	tmp->sentSize = 0;
+	tmp->failCount = 0;
+	tmp->retryAt = 0;
+
+	*conn = tmp;
+	return KSI_OK;
+}
+
+/* Grows the connection pool to the size set with #KSI_ASYNC_OPT_CONNECTION_COUNT. */
+static int updateConnectionPool(TcpAsyncCtx *tcpCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t count = tcpCtx->options[KSI_ASYNC_OPT_CONNECTION_COUNT];
+	TcpAsyncConn **conns = NULL;
+	struct pollfd *pfds = NULL;
+
+	if (count <= tcpCtx->connCount) {
+		res = KSI_OK;
 		goto cleanup;
-	} else if (res == KSI_SCK_SOCKET_ERROR) {
-		closeSocket(tcpCtx, __LINE__);
-		KSI_LOG_error(tcpCtx->ctx, "Async TCP failed to test socket. Error: %d (%s).", KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-		res = KSI_ASYNC_CONNECTION_CLOSED;
+	}
+
+	conns = KSI_calloc(count, sizeof(TcpAsyncConn *));
+	pfds = KSI_calloc(count, sizeof(struct pollfd));
+	if (conns == NULL || pfds == NULL) {
+		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
-	tcpCtx->socketReady = true;
+	if (tcpCtx->connCount) memcpy(conns, tcpCtx->conns, tcpCtx->connCount * sizeof(TcpAsyncConn *));
+
+	KSI_free(tcpCtx->conns);
+	tcpCtx->conns = conns;
+	conns = NULL;
+	KSI_free(tcpCtx->pfds);
+	tcpCtx->pfds = pfds;
+	pfds = NULL;
+
+	for (; tcpCtx->connCount < count; tcpCtx->connCount++) {
+		res = TcpAsyncConn_new(&tcpCtx->conns[tcpCtx->connCount]);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	KSI_free(conns);
+	KSI_free(pfds);
+	return res;
+}
+
+/* Reads the available input of the connection into the response queue. */
+static int readConnection(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *resp = NULL;
+	bool inputProcessed = false;
 
-	/* Handle input. */
 	do {
-		if (pfd.revents & POLLIN) {
-			inputProcessed = false;
-			if ((tcpCtx->inLen + KSI_TLV_MAX_SIZE) <= sizeof(tcpCtx->inBuf)) {
-				int c = 0;
-				/* Read data from socket. */
-				c = recv(tcpCtx->sockfd, (tcpCtx->inBuf + tcpCtx->inLen), KSI_TLV_MAX_SIZE, 0);
-				if (c == 0) {
-					/* Connection has been closed unexpectedly. */
-					KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection closed.");
-					closeSocket(tcpCtx, __LINE__);
+		if ((conn->inLen + KSI_TLV_MAX_SIZE) <= sizeof(conn->inBuf)) {
+			int c = 0;
+			/* Read data from socket. */
+			c = recv(conn->sockfd, (conn->inBuf + conn->inLen), KSI_TLV_MAX_SIZE, 0);
+			if (c == 0) {
+				/* Connection has been closed unexpectedly. */
+				KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection closed.");
+				closeConnection(tcpCtx, conn, false, KSI_ASYNC_CONNECTION_CLOSED, __LINE__);
+				res = KSI_ASYNC_CONNECTION_CLOSED;
+				goto cleanup;
+			} else if (c == KSI_SCK_SOCKET_ERROR) {
+				if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
+					/* All data has been read out from socket. */
+					inputProcessed = true;
+				} else {
+					/* Non-recoverable error has occurred. */
+					KSI_LOG_error(tcpCtx->ctx,
+								  "Async TCP closing connection. Unrecoverable error has occured: %d (%s).",
+								  KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+					closeConnection(tcpCtx, conn, true, KSI_ASYNC_CONNECTION_CLOSED, __LINE__);
 					res = KSI_ASYNC_CONNECTION_CLOSED;
 					goto cleanup;
-				} else if (c == KSI_SCK_SOCKET_ERROR) {
-					if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
-						/* All data has been read out from socket. */
-						inputProcessed = true;
-					} else {
-						/* Non-recoverable error has occurred. */
-						KSI_LOG_error(tcpCtx->ctx,
-									  "Async TCP closing connection. Unrecoverable error has occured: %d (%s).",
-									  KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-						closeSocket(tcpCtx, __LINE__);
-						res = KSI_ASYNC_CONNECTION_CLOSED;
-						goto cleanup;
-					}
-				} else {
-					tcpCtx->inLen += c;
-					if (tcpCtx->inLen > sizeof(tcpCtx->inBuf)) {
-						KSI_pushError(tcpCtx->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
-						goto cleanup;
-					}
 				}
 			} else {
-				inputProcessed = true;
-				KSI_LOG_debug(tcpCtx->ctx, "Async TCP input stream would not fit into buffer.");
+				conn->inLen += c;
+				if (conn->inLen > sizeof(conn->inBuf)) {
+					KSI_pushError(tcpCtx->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
+					goto cleanup;
+				}
 			}
+		} else {
+			inputProcessed = true;
+			KSI_LOG_debug(tcpCtx->ctx, "Async TCP input stream would not fit into buffer.");
 		}
 
 		/* Handle read buffer. */
-		while (tcpCtx->inLen > 0) {
+		while (conn->inLen > 0) {
 			KSI_FTLV ftlv;
 			size_t count = 0;
 
 			/* Traverse through the input stream and verify that a complete TLV is present. */
 			memset(&ftlv, 0, sizeof(KSI_FTLV));
-			res = KSI_FTLV_memRead(tcpCtx->inBuf, tcpCtx->inLen, &ftlv);
+			res = KSI_FTLV_memRead(conn->inBuf, conn->inLen, &ftlv);
 			count = ftlv.hdr_len + ftlv.dat_len;
 			/* Verify if the input byte stream is long enought for extacting a PDU. */
-			if (count != 0 && tcpCtx->inLen >= count) {
+			if (count != 0 && conn->inLen >= count) {
 				if (res != KSI_OK) {
 					KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_ERROR,
 									"Async TCP closing connection. Unable to extract TLV from input stream",
-									tcpCtx->inBuf, tcpCtx->inLen);
-					closeSocket(tcpCtx, __LINE__);
+									conn->inBuf, conn->inLen);
+					closeConnection(tcpCtx, conn, true, KSI_ASYNC_CONNECTION_CLOSED, __LINE__);
 					res = KSI_ASYNC_CONNECTION_CLOSED;
 					goto cleanup;
 				}
@@ -306,10 +465,10 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 				goto cleanup;
 			}
 
-			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "Async TCP received response", tcpCtx->inBuf, count);
+			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "Async TCP received response", conn->inBuf, count);
 
 			/* A complete PDU is in cache. Move it into the receive queue. */
-			res = KSI_OctetString_new(tcpCtx->ctx, tcpCtx->inBuf, count, &resp);
+			res = KSI_OctetString_new(tcpCtx->ctx, conn->inBuf, count, &resp);
 			if (res != KSI_OK) {
 				KSI_LOG_error(tcpCtx->ctx, "Async TCP unable to create new KSI_OctetString object. Error: 0x%x.", res);
 				res = KSI_OK;
@@ -325,102 +484,351 @@ static int dispatch(TcpAsyncCtx *tcpCtx) {
 			resp = NULL;
 
 			/* The response has been successfully moved to the input queue. Remove the data from the input stream. */
-			tcpCtx->inLen -= count;
-			memmove(tcpCtx->inBuf, tcpCtx->inBuf + count, tcpCtx->inLen);
+			conn->inLen -= count;
+			memmove(conn->inBuf, conn->inBuf + count, conn->inLen);
 		}
 	} while (!inputProcessed);
 
-	/* Handle output. */
-	if (!(pfd.revents & POLLOUT)) {
-		KSI_LOG_debug(tcpCtx->ctx, "Async TCP output buffer not ready.");
+	res = KSI_OK;
+cleanup:
+	KSI_OctetString_free(resp);
+	return res;
+}
+
+/* Marks the request as sent and moves it to the list of the requests waiting for a response. */
+static int conn_completeRequest(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn, KSI_AsyncHandle *req, time_t curTime) {
+	int res;
+
+	/* Release the serialized payload. */
+	KSI_free(req->raw);
+	req->raw = NULL;
+	req->len = 0;
+	req->sentCount = 0;
+
+	tcpCtx->roundCount++;
+
+	/* Update state. */
+	KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
+	/* Start receive timeout. */
+	req->sndTime = curTime;
+
+	tcpCtx->options[KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT]++;
+
+	/* Keep track of the requests sent over the connection. */
+	res = handleArray_append(&conn->sent, &conn->sentLen, &conn->sentSize, req);
+	if (res != KSI_OK) KSI_AsyncHandle_free(req);
+	return res;
+}
+
+/**
+ * Writes the requests assigned to the connection. The requests are gathered into a single vectored write
+ * of up to #TCP_SEND_BATCH_MAX requests. Returns #KSI_ASYNC_NOT_FINISHED if the send would block.
+ */
+static int writeConnection(TcpAsyncCtx *tcpCtx, TcpAsyncConn *conn, time_t curTime) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	while (conn->outLen > 0) {
+		size_t n = (conn->outLen < TCP_SEND_BATCH_MAX) ? conn->outLen : TCP_SEND_BATCH_MAX;
+		size_t done = 0;
+		size_t i;
+#ifdef _WIN32
+		WSABUF bufs[TCP_SEND_BATCH_MAX];
+		DWORD c = 0;
+
+		for (i = 0; i < n; i++) {
+			bufs[i].buf = (char *)conn->out[i]->raw + conn->out[i]->sentCount;
+			bufs[i].len = (ULONG)(conn->out[i]->len - conn->out[i]->sentCount);
+		}
+
+		tcpCtx->options[KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT]++;
+		if (WSASend(conn->sockfd, bufs, (DWORD)n, &c, 0, NULL, NULL) == SOCKET_ERROR) {
+#else
+		struct iovec iov[TCP_SEND_BATCH_MAX];
+		struct msghdr msg;
+		ssize_t c;
+
+		for (i = 0; i < n; i++) {
+			iov[i].iov_base = conn->out[i]->raw + conn->out[i]->sentCount;
+			iov[i].iov_len = conn->out[i]->len - conn->out[i]->sentCount;
+		}
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n;
+
+		tcpCtx->options[KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT]++;
+		c = sendmsg(conn->sockfd, &msg, 0);
+		if (c == KSI_SCK_SOCKET_ERROR) {
+#endif
+			if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
+				KSI_LOG_info(tcpCtx->ctx,
+						"Async TCP send would block. Requests waiting to be sent %llu. Error: %d (%s).",
+						(unsigned long long)conn->outLen, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+				res = KSI_ASYNC_NOT_FINISHED;
+				goto cleanup;
+			} else {
+				KSI_LOG_error(tcpCtx->ctx,
+						"Async TCP closing connection. Unable to write to socket. Error: %d (%s).",
+						KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+				closeConnection(tcpCtx, conn, true, KSI_ASYNC_CONNECTION_CLOSED, __LINE__);
+				res = KSI_ASYNC_CONNECTION_CLOSED;
+				goto cleanup;
+			}
+		}
+
+		/* Update the progress of the written requests. */
 		res = KSI_OK;
+		for (i = 0; i < n; i++) {
+			KSI_AsyncHandle *req = conn->out[i];
+			size_t left = req->len - req->sentCount;
+
+			if ((size_t)c < left) {
+				req->sentCount += (size_t)c;
+				break;
+			}
+			c -= left;
+			done++;
+
+			KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "Sent request", req->raw, req->len);
+			res = conn_completeRequest(tcpCtx, conn, req, curTime);
+			if (res != KSI_OK) break;
+		}
+		conn->outLen -= done;
+		memmove(conn->out, conn->out + done, conn->outLen * sizeof(KSI_AsyncHandle *));
+		if (res != KSI_OK) goto cleanup;
+
+		/* The socket buffer is full. */
+		if (done < n) {
+			res = KSI_ASYNC_NOT_FINISHED;
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int dispatch(TcpAsyncCtx *tcpCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *req = NULL;
+	time_t curTime = 0;
+	size_t i;
+	size_t nfds = 0;
+	bool connected = false;
+	int connErr = KSI_OK;
+	long connErrExt = 0;
+
+	if (tcpCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
-	while (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0 &&
-			KSI_AsyncHandleList_elementAt(tcpCtx->reqQueue, 0, &req) == KSI_OK && req != NULL) {
-		time_t curTime = 0;
+	KSI_ERR_clearErrors(tcpCtx->ctx);
+
+	res = updateConnectionPool(tcpCtx);
+	if (res != KSI_OK) {
+		KSI_pushError(tcpCtx->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	time(&curTime);
 
-		/* Check if the request count can be restarted. */
-		if (difftime(time(&curTime), tcpCtx->roundStartAt) >= tcpCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]) {
-			KSI_LOG_info(tcpCtx->ctx, "Async TCP round request count: %llu.", (unsigned long long)tcpCtx->roundCount);
-			tcpCtx->roundCount = 0;
-			tcpCtx->roundStartAt = curTime;
+	/* Check connections. */
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		conn_pruneSent(conn);
+		conn_pruneOut(tcpCtx, conn, curTime);
+
+		if (conn->sockfd == TCP_INVALID_SOCKET_FD) {
+			/* Only open connection if there is anything in request queue. */
+			if (KSI_AsyncHandleList_length(tcpCtx->reqQueue) == 0 || conn->retryAt > curTime) continue;
+
+			res = openSocket(tcpCtx, conn);
+			if (res != KSI_OK) {
+				connErr = res;
+				connErrExt = KSI_SCK_errno;
+				closeConnection(tcpCtx, conn, true, res, __LINE__);
+				continue;
+			}
 		}
-		/* Check if more requests can be sent within the given timeframe. */
-		if (!(tcpCtx->roundCount < tcpCtx->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT])) {
-			KSI_LOG_debug(tcpCtx->ctx, "Async TCP round max request count reached.");
-			break;
+
+		tcpCtx->pfds[nfds].fd = conn->sockfd;
+		tcpCtx->pfds[nfds].events = POLLIN | POLLOUT;
+		tcpCtx->pfds[nfds].revents = 0;
+		nfds++;
+	}
+
+	if (nfds == 0) {
+		/* Fail the queued requests, if no connection could be opened. */
+		if (connErr != KSI_OK) reqQueue_clearWithError(tcpCtx->reqQueue, connErr, connErrExt);
+		KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection not ready.");
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = poll(tcpCtx->pfds, (unsigned)nfds, 0);
+	if (res == KSI_SCK_SOCKET_ERROR) {
+		KSI_LOG_error(tcpCtx->ctx, "Async TCP failed to test socket. Error: %d (%s).", KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
+		for (i = 0; i < tcpCtx->connCount; i++) {
+			if (tcpCtx->conns[i]->sockfd != TCP_INVALID_SOCKET_FD) {
+				closeConnection(tcpCtx, tcpCtx->conns[i], true, KSI_ASYNC_CONNECTION_CLOSED, __LINE__);
+			}
 		}
+		res = KSI_ASYNC_CONNECTION_CLOSED;
+		goto cleanup;
+	}
 
-		if (req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
-			/* The state could have been changed in application layer. Just remove the request from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+	for (i = 0, nfds = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		if (conn->sockfd == TCP_INVALID_SOCKET_FD) continue;
+		conn->revents = tcpCtx->pfds[nfds++].revents;
+	}
+
+	/* Handle input. */
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		if (conn->sockfd == TCP_INVALID_SOCKET_FD) continue;
+
+		if (conn->revents == 0) {
+			if (!conn->socketReady &&
+						(tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT] == 0 ||
+						(difftime(curTime, conn->connectedAt) > tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT]))) {
+				KSI_LOG_debug(tcpCtx->ctx, "Async TCP connection timeout.");
+				closeConnection(tcpCtx, conn, true, KSI_NETWORK_CONNECTION_TIMEOUT, __LINE__);
+				connErr = KSI_NETWORK_CONNECTION_TIMEOUT;
+				connErrExt = 0;
+			} else {
+				connected = true;
+			}
 			continue;
 		}
+		if (!conn->socketReady) {
+			conn->socketReady = true;
+			conn->failCount = 0;
+			conn->retryAt = 0;
+		}
 
-		/* Verify that the send timeout has not elapsed. */
-		if (tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
-			(difftime(curTime, req->reqTime) > tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
-			/* Set error. */
-			req->state = KSI_ASYNC_STATE_ERROR;
-			req->err = KSI_NETWORK_SEND_TIMEOUT;
-			/* Just remove the request from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
-			continue;
+		if (conn->revents & POLLIN) {
+			/* On failure the connection is closed, but the others may still be able to serve the requests. */
+			res = readConnection(tcpCtx, conn);
+			if (res == KSI_ASYNC_CONNECTION_CLOSED) continue;
+			if (res != KSI_OK) goto cleanup;
 		}
+		connected = true;
+	}
 
-		KSI_LOG_logBlob(tcpCtx->ctx, KSI_LOG_DEBUG, "Sending request", req->raw, req->len);
+	if (!connected) {
+		/* Fail the queued requests, if none of the connections is usable. */
+		if (connErr != KSI_OK) reqQueue_clearWithError(tcpCtx->reqQueue, connErr, connErrExt);
+		res = KSI_OK;
+		goto cleanup;
+	}
 
-		while (req->sentCount < req->len) {
-			int c;
-#ifdef _WIN32
-			if (req->len - req->sentCount > INT_MAX) {
-				c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, (int) (INT_MAX), 0);
-			} else {
-				c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, (int) (req->len - req->sentCount), 0);
+	/* Handle output. Finish the requests that have been partially sent first. */
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		if (conn->outLen > 0 && (conn->revents & POLLOUT)) {
+			if (writeConnection(tcpCtx, conn, curTime) != KSI_OK) conn->revents &= ~POLLOUT;
+		}
+	}
+
+	/* Distribute the queued requests between the writable connections and write them in batches. */
+	while (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0) {
+		size_t nofWritable = 0;
+		size_t pending = 0;
+		size_t batch;
+		bool assigned = false;
+
+		for (i = 0; i < tcpCtx->connCount; i++) {
+			TcpAsyncConn *conn = tcpCtx->conns[i];
+
+			pending += conn->outLen;
+			if (conn->sockfd != TCP_INVALID_SOCKET_FD && conn->outLen == 0 && (conn->revents & POLLOUT)) nofWritable++;
+		}
+		if (nofWritable == 0) {
+			KSI_LOG_debug(tcpCtx->ctx, "Async TCP output buffer not ready.");
+			break;
+		}
+		/* Spread the requests evenly, but do not exceed the batch size of a single write. */
+		batch = (KSI_AsyncHandleList_length(tcpCtx->reqQueue) + nofWritable - 1) / nofWritable;
+		if (batch > TCP_SEND_BATCH_MAX) batch = TCP_SEND_BATCH_MAX;
+
+		while (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0 &&
+				KSI_AsyncHandleList_elementAt(tcpCtx->reqQueue, 0, &req) == KSI_OK && req != NULL) {
+			TcpAsyncConn *conn = NULL;
+
+			/* Check if the request count can be restarted. */
+			if (difftime(time(&curTime), tcpCtx->roundStartAt) >= tcpCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]) {
+				KSI_LOG_info(tcpCtx->ctx, "Async TCP round request count: %llu.", (unsigned long long)tcpCtx->roundCount);
+				tcpCtx->roundCount = 0;
+				tcpCtx->roundStartAt = curTime;
 			}
-#else
-			c = send(tcpCtx->sockfd, (char *) req->raw + req->sentCount, req->len - req->sentCount, 0);
-#endif
-			if (c == KSI_SCK_SOCKET_ERROR) {
-				if (KSI_SCK_errno == KSI_SCK_EWOULDBLOCK || KSI_SCK_errno == KSI_SCK_EAGAIN) {
-					KSI_LOG_info(tcpCtx->ctx,
-							"Async TCP send would block. Bytes sent so far %d/%d. Error: %d (%s).",
-							(unsigned)req->sentCount, (unsigned)req->len, KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-					goto cleanup;
-				} else {
-					closeSocket(tcpCtx, __LINE__);
-					KSI_LOG_error(tcpCtx->ctx,
-							"Async TCP closing connection. Unable to write to socket. Error: %d (%s).",
-							KSI_SCK_errno, KSI_SCK_strerror(KSI_SCK_errno));
-					res = KSI_ASYNC_CONNECTION_CLOSED;
-					goto cleanup;
-				}
+			/* Check if more requests can be sent within the given timeframe. */
+			if (!(tcpCtx->roundCount + pending < tcpCtx->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT])) {
+				KSI_LOG_debug(tcpCtx->ctx, "Async TCP round max request count reached.");
+				break;
+			}
+
+			if (req->state != KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) {
+				/* The state could have been changed in application layer. Just remove the request from the request queue. */
+				KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+				continue;
+			}
+
+			/* Verify that the send timeout has not elapsed. */
+			if (tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ||
+				(difftime(curTime, req->reqTime) > tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT])) {
+				/* Set error. */
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
+				req->err = KSI_NETWORK_SEND_TIMEOUT;
+				/* Just remove the request from the request queue. */
+				KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+				continue;
+			}
+
+			/* Pick the least loaded writable connection that has room in its batch. */
+			for (i = 0; i < tcpCtx->connCount; i++) {
+				TcpAsyncConn *tmp = tcpCtx->conns[i];
+
+				if (tmp->sockfd == TCP_INVALID_SOCKET_FD || !(tmp->revents & POLLOUT) || tmp->outLen >= batch) continue;
+				if (conn == NULL || conn_getLoad(tmp) < conn_getLoad(conn)) conn = tmp;
+			}
+			if (conn == NULL) break;
+
+			/* Move the request from the request queue to the connection. */
+			res = KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, &req);
+			if (res != KSI_OK) {
+				KSI_pushError(tcpCtx->ctx, res, NULL);
+				goto cleanup;
+			}
+			res = handleArray_append(&conn->out, &conn->outLen, &conn->outSize, req);
+			if (res != KSI_OK) {
+				KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
+				req->err = res;
+				KSI_AsyncHandle_free(req);
+				KSI_pushError(tcpCtx->ctx, res, NULL);
+				goto cleanup;
 			}
-			req->sentCount += c;
+			pending++;
+			assigned = true;
 		}
+		if (!assigned) break;
+
+		/* Write the assigned batches. */
+		for (i = 0; i < tcpCtx->connCount; i++) {
+			TcpAsyncConn *conn = tcpCtx->conns[i];
 
-		if (req->sentCount == req->len) {
-			tcpCtx->roundCount++;
-
-			/* Release the serialized payload. */
-			KSI_free(req->raw);
-			req->raw = NULL;
-			req->len = 0;
-			req->sentCount = 0;
-
-			/* Update state. */
-			req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
-			/* Start receive timeout. */
-			req->sndTime = curTime;
-			/* The request has been successfully dispatched. Remove it from the request queue. */
-			KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+			if (conn->outLen > 0 && (conn->revents & POLLOUT)) {
+				if (writeConnection(tcpCtx, conn, curTime) != KSI_OK) conn->revents &= ~POLLOUT;
+			}
 		}
 	}
 
 	res = KSI_OK;
 cleanup:
-	KSI_OctetString_free(resp);
 	return res;
 }
 
@@ -432,7 +840,7 @@ static int addToSendQueue(TcpAsyncCtx *tcpCtx, KSI_AsyncHandle *request) {
 		goto cleanup;
 	}
 
-	request->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
+	KSI_AsyncHandle_setState(request, KSI_ASYNC_STATE_WAITING_FOR_DISPATCH);
 	/* Start send timeout. */
 	time(&request->reqTime);
 
@@ -444,6 +852,123 @@ cleanup:
 	return res;
 }
 
+static bool isRoundFull(TcpAsyncCtx *tcpCtx, time_t curTime) {
+	return difftime(curTime, tcpCtx->roundStartAt) < tcpCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION] &&
+			!(tcpCtx->roundCount < tcpCtx->options[KSI_ASYNC_OPT_MAX_REQUEST_COUNT]);
+}
+
+static int getPollFds(TcpAsyncCtx *tcpCtx, KSI_AsyncPollFd *fds, size_t fds_len, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+	size_t n = 0;
+	bool sendQueued = false;
+
+	if (tcpCtx == NULL || (fds == NULL && fds_len != 0) || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* The connections are opened during dispatch. */
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		if (tcpCtx->conns[i]->sockfd != TCP_INVALID_SOCKET_FD) n++;
+	}
+
+	*count = n;
+	if (fds_len < n) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	sendQueued = KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0 && !isRoundFull(tcpCtx, time(NULL));
+	for (i = 0, n = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		if (conn->sockfd == TCP_INVALID_SOCKET_FD) continue;
+
+		fds[n].fd = conn->sockfd;
+		fds[n].events = KSI_ASYNC_EVENT_READ;
+		/* Wait for the connection to be established, or for the requests to be sent. */
+		if (!conn->socketReady || conn->outLen > 0 || sendQueued) {
+			fds[n].events |= KSI_ASYNC_EVENT_WRITE;
+		}
+		n++;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int getTimeout(TcpAsyncCtx *tcpCtx, long *timeout) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncHandle *req = NULL;
+	long tmp = -1;
+	size_t i;
+	size_t j;
+
+	if (tcpCtx == NULL || timeout == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Drop the requests that can not be dispatched anymore, as dispatch would. The state could have been
+	 * changed in application layer. */
+	while (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0) {
+		res = KSI_AsyncHandleList_elementAt(tcpCtx->reqQueue, 0, &req);
+		if (res != KSI_OK) goto cleanup;
+
+		if (req->state == KSI_ASYNC_STATE_WAITING_FOR_DISPATCH) break;
+
+		res = KSI_AsyncHandleList_remove(tcpCtx->reqQueue, 0, NULL);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (KSI_AsyncHandleList_length(tcpCtx->reqQueue) > 0) {
+		/* The connections are opened during dispatch. */
+		if (tcpCtx->connCount < tcpCtx->options[KSI_ASYNC_OPT_CONNECTION_COUNT]) {
+			*timeout = 0;
+			res = KSI_OK;
+			goto cleanup;
+		}
+		for (i = 0; i < tcpCtx->connCount; i++) {
+			if (tcpCtx->conns[i]->sockfd == TCP_INVALID_SOCKET_FD) {
+				KSI_AsyncTimeout_update(&tmp, tcpCtx->conns[i]->retryAt);
+			}
+		}
+
+		/* The queue is in the order of the request time, so the head has the earliest send deadline. */
+		KSI_AsyncTimeout_update(&tmp, tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ? 0 :
+				req->reqTime + (time_t)tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] + 1);
+
+		/* Wait for the next round to start. */
+		if (isRoundFull(tcpCtx, time(NULL))) {
+			KSI_AsyncTimeout_update(&tmp, tcpCtx->roundStartAt + (time_t)tcpCtx->options[KSI_ASYNC_PRIVOPT_ROUND_DURATION]);
+		}
+	}
+
+	for (i = 0; i < tcpCtx->connCount; i++) {
+		TcpAsyncConn *conn = tcpCtx->conns[i];
+
+		if (conn->sockfd != TCP_INVALID_SOCKET_FD && !conn->socketReady) {
+			KSI_AsyncTimeout_update(&tmp, tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT] == 0 ? 0 :
+					conn->connectedAt + (time_t)tcpCtx->options[KSI_ASYNC_OPT_CON_TIMEOUT] + 1);
+		}
+
+		/* The requests waiting for the connection to become writable expire in the order they were added. */
+		for (j = 0; j < conn->outLen; j++) {
+			if (conn->out[j]->sentCount > 0) continue;
+			KSI_AsyncTimeout_update(&tmp, tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] == 0 ? 0 :
+					conn->out[j]->reqTime + (time_t)tcpCtx->options[KSI_ASYNC_OPT_SND_TIMEOUT] + 1);
+			break;
+		}
+	}
+
+	*timeout = tmp;
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 static int getResponse(TcpAsyncCtx *tcpCtx, KSI_OctetString **response, size_t *left) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_OctetString *tmp = NULL;
@@ -503,9 +1028,13 @@ static int getCredentials(TcpAsyncCtx *tcpCtx, const char **user, const char **p
 
 static void TcpAsyncCtx_free(TcpAsyncCtx *t) {
 	if (t != NULL) {
+		size_t i;
+
 		KSI_AsyncHandleList_free(t->reqQueue);
 		KSI_OctetStringList_free(t->respQueue);
-		if (t->sockfd != TCP_INVALID_SOCKET_FD) close(t->sockfd);
+		for (i = 0; i < t->connCount; i++) TcpAsyncConn_free(t->conns[i]);
+		KSI_free(t->conns);
+		KSI_free(t->pfds);
 		KSI_free(t->host);
 		KSI_free(t->ksi_user);
 		KSI_free(t->ksi_pass);
@@ -529,20 +1058,18 @@ static int TcpAsyncCtx_new(KSI_CTX *ctx, TcpAsyncCtx **tcpCtx) {
 		goto cleanup;
 	}
 	tmp->ctx = ctx;
-	tmp->sockfd = TCP_INVALID_SOCKET_FD;
+	tmp->conns = NULL;
+	tmp->connCount = 0;
+	tmp->pfds = NULL;
 
 	tmp->reqQueue = NULL;
 	tmp->respQueue = NULL;
 
-	tmp->inLen = 0;
-
 	tmp->ksi_user = NULL;
 	tmp->ksi_pass = NULL;
 	tmp->host = NULL;
 	tmp->port = 0;
 
-	tmp->socketReady = false;
-	tmp->connectedAt = 0;
 	tmp->roundStartAt = 0;
 	tmp->roundCount = 0;
 
@@ -578,7 +1105,8 @@ int KSI_TcpAsyncClient_new(KSI_CTX *ctx, KSI_AsyncClient **c) {
 	tmp->getResponse = (int (*)(void *, KSI_OctetString **, size_t *))getResponse;
 	tmp->dispatch = (int (*)(void *))dispatch;
 	tmp->getCredentials = (int (*)(void *, const char **, const char **))getCredentials;
-
+	tmp->getPollFds = (int (*)(void *, KSI_AsyncPollFd *, size_t, size_t *))getPollFds;
+	tmp->getTimeout = (int (*)(void *, long *))getTimeout;
 
 	res = TcpAsyncCtx_new(ctx, &netImpl);
 	if (res != KSI_OK) goto cleanup;
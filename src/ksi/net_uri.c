@@ -468,8 +468,9 @@ cleanup:
 	return res;
 }
 
-static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char *loginId, const char *key) {
+static int uri_newAsyncClient(KSI_AsyncService *s, const char *uri, const char *loginId, const char *key, KSI_AsyncClient **client) {
 	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncClient *tmp = NULL;
 	char *schm = NULL;
 	char *ksi_user = NULL;
 	char *ksi_pass = NULL;
@@ -484,16 +485,11 @@ static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char
 	char addr[0xffff];
 	int c;
 
-	if (s == NULL || uri == NULL) {
+	if (s == NULL || uri == NULL || client == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	if (s->impl != NULL) {
-		res = KSI_INVALID_STATE;
-		goto cleanup;
-	}
-
 	res = s->uriSplit(uri, &schm, &ksi_user, &ksi_pass, &host, &port, &path, &query, &fragment);
 	if (res != KSI_OK) unableToParse = 1;
 
@@ -507,11 +503,10 @@ static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char
 				goto cleanup;
 			}
 
-			s->impl_free = (void (*)(void*))KSI_AsyncClient_free;
-			res = KSI_TcpAsyncClient_new(s->ctx, (KSI_AsyncClient **)&s->impl);
+			res = KSI_TcpAsyncClient_new(s->ctx, &tmp);
 			if (res != KSI_OK) goto cleanup;
 
-			res = KSI_TcpAsyncClient_setService(s->impl,
+			res = KSI_TcpAsyncClient_setService(tmp,
 					host, port,
 					loginId != NULL ? loginId : ksi_user,
 					key != NULL ? key : ksi_pass);
@@ -525,11 +520,10 @@ static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char
 				if (res != KSI_OK) goto cleanup;
 			}
 
-			s->impl_free = (void (*)(void*))KSI_AsyncClient_free;
-			res = KSI_HttpAsyncClient_new(s->ctx, (KSI_AsyncClient **)&s->impl);
+			res = KSI_HttpAsyncClient_new(s->ctx, &tmp);
 			if (res != KSI_OK) goto cleanup;
 
-			res = KSI_HttpAsyncClient_setService(s->impl,
+			res = KSI_HttpAsyncClient_setService(tmp,
 					strlen(addr) ? addr : uri,
 					loginId != NULL ? loginId : ksi_user,
 					key != NULL ? key : ksi_pass);
@@ -543,10 +537,14 @@ static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char
 			goto cleanup;
 	}
 
+	*client = tmp;
+	tmp = NULL;
+
 	res = KSI_OK;
 
 cleanup:
 
+	KSI_AsyncClient_free(tmp);
 	KSI_free(schm);
 	KSI_free(ksi_user);
 	KSI_free(ksi_pass);
@@ -558,7 +556,74 @@ cleanup:
 	return res;
 }
 
+static int uri_setAsyncService(KSI_AsyncService *s, const char *uri, const char *loginId, const char *key) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (s == NULL || uri == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (s->impl != NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	res = uri_newAsyncClient(s, uri, loginId, key, (KSI_AsyncClient **)&s->impl);
+	if (res != KSI_OK) goto cleanup;
+	s->impl_free = (void (*)(void*))KSI_AsyncClient_free;
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
+static int uri_setAsyncServiceMulti(KSI_AsyncService *s, const char **uris, size_t count, const char *loginId, const char *key) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AsyncClient *multi = NULL;
+	KSI_AsyncClient *endpoint = NULL;
+	size_t i;
+
+	if (s == NULL || uris == NULL || count == 0) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (s->impl != NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	res = KSI_MultiAsyncClient_new(s->ctx, &multi);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < count; i++) {
+		res = uri_newAsyncClient(s, uris[i], loginId, key, &endpoint);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_MultiAsyncClient_addEndpoint(multi, endpoint);
+		if (res != KSI_OK) goto cleanup;
+		endpoint = NULL;
+	}
+
+	s->impl = multi;
+	s->impl_free = (void (*)(void*))KSI_AsyncClient_free;
+	multi = NULL;
+
+	res = KSI_OK;
+cleanup:
+	KSI_AsyncClient_free(endpoint);
+	KSI_AsyncClient_free(multi);
+
+	return res;
+}
+
 int KSI_AsyncService_setEndpoint(KSI_AsyncService *s, const char *uri, const char *loginId, const char *key) {
 	if (s == NULL || uri == NULL) return KSI_INVALID_ARGUMENT;
 	return uri_setAsyncService(s, uri, loginId, key);
 }
+
+int KSI_AsyncService_setEndpoints(KSI_AsyncService *s, const char **uris, size_t count, const char *loginId, const char *key) {
+	if (s == NULL || uris == NULL || count == 0) return KSI_INVALID_ARGUMENT;
+	return uri_setAsyncServiceMulti(s, uris, count, loginId, key);
+}
@@ -54,6 +54,24 @@ extern "C" {
 
 	int KSI_AsyncService_setEndpoint(KSI_AsyncService *s, const char *uri, const char *loginId, const char *key);
 
+	/**
+	 * Configures the async service to use several alternative endpoints, e.g. the gateways of the same
+	 * aggregator deployment. Each request is routed to the endpoint with the lowest round-trip time
+	 * (exponentially weighted moving average), taking into account the requests the endpoint is already
+	 * busy with. A request that fails due to a connection error (e.g. #KSI_ASYNC_CONNECTION_CLOSED) is
+	 * resubmitted to another endpoint, while the failed endpoint is avoided for a backoff interval.
+	 * \param[in]	s			Async service object.
+	 * \param[in]	uris		List of endpoint URIs.
+	 * \param[in]	count		Number of URIs in \c uris.
+	 * \param[in]	loginId		Login id (\c NULL to use the user info of the URIs).
+	 * \param[in]	key			HMAC shared secret (\c NULL to use the user info of the URIs).
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note All of the endpoints must accept the same credentials.
+	 * \note The async options (see #KSI_AsyncOption) apply to each of the endpoints separately.
+	 * \see #KSI_AsyncService_setEndpoint for a single endpoint.
+	 */
+	int KSI_AsyncService_setEndpoints(KSI_AsyncService *s, const char **uris, size_t count, const char *loginId, const char *key);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,18 @@ extern "C" {
 	#  define KSI_EVP_MD_CTX_cleanup(md) EVP_MD_CTX_reset((md))
 	#endif
 
+	#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	#  define KSI_ASN1_STRING_get0_data(str) ASN1_STRING_data((str))
+	#else
+	#  define KSI_ASN1_STRING_get0_data(str) ASN1_STRING_get0_data((str))
+	#endif
+
+	#if OPENSSL_VERSION_NUMBER < 0x30000000L
+	#  define KSI_EVP_MD_CTX_md(md) EVP_MD_CTX_md((md))
+	#else
+	#  define KSI_EVP_MD_CTX_md(md) EVP_MD_CTX_get0_md((md))
+	#endif
+
 
 #ifdef __cplusplus
 }
@@ -53,9 +53,29 @@ static const char *defaultCaDir =
 
 static int KSI_PKITruststore_global_initCount = 0;
 
+/* Number of verified certificate chains remembered by a truststore. */
+#define PKI_CHAIN_CACHE_SIZE 16
+#define PKI_CHAIN_CACHE_DIGEST_LEN 32
+
+typedef struct PKIChainCacheEntry_st {
+	/* SHA-256 of the signing certificate followed by SHA-256 of the accompanying certificates. */
+	unsigned char key[2 * PKI_CHAIN_CACHE_DIGEST_LEN];
+	/* The earliest expiration time of the certificates in the verified chain. */
+	time_t notAfter;
+	int used;
+} PKIChainCacheEntry;
+
+typedef struct PKIChainCache_st {
+	PKIChainCacheEntry entries[PKI_CHAIN_CACHE_SIZE];
+	/* Slot to be replaced next. */
+	size_t next;
+} PKIChainCache;
+
 struct KSI_PKITruststore_st {
 	KSI_CTX *ctx;
 	X509_STORE *store;
+	/* Certificate chains already verified against the store. */
+	PKIChainCache *chainCache;
 };
 
 struct KSI_PKICertificate_st {
@@ -110,6 +130,7 @@ static int KSI_MD2hashAlg(EVP_MD *hash_alg) {
 void KSI_PKITruststore_free(KSI_PKITruststore *trust) {
 	if (trust != NULL) {
 		if (trust->store != NULL) X509_STORE_free(trust->store);
+		KSI_free(trust->chainCache);
 		KSI_free(trust);
 	}
 }
@@ -213,6 +234,7 @@ int KSI_PKITruststore_new(KSI_CTX *ctx, int setDefaults, KSI_PKITruststore **tru
 
 	tmp->ctx = ctx;
 	tmp->store = NULL;
+	tmp->chainCache = NULL;
 
 	tmp->store = X509_STORE_new();
 	if (tmp->store == NULL) {
@@ -220,6 +242,13 @@ int KSI_PKITruststore_new(KSI_CTX *ctx, int setDefaults, KSI_PKITruststore **tru
 		goto cleanup;
 	}
 
+	tmp->chainCache = KSI_new(PKIChainCache);
+	if (tmp->chainCache == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	memset(tmp->chainCache, 0, sizeof(PKIChainCache));
+
 	if (setDefaults) {
 		/* Set system default paths. */
 		if (!X509_STORE_set_default_paths(tmp->store)) {
@@ -717,11 +746,99 @@ cleanup:
 	return res;
 }
 
+/* Computes the chain cache key of the signing certificate and the certificates accompanying it. */
+static int pki_chainCache_makeKey(X509 *cert, STACK_OF(X509) *untrusted, unsigned char *key) {
+	int res = KSI_UNKNOWN_ERROR;
+	EVP_MD_CTX *md_ctx = NULL;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int md_len = 0;
+	int i;
+
+	if (!X509_digest(cert, EVP_sha256(), key, &md_len) || md_len != PKI_CHAIN_CACHE_DIGEST_LEN) {
+		res = KSI_CRYPTO_FAILURE;
+		goto cleanup;
+	}
+
+	md_ctx = KSI_EVP_MD_CTX_create();
+	if (md_ctx == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	if (!EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL)) {
+		res = KSI_CRYPTO_FAILURE;
+		goto cleanup;
+	}
+
+	for (i = 0; untrusted != NULL && i < sk_X509_num(untrusted); i++) {
+		if (!X509_digest(sk_X509_value(untrusted, i), EVP_sha256(), md, &md_len) || !EVP_DigestUpdate(md_ctx, md, md_len)) {
+			res = KSI_CRYPTO_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	if (!EVP_DigestFinal_ex(md_ctx, key + PKI_CHAIN_CACHE_DIGEST_LEN, &md_len)) {
+		res = KSI_CRYPTO_FAILURE;
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (md_ctx != NULL) KSI_EVP_MD_CTX_destroy(md_ctx);
+
+	return res;
+}
+
+/* Returns non-zero, if the chain has been verified and none of its certificates has expired since. */
+static int pki_chainCache_contains(const PKIChainCache *cache, const unsigned char *key, time_t now) {
+	size_t i;
+
+	for (i = 0; i < PKI_CHAIN_CACHE_SIZE; i++) {
+		const PKIChainCacheEntry *entry = &cache->entries[i];
+		if (entry->used && now <= entry->notAfter && memcmp(entry->key, key, sizeof(entry->key)) == 0) return 1;
+	}
+
+	return 0;
+}
+
+static void pki_chainCache_add(PKIChainCache *cache, const unsigned char *key, X509_STORE_CTX *storeCtx, time_t now) {
+	STACK_OF(X509) *chain = NULL;
+	PKIChainCacheEntry *entry = NULL;
+	time_t notAfter = 0;
+	int i;
+
+	chain = X509_STORE_CTX_get1_chain(storeCtx);
+	if (chain == NULL || sk_X509_num(chain) == 0) goto cleanup;
+
+	for (i = 0; i < sk_X509_num(chain); i++) {
+		time_t t = ASN1_GetTimeT(X509_get_notAfter(sk_X509_value(chain, i)));
+		if (i == 0 || t < notAfter) notAfter = t;
+	}
+
+	/* Nothing to remember, if the chain expires right away. */
+	if (notAfter < now) goto cleanup;
+
+	entry = &cache->entries[cache->next];
+	cache->next = (cache->next + 1) % PKI_CHAIN_CACHE_SIZE;
+
+	memcpy(entry->key, key, sizeof(entry->key));
+	entry->notAfter = notAfter;
+	entry->used = 1;
+
+cleanup:
+
+	if (chain != NULL) sk_X509_pop_free(chain, X509_free);
+}
+
 static int KSI_PKITruststore_verifySignatureCertificate(const KSI_PKITruststore *pki, const KSI_PKISignature *signature) {
 	int res;
 	X509 *cert = NULL;
 	X509_STORE_CTX *storeCtx = NULL;
 	KSI_PKICertificate *ksi_pki_cert = NULL;
+	unsigned char key[2 * PKI_CHAIN_CACHE_DIGEST_LEN];
+	time_t now;
 
 	if (pki == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -745,6 +862,19 @@ static int KSI_PKITruststore_verifySignatureCertificate(const KSI_PKITruststore
 
 	KSI_LOG_debug(pki->ctx, "Verifying PKI signature certificate.");
 
+	res = pki_chainCache_makeKey(cert, signature->pkcs7->d.sign->cert, key);
+	if (res != KSI_OK) {
+		KSI_pushError(pki->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	now = time(NULL);
+	if (pki_chainCache_contains(pki->chainCache, key, now)) {
+		KSI_LOG_debug(pki->ctx, "PKI signature certificate chain already verified.");
+		res = KSI_OK;
+		goto cleanup;
+	}
+
 	storeCtx = X509_STORE_CTX_new();
 	if (storeCtx == NULL) {
 		KSI_pushError(pki->ctx, res = KSI_OUT_OF_MEMORY, NULL);
@@ -770,6 +900,9 @@ static int KSI_PKITruststore_verifySignatureCertificate(const KSI_PKITruststore
 		goto cleanup;
 	}
 
+	/* Only trusted chains are remembered, adding lookups to the store can not make them untrusted. */
+	pki_chainCache_add(pki->chainCache, key, storeCtx, now);
+
 	KSI_LOG_debug(pki->ctx, "PKI signature certificate verified.");
 
 	res = KSI_OK;
@@ -782,14 +915,52 @@ cleanup:
 	return res;
 }
 
+/**
+ * Finds the first subject name entry with the given OID. The well-known OIDs are resolved to a NID
+ * with a table lookup, only the unknown ones are parsed into an ASN.1 object.
+ */
+static int pki_certificate_findSubjectEntry(KSI_CTX *ctx, X509_NAME *subj, const char *oidStr, int *index) {
+	int res = KSI_UNKNOWN_ERROR;
+	ASN1_OBJECT *oid = NULL;
+	int nid;
+
+	nid = OBJ_txt2nid(oidStr);
+	if (nid != NID_undef) {
+		*index = X509_NAME_get_index_by_NID(subj, nid, -1);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	oid = OBJ_txt2obj(oidStr, 1);
+	if (oid == NULL) {
+		if (ERR_GET_REASON(ERR_peek_last_error()) == ERR_R_MALLOC_FAILURE) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		} else if (ERR_GET_REASON(ERR_peek_last_error()) > 99) {
+			/* ASN1 library error codes start from 100. */
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Unknown OID.");
+		} else {
+			KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, NULL);
+		}
+		goto cleanup;
+	}
+
+	*index = X509_NAME_get_index_by_OBJ(subj, oid, -1);
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (oid != NULL) ASN1_OBJECT_free(oid);
+
+	return res;
+}
+
 static int pki_truststore_verifyCertificateConstraints(const KSI_PKITruststore *pki, const KSI_PKISignature *signature, KSI_CertConstraint *certConstraints) {
 	size_t i;
 	int res;
 	KSI_PKICertificate *ksi_pki_cert = NULL;
 	X509 *cert = NULL;
 	X509_NAME *subj = NULL;
-	ASN1_OBJECT *oid = NULL;
-	char tmp[256];
 
 	if (pki == NULL || pki->ctx == NULL || signature == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -826,37 +997,27 @@ static int pki_truststore_verifyCertificateConstraints(const KSI_PKITruststore *
 
 	for (i = 0; certConstraints[i].oid != NULL; i++) {
 		KSI_CertConstraint *ptr = &certConstraints[i];
+		ASN1_STRING *value = NULL;
+		int index = -1;
 
 		KSI_LOG_info(pki->ctx, "%llu. Verifying PKI signature certificate with OID: '%s' expected value: '%s'.", (unsigned long long)i + 1, ptr->oid, ptr->val);
 
-		oid = OBJ_txt2obj(ptr->oid, 1);
-		if (oid == NULL) {
-			if (ERR_GET_REASON(ERR_peek_last_error()) == ERR_R_MALLOC_FAILURE) {
-				KSI_pushError(pki->ctx, res = KSI_OUT_OF_MEMORY, NULL);
-			} else if (ERR_GET_REASON(ERR_peek_last_error()) > 99) {
-				/* ASN1 library error codes start from 100. */
-				KSI_pushError(pki->ctx, res = KSI_INVALID_ARGUMENT, "Unknown OID.");
-			} else {
-				KSI_pushError(pki->ctx, res = KSI_UNKNOWN_ERROR, NULL);
-			}
-			goto cleanup;
-		}
+		res = pki_certificate_findSubjectEntry(pki->ctx, subj, ptr->oid, &index);
+		if (res != KSI_OK) goto cleanup;
 
-		res = X509_NAME_get_text_by_OBJ(subj, oid, tmp, sizeof(tmp));
-		if (res < 0) {
+		if (index < 0 || (value = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(subj, index))) == NULL) {
 			KSI_LOG_debug(pki->ctx, "Value for OID: '%s' does not exist.", ptr->oid);
 			KSI_pushError(pki->ctx, res = KSI_PKI_CERTIFICATE_NOT_TRUSTED, NULL);
 			goto cleanup;
 		}
 
-		if (strncmp(tmp, ptr->val, sizeof(tmp))) {
-			KSI_LOG_debug(pki->ctx, "Unexpected value: '%s' for OID: '%s'.", tmp, ptr->oid);
+		/* Compare the raw value in place, there is no need to format it first. */
+		if (ptr->val == NULL || (size_t)ASN1_STRING_length(value) != strlen(ptr->val) ||
+				memcmp(KSI_ASN1_STRING_get0_data(value), ptr->val, (size_t)ASN1_STRING_length(value)) != 0) {
+			KSI_LOG_debug(pki->ctx, "Unexpected value: '%.*s' for OID: '%s'.", ASN1_STRING_length(value), (const char *)KSI_ASN1_STRING_get0_data(value), ptr->oid);
 			KSI_pushError(pki->ctx, res = KSI_PKI_CERTIFICATE_NOT_TRUSTED, "Unexpected OID value for PKI Certificate constraint.");
 			goto cleanup;
 		}
-
-		ASN1_OBJECT_free(oid);
-		oid = NULL;
 	}
 	KSI_LOG_debug(pki->ctx, "PKI signature certificate constraints verified.");
 	res = KSI_OK;
@@ -864,7 +1025,6 @@ static int pki_truststore_verifyCertificateConstraints(const KSI_PKITruststore *
 cleanup:
 
 	KSI_PKICertificate_free(ksi_pki_cert);
-	if (oid != NULL) ASN1_OBJECT_free(oid);
 
 	return res;
 }
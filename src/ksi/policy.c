@@ -26,11 +26,15 @@
 #include "impl/policy_impl.h"
 #include "impl/signature_impl.h"
 #include "impl/ctx_impl.h"
+#include "impl/calendar_cache_impl.h"
 
 
 static void RuleVerificationResult_free(KSI_RuleVerificationResult *result);
 static void VerificationTempData_clear(VerificationTempData *tmp);
 
+/* Upper limit of the extended calendar hash chains cached for a batch, if the context cache is disabled. */
+#define KSI_VERIFY_BATCH_CHAIN_CACHE_SIZE 1024
+
 KSI_IMPLEMENT_LIST(KSI_RuleVerificationResult, RuleVerificationResult_free);
 KSI_IMPLEMENT_REF(KSI_PolicyVerificationResult);
 
@@ -730,7 +734,7 @@ cleanup:
 	return res;
 }
 
-int KSI_SignatureVerifier_verify(const KSI_Policy *policy, KSI_VerificationContext *context, KSI_PolicyVerificationResult **result) {
+static int signatureVerifier_verify(const KSI_Policy *policy, KSI_VerificationContext *context, VerificationBatchData *batch, KSI_PolicyVerificationResult **result) {
 	const KSI_Policy *currentPolicy;
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ctx = NULL;
@@ -741,6 +745,7 @@ int KSI_SignatureVerifier_verify(const KSI_Policy *policy, KSI_VerificationConte
 	tempData.aggregationOutputHash = NULL;
 	tempData.calendarChain = NULL;
 	tempData.publicationsFile = NULL;
+	tempData.batch = batch;
 
 	if (policy == NULL || context == NULL || context->ctx == NULL || result == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -825,6 +830,80 @@ cleanup:
 	return res;
 }
 
+int KSI_SignatureVerifier_verify(const KSI_Policy *policy, KSI_VerificationContext *context, KSI_PolicyVerificationResult **result) {
+	return signatureVerifier_verify(policy, context, NULL, result);
+}
+
+int KSI_SignatureVerifier_verifyBatch(const KSI_Policy *policy, KSI_VerificationContext *context, KSI_Signature **signatures,
+		const KSI_DataHash **documentHashes, size_t count, KSI_PolicyVerificationResult **results) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	KSI_Signature *signature = NULL;
+	const KSI_DataHash *documentHash = NULL;
+	VerificationBatchData batch;
+	size_t chainCacheSize = 0;
+	bool chainCacheEnabled = false;
+	size_t i;
+
+	memset(&batch, 0, sizeof(batch));
+
+	if (policy == NULL || context == NULL || context->ctx == NULL || (signatures == NULL && count != 0) || results == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	ctx = context->ctx;
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < count; i++) results[i] = NULL;
+
+	/* Keep the signature specific fields of the template context. */
+	signature = context->signature;
+	documentHash = context->documentHash;
+
+	/* Share the extended calendar hash chains between the signatures of the batch, even if the cache is disabled. */
+	chainCacheSize = ctx->options[KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE];
+	if (chainCacheSize == 0 && count > 1) {
+		ctx->options[KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE] = count < KSI_VERIFY_BATCH_CHAIN_CACHE_SIZE ? count : KSI_VERIFY_BATCH_CHAIN_CACHE_SIZE;
+		chainCacheEnabled = true;
+	}
+
+	for (i = 0; i < count; i++) {
+		context->signature = signatures[i];
+		context->documentHash = documentHashes != NULL ? documentHashes[i] : NULL;
+
+		res = signatureVerifier_verify(policy, context, &batch, &results[i]);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK && results != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_PolicyVerificationResult_free(results[i]);
+			results[i] = NULL;
+		}
+	}
+
+	if (context != NULL) {
+		context->signature = signature;
+		context->documentHash = documentHash;
+	}
+
+	/* Drop the chains cached for the batch only. */
+	if (chainCacheEnabled) {
+		ctx->options[KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE] = chainCacheSize;
+		KSI_CalendarChainCache_free(ctx->calendarChainCache);
+		ctx->calendarChainCache = NULL;
+	}
+
+	KSI_PublicationsFile_free(batch.publicationsFile);
+
+	return res;
+}
+
 void KSI_Policy_free(KSI_Policy *policy) {
 	KSI_free(policy);
 }
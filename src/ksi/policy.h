@@ -266,6 +266,28 @@ extern "C" {
 	 */
 	int KSI_SignatureVerifier_verify(const KSI_Policy *policy, KSI_VerificationContext *context, KSI_PolicyVerificationResult **result);
 
+	/**
+	 * Verifies a batch of KSI signatures according to specified \c policy. Every signature is verified
+	 * as with #KSI_SignatureVerifier_verify, using \c context as a template for the other verification
+	 * parameters. The work that does not depend on the individual signature is done only once for the
+	 * whole batch: the publications file is received and verified once, and the extended calendar
+	 * hash chains are shared between the signatures with the same aggregation and publication time,
+	 * even if #KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE is 0.
+	 * \param[in]	policy			Policy to be verified.
+	 * \param[in]	context			Context for verifying the policy. The \c signature and \c documentHash
+	 *								fields are ignored and restored on return.
+	 * \param[in]	signatures		Signatures to be verified.
+	 * \param[in]	documentHashes	Document hashes of the signatures, may be \c NULL. Individual hashes may also be \c NULL.
+	 * \param[in]	count			Number of signatures.
+	 * \param[out]	results			Array of \c count receiving pointers for the verification results.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The user is responsible for freeing each of the \c results with #KSI_PolicyVerificationResult_free.
+	 * On failure, none of the results are returned.
+	 * \see #KSI_SignatureVerifier_verify
+	 */
+	int KSI_SignatureVerifier_verifyBatch(const KSI_Policy *policy, KSI_VerificationContext *context, KSI_Signature **signatures,
+			const KSI_DataHash **documentHashes, size_t count, KSI_PolicyVerificationResult **results);
+
 	/**
 	 * Frees a user created or cloned #KSI_Policy object. Predefined policies cannot be freed.
 	 * The function does not free any potential fallback policy objects which the user must free separately.
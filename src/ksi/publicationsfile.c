@@ -1323,6 +1323,7 @@ KSI_IMPLEMENT_SETTER(KSI_PublicationData, KSI_DataHash*, imprint, Imprint);
 KSI_IMPORT_TLV_TEMPLATE(KSI_PublicationData);
 KSI_IMPLEMENT_FROMTLV(KSI_PublicationData, 0x10, FROMTLV_ADD_BASETLV(baseTlv));
 KSI_IMPLEMENT_TOTLV(KSI_PublicationData);
+KSI_IMPLEMENT_WRITE_TLV(KSI_PublicationData);
 /**
  * KSI_PublicationRecord
  */
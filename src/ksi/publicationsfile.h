@@ -339,6 +339,7 @@ extern "C" {
 	char *KSI_PublicationData_toString(const KSI_PublicationData *t, char *buffer, size_t buffer_len);
 	int KSI_PublicationData_fromTlv(KSI_TLV *tlv, KSI_PublicationData **data);
 	int KSI_PublicationData_toTlv (KSI_CTX *ctx, const KSI_PublicationData *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_PublicationData);
 	KSI_DEFINE_REF(KSI_PublicationData);
 
 	/**
@@ -270,15 +270,21 @@ KSI_IMPLEMENT_SETTER(KSI_RFC3161, KSI_Integer*, sigAttrAlgo, SigAttrAlgo)
 
 KSI_IMPLEMENT_LIST(KSI_RFC3161, KSI_RFC3161_free);
 
-static int extractSignature(KSI_CTX *ctx, KSI_TLV *tlv, KSI_Signature **signature) {
+/**
+ * Extracts the signature from the TLV tree. On success the ownership of the tree is
+ * transferred to the signature object (as its base TLV) and \c *tlv is set to \c NULL.
+ */
+static int extractSignature(KSI_CTX *ctx, KSI_TLV **baseTlv, KSI_Signature **signature) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_SignatureBuilder *builder = NULL;
+	KSI_TLV *tlv = NULL;
 
 	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || tlv == NULL || signature == NULL) {
+	if (ctx == NULL || baseTlv == NULL || *baseTlv == NULL || signature == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
+	tlv = *baseTlv;
 
 	if (KSI_TLV_getTag(tlv) != 0x800) {
 		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Uni-Signature element is missing.");
@@ -299,11 +305,9 @@ static int extractSignature(KSI_CTX *ctx, KSI_TLV *tlv, KSI_Signature **signatur
 		goto cleanup;
 	}
 
-	res = KSI_TLV_clone(tlv, &builder->sig->baseTlv);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+	/* The parsed tree becomes the base TLV of the signature - no need to copy it. */
+	builder->sig->baseTlv = tlv;
+	*baseTlv = NULL;
 
 	/* Turn off the verification. */
 	builder->noVerify = 1;
@@ -738,93 +742,116 @@ cleanup:
 	return res;
 }
 
-static int KSI_signature_extendToWithoutVerification(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended) {
+int KSI_Signature_extendWithResponse(const KSI_Signature *sig, const KSI_ExtendReq *req, const KSI_ExtendResp *resp, KSI_Signature **extended) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_ExtendReq *req = NULL;
-	KSI_Integer *signTime = NULL;
-	KSI_RequestHandle *handle = NULL;
-	KSI_ExtendResp *resp = NULL;
 	KSI_CalendarHashChain *calHashChain = NULL;
 	KSI_Signature *tmp = NULL;
 
+	if (sig == NULL || req == NULL || resp == NULL || extended == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
 
-	KSI_ERR_clearErrors(ctx);
-	if (sig == NULL || ctx == NULL || extended == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	/* Verify the correctness of the response. */
+	res = KSI_ExtendResp_verifyWithRequest(resp, req);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
 	/* Make a copy of the original signature. */
 	res = KSI_Signature_clone(sig, &tmp);
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Request the calendar hash chain from this moment on. */
-	res = KSI_Signature_getSigningTime(sig, &signTime);
+	/* Extract the calendar hash chain. */
+	res = KSI_ExtendResp_getCalendarHashChain(resp, &calHashChain);
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Create request. */
-	res = KSI_createExtendRequest(ctx, signTime, to, &req);
+	/* Add the hash chain to the signature. */
+	res = tmp->replaceCalendarChain(tmp, (calHashChain = KSI_CalendarHashChain_ref(calHashChain)));
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		KSI_CalendarHashChain_free(calHashChain);
+		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Send the actual request. */
-	res = KSI_sendExtendRequest(ctx, req, &handle);
+	/* Remove calendar auth record and publication. */
+	res = removeCalAuthAndPublication(tmp);
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_RequestHandle_perform(handle);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx,res, NULL);
+	*extended = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Signature_free(tmp);
+
+	return res;
+}
+
+static int KSI_signature_extendToWithoutVerification(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_ExtendReq *req = NULL;
+	KSI_Integer *signTime = NULL;
+	KSI_RequestHandle *handle = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_Signature *tmp = NULL;
+
+
+	KSI_ERR_clearErrors(ctx);
+	if (sig == NULL || ctx == NULL || extended == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	/* Get and parse the response. */
-	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
+	/* Request the calendar hash chain from this moment on. */
+	res = KSI_Signature_getSigningTime(sig, &signTime);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Verify the correctness of the response. */
-	res = KSI_ExtendResp_verifyWithRequest(resp, req);
+	/* Create request. */
+	res = KSI_createExtendRequest(ctx, signTime, to, &req);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Extract the calendar hash chain. */
-	res = KSI_ExtendResp_getCalendarHashChain(resp, &calHashChain);
+	/* Send the actual request. */
+	res = KSI_sendExtendRequest(ctx, req, &handle);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Add the hash chain to the signature. */
-	res = tmp->replaceCalendarChain(tmp, calHashChain);
+	res = KSI_RequestHandle_perform(handle);
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		KSI_pushError(ctx,res, NULL);
 		goto cleanup;
 	}
 
-	/* Remove the chain from the structure, as it will be freed when this function finishes. */
-	res = KSI_ExtendResp_setCalendarHashChain(resp, NULL);
+	/* Get and parse the response. */
+	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Remove calendar auth record and publication. */
-	res = removeCalAuthAndPublication(tmp);
+	/* Replace the calendar hash chain of a copy of the original signature. */
+	res = KSI_Signature_extendWithResponse(sig, req, resp, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -1069,6 +1096,7 @@ cleanup:
 }
 
 int KSI_Signature_clone(const KSI_Signature *sig, KSI_Signature **clone) {
+	KSI_TLV *tlv = NULL;
 	KSI_Signature *tmp = NULL;
 	int res;
 
@@ -1078,7 +1106,14 @@ int KSI_Signature_clone(const KSI_Signature *sig, KSI_Signature **clone) {
 	}
 	KSI_ERR_clearErrors(sig->ctx);
 
-	res = extractSignature(sig->ctx, sig->baseTlv, &tmp);
+	/* The clone owns its memory, even if the original is a view (see #KSI_Signature_parseView). */
+	res = KSI_TLV_clone(sig->baseTlv, &tlv);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = extractSignature(sig->ctx, &tlv, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
@@ -1090,6 +1125,7 @@ int KSI_Signature_clone(const KSI_Signature *sig, KSI_Signature **clone) {
 	res = KSI_OK;
 
 cleanup:
+	KSI_TLV_free(tlv);
 	KSI_Signature_free(tmp);
 
 	return res;
@@ -1112,7 +1148,50 @@ int KSI_Signature_parseWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t
 		goto cleanup;
 	}
 
-	res = extractSignature(ctx, tlv, &tmp);
+	res = extractSignature(ctx, &tlv, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_verifyWithPolicy(tmp, NULL, 0, policy, context);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TLV_free(tlv);
+	KSI_Signature_free(tmp);
+
+	return res;
+}
+
+
+int KSI_Signature_parseViewWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_Policy *policy, KSI_VerificationContext *context, KSI_Signature **sig) {
+	KSI_TLV *tlv = NULL;
+	KSI_Signature *tmp = NULL;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || raw_len == 0 || sig == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_parseBlobView(ctx, raw, raw_len, &tlv);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = extractSignature(ctx, &tlv, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -1179,6 +1258,33 @@ cleanup:
 
 }
 
+KSI_DEFINE_WRITE_BYTES(KSI_Signature) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (o == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(o->ctx);
+
+	if (o->baseTlv != NULL) {
+		/* We assume that the baseTlv tree is up to date! */
+		res = KSI_TLV_writeBytes(o->baseTlv, buf, buf_size, buf_len, opt);
+	} else {
+		res = KSI_TlvTemplate_writeBytes(o->ctx, o, 0x0800, 0, 0, KSI_TLV_TEMPLATE(KSI_Signature), buf, buf_size, buf_len, opt);
+	}
+	if (res != KSI_OK) {
+		KSI_pushError(o->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_Signature_getAggregationHashChainIdentity(const KSI_Signature *sig, KSI_HashChainLinkIdentityList **identity) {
 	int res = KSI_UNKNOWN_ERROR;
 	size_t i;
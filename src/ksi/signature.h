@@ -70,6 +70,28 @@ extern "C" {
 
 #define KSI_Signature_parse(ctx, raw, raw_len, sig) KSI_Signature_parseWithPolicy(ctx, raw, raw_len, KSI_VERIFICATION_POLICY_INTERNAL, NULL, sig)
 
+	/**
+	 * Parses a KSI signature from raw buffer and verifies it with the provided policy and context,
+	 * without copying the TLV values of the buffer. In contrast to #KSI_Signature_parseWithPolicy the
+	 * signature object refers to the caller-owned buffer, thus the buffer must stay valid and
+	 * unmodified until the signature is freed. Use #KSI_Signature_clone to obtain a signature that
+	 * does not depend on the buffer.
+	 *
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		raw			Pointer to the raw signature.
+	 * \param[in]		raw_len		Length of the raw signature.
+	 * \param[in]		policy		Verification policy.
+	 * \param[in]		context		Verification context.
+	 * \param[out]		sig			Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \see #KSI_TLV_parseBlobView
+	 */
+	int KSI_Signature_parseViewWithPolicy(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_Policy *policy, KSI_VerificationContext *context, KSI_Signature **sig);
+
+#define KSI_Signature_parseView(ctx, raw, raw_len, sig) KSI_Signature_parseViewWithPolicy(ctx, raw, raw_len, KSI_VERIFICATION_POLICY_INTERNAL, NULL, sig)
+
 	/**
 	 * This function serializes the signature object into raw data. To deserialize it again
 	 * use #KSI_Signature_parse.
@@ -85,6 +107,12 @@ extern "C" {
 	 */
 	int KSI_Signature_serialize(const KSI_Signature *sig, unsigned char **raw, size_t *raw_len);
 
+	/**
+	 * Same as #KSI_Signature_serialize, but the signature is written into a pre-allocated
+	 * buffer. If \c buf is \c NULL and \c buf_size is 0, only the length is calculated.
+	 */
+	KSI_DEFINE_WRITE_BYTES(KSI_Signature);
+
 	/**
 	 * This function signs the given root hash value (\c rootHash) with the aggregation level (\c rootLevel)
 	 * of a locally aggregated hash tree. This function requires access to a working aggregaton and fails if
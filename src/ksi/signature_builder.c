@@ -359,56 +359,54 @@ cleanup:
 	return res;
 }
 
-static int appendAggregationChain(KSI_Signature *sig, KSI_AggregationHashChain *aggr) {
+/* Sets the aggregation time and completes the chain index of a chain to be prepended to the signature. */
+static int prepareAggregationChain(const KSI_Signature *sig, KSI_AggregationHashChain *aggr) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Integer *pAggrTm = NULL;
 	KSI_AggregationHashChain *pCurrent = NULL;
 	size_t listLen;
 	size_t i;
-	KSI_TLV *tlv = NULL;
-	KSI_LIST(KSI_HashChainLink) *pList = NULL;
 	KSI_LIST(KSI_Integer) *pIndex = NULL;
 	KSI_LIST(KSI_Integer) *pCurrentIndex = NULL;
 
-	if (sig == NULL || aggr == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
-	KSI_ERR_clearErrors(sig->ctx);
-
-	res = KSI_AggregationHashChain_getChain(aggr, &pList);
+	/* Get and update the aggregation time. */
+	res = KSI_Signature_getSigningTime(sig, &pAggrTm);
 	if (res != KSI_OK) {
 		KSI_pushError(sig->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	if (KSI_HashChainLinkList_length(pList) > 0) {
-		/* Get and update the aggregation time. */
-		res = KSI_Signature_getSigningTime(sig, &pAggrTm);
+	{
+		KSI_Integer *ref = NULL;
+		res = KSI_AggregationHashChain_setAggregationTime(aggr, ref = KSI_Integer_ref(pAggrTm));
 		if (res != KSI_OK) {
+			KSI_Integer_free(ref);
 			KSI_pushError(sig->ctx, res, NULL);
 			goto cleanup;
 		}
+	}
 
-		{
-			KSI_Integer *ref = NULL;
-			res = KSI_AggregationHashChain_setAggregationTime(aggr, ref = KSI_Integer_ref(pAggrTm));
-			if (res != KSI_OK) {
-				KSI_Integer_free(ref);
-				KSI_pushError(sig->ctx, res, NULL);
-				goto cleanup;
-			}
-		}
+	/* Update the aggregation hash chain. */
+	listLen = KSI_AggregationHashChainList_length(sig->aggregationChainList);
+	if (listLen == 0) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_STATE, "Signature does not contain any aggregation hash chains.");
+		goto cleanup;
+	}
+
+	/* Just make sure there is a chain index present. */
+	res = KSI_AggregationHashChain_getChainIndex(aggr, &pIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		/* Update the aggregation hash chain. */
-		listLen = KSI_AggregationHashChainList_length(sig->aggregationChainList);
-		if (listLen == 0) {
-			KSI_pushError(sig->ctx, res = KSI_INVALID_STATE, "Signature does not contain any aggregation hash chains.");
+	if (pIndex == NULL) {
+		res = addChainIndex(sig->ctx, aggr);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
 			goto cleanup;
 		}
 
-		/* Just make sure there is a chain index present. */
 		res = KSI_AggregationHashChain_getChainIndex(aggr, &pIndex);
 		if (res != KSI_OK) {
 			KSI_pushError(sig->ctx, res, NULL);
@@ -416,63 +414,78 @@ static int appendAggregationChain(KSI_Signature *sig, KSI_AggregationHashChain *
 		}
 
 		if (pIndex == NULL) {
-			res = addChainIndex(sig->ctx, aggr);
-			if (res != KSI_OK) {
-				KSI_pushError(sig->ctx, res, NULL);
-				goto cleanup;
-			}
+			KSI_pushError(sig->ctx, res = KSI_INVALID_STATE, NULL);
+			goto cleanup;
+		}
+	}
 
-			res = KSI_AggregationHashChain_getChainIndex(aggr, &pIndex);
-			if (res != KSI_OK) {
-				KSI_pushError(sig->ctx, res, NULL);
-				goto cleanup;
-			}
+	/* We assume the aggregation hash chain is ordered and the first aggregation hash chain is the one
+	 * with the longest chain index.
+	 */
+	res = KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &pCurrent);
+	if (res != KSI_OK || pCurrent == NULL) {
+		KSI_pushError(sig->ctx, res != KSI_OK ? res : (res = KSI_INVALID_STATE), NULL);
+		goto cleanup;
+	}
 
-			if (pIndex == NULL) {
-				KSI_pushError(sig->ctx, res = KSI_INVALID_STATE, NULL);
-				goto cleanup;
-			}
-		}
+	/* Traverse the chain index from back to forth, and add the values to the begining of the
+	 * aggregation hash chain.
+	 */
+
+	res = KSI_AggregationHashChain_getChainIndex(pCurrent, &pCurrentIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
 
-		/* We assume the aggregation hash chain is ordered and the first aggregation hash chain is the one
-		 * with the longest chain index.
-		 */
-		res = KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &pCurrent);
-		if (res != KSI_OK || pCurrent == NULL) {
-			KSI_pushError(sig->ctx, res != KSI_OK ? res : (res = KSI_INVALID_STATE), NULL);
+	for (i = KSI_IntegerList_length(pCurrentIndex); i > 0; i--) {
+		KSI_Integer *tmp = NULL;
+		KSI_Integer *ref = NULL;
+
+		res = KSI_IntegerList_elementAt(pCurrentIndex, i - 1, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
 			goto cleanup;
 		}
 
-		/* Traverse the chain index from back to forth, and add the values to the begining of the
-		 * aggregation hash chain.
-		 */
-
-		res = KSI_AggregationHashChain_getChainIndex(pCurrent, &pCurrentIndex);
+		res = KSI_IntegerList_insertAt(pIndex, 0, ref = KSI_Integer_ref(tmp));
 		if (res != KSI_OK) {
+			/* Cleanup the reference. */
+			KSI_Integer_free(ref);
+
 			KSI_pushError(sig->ctx, res, NULL);
 			goto cleanup;
 		}
+	}
 
-		for (i = KSI_IntegerList_length(pCurrentIndex); i > 0; i--) {
-			KSI_Integer *tmp = NULL;
-			KSI_Integer *ref = NULL;
+	res = KSI_OK;
 
-			res = KSI_IntegerList_elementAt(pCurrentIndex, i - 1, &tmp);
-			if (res != KSI_OK) {
-				KSI_pushError(sig->ctx, res, NULL);
-				goto cleanup;
-			}
+cleanup:
 
-			res = KSI_IntegerList_insertAt(pIndex, 0, ref = KSI_Integer_ref(tmp));
-			if (res != KSI_OK) {
-				/* Cleanup the reference. */
-				KSI_Integer_free(ref);
+	return res;
+}
 
-				KSI_pushError(sig->ctx, res, NULL);
-				goto cleanup;
-			}
-		}
+static int appendAggregationChain(KSI_Signature *sig, KSI_AggregationHashChain *aggr) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+	KSI_LIST(KSI_HashChainLink) *pList = NULL;
+
+	if (sig == NULL || aggr == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
 
+	KSI_ERR_clearErrors(sig->ctx);
+
+	res = KSI_AggregationHashChain_getChain(aggr, &pList);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (KSI_HashChainLinkList_length(pList) > 0) {
+		res = prepareAggregationChain(sig, aggr);
+		if (res != KSI_OK) goto cleanup;
 
 		/* Prepend the aggregation hash chain to the signature. */
 		{
@@ -690,6 +703,91 @@ cleanup:
 	return res;
 }
 
+int KSI_SignatureBuilder_serializeBase(const KSI_Signature *sig, int rootLevel, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Signature *clone = NULL;
+
+	if (sig == NULL || rootLevel < 0 || raw == NULL || raw_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (sig->baseTlv == NULL) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_STATE, "Signature has not been serialized.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_clone(sig, &clone);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The same as #KSI_SignatureBuilder_appendAggregationChain does. */
+	res = subRootLevel(clone, (KSI_uint64_t)rootLevel);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_serialize(clone, raw, raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Signature_free(clone);
+
+	return res;
+}
+
+int KSI_SignatureBuilder_serializeAggregationChain(const KSI_Signature *sig, KSI_AggregationHashChain *aggr, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_LIST(KSI_HashChainLink) *pList = NULL;
+
+	if (sig == NULL || aggr == NULL || raw == NULL || raw_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(sig->ctx);
+
+	res = KSI_AggregationHashChain_getChain(aggr, &pList);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* An empty chain is not appended to the signature. */
+	if (KSI_HashChainLinkList_length(pList) == 0) {
+		*raw = NULL;
+		*raw_len = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = prepareAggregationChain(sig, aggr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_serializeObject(sig->ctx, aggr, 0x0801, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationHashChain), raw, raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_SignatureBuilder_openFromSignature(const KSI_Signature *sig, KSI_SignatureBuilder **builder) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_SignatureBuilder *tmp = NULL;
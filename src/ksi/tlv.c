@@ -26,6 +26,36 @@
 
 #define KSI_BUFFER_SIZE 0xffff + 1
 
+/* Minimal size of an arena chunk allocated for a TLV tree with more than one buffer. */
+#define KSI_TLV_ARENA_CHUNK_SIZE 0x400
+
+typedef struct TlvArenaChunk_st TlvArenaChunk;
+
+struct TlvArenaChunk_st {
+	/** Previously allocated chunk. */
+	TlvArenaChunk *next;
+	/** Size of the storage following this header. */
+	size_t size;
+	/** Number of bytes already handed out. */
+	size_t used;
+};
+
+/**
+ * Reference counted storage of the TLV values. Every TLV holds a reference to the arena
+ * its value is stored in, so a nested TLV stays valid after it is detached from the tree
+ * and the rest of the tree is freed.
+ */
+typedef struct TlvArena_st {
+	/** The chunk currently used for allocations (head of the chunk list). */
+	TlvArenaChunk *chunks;
+	/** The first chunk, allocated together with the arena, or \c NULL. */
+	TlvArenaChunk *inlined;
+	/** Parsed buffer owned by the arena (see #KSI_TLV_parseBlob2), or \c NULL. */
+	unsigned char *owned;
+	/** Reference count. */
+	size_t ref;
+} TlvArena;
+
 struct KSI_TLV_st {
 	/** Context. */
 	KSI_CTX *ctx;
@@ -37,12 +67,15 @@ struct KSI_TLV_st {
 	/** TLV tag. */
 	unsigned tag;
 
-	/** Max size of the buffer. Default is 0xffff bytes. */
+	/** Size of the internal storage. */
 	size_t buffer_size;
 
-	/** Internal storage. */
+	/** Internal storage, part of #storage. */
 	unsigned char *buffer;
 
+	/** Flag indicating nested TLV's have been parsed from the internal storage, so it may not be overwritten. */
+	int isBufferShared;
+
 	/** Internal storage of nested TLV's. */
 	KSI_LIST(KSI_TLV) *nested;
 
@@ -52,56 +85,186 @@ struct KSI_TLV_st {
 	size_t relativeOffset;
 	size_t absoluteOffset;
 
+	/** Flag indicating the value points into a caller-owned buffer (see #KSI_TLV_parseBlobView). */
+	int isView;
+
+	/** Arena holding the value of this TLV, \c NULL if the value is not owned by the TLV tree. */
+	TlvArena *storage;
+
+	/** Arena used for allocating new storage, shared by the whole tree. Created on first use. */
+	TlvArena *arena;
 };
 
 KSI_IMPLEMENT_LIST(KSI_TLV, KSI_TLV_free);
 
 /**
- *
+ * Creates a new arena. The first chunk of \c size bytes is allocated together with the arena,
+ * so a standalone TLV does not pay for more than its payload.
  */
-static int createOwnBuffer(KSI_TLV *tlv, int copy) {
+static TlvArena *TlvArena_new(size_t size) {
+	TlvArena *arena = NULL;
+
+	arena = KSI_malloc(sizeof(TlvArena) + (size > 0 ? sizeof(TlvArenaChunk) + size : 0));
+	if (arena == NULL) return NULL;
+
+	arena->chunks = NULL;
+	arena->inlined = NULL;
+	arena->owned = NULL;
+	arena->ref = 1;
+
+	if (size > 0) {
+		arena->inlined = (TlvArenaChunk *)(arena + 1);
+		arena->inlined->next = NULL;
+		arena->inlined->size = size;
+		arena->inlined->used = 0;
+		arena->chunks = arena->inlined;
+	}
+
+	return arena;
+}
+
+static TlvArena *TlvArena_ref(TlvArena *arena) {
+	if (arena != NULL) arena->ref++;
+	return arena;
+}
+
+static void TlvArena_free(TlvArena *arena) {
+	TlvArenaChunk *chunk = NULL;
+
+	if (arena == NULL || --arena->ref > 0) return;
+
+	while ((chunk = arena->chunks) != NULL) {
+		arena->chunks = chunk->next;
+		if (chunk != arena->inlined) KSI_free(chunk);
+	}
+
+	KSI_free(arena->owned);
+	KSI_free(arena);
+}
+
+/**
+ * Carves \c size bytes from the arena. The chunks grow geometrically.
+ */
+static unsigned char *TlvArena_alloc(TlvArena *arena, size_t size) {
+	TlvArenaChunk *chunk = NULL;
+	size_t chunkSize;
+
+	if (arena == NULL || size == 0) return NULL;
+
+	chunk = arena->chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		chunkSize = size;
+		if (chunk != NULL) {
+			chunkSize = chunk->size * 2;
+			if (chunkSize < KSI_TLV_ARENA_CHUNK_SIZE) chunkSize = KSI_TLV_ARENA_CHUNK_SIZE;
+			if (chunkSize < size) chunkSize = size;
+		}
+
+		chunk = KSI_malloc(sizeof(TlvArenaChunk) + chunkSize);
+		if (chunk == NULL) return NULL;
+
+		chunk->size = chunkSize;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	chunk->used += size;
+
+	return (unsigned char *)(chunk + 1) + chunk->used - size;
+}
+
+/**
+ * Allocates a new right-sized storage from the arena of the TLV. The storage of the TLV is
+ * not changed, as the current value may still be needed (see #setOwnBuffer).
+ */
+static int createOwnBuffer(KSI_TLV *tlv, size_t size, unsigned char **buf) {
 	int res = KSI_UNKNOWN_ERROR;
-	unsigned char *buf = NULL;
-	size_t buf_len = 0;
+	unsigned char *tmp = NULL;
 
-	if (tlv == NULL) {
+	if (tlv == NULL || size == 0 || buf == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 	KSI_ERR_clearErrors(tlv->ctx);
 
-	if (tlv->buffer != NULL) {
-		KSI_pushError(tlv->ctx, res = KSI_INVALID_ARGUMENT, "TLV buffer already allocated.");
+	if (size >= KSI_BUFFER_SIZE) {
+		KSI_pushError(tlv->ctx, res = KSI_BUFFER_OVERFLOW, NULL);
 		goto cleanup;
 	}
 
-	buf = KSI_malloc(KSI_BUFFER_SIZE);
-	if (buf == NULL) {
+	if (tlv->arena == NULL) {
+		tlv->arena = TlvArena_new(size);
+		if (tlv->arena == NULL) {
+			KSI_pushError(tlv->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+	}
+
+	tmp = TlvArena_alloc(tlv->arena, size);
+	if (tmp == NULL) {
 		KSI_pushError(tlv->ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
 	}
 
-	if (copy && tlv->datap != NULL) {
-		buf_len = tlv->datap_len;
+	*buf = tmp;
 
-		memcpy(buf, tlv->datap, buf_len);
-	}
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Replaces the internal storage of the TLV with a buffer allocated by #createOwnBuffer (or
+ * \c NULL). The reference to the previous storage is released; the nested TLV's pointing into
+ * it hold references of their own.
+ */
+static void setOwnBuffer(KSI_TLV *tlv, unsigned char *buf, size_t size) {
+	TlvArena *storage = buf != NULL ? TlvArena_ref(tlv->arena) : NULL;
+
+	TlvArena_free(tlv->storage);
+	tlv->storage = storage;
 
 	tlv->buffer = buf;
-	buf = NULL;
+	tlv->buffer_size = size;
+	tlv->isBufferShared = 0;
 
 	tlv->datap = tlv->buffer;
-	tlv->datap_len = buf_len;
+	tlv->datap_len = 0;
+}
 
-	tlv->buffer_size = KSI_BUFFER_SIZE;
+static void relinkArena(KSI_TLV *tlv, TlvArena *arena) {
+	size_t i;
 
-	res = KSI_OK;
+	if (tlv->arena != arena) {
+		TlvArena_ref(arena);
+		TlvArena_free(tlv->arena);
+		tlv->arena = arena;
+	}
 
-cleanup:
+	for (i = 0; i < KSI_TLVList_length(tlv->nested); i++) {
+		KSI_TLV *tmp = NULL;
+		if (KSI_TLVList_elementAt(tlv->nested, i, &tmp) == KSI_OK && tmp != NULL) {
+			relinkArena(tmp, arena);
+		}
+	}
+}
 
-	KSI_free(buf);
+/**
+ * Makes the TLV (and its nested TLV's) use the arena of the parent for all further
+ * allocations. Storage already allocated stays referenced by its current users.
+ */
+static void attachToParent(KSI_TLV *parent, KSI_TLV *tlv) {
+	if (parent == NULL || tlv == NULL) return;
 
-	return res;
+	if (parent->arena == NULL) {
+		/* Share the arena of the child instead. */
+		parent->arena = TlvArena_ref(tlv->arena);
+	} else if (tlv->arena != parent->arena) {
+		relinkArena(tlv, parent->arena);
+	}
 }
 
 /**
@@ -109,9 +272,8 @@ cleanup:
  */
 static int encodeAsRaw(KSI_TLV *tlv) {
 	int res = KSI_UNKNOWN_ERROR;
-	size_t payloadLength;
+	size_t payloadLength = 0;
 	unsigned char *buf = NULL;
-	size_t buf_size = 0;
 
 	if (tlv == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -124,42 +286,37 @@ static int encodeAsRaw(KSI_TLV *tlv) {
 		goto cleanup;
 	}
 
-	if (tlv->buffer == NULL) {
-		buf_size = 0xffff + 1;
-		buf = KSI_calloc(buf_size, 1);
-		if (buf == NULL) {
-			KSI_pushError(tlv->ctx, res = KSI_OUT_OF_MEMORY, NULL);
-			goto cleanup;
-		}
-	} else {
-		buf = tlv->buffer;
-		buf_size = tlv->buffer_size;
-	}
-
-	payloadLength = buf_size;
-	res = KSI_TLV_serializePayload(tlv, buf, &payloadLength);
+	/* Calculate the exact size of the payload. */
+	res = KSI_TLV_writeBytes(tlv, NULL, 0, &payloadLength, KSI_TLV_OPT_NO_HEADER);
 	if (res != KSI_OK) {
 		KSI_pushError(tlv->ctx, res, NULL);
 		goto cleanup;
 	}
 
-	tlv->buffer = buf;
-	tlv->buffer_size = buf_size;
+	if (payloadLength > 0) {
+		res = createOwnBuffer(tlv, payloadLength, &buf);
+		if (res != KSI_OK) {
+			KSI_pushError(tlv->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_TLV_serializePayload(tlv, buf, &payloadLength);
+		if (res != KSI_OK) {
+			KSI_pushError(tlv->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
 
-	tlv->datap = buf;
+	setOwnBuffer(tlv, buf, payloadLength);
 	tlv->datap_len = payloadLength;
 
 	KSI_TLVList_free(tlv->nested);
 	tlv->nested = NULL;
 
-	buf = NULL;
-
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_free(buf);
-
 	return res;
 }
 
@@ -235,6 +392,12 @@ static int encodeAsNestedTlvs(KSI_TLV *tlv) {
 		/* Update the absolute offset of the child TLV object. */
 		tmp->absoluteOffset += allConsumedBytes;
 
+		attachToParent(tlv, tmp);
+
+		/* The nested TLV is a view of the same memory as its parent. */
+		tmp->isView = tlv->isView;
+		tmp->storage = TlvArena_ref(tlv->storage);
+
 		allConsumedBytes += lastConsumedBytes;
 
 		res = KSI_TLVList_append(tlvList, tmp);
@@ -255,6 +418,9 @@ static int encodeAsNestedTlvs(KSI_TLV *tlv) {
 	tlv->nested = tlvList;
 	tlvList = NULL;
 
+	/* The nested TLV's point into the storage of this TLV. */
+	tlv->isBufferShared = 1;
+
 	res = KSI_OK;
 
 cleanup:
@@ -267,6 +433,7 @@ cleanup:
 
 int KSI_TLV_setRawValue(KSI_TLV *tlv, const void *data, size_t data_len) {
 	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *buf = NULL;
 
 	if (tlv == NULL || (data == NULL && data_len != 0)) {
 		res = KSI_INVALID_ARGUMENT;
@@ -280,32 +447,31 @@ int KSI_TLV_setRawValue(KSI_TLV *tlv, const void *data, size_t data_len) {
 		goto cleanup;
 	}
 
-	if (tlv->buffer == NULL && data != NULL && data_len != 0) {
-		res = createOwnBuffer(tlv, 0);
+	/* Reuse the existing storage only if it is large enough and no detached nested TLV's may point into it. */
+	if (data_len != 0 && (tlv->buffer == NULL || tlv->buffer_size < data_len || tlv->isBufferShared)) {
+		res = createOwnBuffer(tlv, data_len, &buf);
 		if (res != KSI_OK) {
 			KSI_pushError(tlv->ctx, res, NULL);
 			goto cleanup;
 		}
+
+		/* The value might be pointing to the current storage, so copy it before releasing the storage. */
+		memcpy(buf, data, data_len);
+
+		setOwnBuffer(tlv, buf, data_len);
+	} else if (data_len > 0) {
+		memmove(tlv->buffer, data, data_len);
 	}
 
 	tlv->datap = tlv->buffer;
 	tlv->datap_len = data_len;
-
-	/* Double check the boundaries. */
-	if (tlv->buffer_size < data_len) {
-		KSI_pushError(tlv->ctx, res = KSI_BUFFER_OVERFLOW, NULL);
-		goto cleanup;
-	}
+	tlv->isView = 0;
 
 	if (tlv->nested != NULL) {
 		KSI_TLVList_free(tlv->nested);
 		tlv->nested = NULL;
 	}
 
-	if (data_len > 0) {
-		memcpy(tlv->datap, data, data_len);
-	}
-
 	res = KSI_OK;
 
 cleanup:
@@ -344,6 +510,10 @@ int KSI_TLV_new(KSI_CTX *ctx, unsigned tag, int isLenient, int isForward, KSI_TL
 
 	tmp->buffer_size = 0;
 	tmp->buffer = NULL;
+	tmp->isBufferShared = 0;
+
+	tmp->storage = NULL;
+	tmp->arena = NULL;
 
 	tmp->datap_len = 0;
 	tmp->datap = NULL;
@@ -351,6 +521,8 @@ int KSI_TLV_new(KSI_CTX *ctx, unsigned tag, int isLenient, int isForward, KSI_TL
 	tmp->relativeOffset = 0;
 	tmp->absoluteOffset = 0;
 
+	tmp->isView = 0;
+
 	/* Update the out parameter. */
 	*tlv = tmp;
 	tmp = NULL;
@@ -369,10 +541,12 @@ cleanup:
  */
 void KSI_TLV_free(KSI_TLV *tlv) {
 	if (tlv != NULL) {
-		KSI_free(tlv->buffer);
 		/* Free nested data. */
-
 		KSI_TLVList_free(tlv->nested);
+
+		/* The storage is released once the last TLV using it is freed. */
+		TlvArena_free(tlv->storage);
+		TlvArena_free(tlv->arena);
 		KSI_free(tlv);
 	}
 }
@@ -450,8 +624,17 @@ int KSI_TLV_parseBlob2(KSI_CTX *ctx, unsigned char *data, size_t data_length, in
 		goto cleanup;
 	}
 
-	/* If the memory should be owned by the TLV, store the pointer to free it after use. */
+	/* If the memory should be owned by the TLV, store the pointer to free it after use. The nested
+	 * TLV's share the same memory, so it is owned by an arena released after the last of them. */
 	if (ownMemory) {
+		tmp->storage = TlvArena_new(0);
+		if (tmp->storage == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		tmp->storage->owned = data;
+		tmp->arena = TlvArena_ref(tmp->storage);
+
 		tmp->buffer = data;
 		tmp->buffer_size = data_length;
 	}
@@ -469,6 +652,37 @@ cleanup:
 
 }
 
+int KSI_TLV_parseBlobView(KSI_CTX *ctx, const unsigned char *data, size_t data_length, KSI_TLV **tlv) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || data == NULL || tlv == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* The memory is not modified nor owned by the TLV. */
+	res = KSI_TLV_parseBlob2(ctx, (unsigned char *)data, data_length, 0, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->isView = 1;
+
+	*tlv = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TLV_free(tmp);
+
+	return res;
+}
+
 /**
  *
  */
@@ -510,6 +724,14 @@ int KSI_TLV_isNonCritical(const KSI_TLV *tlv) {
 	return (tlv != NULL) ? tlv->isNonCritical : 0;
 }
 
+int KSI_TLV_isView(const KSI_TLV *tlv) {
+	return (tlv != NULL) ? tlv->isView : 0;
+}
+
+int KSI_TLV_isNested(const KSI_TLV *tlv) {
+	return (tlv != NULL && tlv->nested != NULL) ? 1 : 0;
+}
+
 int KSI_TLV_isForward(const KSI_TLV *tlv) {
 	return (tlv != NULL) ? tlv->isForwardable : 0;
 }
@@ -551,6 +773,8 @@ int KSI_TLV_replaceNestedTlv(KSI_TLV *parentTlv, KSI_TLV *oldTlv, KSI_TLV *newTl
 		goto cleanup;
 	}
 
+	attachToParent(parentTlv, newTlv);
+
 	res = KSI_OK;
 
 cleanup:
@@ -591,6 +815,8 @@ int KSI_TLV_appendNestedTlv(KSI_TLV *target, KSI_TLV *tlv) {
 		goto cleanup;
 	}
 
+	attachToParent(target, tlv);
+
 	res = KSI_OK;
 
 cleanup:
@@ -621,7 +847,9 @@ static int serializeRaw(const KSI_TLV *tlv, unsigned char *buf, size_t buf_size,
 			KSI_pushError(tlv->ctx, res = KSI_INVALID_ARGUMENT, NULL);
 			goto cleanup;
 		}
-		memcpy(buf + buf_size - payloadLength, tlv->datap, payloadLength);
+		if (payloadLength > 0) {
+			memcpy(buf + buf_size - payloadLength, tlv->datap, payloadLength);
+		}
 	}
 
 	*buf_len = payloadLength;
@@ -729,6 +957,11 @@ static int serializeTlv(const KSI_TLV *tlv, unsigned char *buf, size_t buf_size,
 		ptr = buf + buf_size - len - 1;
 	}
 
+	if (len > 0xffff) {
+		KSI_pushError(tlv->ctx, res = KSI_BUFFER_OVERFLOW, "TLV payload too long.");
+		goto cleanup;
+	}
+
 	if ((opt & KSI_TLV_OPT_NO_HEADER) == 0) {
 		/* Write header. */
 		if (len > 0xff || tlv->tag > KSI_TLV_MASK_TLV8_TYPE) {
@@ -825,13 +1058,22 @@ int KSI_TLV_serialize(const KSI_TLV *tlv, unsigned char **buf, size_t *buf_len)
 
 	unsigned char *tmp = NULL;
 
-	tmp = KSI_calloc(4 + KSI_BUFFER_SIZE, 1);
+	if (tlv == NULL || buf == NULL || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Calculate the exact length of the serialized value to avoid allocating the maximum size. */
+	res = KSI_TLV_writeBytes(tlv, NULL, 0, &tmp_len, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp = KSI_malloc(tmp_len);
 	if (tmp == NULL) {
 		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
-	res = KSI_TLV_serialize_ex(tlv, tmp, 4 + KSI_BUFFER_SIZE, &tmp_len);
+	res = KSI_TLV_serialize_ex(tlv, tmp, tmp_len, &tmp_len);
 	if (res != KSI_OK) goto cleanup;
 
 
@@ -102,6 +102,38 @@ extern "C" {
 	 */
 	int KSI_TLV_parseBlob2(KSI_CTX *ctx, unsigned char *data, size_t data_length, int ownMemory, KSI_TLV **tlv);
 
+	/**
+	 * Parses a raw TLV into a #KSI_TLV without copying the data. The resulting TLV and all
+	 * the nested TLV's are views of the caller's buffer (see #KSI_TLV_isView) and objects extracted
+	 * from them may keep pointing into it.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	data		Pointer to the raw TLV.
+	 * \param[in]	data_length	Length of the raw data.
+	 * \param[out]	tlv			Pointer to the receiving pointer.
+	 *
+	 * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+	 * \note The buffer must not be modified or freed before the TLV and all the objects extracted from it.
+	 */
+	int KSI_TLV_parseBlobView(KSI_CTX *ctx, const unsigned char *data, size_t data_length, KSI_TLV **tlv);
+
+	/**
+	 * Checks if the value of the TLV is a view of the caller's buffer passed to #KSI_TLV_parseBlobView.
+	 * The flag is cleared as soon as the TLV gets its own storage.
+	 * \param[in]	tlv			The TLV object.
+	 *
+	 * \return 1 if the TLV is a view, 0 otherwise.
+	 */
+	int KSI_TLV_isView(const KSI_TLV *tlv);
+
+	/**
+	 * Checks if the value of the TLV is currently represented as a list of nested TLV's
+	 * (see #KSI_TLV_getNestedList), instead of a raw value.
+	 * \param[in]	tlv			The TLV object.
+	 *
+	 * \return 1 if the TLV value is a list of nested TLV's, 0 otherwise.
+	 */
+	int KSI_TLV_isNested(const KSI_TLV *tlv);
+
 	/**
 	 * This function extracts the binary data from the TLV.
 	 *
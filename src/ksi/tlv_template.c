@@ -26,6 +26,7 @@
 #include "hashchain.h"
 #include "pkitruststore.h"
 #include "fast_tlv.h"
+#include "impl/ctx_impl.h"
 
 /* At the moment value 0xff should be enough for everyone (actually less than 10 is used). */
 #define MAX_TEMPLATE_SIZE 0xff
@@ -41,6 +42,7 @@
 
 #define KSI_CalendarHashChainLink_free KSI_HashChainLink_free
 
+
 #define IS_FLAG_SET(tmpl, flg) (((tmpl).flags & flg) != 0)
 
 struct tlv_track_s {
@@ -429,6 +431,103 @@ cleanup:
 	return res;
 }
 
+/**
+ * A single element matched against the template. The element is either a #KSI_TLV object or, when
+ * decoding straight from the raw data, a TLV header read with #KSI_FTLV_memRead.
+ */
+typedef struct TemplateElement_st {
+	/* TLV tag. */
+	unsigned tag;
+	/* Flag - is non critical. */
+	int isNonCritical;
+	/* The TLV object, or NULL if the element is read from raw data. */
+	KSI_TLV *tlv;
+	/* Pointer to the beginning of the raw TLV (incl. the header), if the element is read from raw data. */
+	const unsigned char *raw;
+	/* The TLV header of the raw element. */
+	KSI_FTLV ftlv;
+	/* Flag - the raw element is a part of the caller-owned buffer (see #KSI_TLV_parseBlobView). */
+	int isView;
+} TemplateElement;
+
+typedef int (*element_generator_t)(void *, TemplateElement **);
+
+/* Adapter for the #KSI_TLV generators. */
+typedef struct TLVGeneratorAdapter_st {
+	void *generatorCtx;
+	int (*generator)(void *, KSI_TLV **);
+	TemplateElement el;
+} TLVGeneratorAdapter;
+
+static int TLVGeneratorAdapter_next(TLVGeneratorAdapter *adapter, TemplateElement **el) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+
+	res = adapter->generator(adapter->generatorCtx, &tlv);
+	if (res != KSI_OK) goto cleanup;
+
+	if (tlv == NULL) {
+		*el = NULL;
+	} else {
+		adapter->el.tag = KSI_TLV_getTag(tlv);
+		adapter->el.isNonCritical = KSI_TLV_isNonCritical(tlv);
+		adapter->el.tlv = tlv;
+		adapter->el.raw = NULL;
+
+		*el = &adapter->el;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Reads the consecutive TLVs from a raw buffer without creating #KSI_TLV objects. */
+typedef struct RawTLVReader_st {
+	const unsigned char *data;
+	size_t data_len;
+	size_t offset;
+	int isView;
+	TemplateElement el;
+} RawTLVReader;
+
+static int RawTLVReader_next(RawTLVReader *reader, TemplateElement **el) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (reader->offset >= reader->data_len) {
+		*el = NULL;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_FTLV_memRead(reader->data + reader->offset, reader->data_len - reader->offset, &reader->el.ftlv);
+	if (res != KSI_OK) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	reader->el.tag = reader->el.ftlv.tag;
+	reader->el.isNonCritical = reader->el.ftlv.is_nc;
+	reader->el.tlv = NULL;
+	reader->el.raw = reader->data + reader->offset;
+	reader->el.isView = reader->isView;
+
+	reader->offset += reader->el.ftlv.hdr_len + reader->el.ftlv.dat_len;
+
+	*el = &reader->el;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int extractElements(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, element_generator_t generator, struct tlv_track_s *tr, size_t tr_len, size_t tr_size);
+static int decode(KSI_CTX *ctx, void *payload, const unsigned char *data, size_t data_len, int isView, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size);
+
 static int extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
 	int res = KSI_UNKNOWN_ERROR;
 	int tr_inc = 0;
@@ -440,14 +539,6 @@ static int extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI_TlvTempl
 		goto cleanup;
 	}
 
-	res = KSI_TLV_getNestedList(tlv, &iter.list);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
-	iter.idx = 0;
-
 	/* When extracting second tlv there is no need to register it twice because it is mention in lower level. */
 	if (tr_len == 0) {
 		tr[tr_len].tag = KSI_TLV_getTag(tlv);
@@ -455,7 +546,29 @@ static int extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI_TlvTempl
 		tr_inc = 1;
 	}
 
-	res = extractGenerator(ctx, payload, (void *)&iter, tmpl, (int (*)(void *, KSI_TLV **))TLVListIterator_next, tr, tr_len + tr_inc, tr_size);
+	if (!KSI_TLV_isNested(tlv)) {
+		const unsigned char *raw = NULL;
+		size_t raw_len = 0;
+
+		/* The nested TLV's have not been created yet - decode the raw value without expanding it. */
+		res = KSI_TLV_getRawValue(tlv, &raw, &raw_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = decode(ctx, payload, raw, raw_len, KSI_TLV_isView(tlv), tmpl, tr, tr_len + tr_inc, tr_size);
+	} else {
+		res = KSI_TLV_getNestedList(tlv, &iter.list);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		iter.idx = 0;
+
+		res = extractGenerator(ctx, payload, (void *)&iter, tmpl, (int (*)(void *, KSI_TLV **))TLVListIterator_next, tr, tr_len + tr_inc, tr_size);
+	}
 	if (res != KSI_OK) {
 		char buf[1024];
 		KSI_LOG_debug(ctx, "Unable to parse TLV: %s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
@@ -471,11 +584,42 @@ cleanup:
 
 }
 
+/**
+ * Decodes the value of a composite TLV (i.e. the concatenation of the nested TLVs) straight from the raw data.
+ */
+static int decode(KSI_CTX *ctx, void *payload, const unsigned char *data, size_t data_len, int isView, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	RawTLVReader reader;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || payload == NULL || (data == NULL && data_len != 0) || tmpl == NULL || tr == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	reader.data = data;
+	reader.data_len = data_len;
+	reader.offset = 0;
+	reader.isView = isView;
+
+	res = extractElements(ctx, payload, (void *)&reader, tmpl, (element_generator_t)RawTLVReader_next, tr, tr_len, tr_size);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_TlvTemplate_extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI_TlvTemplate *tmpl) {
 	int res = KSI_UNKNOWN_ERROR;
 	struct tlv_track_s tr[0xf];
 
-	res = extract(ctx, payload, tlv, tmpl, tr, 0, sizeof(tr));
+	res = extract(ctx, payload, tlv, tmpl, tr, 0, sizeof(tr) / sizeof(*tr));
 	if (res != KSI_OK) {
 		KSI_LOG_logTlv(ctx, KSI_LOG_DEBUG, "Parsed tlv at failure", tlv);
 	}
@@ -484,24 +628,30 @@ int KSI_TlvTemplate_extract(KSI_CTX *ctx, void *payload, KSI_TLV *tlv, const KSI
 
 int KSI_TlvTemplate_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, const KSI_TlvTemplate *tmpl, void *payload) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
+	KSI_FTLV ftlv;
 	struct tlv_track_s tr[0xf];
 
 	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || raw == NULL || tmpl == NULL || payload == NULL) {
+	if (ctx == NULL || raw == NULL || raw_len < 2 || tmpl == NULL || payload == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_TLV_parseBlob2(ctx, (unsigned char *)raw, raw_len, 0, &tlv);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+	/* Read only the outer header, the value is decoded in a single pass without creating the TLV tree. */
+	res = KSI_FTLV_memRead(raw, raw_len, &ftlv);
+	if (res != KSI_OK || ftlv.hdr_len + ftlv.dat_len != raw_len) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Data size mismatch.");
 		goto cleanup;
 	}
 
-	res = extract(ctx, payload, tlv, tmpl, tr, 0, sizeof(tr));
+	tr[0].tag = ftlv.tag;
+	tr[0].desc = NULL;
+
+	res = decode(ctx, payload, raw + ftlv.hdr_len, ftlv.dat_len, 0, tmpl, tr, 1, sizeof(tr) / sizeof(*tr));
 	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+		char buf[1024];
+		KSI_LOG_debug(ctx, "Unable to parse TLV: %s", track_str(tr, 1, sizeof(tr) / sizeof(*tr), buf, sizeof(buf)));
+		KSI_pushError(ctx, res, buf);
 		goto cleanup;
 	}
 
@@ -509,8 +659,6 @@ int KSI_TlvTemplate_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len
 
 cleanup:
 
-	KSI_TLV_free(tlv);
-
 	return res;
 }
 
@@ -525,114 +673,258 @@ static size_t getTemplateLength(const KSI_TlvTemplate *tmpl) {
 	return len;
 }
 
-static int extractObject(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, KSI_TLV *tlv) {
-	int res = KSI_UNKNOWN_ERROR;
-	unsigned char *raw = NULL;
+/* Flags that have to be verified after all the elements have been processed. */
+#define TEMPLATE_REQUIRED_FLAGS (KSI_TLV_TMPL_FLG_MANDATORY | KSI_TLV_TMPL_FLG_LEAST_ONE_G0 | KSI_TLV_TMPL_FLG_LEAST_ONE_G1)
+
+/* Initial number of slots in the template cache (must be a power of two). */
+#define TEMPLATE_CACHE_INITIAL_SIZE 64
+
+typedef int (*toTlv_t)(KSI_CTX *, void *, unsigned, int, int, KSI_TLV **);
+typedef int (*write_t)(KSI_CTX *, const void *, unsigned, int, int, unsigned char *, size_t, size_t *, int);
+
+/**
+ * Objects which can be written directly into the output buffer, keyed by
+ * the \c toTlv function of the template entry (see #KSI_DEFINE_FN_WRITE_TLV).
+ */
+static const struct {
+	toTlv_t toTlv;
+	write_t writer;
+} templateWriters[] = {
+	{(toTlv_t)KSI_Integer_toTlv, (write_t)KSI_Integer_writeTlv},
+	{(toTlv_t)KSI_OctetString_toTlv, (write_t)KSI_OctetString_writeTlv},
+	{(toTlv_t)KSI_Utf8String_toTlv, (write_t)KSI_Utf8String_writeTlv},
+	{(toTlv_t)KSI_Utf8StringNZ_toTlv, (write_t)KSI_Utf8StringNZ_writeTlv},
+	{(toTlv_t)KSI_DataHash_toTlv, (write_t)KSI_DataHash_writeTlv},
+	{(toTlv_t)KSI_HashChainLink_toTlv, (write_t)KSI_HashChainLink_writeTlv},
+	{(toTlv_t)KSI_CalendarHashChainLink_toTlv, (write_t)KSI_CalendarHashChainLink_writeTlv},
+	{(toTlv_t)KSI_HashChainLink_LegacyId_toTlv, (write_t)KSI_HashChainLink_LegacyId_writeTlv},
+	{(toTlv_t)KSI_MetaDataElement_toTlv, (write_t)KSI_MetaDataElement_writeTlv},
+	{(toTlv_t)KSI_PublicationData_toTlv, (write_t)KSI_PublicationData_writeTlv},
+	{(toTlv_t)KSI_Header_toTlv, (write_t)KSI_Header_writeTlv},
+	{(toTlv_t)KSI_AggregationReq_toTlv, (write_t)KSI_AggregationReq_writeTlv},
+	{(toTlv_t)KSI_AggregationResp_toTlv, (write_t)KSI_AggregationResp_writeTlv},
+	{(toTlv_t)KSI_ExtendReq_toTlv, (write_t)KSI_ExtendReq_writeTlv},
+	{(toTlv_t)KSI_ExtendResp_toTlv, (write_t)KSI_ExtendResp_writeTlv}
+};
+
+static write_t findTemplateWriter(toTlv_t toTlv) {
+	size_t i;
+
+	if (toTlv == NULL) return NULL;
+
+	for (i = 0; i < sizeof(templateWriters) / sizeof(*templateWriters); i++) {
+		if (templateWriters[i].toTlv == toTlv) return templateWriters[i].writer;
+	}
+
+	return NULL;
+}
+
+/**
+ * Template compiled into an open addressing lookup table. All the index values
+ * are stored as \c index + 1, so zero marks an empty slot or the end of a chain.
+ */
+typedef struct CompiledTemplate_st {
+	/** The source template. */
+	const KSI_TlvTemplate *tmpl;
+	/** Number of entries in the template. */
 	size_t len;
-	void *tmp = NULL;
+	/** Size of the #slots table - 1. */
+	size_t mask;
+	/** Tag hash table pointing to the first template entry with the given tag. */
+	unsigned char *slots;
+	/** For every template entry, the next entry with the same tag. */
+	unsigned char *next;
+	/** Template entries with mandatory or group flags. */
+	unsigned char *required;
+	/** Number of elements in #required. */
+	size_t required_len;
+	/** For every template entry, the function writing the object directly into a buffer or \c NULL. */
+	write_t *writers;
+} CompiledTemplate;
+
+struct KSI_TlvTemplateCache_st {
+	/** Hash table of compiled templates keyed by the template pointer. */
+	CompiledTemplate **table;
+	/** Size of the table (a power of two). */
+	size_t size;
+	/** Number of templates in the table. */
+	size_t count;
+};
 
-	if (tmpl->fromTlv == NULL && tmpl->parser == NULL) {
-		KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR,
-				"Invalid template: no method for converting from tlv to object.");
+static size_t CompiledTemplate_slotOf(const CompiledTemplate *ct, unsigned tag) {
+	size_t i = tag & ct->mask;
+
+	/* The table is always at least twice the size of the template, so there is a free slot. */
+	while (ct->slots[i] != 0 && ct->tmpl[ct->slots[i] - 1].tag != tag) {
+		i = (i + 1) & ct->mask;
+	}
+
+	return i;
+}
+
+/* Returns the first template entry with the given tag, or #template_len if not present. */
+static size_t CompiledTemplate_first(const CompiledTemplate *ct, unsigned tag) {
+	size_t slot = CompiledTemplate_slotOf(ct, tag);
+	return ct->slots[slot] != 0 ? (size_t)ct->slots[slot] - 1 : ct->len;
+}
+
+/* Returns the next template entry with the same tag, or #template_len if none. */
+static size_t CompiledTemplate_next(const CompiledTemplate *ct, size_t i) {
+	return ct->next[i] != 0 ? (size_t)ct->next[i] - 1 : ct->len;
+}
+
+static int CompiledTemplate_new(const KSI_TlvTemplate *tmpl, size_t template_len, CompiledTemplate **out) {
+	int res = KSI_UNKNOWN_ERROR;
+	CompiledTemplate *tmp = NULL;
+	unsigned char last[MAX_TEMPLATE_SIZE];
+	size_t slots_size = 8;
+	size_t i;
+
+	if (tmpl == NULL || template_len == 0 || template_len > MAX_TEMPLATE_SIZE || out == NULL) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	/* Parse the object. */
-	if (tmpl->parser != NULL) {
-		res = KSI_TLV_getRawValue(tlv, (const unsigned char **) &raw, &len);
-		if (res != KSI_OK) {
-			KSI_pushError(ctx, res, NULL);
-			goto cleanup;
-		}
+	while (slots_size < 2 * template_len) slots_size <<= 1;
 
-		res = tmpl->parser(ctx, raw, len, tmpl->parser_opt, &tmp);
-		if (res != KSI_OK) {
-			KSI_pushError(ctx, res, NULL);
-			goto cleanup;
+	/* Allocate the structure and all its tables as a single block. */
+	tmp = KSI_malloc(sizeof(CompiledTemplate) + template_len * sizeof(write_t) + slots_size + 2 * template_len);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->tmpl = tmpl;
+	tmp->len = template_len;
+	tmp->mask = slots_size - 1;
+	tmp->writers = (write_t *)(tmp + 1);
+	tmp->slots = (unsigned char *)(tmp->writers + template_len);
+	tmp->next = tmp->slots + slots_size;
+	tmp->required = tmp->next + template_len;
+	tmp->required_len = 0;
+
+	memset(tmp->slots, 0, slots_size + template_len);
+
+	for (i = 0; i < template_len; i++) {
+		size_t slot = CompiledTemplate_slotOf(tmp, tmpl[i].tag);
+
+		/* Keep the entries with the same tag chained in the template order. */
+		if (tmp->slots[slot] == 0) {
+			tmp->slots[slot] = (unsigned char)(i + 1);
+		} else {
+			tmp->next[last[tmp->slots[slot] - 1]] = (unsigned char)(i + 1);
 		}
-	} else {
-		res = tmpl->fromTlv(tlv, &tmp);
-		if (res != KSI_OK) {
-			KSI_pushError(ctx, res, NULL);
-			goto cleanup;
+		/* The tail of each chain is stored at the index of its head. */
+		last[tmp->slots[slot] - 1] = (unsigned char)i;
+
+		if ((tmpl[i].flags & TEMPLATE_REQUIRED_FLAGS) != 0) {
+			tmp->required[tmp->required_len++] = (unsigned char)i;
 		}
-	}
 
-	res = storeObjectValue(ctx, tmpl, payload, tmp);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+		tmp->writers[i] = tmpl[i].type == KSI_TLV_TEMPLATE_OBJECT ? findTemplateWriter(tmpl[i].toTlv) : NULL;
 	}
 
+	*out = tmp;
 	tmp = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	tmpl->destruct(tmp);
+	KSI_free(tmp);
 
 	return res;
 }
 
-static int extractComposite(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, KSI_TLV *tlv, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
-	int res = KSI_UNKNOWN_ERROR;
-	char buf[1024];
-	void *tmp = NULL;
+static size_t TlvTemplateCache_slotOf(const KSI_TlvTemplateCache *cache, const KSI_TlvTemplate *tmpl) {
+	size_t mask = cache->size - 1;
+	/* Templates are arrays of structs, so the lowest bits of the address carry no information. */
+	size_t i = ((size_t)tmpl / sizeof(KSI_TlvTemplate)) & mask;
 
-	res = tmpl->construct(ctx, &tmp);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	while (cache->table[i] != NULL && cache->table[i]->tmpl != tmpl) {
+		i = (i + 1) & mask;
 	}
 
-	res = extract(ctx, tmp, tlv, tmpl->subTemplate, tr, tr_len + 1, tr_size);
-	if (res != KSI_OK) {
-		KSI_LOG_debug(ctx, "Unable to parse composite TLV: %s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
-		KSI_pushError(ctx, res, NULL);
+	return i;
+}
+
+static int TlvTemplateCache_grow(KSI_TlvTemplateCache *cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	CompiledTemplate **old = cache->table;
+	size_t old_size = cache->size;
+	size_t i;
+
+	cache->size = old_size == 0 ? TEMPLATE_CACHE_INITIAL_SIZE : old_size * 2;
+	cache->table = KSI_calloc(cache->size, sizeof(CompiledTemplate *));
+	if (cache->table == NULL) {
+		cache->table = old;
+		cache->size = old_size;
+		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
 
-	res = storeObjectValue(ctx, tmpl, payload, (void *)tmp);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	for (i = 0; i < old_size; i++) {
+		if (old[i] != NULL) cache->table[TlvTemplateCache_slotOf(cache, old[i]->tmpl)] = old[i];
 	}
-	tmp = NULL;
+
+	KSI_free(old);
 
 	res = KSI_OK;
 
 cleanup:
 
-	tmpl->destruct(tmp);
-
 	return res;
 }
 
-static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, int (*generator)(void *, KSI_TLV **), struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
-	char buf[1024];
-
-	void *valuep = NULL;
-	KSI_TLV *tlvVal = NULL;
+void KSI_TlvTemplateCache_free(KSI_TlvTemplateCache *cache) {
+	if (cache != NULL) {
+		size_t i;
+		for (i = 0; i < cache->size; i++) {
+			KSI_free(cache->table[i]);
+		}
+		KSI_free(cache->table);
+		KSI_free(cache);
+	}
+}
 
-	size_t template_len = 0;
-	bool templateHit[MAX_TEMPLATE_SIZE];
-	bool groupHit[2] = {false, false};
-	bool oneOf[2] = {false, false};
-	size_t i;
-	size_t tmplStart = 0;
-	size_t maxOrder = 0;
-	bool firstHit = false;
-	bool lastHit = false;
+/**
+ * Returns the compiled version of the template, compiling it on the first call.
+ */
+static int getCompiledTemplate(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, const CompiledTemplate **out) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TlvTemplateCache *cache = NULL;
+	CompiledTemplate *ct = NULL;
+	size_t template_len;
+	size_t slot;
 
-	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || payload == NULL || generatorCtx == NULL || tmpl == NULL || generator == NULL || tr == NULL) {
+	if (ctx == NULL || tmpl == NULL || out == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
+	if (ctx->tlvTemplateCache == NULL) {
+		cache = KSI_new(KSI_TlvTemplateCache);
+		if (cache == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		cache->table = NULL;
+		cache->size = 0;
+		cache->count = 0;
+
+		ctx->tlvTemplateCache = cache;
+	}
+	cache = ctx->tlvTemplateCache;
+
+	if (cache->size != 0) {
+		slot = TlvTemplateCache_slotOf(cache, tmpl);
+		if (cache->table[slot] != NULL) {
+			*out = cache->table[slot];
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
 	/* Analyze the template. */
 	template_len = getTemplateLength(tmpl);
 
@@ -646,59 +938,258 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Template too big.");
 		goto cleanup;
 	}
-	memset(templateHit, 0, sizeof(templateHit));
 
-	for (;;) {
-		int matchCount = 0;
-		res = generator(generatorCtx, &tlv);
+	/* Keep the load factor below 1/2. */
+	if (2 * (cache->count + 1) > cache->size) {
+		res = TlvTemplateCache_grow(cache);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
+	}
 
-		if (tlv == NULL) break;
+	res = CompiledTemplate_new(tmpl, template_len, &ct);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
 
-		if (tr_len < tr_size) {
-			tr[tr_len].tag = KSI_TLV_getTag(tlv);
-			tr[tr_len].desc = NULL;
-		}
+	cache->table[TlvTemplateCache_slotOf(cache, tmpl)] = ct;
+	cache->count++;
 
-		for (i = tmplStart; i < template_len; i++) {
-			if (tmpl[i].tag != KSI_TLV_getTag(tlv)) continue;
-			if (i == tmplStart && !tmpl[i].multiple) tmplStart++;
+	*out = ct;
 
-			tr[tr_len].desc = tmpl[i].descr;
+	res = KSI_OK;
 
-			matchCount++;
-			templateHit[i] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) groupHit[0] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) groupHit[1] = true;
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIXED_ORDER)) {
-				if (i < maxOrder) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element at wrong position.");
-					goto cleanup;
-				}
-				maxOrder = i;
-			}
+cleanup:
 
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIRST)) {
-				if (firstHit) {
-					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at first position.");
-					goto cleanup;
-				}
-			}
-			firstHit = true;
+	return res;
+}
 
-			if (lastHit) {
-				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at last position.");
-				goto cleanup;
-			}
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LAST)) {
-				lastHit = true;
-			}
+static int extractObject(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, KSI_TLV *tlv) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	size_t len;
+	void *tmp = NULL;
 
-			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G0)) {
-				if (oneOf[0]) {
+	if (tmpl->fromTlv == NULL && tmpl->parser == NULL) {
+		KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR,
+				"Invalid template: no method for converting from tlv to object.");
+		goto cleanup;
+	}
+
+	/* Parse the object - prefer the TLV conversion, as it is aware of the TLV memory ownership. */
+	if (tmpl->fromTlv != NULL) {
+		res = tmpl->fromTlv(tlv, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		res = KSI_TLV_getRawValue(tlv, (const unsigned char **) &raw, &len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = tmpl->parser(ctx, raw, len, tmpl->parser_opt, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = storeObjectValue(ctx, tmpl, payload, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	tmpl->destruct(tmp);
+
+	return res;
+}
+
+static int decodeObject(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, const TemplateElement *el) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+	void *tmp = NULL;
+
+	if (tmpl->parser == NULL || el->isView) {
+		/* The object can only be created from a TLV (or the object may refer to the caller's
+		 * buffer) - wrap the element without copying the data. */
+		if (el->isView) {
+			res = KSI_TLV_parseBlobView(ctx, el->raw, el->ftlv.hdr_len + el->ftlv.dat_len, &tlv);
+		} else {
+			res = KSI_TLV_parseBlob2(ctx, (unsigned char *)el->raw, el->ftlv.hdr_len + el->ftlv.dat_len, 0, &tlv);
+		}
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = extractObject(ctx, tmpl, payload, tlv);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		res = tmpl->parser(ctx, (unsigned char *)el->raw + el->ftlv.hdr_len, el->ftlv.dat_len, tmpl->parser_opt, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = storeObjectValue(ctx, tmpl, payload, tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		tmp = NULL;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	tmpl->destruct(tmp);
+	KSI_TLV_free(tlv);
+
+	return res;
+}
+
+static int extractComposite(KSI_CTX *ctx, const KSI_TlvTemplate *tmpl, void *payload, const TemplateElement *el, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	char buf[1024];
+	void *tmp = NULL;
+
+	res = tmpl->construct(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (el->tlv != NULL) {
+		res = extract(ctx, tmp, el->tlv, tmpl->subTemplate, tr, tr_len + 1, tr_size);
+	} else {
+		res = decode(ctx, tmp, el->raw + el->ftlv.hdr_len, el->ftlv.dat_len, el->isView, tmpl->subTemplate, tr, tr_len + 1, tr_size);
+	}
+	if (res != KSI_OK) {
+		KSI_LOG_debug(ctx, "Unable to parse composite TLV: %s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = storeObjectValue(ctx, tmpl, payload, (void *)tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	tmpl->destruct(tmp);
+
+	return res;
+}
+
+static int extractElements(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, element_generator_t generator, struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	TemplateElement *el = NULL;
+	char buf[1024];
+
+	void *valuep = NULL;
+
+	const CompiledTemplate *ct = NULL;
+	size_t template_len = 0;
+	bool templateHit[MAX_TEMPLATE_SIZE];
+	bool groupHit[2] = {false, false};
+	bool oneOf[2] = {false, false};
+	size_t i;
+	size_t r;
+	size_t tmplStart = 0;
+	size_t maxOrder = 0;
+	bool firstHit = false;
+	bool lastHit = false;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || payload == NULL || generatorCtx == NULL || tmpl == NULL || generator == NULL || tr == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = getCompiledTemplate(ctx, tmpl, &ct);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	template_len = ct->len;
+	memset(templateHit, 0, template_len * sizeof(*templateHit));
+
+	for (;;) {
+		int matchCount = 0;
+		size_t scanStart = tmplStart;
+		res = generator(generatorCtx, &el);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (el == NULL) break;
+
+		if (tr_len < tr_size) {
+			tr[tr_len].tag = el->tag;
+			tr[tr_len].desc = NULL;
+		}
+
+		/* Visit the template entries with a matching tag in the template order. */
+		for (i = CompiledTemplate_first(ct, el->tag); i < template_len; i = CompiledTemplate_next(ct, i)) {
+			if (i < scanStart) continue;
+			if (i == tmplStart && !tmpl[i].multiple) tmplStart++;
+
+			if (tr_len < tr_size) tr[tr_len].desc = tmpl[i].descr;
+
+			matchCount++;
+			templateHit[i] = true;
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) groupHit[0] = true;
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) groupHit[1] = true;
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIXED_ORDER)) {
+				if (i < maxOrder) {
+					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element at wrong position.");
+					goto cleanup;
+				}
+				maxOrder = i;
+			}
+
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FIRST)) {
+				if (firstHit) {
+					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at first position.");
+					goto cleanup;
+				}
+			}
+			firstHit = true;
+
+			if (lastHit) {
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Element not at last position.");
+				goto cleanup;
+			}
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LAST)) {
+				lastHit = true;
+			}
+
+			if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G0)) {
+				if (oneOf[0]) {
 					KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mutually exclusive elements present within group 0.");
 					goto cleanup;
 				}
@@ -731,7 +1222,11 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 			/* Parse the current TLV. */
 			switch (tmpl[i].type) {
 				case KSI_TLV_TEMPLATE_OBJECT:
-					res = extractObject(ctx, &tmpl[i], payload, tlv);
+					if (el->tlv != NULL) {
+						res = extractObject(ctx, &tmpl[i], payload, el->tlv);
+					} else {
+						res = decodeObject(ctx, &tmpl[i], payload, el);
+					}
 					if (res != KSI_OK) {
 						KSI_pushError(ctx, res, NULL);
 						goto cleanup;
@@ -739,7 +1234,7 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 					break;
 				case KSI_TLV_TEMPLATE_COMPOSITE:
 
-					res = extractComposite(ctx, &tmpl[i], payload, tlv, tr, tr_len, tr_size);
+					res = extractComposite(ctx, &tmpl[i], payload, el, tr, tr_len, tr_size);
 					if (res != KSI_OK) {
 						KSI_pushError(ctx, res, NULL);
 						goto cleanup;
@@ -758,7 +1253,7 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 		/* Check if a match was found, an raise an error if the TLV is marked as critical. */
 		if (matchCount == 0) {
 			char msg[1024];
-			if (KSI_TLV_isNonCritical(tlv)) {
+			if (el->isNonCritical) {
 				KSI_snprintf(msg, sizeof(msg), "Ignoring unknown non-critical tag: %s", track_str(tr, tr_len + 1, tr_size, buf, sizeof(buf)));
 				KSI_LOG_warn(ctx, "%s", msg);
 			} else {
@@ -771,8 +1266,9 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 	}
 
 	/* Check that every mandatory component was present. */
-	for (i = 0; i < template_len; i++) {
+	for (r = 0; r < ct->required_len; r++) {
 		char errm[100];
+		i = ct->required[r];
 		if ((tmpl[i].flags & KSI_TLV_TMPL_FLG_MANDATORY) != 0 && !templateHit[i]) {
 			KSI_snprintf(errm, sizeof(errm), "Mandatory element missing: %s->[0x%x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr != NULL ? tmpl[i].descr : "");
 			KSI_LOG_debug(ctx, "%s", errm);
@@ -792,14 +1288,26 @@ static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, con
 
 cleanup:
 
-	KSI_TLV_free(tlvVal);
-
 	return res;
 }
 
+static int extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, int (*generator)(void *, KSI_TLV **), struct tlv_track_s *tr, size_t tr_len, size_t tr_size) {
+	TLVGeneratorAdapter adapter;
+
+	if (generatorCtx == NULL || generator == NULL) {
+		KSI_pushError(ctx, KSI_INVALID_ARGUMENT, NULL);
+		return KSI_INVALID_ARGUMENT;
+	}
+
+	adapter.generatorCtx = generatorCtx;
+	adapter.generator = generator;
+
+	return extractElements(ctx, payload, (void *)&adapter, tmpl, (element_generator_t)TLVGeneratorAdapter_next, tr, tr_len, tr_size);
+}
+
 int KSI_TlvTemplate_extractGenerator(KSI_CTX *ctx, void *payload, void *generatorCtx, const KSI_TlvTemplate *tmpl, int (*generator)(void *, KSI_TLV **)) {
 	struct tlv_track_s buf[0xf];
-	return extractGenerator(ctx, payload, generatorCtx, tmpl, generator, buf, 0, sizeof(buf));
+	return extractGenerator(ctx, payload, generatorCtx, tmpl, generator, buf, 0, sizeof(buf) / sizeof(*buf));
 }
 
 static int construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, const size_t tr_size) {
@@ -1043,42 +1551,363 @@ cleanup:
 
 int KSI_TlvTemplate_construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_TlvTemplate *tmpl) {
 	struct tlv_track_s tr[0xf];
-	return construct(ctx, tlv, payload, tmpl, tr, 0, sizeof(tr));
+	return construct(ctx, tlv, payload, tmpl, tr, 0, sizeof(tr) / sizeof(*tr));
 }
 
-int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char **raw, size_t *raw_len) {
+/**
+ * Output buffer which is filled back to front - the written data occupies
+ * the last \c len bytes of the buffer. If \c buf is \c NULL, only the length
+ * is calculated.
+ */
+typedef struct TailWriter_st {
+	unsigned char *buf;
+	size_t size;
+	size_t len;
+} TailWriter;
+
+static int writeTlvHeader(KSI_CTX *ctx, TailWriter *w, unsigned tag, int isNc, int isFwd, size_t dat_len) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
-	unsigned char *tmp = NULL;
-	size_t tmp_len = 0;
+	size_t len = dat_len;
+
+	if (dat_len > 0xffff) {
+		KSI_pushError(ctx, res = KSI_BUFFER_OVERFLOW, "TLV payload too long.");
+		goto cleanup;
+	}
+
+	/* The value of the TLV is the last dat_len bytes of the written data. */
+	res = KSI_FTLV_writeHeader(tag, isNc, isFwd, w->buf, w->buf != NULL ? w->size - w->len + dat_len : 0, &len, KSI_TLV_OPT_NO_MOVE);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	w->len += len - dat_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int writeObject(KSI_CTX *ctx, TailWriter *w, const KSI_TlvTemplate *tmpl, write_t writer, const void *obj, int isNc, int isFwd) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tmp = NULL;
+	size_t len = 0;
+	unsigned char *free_buf = w->buf;
+	size_t free_size = free_buf != NULL ? w->size - w->len : 0;
+
+	if (writer != NULL) {
+		/* Write the TLV to the end of the free space. */
+		res = writer(ctx, obj, tmpl->tag, isNc, isFwd, free_buf, free_size, &len, KSI_TLV_OPT_NO_MOVE);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		/* Fall back to the intermediate TLV for objects without a writer. */
+		if (tmpl->toTlv == NULL) {
+			KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Invalid template: toTlv not set.");
+			goto cleanup;
+		}
+
+		res = tmpl->toTlv(ctx, (void *)obj, tmpl->tag, isNc, isFwd, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_TLV_writeBytes(tmp, free_buf, free_size, &len, KSI_TLV_OPT_NO_MOVE);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	w->len += len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TLV_free(tmp);
+
+	return res;
+}
+
+/**
+ * Validates the payload against the template the same way as #construct does. As the
+ * serialization is done back to front, the checks are made in a separate forward pass
+ * to keep the error messages the same.
+ */
+static int validateConstruct(KSI_CTX *ctx, const void *payload, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, const size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *payloadp = NULL;
+	const CompiledTemplate *ct = NULL;
+	bool templateHit[MAX_TEMPLATE_SIZE];
+	bool groupHit[2] = {false, false};
+	bool oneOf[2] = {false, false};
+	size_t i;
+	size_t r;
+	char buf[1000];
+
+	res = getCompiledTemplate(ctx, tmpl, &ct);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	memset(templateHit, 0, ct->len * sizeof(*templateHit));
+
+	for (i = 0; i < ct->len; i++) {
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NO_SERIALIZE)) continue;
+
+		payloadp = NULL;
+
+		res = tmpl[i].getValue(payload, &payloadp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (payloadp == NULL) continue;
+
+		/* Register for tracking. */
+		if (tr_len < tr_size) {
+			tr[tr_len].tag = tmpl[i].tag;
+			tr[tr_len].desc = tmpl[i].descr;
+		}
+
+		templateHit[i] = true;
+
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0)) {
+			if (tmpl[i].listLength != NULL && tmpl[i].listLength(payloadp) == 0) {
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mandatory list object is empty within group 0.");
+				goto cleanup;
+			}
+			groupHit[0] = true;
+		}
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1)) {
+			if (tmpl[i].listLength != NULL && tmpl[i].listLength(payloadp) == 0) {
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Mandatory list object is empty within group 1.");
+				goto cleanup;
+			}
+			groupHit[1] = true;
+		}
+
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G0)) {
+			if (oneOf[0]) {
+				char errm[1000];
+				KSI_snprintf(errm, sizeof(errm), "Mutually exclusive elements present within group 0 (%s).", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+				goto cleanup;
+			}
+			if ((tmpl[i].listLength == NULL) || (tmpl[i].listLength != NULL && tmpl[i].listLength(payloadp) > 0)) {
+				oneOf[0] = true;
+			}
+		}
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MOST_ONE_G1)) {
+			if (oneOf[1]) {
+				char errm[1000];
+				KSI_snprintf(errm, sizeof(errm), "Mutually exclusive elements present within group 1 (%s).", track_str(tr, tr_len, tr_size, buf, sizeof(buf)));
+				KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+				goto cleanup;
+			}
+			if ((tmpl[i].listLength == NULL) || (tmpl[i].listLength != NULL && tmpl[i].listLength(payloadp) > 0)) {
+				oneOf[1] = true;
+			}
+		}
+	}
+
+	/* Check that every mandatory component was present. */
+	for (r = 0; r < ct->required_len; r++) {
+		char errm[1000];
+		i = ct->required[r];
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_MANDATORY) && !templateHit[i]) {
+			KSI_snprintf(errm, sizeof(errm), "Mandatory element missing: %s->[0x%02x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr == NULL ? "" : tmpl[i].descr);
+			KSI_LOG_debug(ctx, "%s", errm);
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+			goto cleanup;
+		}
+		if ((IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G0) && !groupHit[0]) ||
+				(IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_LEAST_ONE_G1) && !groupHit[1])) {
+			KSI_snprintf(errm, sizeof(errm), "Mandatory group missing: %s->[0x%02x]%s", track_str(tr, tr_len, tr_size, buf, sizeof(buf)), tmpl[i].tag, tmpl[i].descr == NULL ? "" : tmpl[i].descr);
+			KSI_LOG_debug(ctx, "%s", errm);
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, errm);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(payloadp);
+
+	return res;
+}
+
+/**
+ * Serializes the payload elements directly into the output buffer. The template
+ * and the lists are processed in reverse order, as the buffer is filled back to front.
+ */
+static int writeElements(KSI_CTX *ctx, TailWriter *w, const void *payload, const KSI_TlvTemplate *tmpl, struct tlv_track_s *tr, size_t tr_len, const size_t tr_size) {
+	int res = KSI_UNKNOWN_ERROR;
+	void *payloadp = NULL;
+	void *listElement = NULL;
+	const CompiledTemplate *ct = NULL;
+	int isNonCritical = 0;
+	int isForward = 0;
+	size_t i;
+	size_t mark;
+	int j;
 
 	KSI_ERR_clearErrors(ctx);
-	if (ctx == NULL || obj == NULL || tmpl == NULL || raw == NULL || raw_len == NULL) {
+	if (ctx == NULL || w == NULL || payload == NULL || tmpl == NULL || tr == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	/* Create TLV for the PDU object. */
-	res = KSI_TLV_new(ctx, tag, isNc, isFwd, &tlv);
+	res = validateConstruct(ctx, payload, tmpl, tr, tr_len, tr_size);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Evaluate the TLV. */
-	res = KSI_TlvTemplate_construct(ctx, tlv, obj, tmpl);
+	res = getCompiledTemplate(ctx, tmpl, &ct);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Serialize the TLV. */
-	res = KSI_TLV_serialize(tlv, &tmp, &tmp_len);
+	for (i = ct->len; i-- > 0;) {
+		if (IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NO_SERIALIZE)) continue;
+
+		payloadp = NULL;
+
+		res = tmpl[i].getValue(payload, &payloadp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (payloadp == NULL) continue;
+
+		if (tr_len < tr_size) {
+			tr[tr_len].tag = tmpl[i].tag;
+			tr[tr_len].desc = tmpl[i].descr;
+		}
+
+		isNonCritical = IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NONCRITICAL);
+		isForward = IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_FORWARD);
+
+		switch (tmpl[i].type) {
+			case KSI_TLV_TEMPLATE_OBJECT:
+				if (tmpl[i].listLength != NULL) {
+					for (j = tmpl[i].listLength(payloadp); j-- > 0;) {
+						res = tmpl[i].listElementAt(payloadp, j, &listElement);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+
+						res = writeObject(ctx, w, &tmpl[i], ct->writers[i], listElement, isNonCritical, isForward);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+					}
+				} else {
+					res = writeObject(ctx, w, &tmpl[i], ct->writers[i], payloadp, isNonCritical, isForward);
+					if (res != KSI_OK) {
+						KSI_pushError(ctx, res, NULL);
+						goto cleanup;
+					}
+				}
+				break;
+			case KSI_TLV_TEMPLATE_COMPOSITE:
+				if (tmpl[i].listLength != NULL) {
+					for (j = tmpl[i].listLength(payloadp); j-- > 0;) {
+						res = tmpl[i].listElementAt(payloadp, j, &listElement);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+
+						mark = w->len;
+						res = writeElements(ctx, w, listElement, tmpl[i].subTemplate, tr, tr_len + 1, tr_size);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+
+						res = writeTlvHeader(ctx, w, tmpl[i].tag, isNonCritical, isForward, w->len - mark);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+					}
+				} else {
+					mark = w->len;
+					if (!IS_FLAG_SET(tmpl[i], KSI_TLV_TMPL_FLG_NO_VALUE)) {
+						res = writeElements(ctx, w, payloadp, tmpl[i].subTemplate, tr, tr_len + 1, tr_size);
+						if (res != KSI_OK) {
+							KSI_pushError(ctx, res, NULL);
+							goto cleanup;
+						}
+					}
+
+					res = writeTlvHeader(ctx, w, tmpl[i].tag, isNonCritical, isForward, w->len - mark);
+					if (res != KSI_OK) {
+						KSI_pushError(ctx, res, NULL);
+						goto cleanup;
+					}
+				}
+				break;
+			default:
+				KSI_LOG_error(ctx, "Unimplemented template type: %d - possible MEMORY CURRUPTION.", tmpl[i].type);
+				KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Unimplemented template type.");
+				goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(payloadp);
+	KSI_nofree(listElement);
+
+	return res;
+}
+
+int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char buf[0xffff + 4];
+	unsigned char *tmp = NULL;
+	size_t tmp_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || obj == NULL || tmpl == NULL || raw == NULL || raw_len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* Serialize into the end of the stack buffer, and copy the result out. */
+	res = KSI_TlvTemplate_writeBytes(ctx, obj, tag, isNc, isFwd, tmpl, buf, sizeof(buf), &tmp_len, KSI_TLV_OPT_NO_MOVE);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
+	tmp = KSI_malloc(tmp_len);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	memcpy(tmp, buf + sizeof(buf) - tmp_len, tmp_len);
+
 	*raw = tmp;
 	tmp = NULL;
 	*raw_len = tmp_len;
@@ -1088,14 +1917,14 @@ int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag,
 cleanup:
 
 	KSI_free(tmp);
-	KSI_TLV_free(tlv);
 
 	return res;
 }
 
 int KSI_TlvTemplate_writeBytes(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char *raw, size_t raw_size, size_t *raw_len, int opt) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_TLV *tlv = NULL;
+	struct tlv_track_s tr[0xf];
+	TailWriter w;
 
 	KSI_ERR_clearErrors(ctx);
 	if (ctx == NULL || obj == NULL || tmpl == NULL || (raw == NULL && raw_size != 0) || raw_len == NULL) {
@@ -1103,33 +1932,34 @@ int KSI_TlvTemplate_writeBytes(KSI_CTX *ctx, const void *obj, unsigned tag, int
 		goto cleanup;
 	}
 
-	/* Create TLV for the PDU object. */
-	res = KSI_TLV_new(ctx, tag, isNc, isFwd, &tlv);
+	w.buf = raw;
+	w.size = raw_size;
+	w.len = 0;
+
+	res = writeElements(ctx, &w, obj, tmpl, tr, 0, sizeof(tr) / sizeof(*tr));
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Evaluate the TLV. */
-	res = KSI_TlvTemplate_construct(ctx, tlv, obj, tmpl);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	if ((opt & KSI_TLV_OPT_NO_HEADER) == 0) {
+		res = writeTlvHeader(ctx, &w, tag, isNc, isFwd, w.len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 	}
 
-	/* Serialize the TLV. */
-	res = KSI_TLV_writeBytes(tlv, raw, raw_size, raw_len, opt);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	if ((opt & KSI_TLV_OPT_NO_MOVE) == 0 && raw != NULL) {
+		/* Move the serialized value to the beginning of the buffer. */
+		memmove(raw, raw + raw_size - w.len, w.len);
 	}
 
+	*raw_len = w.len;
+
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_TLV_free(tlv);
-
 	return res;
 }
-
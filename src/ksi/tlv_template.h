@@ -331,6 +331,18 @@ extern "C" {
 	#define KSI_TLV_WRAP_OBJECT(tg, flg, gttr, sttr, parser, toTlv, destr, descr) KSI_TLV_FULL_TEMPLATE_DEF(KSI_TLV_TEMPLATE_OBJECT, tg, flg, gttr, sttr, NULL, destr, NULL, NULL, 0, NULL, NULL, NULL, NULL, NULL, toTlv, descr, (parser), 0, NULL)
 	#define KSI_TLV_COMPOSITE_OBJECT(tg, flg, gttr, sttr, fromTlv, toTlv, destr, tmpl, descr) KSI_TLV_FULL_TEMPLATE_DEF(KSI_TLV_TEMPLATE_OBJECT, tg, flg, gttr, sttr, NULL, destr, (tmpl), NULL, 0, NULL, NULL, NULL, NULL, fromTlv, toTlv, descr, NULL, 0, NULL)
 
+	/**
+	 * Generic TLV template for primitive objects, which in addition to the \c fromTlv and \c toTlv
+	 * functions define a raw value parser \c obj_parseValue (see #KSI_DEFINE_FN_PARSE_VALUE).
+	 * \param[in]	tg				TLV tag value.
+	 * \param[in]	flg				Flags for the template.
+	 * \param[in]	gttr			Getter function.
+	 * \param[in]	sttr			Setter function.
+	 * \param[in]	obj				Type of the object.
+	 * \param[in]	descr			Short description.
+	 */
+	#define KSI_TLV_PRIMITIVE_OBJECT(tg, flg, gttr, sttr, obj, descr) KSI_TLV_FULL_TEMPLATE_DEF(KSI_TLV_TEMPLATE_OBJECT, tg, flg, gttr, sttr, NULL, obj##_free, NULL, NULL, 0, NULL, NULL, NULL, NULL, obj##_fromTlv, obj##_toTlv, descr, obj##_parseValue, 0, NULL)
+
 
 	/**
 	 * TLV template for #KSI_Utf8String type.
@@ -340,7 +352,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_UTF8_STRING(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT(tg, flg, gttr, sttr, KSI_Utf8String_fromTlv, KSI_Utf8String_toTlv, KSI_Utf8String_free, descr)
+	#define KSI_TLV_UTF8_STRING(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_OBJECT(tg, flg, gttr, sttr, KSI_Utf8String, descr)
 
 	/**
 	 * TLV template for #KSI_Integer type.
@@ -350,7 +362,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_INTEGER(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT(tg, flg, gttr, sttr, KSI_Integer_fromTlv, KSI_Integer_toTlv, KSI_Integer_free, descr)
+	#define KSI_TLV_INTEGER(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_OBJECT(tg, flg, gttr, sttr, KSI_Integer, descr)
 
 	/**
 	 * TLV template for #KSI_OctetString type.
@@ -360,7 +372,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_OCTET_STRING(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT(tg, flg, gttr, sttr, KSI_OctetString_fromTlv, KSI_OctetString_toTlv, KSI_OctetString_free, descr)
+	#define KSI_TLV_OCTET_STRING(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_OBJECT(tg, flg, gttr, sttr, KSI_OctetString, descr)
 
 	/**
 	 * TLV template for #KSI_DataHash type.
@@ -370,8 +382,8 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_IMPRINT(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT(tg, flg, gttr, sttr, KSI_DataHash_fromTlv, KSI_DataHash_toTlv, KSI_DataHash_free, descr)
-	#define KSI_TLV_WRAP_IMPRINT(tg, flg, gttr, sttr, descr) KSI_TLV_WRAP_OBJECT(tg, flg, gttr, sttr, KSI_DataHash_parse, KSI_DataHash_toTlv, KSI_DataHash_free, descr)
+	#define KSI_TLV_IMPRINT(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_OBJECT(tg, flg, gttr, sttr, KSI_DataHash, descr)
+	#define KSI_TLV_WRAP_IMPRINT(tg, flg, gttr, sttr, descr) KSI_TLV_WRAP_OBJECT(tg, flg, gttr, sttr, KSI_DataHash_parseValue, KSI_DataHash_toTlv, KSI_DataHash_free, descr)
 
 	/**
 	 * TLV templates for time representation
@@ -391,6 +403,17 @@ extern "C" {
 	 */
 	#define KSI_TLV_OBJECT_LIST(tg, flg, gttr, sttr, obj, descr) KSI_TLV_FULL_TEMPLATE_DEF(KSI_TLV_TEMPLATE_OBJECT, tg, flg, gttr, sttr, NULL, obj##_free, NULL, KSI_List_append, 1, obj##List_new, obj##List_free, KSI_List_length, KSI_List_elementAt, obj##_fromTlv, obj##_toTlv, descr, NULL, 0, NULL)
 
+	/**
+	 * Same as #KSI_TLV_OBJECT_LIST, but for primitive objects with a raw value parser (see #KSI_TLV_PRIMITIVE_OBJECT).
+	 * \param[in]	tg				TLV tag value.
+	 * \param[in]	flg				Flags for the template.
+	 * \param[in]	gttr			Getter function.
+	 * \param[in]	sttr			Setter function.
+	 * \param[in]	obj				Type of object stored in the list.
+	 * \param[in]	descr			Short description.
+	 */
+	#define KSI_TLV_PRIMITIVE_LIST(tg, flg, gttr, sttr, obj, descr) KSI_TLV_FULL_TEMPLATE_DEF(KSI_TLV_TEMPLATE_OBJECT, tg, flg, gttr, sttr, NULL, obj##_free, NULL, KSI_List_append, 1, obj##List_new, obj##List_free, KSI_List_length, KSI_List_elementAt, obj##_fromTlv, obj##_toTlv, descr, obj##_parseValue, 0, NULL)
+
 	/**
 	 * TLV template for list of #KSI_OctetString types.
 	 * \param[in]	tg				TLV tag value.
@@ -399,7 +422,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_OCTET_STRING_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT_LIST(tg, flg, gttr, sttr, KSI_OctetString, descr)
+	#define KSI_TLV_OCTET_STRING_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_LIST(tg, flg, gttr, sttr, KSI_OctetString, descr)
 
 	/**
 	 * TLV template for list of #KSI_Utf8String types.
@@ -409,7 +432,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_UTF8_STRING_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT_LIST(tg, flg, gttr, sttr, KSI_Utf8String, descr)
+	#define KSI_TLV_UTF8_STRING_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_LIST(tg, flg, gttr, sttr, KSI_Utf8String, descr)
 
 	/**
 	 * TLV template for list of #KSI_Integer types.
@@ -419,7 +442,7 @@ extern "C" {
 	 * \param[in]	sttr			Setter function.
 	 * \param[in]	descr			Short description.
 	 */
-	#define KSI_TLV_INTEGER_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_OBJECT_LIST(tg, flg, gttr, sttr, KSI_Integer, descr)
+	#define KSI_TLV_INTEGER_LIST(tg, flg, gttr, sttr, descr) KSI_TLV_PRIMITIVE_LIST(tg, flg, gttr, sttr, KSI_Integer, descr)
 
 	/**
 	 * TLV template for composite objects.
@@ -461,6 +484,9 @@ extern "C" {
 
 	/**
 	 * Parses a given raw data into a pre-existing element. The caller needs to know the outcome type and create it.
+	 * The data is decoded in a single pass straight from the TLV headers, without building an intermediate
+	 * #KSI_TLV tree. Only elements without a raw value parser (see #KSI_TLV_PRIMITIVE_OBJECT) are wrapped into
+	 * a temporary #KSI_TLV, which refers to the input buffer.
 	 * \param[in]	ctx			KSI context.
 	 * \param[in]	raw			Pointer to the raw data.
 	 * \param[in]	raw_len		Length of the raw data.
@@ -498,7 +524,8 @@ extern "C" {
 	int KSI_TlvTemplate_construct(KSI_CTX *ctx, KSI_TLV *tlv, const void *payload, const KSI_TlvTemplate *tmpl);
 
 	/**
-	 * Serializes an object using #KSI_TlvTemplate.
+	 * Serializes an object using #KSI_TlvTemplate. The TLV bytes are written directly into a single
+	 * buffer of the exact size, without constructing an intermediate #KSI_TLV tree.
 	 * \param[in]	ctx		KSI context.
 	 * \param[in]	obj		Object to be serialized.
 	 * \param[in]	tag		Tag of the serialized object.
@@ -514,7 +541,9 @@ extern "C" {
 	int KSI_TlvTemplate_serializeObject(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char **raw, size_t *raw_len);
 
 	/**
-	 * This function serializes the given object based on the template.
+	 * This function serializes the given object based on the template directly into the target buffer.
+	 * The elements are written back to front, starting from the end of the buffer.
+	 * If \c raw is \c NULL and \c raw_size is 0, only the length of the serialization is calculated.
 	 * \param[in]	ctx			KSI context.
 	 * \param[in]	obj			Object to be serialized.
 	 * \param[in]	tag			Tag of the outer TLV.
@@ -524,7 +553,7 @@ extern "C" {
 	 * \param[in]	raw			Pointer to target buffer
 	 * \param[in]	raw_size	Size of the target buffer
 	 * \param[out]	raw_len		Length of the serialization.
-	 * \param[in]	opt			Options.
+	 * \param[in]	opt			Options (see #KSI_Serialize_Opt_en).
 	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
 	 */
 	int KSI_TlvTemplate_writeBytes(KSI_CTX *ctx, const void *obj, unsigned tag, int isNc, int isFwd, const KSI_TlvTemplate *tmpl, unsigned char *raw, size_t raw_size, size_t *raw_len, int opt);
@@ -17,12 +17,20 @@
  * reserves and retains all trademark rights.
  */
 
+#include <stdio.h>
 #include <string.h>
 
 #include "internal.h"
 #include "tree_builder.h"
 #include "hashchain.h"
 #include "impl/meta_data_impl.h"
+#include "impl/meta_data_element_impl.h"
+#include "impl/hash_impl.h"
+#include "impl/tree_builder_impl.h"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 
 KSI_IMPLEMENT_LIST(KSI_TreeBuilderLeafProcessor, NULL);
 
@@ -725,3 +733,1969 @@ cleanup:
 	return res;
 }
 
+
+/**/
+
+/* Index value for a missing node. */
+#define FLAT_NONE ((size_t)-1)
+
+/* The node is the left child of its parent. */
+#define FLAT_NODE_LEFT	0x01
+/* The node value is not in the imprint slot, but in the external value table. */
+#define FLAT_NODE_EXT	0x02
+
+typedef struct {
+	/** Index of the node the value belongs to. */
+	size_t node;
+	/** Hash value that does not fit into the imprint slot. */
+	KSI_DataHash *hash;
+	/** Meta-data value. */
+	KSI_MetaData *metaData;
+} FlatTreeExtValue;
+
+struct KSI_FlatTreeBuilder_st {
+	/** KSI context. */
+	KSI_CTX *ctx;
+	/** Hashing algorithm for the internal nodes. */
+	KSI_HashAlgorithm algo;
+	/** Leaf processors, see #KSI_TreeBuilder::cbList. */
+	KSI_LIST(KSI_TreeBuilderLeafProcessor) *cbList;
+
+	/** Number of nodes. */
+	size_t count;
+	/** Capacity of the node arrays, in slots (see #FLAT_SLOT). */
+	size_t size;
+	/** Size of an imprint slot, equal to the imprint length of the internal nodes. */
+	size_t stride;
+
+	/** Node imprints, \c stride bytes per node. */
+	unsigned char *imprint;
+	/** Node imprint lengths. */
+	unsigned char *imprintLen;
+	/** Node levels. */
+	unsigned char *level;
+	/** Node flags (FLAT_NODE_*). */
+	unsigned char *flags;
+	/** Parent node indices. */
+	size_t *parent;
+	/** Sibling node indices. */
+	size_t *sibling;
+
+	/** Meta-data and oversized hash values, ordered by the node index. */
+	FlatTreeExtValue *ext;
+	size_t ext_count;
+	size_t ext_size;
+
+	/** Stack of the root nodes of complete binary trees. */
+	size_t stack[KSI_TREE_BUILDER_STACK_LEN];
+	/** The root node of the computed tree, if set, the computation is finished. */
+	size_t root;
+
+	/** Index of the first node kept in the node arrays as is. The nodes below it are either
+	 * pinned or spilled to the spill file, see #FlatTree_spill. */
+	size_t base;
+	/** Number of the pinned nodes, that occupy the first slots of the node arrays. */
+	size_t pinned;
+	/** Indices of the pinned nodes in the increasing order. */
+	size_t *pinnedNode;
+
+	/** Spill file of the node records, \c NULL if the builder keeps all the nodes in memory. */
+	FILE *spill;
+	/** Spill file of the external values. */
+	FILE *spillValues;
+	/** Length of the external value spill file. */
+	KSI_uint64_t spillValuesLen;
+	/** Names of the spill files, \c NULL for temporary files. */
+	char *spillPath;
+	char *spillValuesPath;
+};
+
+/* Returns the slot of an in-memory node in the node arrays. Without spilling, the slot is equal
+ * to the node index. */
+#define FLAT_SLOT(builder, i) ((i) >= (builder)->base ? (builder)->pinned + ((i) - (builder)->base) : FlatTree_pinnedSlot((builder), (i)))
+
+/* Spill the finished nodes, once there are this many nodes in the window. */
+#define FLAT_SPILL_WINDOW 4096
+
+/* Size of a spilled node record: the parent, sibling and value offset, the level, flags and the
+ * imprint length, followed by the imprint slot. */
+#define FLAT_RECORD_LEN(builder) (3 * 8 + 3 + (builder)->stride)
+
+/* External value kinds in the value spill file. */
+#define FLAT_VALUE_HASH	0x01
+#define FLAT_VALUE_META	0x02
+
+/* Returns the slot of a pinned node, or #FLAT_NONE if the node has been spilled. */
+static size_t FlatTree_pinnedSlot(const KSI_FlatTreeBuilder *builder, size_t node) {
+	size_t lo = 0;
+	size_t hi = builder->pinned;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (builder->pinnedNode[mid] == node) return mid;
+		if (builder->pinnedNode[mid] < node) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return FLAT_NONE;
+}
+
+static int growArray(void **arr, size_t elem_size, size_t old_count, size_t new_count) {
+	void *tmp = NULL;
+
+	tmp = KSI_malloc(elem_size * new_count);
+	if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+	if (*arr != NULL) memcpy(tmp, *arr, elem_size * old_count);
+	KSI_free(*arr);
+	*arr = tmp;
+
+	return KSI_OK;
+}
+
+static int FlatTree_reserve(KSI_FlatTreeBuilder *builder, size_t n) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t used = builder->pinned + (builder->count - builder->base);
+	size_t size;
+
+	if (used + n <= builder->size) return KSI_OK;
+
+	size = builder->size == 0 ? 1024 : builder->size;
+	while (size < used + n) size *= 2;
+
+	res = growArray((void **)&builder->imprint, builder->stride, used, size);
+	if (res != KSI_OK) goto cleanup;
+	res = growArray((void **)&builder->imprintLen, sizeof(*builder->imprintLen), used, size);
+	if (res != KSI_OK) goto cleanup;
+	res = growArray((void **)&builder->level, sizeof(*builder->level), used, size);
+	if (res != KSI_OK) goto cleanup;
+	res = growArray((void **)&builder->flags, sizeof(*builder->flags), used, size);
+	if (res != KSI_OK) goto cleanup;
+	res = growArray((void **)&builder->parent, sizeof(*builder->parent), used, size);
+	if (res != KSI_OK) goto cleanup;
+	res = growArray((void **)&builder->sibling, sizeof(*builder->sibling), used, size);
+	if (res != KSI_OK) goto cleanup;
+
+	builder->size = size;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static const FlatTreeExtValue *FlatTree_getExt(const KSI_FlatTreeBuilder *builder, size_t node) {
+	size_t lo = 0;
+	size_t hi = builder->ext_count;
+
+	/* The values are appended in the order of node creation, so they are sorted by the index. */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (builder->ext[mid].node == node) return &builder->ext[mid];
+		if (builder->ext[mid].node < node) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return NULL;
+}
+
+/* Sets the value of the node with the given index, the node arrays must have room for it. */
+static int FlatTree_setNode(KSI_FlatTreeBuilder *builder, size_t i, KSI_DataHash *hsh, KSI_MetaData *metaData, int level) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	size_t s = FLAT_SLOT(builder, i);
+
+	if ((hsh == NULL && metaData == NULL) || (hsh != NULL && metaData != NULL) || !KSI_IS_VALID_TREE_LEVEL(level)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	builder->level[s] = (unsigned char)level;
+	builder->flags[s] = 0;
+	builder->parent[s] = FLAT_NONE;
+	builder->sibling[s] = FLAT_NONE;
+	builder->imprintLen[s] = 0;
+
+	if (hsh != NULL) {
+		res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (hsh != NULL && imprint_len <= builder->stride) {
+		memcpy(builder->imprint + s * builder->stride, imprint, imprint_len);
+		builder->imprintLen[s] = (unsigned char)imprint_len;
+	} else {
+		if (builder->ext_count == builder->ext_size) {
+			size_t size = builder->ext_size == 0 ? 16 : builder->ext_size * 2;
+
+			res = growArray((void **)&builder->ext, sizeof(*builder->ext), builder->ext_count, size);
+			if (res != KSI_OK) goto cleanup;
+
+			builder->ext_size = size;
+		}
+
+		builder->ext[builder->ext_count].node = i;
+		builder->ext[builder->ext_count].hash = KSI_DataHash_ref(hsh);
+		builder->ext[builder->ext_count].metaData = KSI_MetaData_ref(metaData);
+		builder->ext_count++;
+
+		builder->flags[s] |= FLAT_NODE_EXT;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Appends a node with the given value and returns its index. */
+static int FlatTree_addNode(KSI_FlatTreeBuilder *builder, KSI_DataHash *hsh, KSI_MetaData *metaData, int level, size_t *node) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	res = FlatTree_reserve(builder, 1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = FlatTree_setNode(builder, builder->count, hsh, metaData, level);
+	if (res != KSI_OK) goto cleanup;
+
+	*node = builder->count++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Adds the node value to the hasher. If \c md is not NULL, it is used as the serialized value
+ * of a meta-data node, otherwise the meta-data is serialized on the spot. */
+static int FlatTree_addNodeToHasher(const KSI_FlatTreeBuilder *builder, KSI_DataHasher *hsr, size_t node, const unsigned char *md, size_t md_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t s = FLAT_SLOT(builder, node);
+
+	if (builder->flags[s] & FLAT_NODE_EXT) {
+		const FlatTreeExtValue *ext = FlatTree_getExt(builder, node);
+
+		if (ext == NULL) {
+			res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+
+		if (ext->hash != NULL) {
+			res = KSI_DataHasher_addImprint(hsr, ext->hash);
+			if (res != KSI_OK) goto cleanup;
+		} else if (md != NULL) {
+			res = KSI_DataHasher_add(hsr, md, md_len);
+			if (res != KSI_OK) goto cleanup;
+		} else {
+			unsigned char buf[0xffff + 4];
+			size_t len;
+
+			res = ext->metaData->serializePayload(ext->metaData, buf, sizeof(buf), &len);
+			if (res != KSI_OK) goto cleanup;
+
+			res = KSI_DataHasher_add(hsr, buf, len);
+			if (res != KSI_OK) goto cleanup;
+		}
+	} else {
+		res = KSI_DataHasher_add(hsr, builder->imprint + s * builder->stride, builder->imprintLen[s]);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Returns the hash value of an in-memory node as a new #KSI_DataHash object, NULL for meta-data nodes. */
+static int FlatTree_getNodeHash(const KSI_FlatTreeBuilder *builder, size_t node, KSI_DataHash **hsh) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t s = FLAT_SLOT(builder, node);
+
+	if (builder->flags[s] & FLAT_NODE_EXT) {
+		const FlatTreeExtValue *ext = FlatTree_getExt(builder, node);
+
+		if (ext == NULL) {
+			res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+
+		*hsh = KSI_DataHash_ref(ext->hash);
+	} else {
+		res = KSI_DataHash_fromImprint(builder->ctx, builder->imprint + s * builder->stride, builder->imprintLen[s], hsh);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Joins two nodes into the node with the index \c i using a freshly reset hasher, the node arrays
+ * must have room for the new node. This function does not touch the context error stack nor the
+ * node count, as it is also used by the batch worker threads. */
+static int FlatTree_joinAt(KSI_FlatTreeBuilder *builder, KSI_DataHasher *hsr, size_t left, size_t right, size_t i, const unsigned char *md, size_t md_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash hsh;
+	size_t ls = FLAT_SLOT(builder, left);
+	size_t rs = FLAT_SLOT(builder, right);
+	size_t s = FLAT_SLOT(builder, i);
+	unsigned level;
+	unsigned char l;
+
+	level = (builder->level[ls] > builder->level[rs] ? builder->level[ls] : builder->level[rs]) + 1;
+
+	/* Sanity check. */
+	if (!KSI_IS_VALID_TREE_LEVEL(level)) {
+		res = KSI_UNKNOWN_ERROR;
+		goto cleanup;
+	}
+
+	l = (unsigned char)level;
+
+	res = FlatTree_addNodeToHasher(builder, hsr, left, md, md_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = FlatTree_addNodeToHasher(builder, hsr, right, md, md_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(hsr, &l, 1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_closeExisting(hsr, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	memcpy(builder->imprint + s * builder->stride, hsh.imprint, hsh.imprint_length);
+	builder->imprintLen[s] = (unsigned char)hsh.imprint_length;
+	builder->level[s] = l;
+	builder->flags[s] = 0;
+	builder->parent[s] = FLAT_NONE;
+	builder->sibling[s] = FLAT_NONE;
+
+	/* Update references. */
+	builder->parent[ls] = i;
+	builder->parent[rs] = i;
+	builder->sibling[ls] = right;
+	builder->sibling[rs] = left;
+	builder->flags[ls] |= FLAT_NODE_LEFT;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* The same as #KSI_TreeNode_join, the new node is appended to the arrays. */
+static int FlatTree_join(KSI_FlatTreeBuilder *builder, size_t left, size_t right, size_t *root) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHasher *hsr = NULL;
+	size_t ls = FLAT_SLOT(builder, left);
+	size_t rs = FLAT_SLOT(builder, right);
+	unsigned level;
+
+	level = (builder->level[ls] > builder->level[rs] ? builder->level[ls] : builder->level[rs]) + 1;
+
+	/* Sanity check. */
+	if (!KSI_IS_VALID_TREE_LEVEL(level)) {
+		KSI_pushError(builder->ctx, res = KSI_UNKNOWN_ERROR, "Tree too large.");
+		goto cleanup;
+	}
+
+	res = FlatTree_reserve(builder, 1);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_openCached(builder->ctx, builder->algo, &hsr);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = FlatTree_joinAt(builder, hsr, left, right, builder->count, NULL, 0);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*root = builder->count++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(hsr);
+
+	return res;
+}
+
+static void FlatTree_putUInt64(unsigned char *buf, KSI_uint64_t val) {
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		buf[i] = (unsigned char)(val & 0xff);
+		val >>= 8;
+	}
+}
+
+static KSI_uint64_t FlatTree_getUInt64(const unsigned char *buf) {
+	KSI_uint64_t val = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		val = (val << 8) | buf[i];
+	}
+
+	return val;
+}
+
+/* Seeks with a 64-bit offset, as the spill files may grow beyond the range of \c long. */
+static int FlatTree_seek(FILE *f, KSI_uint64_t offset) {
+#ifdef _WIN32
+	if (offset > (KSI_uint64_t)_I64_MAX) return KSI_BUFFER_OVERFLOW;
+	return _fseeki64(f, (__int64)offset, SEEK_SET) == 0 ? KSI_OK : KSI_IO_ERROR;
+#else
+	off_t off = (off_t)offset;
+
+	/* Fails only if off_t is 32 bits. */
+	if (off < 0 || (KSI_uint64_t)off != offset) return KSI_BUFFER_OVERFLOW;
+	return fseeko(f, off, SEEK_SET) == 0 ? KSI_OK : KSI_IO_ERROR;
+#endif
+}
+
+/* Appends the external value of an in-memory node to the value spill file and returns its offset. */
+static int FlatTree_spillValue(KSI_FlatTreeBuilder *builder, size_t node, KSI_uint64_t *offset) {
+	int res = KSI_UNKNOWN_ERROR;
+	const FlatTreeExtValue *ext = FlatTree_getExt(builder, node);
+	unsigned char buf[5 + 0xffff + 4];
+	const unsigned char *imprint = NULL;
+	size_t len = 0;
+
+	if (ext == NULL) {
+		res = KSI_INVALID_STATE;
+		goto cleanup;
+	}
+
+	if (ext->hash != NULL) {
+		res = KSI_DataHash_getImprint(ext->hash, &imprint, &len);
+		if (res != KSI_OK) goto cleanup;
+
+		buf[0] = FLAT_VALUE_HASH;
+		memcpy(buf + 5, imprint, len);
+	} else {
+		res = ext->metaData->serializePayload(ext->metaData, buf + 5, sizeof(buf) - 5, &len);
+		if (res != KSI_OK) goto cleanup;
+
+		buf[0] = FLAT_VALUE_META;
+	}
+
+	buf[1] = (unsigned char)(len >> 24);
+	buf[2] = (unsigned char)(len >> 16);
+	buf[3] = (unsigned char)(len >> 8);
+	buf[4] = (unsigned char)len;
+
+	if (fwrite(buf, 1, len + 5, builder->spillValues) != len + 5) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	*offset = builder->spillValuesLen;
+	builder->spillValuesLen += len + 5;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Writes the record of an in-memory node to the spill file. The position of the file is
+ * tracked by \c pos to avoid seeking when the records are written in order. */
+static int FlatTree_spillNode(KSI_FlatTreeBuilder *builder, size_t node, size_t s, KSI_uint64_t *pos) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char rec[3 * 8 + 3 + KSI_MAX_IMPRINT_LEN];
+	KSI_uint64_t valueOffset = 0;
+	KSI_uint64_t offset = (KSI_uint64_t)node * FLAT_RECORD_LEN(builder);
+
+	if (builder->flags[s] & FLAT_NODE_EXT) {
+		res = FlatTree_spillValue(builder, node, &valueOffset);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	FlatTree_putUInt64(rec, builder->parent[s]);
+	FlatTree_putUInt64(rec + 8, builder->sibling[s]);
+	FlatTree_putUInt64(rec + 16, valueOffset);
+	rec[24] = builder->level[s];
+	rec[25] = builder->flags[s];
+	rec[26] = builder->imprintLen[s];
+	memcpy(rec + 27, builder->imprint + s * builder->stride, builder->stride);
+
+	if (*pos != offset) {
+		res = FlatTree_seek(builder->spill, offset);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (fwrite(rec, 1, FLAT_RECORD_LEN(builder), builder->spill) != FLAT_RECORD_LEN(builder)) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	*pos = offset + FLAT_RECORD_LEN(builder);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Writes all the joined nodes to the spill file and releases their memory. Only the nodes without
+ * a parent (the roots on the stack) stay in memory as pinned nodes, thus the memory usage is
+ * bounded by the height of the tree and the size of the window. */
+static int FlatTree_spill(KSI_FlatTreeBuilder *builder) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t used = builder->pinned + (builder->count - builder->base);
+	size_t *pinnedNode = NULL;
+	size_t live = 0;
+	size_t ext = 0;
+	KSI_uint64_t pos = (KSI_uint64_t)-1;
+	size_t s;
+	size_t j;
+
+	res = FlatTree_seek(builder->spillValues, builder->spillValuesLen);
+	if (res != KSI_OK) goto cleanup;
+
+	for (s = 0; s < used; s++) {
+		size_t node = s < builder->pinned ? builder->pinnedNode[s] : builder->base + (s - builder->pinned);
+
+		if (builder->parent[s] == FLAT_NONE) {
+			live++;
+			continue;
+		}
+
+		res = FlatTree_spillNode(builder, node, s, &pos);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (live > 0) {
+		pinnedNode = KSI_calloc(live, sizeof(*pinnedNode));
+		if (pinnedNode == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+	}
+
+	/* Move the remaining nodes to the first slots, their order is kept. */
+	for (s = 0, j = 0; s < used; s++) {
+		if (builder->parent[s] != FLAT_NONE) continue;
+
+		pinnedNode[j] = s < builder->pinned ? builder->pinnedNode[s] : builder->base + (s - builder->pinned);
+		memmove(builder->imprint + j * builder->stride, builder->imprint + s * builder->stride, builder->stride);
+		builder->imprintLen[j] = builder->imprintLen[s];
+		builder->level[j] = builder->level[s];
+		builder->flags[j] = builder->flags[s];
+		builder->parent[j] = FLAT_NONE;
+		builder->sibling[j] = builder->sibling[s];
+		j++;
+	}
+
+	/* Keep the external values of the remaining nodes only, both lists are ordered by the index. */
+	for (s = 0, j = 0; s < builder->ext_count; s++) {
+		while (j < live && pinnedNode[j] < builder->ext[s].node) j++;
+
+		if (j < live && pinnedNode[j] == builder->ext[s].node) {
+			builder->ext[ext++] = builder->ext[s];
+		} else {
+			KSI_DataHash_free(builder->ext[s].hash);
+			KSI_MetaData_free(builder->ext[s].metaData);
+		}
+	}
+	builder->ext_count = ext;
+
+	KSI_free(builder->pinnedNode);
+	builder->pinnedNode = pinnedNode;
+	pinnedNode = NULL;
+	builder->pinned = live;
+	builder->base = builder->count;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(pinnedNode);
+
+	return res;
+}
+
+/* Spills the finished nodes, if the window is full. */
+static int FlatTree_checkSpill(KSI_FlatTreeBuilder *builder) {
+	int res = KSI_OK;
+
+	if (builder->spill != NULL && builder->count - builder->base >= FLAT_SPILL_WINDOW) {
+		res = FlatTree_spill(builder);
+		if (res != KSI_OK) KSI_pushError(builder->ctx, res, "Unable to write the spill file.");
+	}
+
+	return res;
+}
+
+/* A node loaded either from the memory or from the spill file. */
+typedef struct {
+	size_t parent;
+	size_t sibling;
+	unsigned char level;
+	unsigned char flags;
+	unsigned char imprintLen;
+	unsigned char imprint[KSI_MAX_IMPRINT_LEN];
+	/** External value of an in-memory node. */
+	const FlatTreeExtValue *ext;
+	/** Offset of the external value of a spilled node in the value spill file. */
+	KSI_uint64_t valueOffset;
+} FlatTreeNode;
+
+static int FlatTree_loadNode(const KSI_FlatTreeBuilder *builder, size_t node, FlatTreeNode *out) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char rec[3 * 8 + 3 + KSI_MAX_IMPRINT_LEN];
+	size_t s = FLAT_SLOT(builder, node);
+
+	out->ext = NULL;
+	out->valueOffset = 0;
+
+	if (s != FLAT_NONE) {
+		out->parent = builder->parent[s];
+		out->sibling = builder->sibling[s];
+		out->level = builder->level[s];
+		out->flags = builder->flags[s];
+		out->imprintLen = builder->imprintLen[s];
+		memcpy(out->imprint, builder->imprint + s * builder->stride, builder->imprintLen[s]);
+
+		if (out->flags & FLAT_NODE_EXT) {
+			out->ext = FlatTree_getExt(builder, node);
+			if (out->ext == NULL) {
+				res = KSI_INVALID_STATE;
+				goto cleanup;
+			}
+		}
+	} else {
+		res = FlatTree_seek(builder->spill, (KSI_uint64_t)node * FLAT_RECORD_LEN(builder));
+		if (res != KSI_OK) goto cleanup;
+
+		if (fread(rec, 1, FLAT_RECORD_LEN(builder), builder->spill) != FLAT_RECORD_LEN(builder)) {
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
+
+		out->parent = (size_t)FlatTree_getUInt64(rec);
+		out->sibling = (size_t)FlatTree_getUInt64(rec + 8);
+		out->valueOffset = FlatTree_getUInt64(rec + 16);
+		out->level = rec[24];
+		out->flags = rec[25];
+		out->imprintLen = rec[26];
+		if (out->imprintLen > builder->stride) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+		memcpy(out->imprint, rec + 27, out->imprintLen);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Returns the value of a loaded node either as a hash value or as a meta-data element. */
+static int FlatTree_loadValue(const KSI_FlatTreeBuilder *builder, const FlatTreeNode *node, KSI_DataHash **hsh, KSI_MetaDataElement **mdEl) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char buf[0xffff + 4];
+	unsigned char hdr[5];
+	KSI_MetaDataElement *tmp = NULL;
+	size_t len;
+
+	*hsh = NULL;
+	*mdEl = NULL;
+
+	if (!(node->flags & FLAT_NODE_EXT)) {
+		res = KSI_DataHash_fromImprint(builder->ctx, node->imprint, node->imprintLen, hsh);
+		goto cleanup;
+	}
+
+	if (node->ext != NULL) {
+		if (node->ext->hash != NULL) {
+			*hsh = KSI_DataHash_ref(node->ext->hash);
+			res = KSI_OK;
+		} else {
+			res = node->ext->metaData->toMetaDataElement(node->ext->metaData, mdEl);
+		}
+		goto cleanup;
+	}
+
+	res = FlatTree_seek(builder->spillValues, node->valueOffset);
+	if (res != KSI_OK) goto cleanup;
+
+	if (fread(hdr, 1, sizeof(hdr), builder->spillValues) != sizeof(hdr)) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	len = ((size_t)hdr[1] << 24) | ((size_t)hdr[2] << 16) | ((size_t)hdr[3] << 8) | hdr[4];
+	if (len > sizeof(buf)) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	if (fread(buf, 1, len, builder->spillValues) != len) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	if (hdr[0] == FLAT_VALUE_HASH) {
+		res = KSI_DataHash_fromImprint(builder->ctx, buf, len, hsh);
+		goto cleanup;
+	}
+
+	/* The same as #KSI_MetaData_toMetaDataElement. */
+	res = KSI_MetaDataElement_new(builder->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->impl->ptr = buf;
+	tmp->impl->ftlv.dat_len = len;
+
+	res = KSI_TlvElement_detach(tmp->impl);
+	if (res != KSI_OK) goto cleanup;
+
+	*mdEl = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_MetaDataElement_free(tmp);
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_new(KSI_CTX *ctx, KSI_HashAlgorithm algo, KSI_FlatTreeBuilder **builder) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_FlatTreeBuilder *tmp = NULL;
+	size_t i;
+
+	if (ctx == NULL || builder == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (!KSI_isHashAlgorithmSupported(algo)) {
+		KSI_pushError(ctx, res = KSI_UNAVAILABLE_HASH_ALGORITHM, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_FlatTreeBuilder);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->algo = algo;
+	tmp->cbList = NULL;
+	tmp->count = 0;
+	tmp->size = 0;
+	tmp->stride = KSI_getHashLength(algo) + 1;
+	tmp->imprint = NULL;
+	tmp->imprintLen = NULL;
+	tmp->level = NULL;
+	tmp->flags = NULL;
+	tmp->parent = NULL;
+	tmp->sibling = NULL;
+	tmp->ext = NULL;
+	tmp->ext_count = 0;
+	tmp->ext_size = 0;
+	tmp->root = FLAT_NONE;
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		tmp->stack[i] = FLAT_NONE;
+	}
+	tmp->base = 0;
+	tmp->pinned = 0;
+	tmp->pinnedNode = NULL;
+	tmp->spill = NULL;
+	tmp->spillValues = NULL;
+	tmp->spillValuesLen = 0;
+	tmp->spillPath = NULL;
+	tmp->spillValuesPath = NULL;
+
+	res = KSI_TreeBuilderLeafProcessorList_new(&tmp->cbList);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*builder = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_FlatTreeBuilder_free(tmp);
+
+	return res;
+}
+
+void KSI_FlatTreeBuilder_free(KSI_FlatTreeBuilder *builder) {
+	if (builder != NULL) {
+		size_t i;
+
+		for (i = 0; i < builder->ext_count; i++) {
+			KSI_DataHash_free(builder->ext[i].hash);
+			KSI_MetaData_free(builder->ext[i].metaData);
+		}
+
+		KSI_free(builder->ext);
+		KSI_free(builder->imprint);
+		KSI_free(builder->imprintLen);
+		KSI_free(builder->level);
+		KSI_free(builder->flags);
+		KSI_free(builder->parent);
+		KSI_free(builder->sibling);
+		KSI_free(builder->pinnedNode);
+		KSI_TreeBuilderLeafProcessorList_free(builder->cbList);
+
+		if (builder->spill != NULL) fclose(builder->spill);
+		if (builder->spillValues != NULL) fclose(builder->spillValues);
+		if (builder->spillPath != NULL) remove(builder->spillPath);
+		if (builder->spillValuesPath != NULL) remove(builder->spillValuesPath);
+		KSI_free(builder->spillPath);
+		KSI_free(builder->spillValuesPath);
+
+		KSI_free(builder);
+	}
+}
+
+int KSI_FlatTreeBuilder_addLeafProcessor(KSI_FlatTreeBuilder *builder, KSI_TreeBuilderLeafProcessor *processor) {
+	if (builder == NULL || processor == NULL) return KSI_INVALID_ARGUMENT;
+	return KSI_TreeBuilderLeafProcessorList_append(builder->cbList, processor);
+}
+
+int KSI_FlatTreeBuilder_setSpillFile(KSI_FlatTreeBuilder *builder, const char *path) {
+	int res = KSI_UNKNOWN_ERROR;
+	FILE *spill = NULL;
+	FILE *spillValues = NULL;
+	char *spillPath = NULL;
+	char *spillValuesPath = NULL;
+	size_t len;
+
+	if (builder == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	if (builder->count > 0 || builder->spill != NULL) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The spill file must be set before adding the leaves.");
+		goto cleanup;
+	}
+
+	if (path == NULL) {
+		spill = tmpfile();
+		spillValues = tmpfile();
+	} else {
+		len = strlen(path) + sizeof(".values");
+
+		spillPath = KSI_malloc(len);
+		spillValuesPath = KSI_malloc(len);
+		if (spillPath == NULL || spillValuesPath == NULL) {
+			KSI_pushError(builder->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		KSI_snprintf(spillPath, len, "%s", path);
+		KSI_snprintf(spillValuesPath, len, "%s.values", path);
+
+		spill = fopen(spillPath, "w+b");
+		if (spill == NULL) {
+			KSI_pushError(builder->ctx, res = KSI_IO_ERROR, "Unable to create the spill file.");
+			goto cleanup;
+		}
+
+		spillValues = fopen(spillValuesPath, "w+b");
+	}
+
+	if (spill == NULL || spillValues == NULL) {
+		KSI_pushError(builder->ctx, res = KSI_IO_ERROR, "Unable to create the spill file.");
+		goto cleanup;
+	}
+
+	builder->spill = spill;
+	builder->spillValues = spillValues;
+	builder->spillPath = spillPath;
+	builder->spillValuesPath = spillValuesPath;
+	spill = NULL;
+	spillValues = NULL;
+	spillPath = NULL;
+	spillValuesPath = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (spill != NULL) {
+		fclose(spill);
+		if (spillPath != NULL) remove(spillPath);
+	}
+	if (spillValues != NULL) {
+		fclose(spillValues);
+		if (spillValuesPath != NULL) remove(spillValuesPath);
+	}
+	KSI_free(spillPath);
+	KSI_free(spillValuesPath);
+
+	return res;
+}
+
+static int FlatTree_insertNode(KSI_FlatTreeBuilder *builder, size_t node) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	/* Merge with the complete binary trees of the same height, see #insertNode. */
+	while (builder->stack[builder->level[FLAT_SLOT(builder, node)]] != FLAT_NONE) {
+		size_t slot = builder->level[FLAT_SLOT(builder, node)];
+		size_t root;
+
+		res = FlatTree_join(builder, builder->stack[slot], node, &root);
+		if (res != KSI_OK) {
+			KSI_pushError(builder->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		builder->stack[slot] = FLAT_NONE;
+		node = root;
+	}
+
+	builder->stack[builder->level[FLAT_SLOT(builder, node)]] = node;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int FlatTree_processAndInsertNode(KSI_FlatTreeBuilder *builder, KSI_DataHash *hsh, KSI_MetaData *metaData, size_t leaf) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t localRoot = leaf;
+	KSI_TreeNode in;
+	KSI_TreeNode *tmp = NULL;
+	KSI_DataHash *rootHash = NULL;
+	size_t i;
+
+	/* The processors see the same node values as with #KSI_TreeBuilder. */
+	in.ctx = builder->ctx;
+	in.hash = hsh;
+	in.metaData = metaData;
+	in.level = builder->level[FLAT_SLOT(builder, leaf)];
+	in.parent = NULL;
+	in.leftChild = NULL;
+	in.rightChild = NULL;
+
+	for (i = 0; i < KSI_TreeBuilderLeafProcessorList_length(builder->cbList); i++) {
+		KSI_TreeBuilderLeafProcessor *cb = NULL;
+		size_t node;
+
+		res = KSI_TreeBuilderLeafProcessorList_elementAt(builder->cbList, i, &cb);
+		if (res != KSI_OK || cb == NULL) {
+			if (res == KSI_OK) res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+
+		if (cb->fn == NULL) {
+			res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+
+		res = cb->fn(&in, cb->c, &tmp);
+		if (res != KSI_OK) goto cleanup;
+
+		if (tmp == NULL) continue;
+
+		res = FlatTree_addNode(builder, tmp->hash, tmp->metaData, tmp->level, &node);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_TreeNode_free(tmp);
+		tmp = NULL;
+
+		res = FlatTree_join(builder, localRoot, node, &localRoot);
+		if (res != KSI_OK) goto cleanup;
+
+		/* The next processor gets the new local root. */
+		KSI_DataHash_free(rootHash);
+		rootHash = NULL;
+
+		res = FlatTree_getNodeHash(builder, localRoot, &rootHash);
+		if (res != KSI_OK) goto cleanup;
+
+		in.hash = rootHash;
+		in.metaData = NULL;
+		in.level = builder->level[FLAT_SLOT(builder, localRoot)];
+	}
+
+	res = FlatTree_insertNode(builder, localRoot);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(rootHash);
+	KSI_TreeNode_free(tmp);
+
+	return res;
+}
+
+static int FlatTree_addLeaf(KSI_FlatTreeBuilder *builder, KSI_DataHash *hsh, KSI_MetaData *metaData, int level, size_t *leafId) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t leaf;
+
+	if (builder == NULL || (hsh == NULL && metaData == NULL) || (hsh != NULL && metaData != NULL) || !KSI_IS_VALID_TREE_LEVEL(level)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(builder->ctx);
+
+	/* Make sure the builder is in a correct state. */
+	if (builder->root != FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been finished, new leafs may not be added.");
+		goto cleanup;
+	}
+
+	res = FlatTree_checkSpill(builder);
+	if (res != KSI_OK) goto cleanup;
+
+	res = FlatTree_addNode(builder, hsh, metaData, level, &leaf);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = FlatTree_processAndInsertNode(builder, hsh, metaData, leaf);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (leafId != NULL) *leafId = leaf;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_addDataHash(KSI_FlatTreeBuilder *builder, KSI_DataHash *hsh, int level, size_t *leafId) {
+	return FlatTree_addLeaf(builder, hsh, NULL, level, leafId);
+}
+
+int KSI_FlatTreeBuilder_addMetaData(KSI_FlatTreeBuilder *builder, KSI_MetaData *metaData, int level, size_t *leafId) {
+	return FlatTree_addLeaf(builder, NULL, metaData, level, leafId);
+}
+
+typedef struct {
+	/** Index of the first leaf of the block in the batch. */
+	size_t first;
+	/** Number of leaves in the block, a power of two. */
+	size_t size;
+	/** Index of the first node of the block. */
+	size_t base;
+	/** Root node of the complete binary tree of the block. */
+	size_t root;
+} FlatTreeBlock;
+
+typedef struct {
+	KSI_FlatTreeBuilder *builder;
+
+	/** Number of nodes per leaf: the leaf itself, the mask and meta-data nodes and their joins. */
+	size_t leafNodes;
+	/** Offset of the mask node from the leaf node, 0 if the leaves are not masked. */
+	size_t maskOffset;
+	/** Offset of the meta-data node from the leaf node, 0 if there is no meta-data. */
+	size_t metaOffset;
+	/** Serialized meta-data value, as the meta-data object may not be used concurrently. */
+	const unsigned char *md;
+	size_t md_len;
+
+	FlatTreeBlock *blocks;
+	size_t blockCount;
+
+	/** Number of blocks with all the masks computed. */
+	size_t ready;
+	/** Next block to be built. */
+	size_t next;
+	/** The first error encountered. */
+	int res;
+
+#ifdef HAVE_PTHREAD
+	bool threaded;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+} FlatTreeBatch;
+
+typedef struct {
+	FlatTreeBatch *batch;
+	/** Private hasher of the worker. */
+	KSI_DataHasher *hsr;
+#ifdef HAVE_PTHREAD
+	pthread_t thread;
+#endif
+} FlatTreeWorker;
+
+static void FlatTreeBatch_lock(FlatTreeBatch *batch) {
+#ifdef HAVE_PTHREAD
+	if (batch->threaded) pthread_mutex_lock(&batch->lock);
+#endif
+}
+
+static void FlatTreeBatch_unlock(FlatTreeBatch *batch) {
+#ifdef HAVE_PTHREAD
+	if (batch->threaded) pthread_mutex_unlock(&batch->lock);
+#endif
+}
+
+/* Wakes up the workers waiting for the masks. Must be called with the lock held. */
+static void FlatTreeBatch_signal(FlatTreeBatch *batch) {
+#ifdef HAVE_PTHREAD
+	if (batch->threaded) pthread_cond_broadcast(&batch->cond);
+#endif
+}
+
+/* Waits for the next block to become ready. Must be called with the lock held. */
+static void FlatTreeBatch_wait(FlatTreeBatch *batch) {
+#ifdef HAVE_PTHREAD
+	if (batch->threaded) pthread_cond_wait(&batch->cond, &batch->lock);
+#endif
+}
+
+/* Splits the leaves into blocks of complete binary trees, such that inserting the roots of the
+ * blocks gives exactly the same tree as inserting the leaves one by one. A block of 2^k leaves
+ * of height h may be built independently iff the stack slots h..h+k-1 are empty when it is
+ * inserted. Returns the number of blocks, and fills in the blocks, if \c blocks is not NULL. */
+static size_t FlatTreeBatch_split(const KSI_FlatTreeBuilder *builder, unsigned height, size_t count, unsigned maxLog, FlatTreeBlock *blocks) {
+	bool occupied[KSI_TREE_BUILDER_STACK_LEN];
+	size_t known = height;
+	size_t first = 0;
+	size_t n = 0;
+	size_t i;
+
+	while (first < count) {
+		unsigned k = 0;
+
+		for (;;) {
+			/* Only the slots above the leaf height are relevant, copy them from the stack on demand. */
+			for (; known <= height + k && known < KSI_TREE_BUILDER_STACK_LEN; known++) {
+				occupied[known] = builder->stack[known] != FLAT_NONE;
+			}
+
+			if (k >= maxLog || ((size_t)2 << k) > count - first || height + k + 1 >= KSI_TREE_BUILDER_STACK_LEN || occupied[height + k]) break;
+			k++;
+		}
+
+		if (blocks != NULL) {
+			blocks[n].first = first;
+			blocks[n].size = (size_t)1 << k;
+		}
+
+		n++;
+		first += (size_t)1 << k;
+
+		/* Simulate the insertion of the block root, see #FlatTree_insertNode. */
+		for (i = height + k; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+			if (i == known) occupied[known++] = builder->stack[i] != FLAT_NONE;
+			if (!occupied[i]) break;
+			occupied[i] = false;
+		}
+		if (i < KSI_TREE_BUILDER_STACK_LEN) occupied[i] = true;
+	}
+
+	return n;
+}
+
+static int FlatTreeBatch_join(FlatTreeBatch *batch, KSI_DataHasher *hsr, size_t left, size_t right, size_t i) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	res = KSI_DataHasher_reset(hsr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = FlatTree_joinAt(batch->builder, hsr, left, right, i, batch->md, batch->md_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Builds the tree of a single block. Only the nodes of the block are modified. */
+static int FlatTreeBatch_buildBlock(FlatTreeBatch *batch, KSI_DataHasher *hsr, FlatTreeBlock *block) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t inner = block->base + block->size * batch->leafNodes;
+	size_t next = inner;
+	size_t from;
+	size_t n;
+	size_t i;
+
+	/* Join the leaves with the masks and meta-data, see #FlatTree_processAndInsertNode. */
+	for (i = 0; i < block->size; i++) {
+		size_t leaf = block->base + i * batch->leafNodes;
+		size_t root = leaf;
+
+		if (batch->maskOffset != 0) {
+			res = FlatTreeBatch_join(batch, hsr, root, leaf + batch->maskOffset, leaf + batch->maskOffset + 1);
+			if (res != KSI_OK) goto cleanup;
+
+			root = leaf + batch->maskOffset + 1;
+		}
+
+		if (batch->metaOffset != 0) {
+			res = FlatTreeBatch_join(batch, hsr, root, leaf + batch->metaOffset, leaf + batch->metaOffset + 1);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+	/* Join the local roots of the leaves pairwise, the inner nodes are stored level by level. */
+	for (i = 0; i + 1 < block->size; i += 2) {
+		res = FlatTreeBatch_join(batch, hsr,
+				block->base + (i + 1) * batch->leafNodes - 1,
+				block->base + (i + 2) * batch->leafNodes - 1,
+				next++);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	for (from = inner, n = block->size / 2; n > 1; from += n, n /= 2) {
+		for (i = 0; i < n; i += 2) {
+			res = FlatTreeBatch_join(batch, hsr, from + i, from + i + 1, next++);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+	block->root = block->size == 1 ? inner - 1 : next - 1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Builds the blocks one by one as soon as their masks have been computed. */
+static void FlatTreeBatch_work(FlatTreeBatch *batch, KSI_DataHasher *hsr) {
+	for (;;) {
+		size_t b;
+		int res;
+
+		FlatTreeBatch_lock(batch);
+		while (batch->res == KSI_OK && batch->next < batch->blockCount && batch->next >= batch->ready) {
+			FlatTreeBatch_wait(batch);
+		}
+
+		if (batch->res != KSI_OK || batch->next >= batch->blockCount) {
+			FlatTreeBatch_unlock(batch);
+			break;
+		}
+
+		b = batch->next++;
+		FlatTreeBatch_unlock(batch);
+
+		res = FlatTreeBatch_buildBlock(batch, hsr, &batch->blocks[b]);
+		if (res != KSI_OK) {
+			FlatTreeBatch_lock(batch);
+			if (batch->res == KSI_OK) batch->res = res;
+			FlatTreeBatch_signal(batch);
+			FlatTreeBatch_unlock(batch);
+			break;
+		}
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static void *FlatTreeWorker_run(void *arg) {
+	FlatTreeWorker *worker = arg;
+
+	FlatTreeBatch_work(worker->batch, worker->hsr);
+
+	return NULL;
+}
+#endif
+
+/* Removes the external values added for the nodes starting from the current node count. */
+static void FlatTreeBatch_rollback(KSI_FlatTreeBuilder *builder) {
+	while (builder->ext_count > 0 && builder->ext[builder->ext_count - 1].node >= builder->count) {
+		builder->ext_count--;
+		KSI_DataHash_free(builder->ext[builder->ext_count].hash);
+		KSI_MetaData_free(builder->ext[builder->ext_count].metaData);
+	}
+}
+
+static int FlatTree_addBatch(KSI_FlatTreeBuilder *builder, KSI_DataHash * const *hashes, size_t count, int level,
+		KSI_FlatTreeMaskFn maskFn, void *maskCtx, KSI_MetaData *metaData, KSI_DataHasher **workers, size_t workerCount, size_t *leafIds) {
+	int res = KSI_UNKNOWN_ERROR;
+	FlatTreeBatch batch;
+	FlatTreeBlock single;
+	FlatTreeWorker *threads = NULL;
+	size_t threadCount = 0;
+	KSI_DataHasher *hsr = NULL;
+	unsigned char md[0xffff + 4];
+	unsigned height;
+	unsigned maxLog;
+	size_t target;
+	size_t end;
+	size_t b;
+	size_t i;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.builder = builder;
+	batch.res = KSI_OK;
+
+	if (builder == NULL || (hashes == NULL && count > 0) || (workers == NULL && workerCount > 0) || !KSI_IS_VALID_TREE_LEVEL(level)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(builder->ctx);
+
+	/* Make sure the builder is in a correct state. */
+	if (builder->root != FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been finished, new leafs may not be added.");
+		goto cleanup;
+	}
+
+	if (KSI_TreeBuilderLeafProcessorList_length(builder->cbList) > 0) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "Leaf processors may not be used together with batches.");
+		goto cleanup;
+	}
+
+	for (i = 0; i < workerCount; i++) {
+		if (workers[i] == NULL || workers[i]->algorithm != builder->algo) {
+			KSI_pushError(builder->ctx, res = KSI_INVALID_ARGUMENT, "Worker hasher algorithm mismatch.");
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = FlatTree_checkSpill(builder);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Layout of the nodes of a single leaf. */
+	batch.leafNodes = 1;
+	height = (unsigned)level;
+	if (maskFn != NULL) {
+		batch.maskOffset = batch.leafNodes;
+		batch.leafNodes += 2;
+		height++;
+	}
+	if (metaData != NULL) {
+		batch.metaOffset = batch.leafNodes;
+		batch.leafNodes += 2;
+		height++;
+
+		res = metaData->serializePayload(metaData, md, sizeof(md), &batch.md_len);
+		if (res != KSI_OK) {
+			KSI_pushError(builder->ctx, res, NULL);
+			goto cleanup;
+		}
+		batch.md = md;
+	}
+
+	if (!KSI_IS_VALID_TREE_LEVEL(height)) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_ARGUMENT, "Tree too large.");
+		goto cleanup;
+	}
+
+#ifndef HAVE_PTHREAD
+	/* Without thread support, everything is computed on the calling thread. */
+	workerCount = 0;
+#endif
+
+	/* A few blocks per thread for balancing the load; a single block per stack slot otherwise. */
+	target = workerCount > 0 ? count / (4 * (workerCount + 1)) : count;
+	for (maxLog = 0; ((size_t)2 << maxLog) <= target; maxLog++);
+
+	batch.blockCount = FlatTreeBatch_split(builder, height, count, maxLog, NULL);
+	batch.blocks = batch.blockCount == 1 ? &single : KSI_calloc(batch.blockCount, sizeof(*batch.blocks));
+	if (batch.blocks == NULL) {
+		KSI_pushError(builder->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	FlatTreeBatch_split(builder, height, count, maxLog, batch.blocks);
+
+	/* Assign the node ranges to the blocks. */
+	end = builder->count;
+	for (b = 0; b < batch.blockCount; b++) {
+		batch.blocks[b].base = end;
+		end += batch.blocks[b].size * (batch.leafNodes + 1) - 1;
+	}
+
+	/* Make sure the node arrays are not reallocated while the workers are running. */
+	res = FlatTree_reserve(builder, end - builder->count);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Set the values of the leaves and the meta-data nodes. The external values are ordered by the
+	 * node index, as the blocks and the leaves within are processed in the increasing order. */
+	for (b = 0; b < batch.blockCount; b++) {
+		const FlatTreeBlock *block = &batch.blocks[b];
+
+		for (i = 0; i < block->size; i++) {
+			size_t leaf = block->base + i * batch.leafNodes;
+
+			res = FlatTree_setNode(builder, leaf, hashes[block->first + i], NULL, level);
+			if (res != KSI_OK) {
+				KSI_pushError(builder->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			if (batch.maskOffset != 0) {
+				/* The mask value is computed later. */
+				size_t mask = FLAT_SLOT(builder, leaf + batch.maskOffset);
+
+				builder->level[mask] = (unsigned char)level;
+				builder->flags[mask] = 0;
+				builder->parent[mask] = FLAT_NONE;
+				builder->sibling[mask] = FLAT_NONE;
+				builder->imprintLen[mask] = 0;
+			}
+
+			if (batch.metaOffset != 0) {
+				res = FlatTree_setNode(builder, leaf + batch.metaOffset, NULL, metaData, level + (batch.maskOffset != 0));
+				if (res != KSI_OK) {
+					KSI_pushError(builder->ctx, res, NULL);
+					goto cleanup;
+				}
+			}
+		}
+	}
+
+	batch.ready = maskFn != NULL ? 0 : batch.blockCount;
+
+#ifdef HAVE_PTHREAD
+	threadCount = workerCount < batch.blockCount - 1 ? workerCount : batch.blockCount - 1;
+	if (threadCount > 0) {
+		threads = KSI_calloc(threadCount, sizeof(*threads));
+		if (threads == NULL) {
+			KSI_pushError(builder->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		if (pthread_mutex_init(&batch.lock, NULL) != 0) {
+			KSI_pushError(builder->ctx, res = KSI_UNKNOWN_ERROR, "Unable to initialize a mutex.");
+			goto cleanup;
+		}
+
+		if (pthread_cond_init(&batch.cond, NULL) != 0) {
+			pthread_mutex_destroy(&batch.lock);
+			KSI_pushError(builder->ctx, res = KSI_UNKNOWN_ERROR, "Unable to initialize a condition variable.");
+			goto cleanup;
+		}
+
+		batch.threaded = true;
+
+		for (i = 0; i < threadCount; i++) {
+			threads[i].batch = &batch;
+			threads[i].hsr = workers[i];
+
+			/* Continue with fewer threads, if the system refuses to create more. */
+			if (pthread_create(&threads[i].thread, NULL, FlatTreeWorker_run, &threads[i]) != 0) break;
+		}
+		threadCount = i;
+	}
+#endif
+
+	/* Compute the masks on the calling thread. The workers start building a block as soon as
+	 * all of its masks are known. */
+	for (b = 0; maskFn != NULL && b < batch.blockCount; b++) {
+		const FlatTreeBlock *block = &batch.blocks[b];
+
+		for (i = 0; i < block->size; i++) {
+			size_t mask = FLAT_SLOT(builder, block->base + i * batch.leafNodes + batch.maskOffset);
+			KSI_DataHash hsh;
+
+			res = maskFn(maskCtx, hashes[block->first + i], level, &hsh);
+			if (res == KSI_OK && hsh.imprint_length > builder->stride) res = KSI_INVALID_STATE;
+			if (res != KSI_OK) break;
+
+			memcpy(builder->imprint + mask * builder->stride, hsh.imprint, hsh.imprint_length);
+			builder->imprintLen[mask] = (unsigned char)hsh.imprint_length;
+		}
+
+		FlatTreeBatch_lock(&batch);
+		if (res != KSI_OK && batch.res == KSI_OK) batch.res = res;
+		if (res == KSI_OK) batch.ready = b + 1;
+		FlatTreeBatch_signal(&batch);
+		FlatTreeBatch_unlock(&batch);
+
+		if (res != KSI_OK || batch.res != KSI_OK) break;
+	}
+
+	/* Help the workers with the rest of the blocks. No hasher is needed if there is nothing to join. */
+	res = (batch.leafNodes > 1 || count > batch.blockCount) ? KSI_DataHasher_openCached(builder->ctx, builder->algo, &hsr) : KSI_OK;
+	if (res != KSI_OK) {
+		FlatTreeBatch_lock(&batch);
+		if (batch.res == KSI_OK) batch.res = res;
+		FlatTreeBatch_signal(&batch);
+		FlatTreeBatch_unlock(&batch);
+	} else {
+		FlatTreeBatch_work(&batch, hsr);
+	}
+
+#ifdef HAVE_PTHREAD
+	for (i = 0; i < threadCount; i++) {
+		pthread_join(threads[i].thread, NULL);
+	}
+
+	if (batch.threaded) {
+		pthread_cond_destroy(&batch.cond);
+		pthread_mutex_destroy(&batch.lock);
+	}
+#endif
+
+	res = batch.res;
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Insert the block roots in the original order. */
+	builder->count = end;
+
+	for (b = 0; b < batch.blockCount; b++) {
+		res = FlatTree_insertNode(builder, batch.blocks[b].root);
+		if (res != KSI_OK) {
+			KSI_pushError(builder->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (leafIds != NULL) {
+		for (b = 0; b < batch.blockCount; b++) {
+			for (i = 0; i < batch.blocks[b].size; i++) {
+				leafIds[batch.blocks[b].first + i] = batch.blocks[b].base + i * batch.leafNodes;
+			}
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* Drop the values of a failed batch. */
+	if (res != KSI_OK && builder != NULL) FlatTreeBatch_rollback(builder);
+
+	KSI_nofree(hsr);
+	KSI_free(threads);
+	if (batch.blocks != &single) KSI_free(batch.blocks);
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_addBatch(KSI_FlatTreeBuilder *builder, KSI_DataHash * const *hashes, size_t count, int level,
+		KSI_FlatTreeMaskFn maskFn, void *maskCtx, KSI_MetaData *metaData, KSI_DataHasher **workers, size_t workerCount, size_t *leafIds) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t chunk;
+	size_t first;
+
+	if (builder == NULL || builder->spill == NULL || count == 0) {
+		res = FlatTree_addBatch(builder, hashes, count, level, maskFn, maskCtx, metaData, workers, workerCount, leafIds);
+		goto cleanup;
+	}
+
+	/* With a spill file, the batch is added in chunks of at most a window of nodes, so the finished
+	 * nodes are spilled in between. Every leaf adds itself, the mask and the meta-data nodes and
+	 * their parents, and one node to join it with the rest of the tree. */
+	chunk = FLAT_SPILL_WINDOW / (2 + (maskFn != NULL ? 2 : 0) + (metaData != NULL ? 2 : 0));
+
+	for (first = 0; first < count; first += chunk) {
+		if (chunk > count - first) chunk = count - first;
+
+		res = FlatTree_addBatch(builder, hashes + first, chunk, level, maskFn, maskCtx, metaData, workers, workerCount,
+				leafIds != NULL ? leafIds + first : NULL);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_close(KSI_FlatTreeBuilder *builder) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t root = FLAT_NONE;
+	size_t i;
+
+	if  (builder == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	/* Closing an already closed tree keeps the existing root. */
+	if (builder->root != FLAT_NONE) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* Finalize the forest of complete binary trees into a single tree. */
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		size_t node = builder->stack[i];
+		builder->stack[i] = FLAT_NONE;
+
+		if (node == FLAT_NONE) continue;
+
+		if (root == FLAT_NONE) {
+			root = node;
+		} else {
+			res = FlatTree_join(builder, node, root, &root);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+	/* Check if all is well. */
+	if (root == FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has no leafs.");
+		goto cleanup;
+	}
+
+	builder->root = root;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_getFrontier(const KSI_FlatTreeBuilder *builder, KSI_DataHash **roots) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+
+	if (builder == NULL || roots == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) roots[i] = NULL;
+
+	if (builder->root != FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree has been finished.");
+		goto cleanup;
+	}
+
+	/* The roots never have a parent, so they are always kept in memory. */
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		size_t node = builder->stack[i];
+
+		if (node == FLAT_NONE) continue;
+
+		res = FlatTree_getNodeHash(builder, node, &roots[i]);
+		if (res != KSI_OK) {
+			KSI_pushError(builder->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (roots[i] == NULL) {
+			KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "Meta-data values are not supported in the frontier.");
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK && roots != NULL) {
+		for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+			KSI_DataHash_free(roots[i]);
+			roots[i] = NULL;
+		}
+	}
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_setFrontier(KSI_FlatTreeBuilder *builder, KSI_DataHash * const *roots) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t i;
+
+	if (builder == NULL || roots == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	if (builder->count > 0 || builder->root != FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The frontier may only be set on an empty tree.");
+		goto cleanup;
+	}
+
+	for (i = 0; i < KSI_TREE_BUILDER_STACK_LEN; i++) {
+		size_t node;
+
+		if (roots[i] == NULL) continue;
+
+		res = FlatTree_addNode(builder, roots[i], NULL, (int)i, &node);
+		if (res != KSI_OK) {
+			KSI_pushError(builder->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		builder->stack[i] = node;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_getRoot(const KSI_FlatTreeBuilder *builder, KSI_DataHash **hsh, int *level) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *tmp = NULL;
+
+	if (builder == NULL || hsh == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	if (builder->root == FLAT_NONE) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_STATE, "The tree is not closed.");
+		goto cleanup;
+	}
+
+	res = FlatTree_getNodeHash(builder, builder->root, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (level != NULL) *level = builder->level[FLAT_SLOT(builder, builder->root)];
+	*hsh = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(tmp);
+
+	return res;
+}
+
+/* The same as #getHashChainLinks, but iterates over the parent indices. The spilled nodes are read
+ * from the spill file. */
+static int FlatTree_getHashChainLinks(const KSI_FlatTreeBuilder *builder, size_t node, KSI_LIST(KSI_HashChainLink) *links) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HashChainLink *link = NULL;
+	KSI_Integer *levelCorrection = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_MetaDataElement *mdEl = NULL;
+	FlatTreeNode cur;
+	FlatTreeNode sibling;
+	FlatTreeNode parent;
+
+	res = FlatTree_loadNode(builder, node, &cur);
+	if (res != KSI_OK) goto cleanup;
+
+	while (cur.parent != FLAT_NONE) {
+		unsigned levelGap;
+
+		res = FlatTree_loadNode(builder, cur.sibling, &sibling);
+		if (res != KSI_OK) goto cleanup;
+
+		res = FlatTree_loadNode(builder, cur.parent, &parent);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_new(builder->ctx, &link);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_setIsLeft(link, (cur.flags & FLAT_NODE_LEFT) != 0);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Add the hash value or the meta-data converted to the internal representation. */
+		res = FlatTree_loadValue(builder, &sibling, &hsh, &mdEl);
+		if (res != KSI_OK) goto cleanup;
+
+		if (hsh != NULL) {
+			res = KSI_HashChainLink_setImprint(link, hsh);
+			if (res != KSI_OK) goto cleanup;
+			hsh = NULL;
+		} else {
+			res = KSI_HashChainLink_setMetaData(link, mdEl);
+			if (res != KSI_OK) goto cleanup;
+			mdEl = NULL;
+		}
+
+		/* Sanity check. */
+		if (parent.level <= cur.level) {
+			res = KSI_INVALID_STATE;
+			goto cleanup;
+		}
+
+		/* Calculate the level correction. */
+		levelGap = parent.level - cur.level - 1;
+
+		if (levelGap > 0) {
+			res = KSI_Integer_new(builder->ctx, levelGap, &levelCorrection);
+			if (res != KSI_OK) goto cleanup;
+
+			res = KSI_HashChainLink_setLevelCorrection(link, levelCorrection);
+			if (res != KSI_OK) goto cleanup;
+
+			levelCorrection = NULL;
+		}
+
+		res = KSI_HashChainLinkList_append(links, link);
+		if (res != KSI_OK) goto cleanup;
+		link = NULL;
+
+		cur = parent;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_MetaDataElement_free(mdEl);
+	KSI_DataHash_free(hsh);
+	KSI_Integer_free(levelCorrection);
+	KSI_HashChainLink_free(link);
+
+	return res;
+}
+
+int KSI_FlatTreeBuilder_getAggregationChain(const KSI_FlatTreeBuilder *builder, size_t leafId, KSI_AggregationHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationHashChain *tmp = NULL;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_DataHash *inputHash = NULL;
+	KSI_MetaDataElement *mdEl = NULL;
+	KSI_Integer *algoId = NULL;
+	FlatTreeNode leaf;
+
+	if (builder == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(builder->ctx);
+
+	if (leafId >= builder->count) {
+		KSI_pushError(builder->ctx, res = KSI_INVALID_ARGUMENT, "Leaf index out of range.");
+		goto cleanup;
+	}
+
+	/* Create new object. */
+	res = KSI_AggregationHashChain_new(builder->ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Create new list. */
+	res = KSI_HashChainLinkList_new(&links);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Extract the hash chain links. */
+	res = FlatTree_getHashChainLinks(builder, leafId, links);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Set the hash chain links to the container. */
+	res = KSI_AggregationHashChain_setChain(tmp, links);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+	links = NULL;
+
+	/* Set the input hash. */
+	res = FlatTree_loadNode(builder, leafId, &leaf);
+	if (res == KSI_OK) res = FlatTree_loadValue(builder, &leaf, &inputHash, &mdEl);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_setInputHash(tmp, inputHash);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+	inputHash = NULL;
+
+	/* Set the aggregation algorithm. */
+	res = KSI_Integer_new(builder->ctx, builder->algo, &algoId);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_setAggrHashId(tmp, algoId);
+	if (res != KSI_OK) {
+		KSI_pushError(builder->ctx, res, NULL);
+		goto cleanup;
+	}
+	algoId = NULL;
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(algoId);
+	KSI_MetaDataElement_free(mdEl);
+	KSI_DataHash_free(inputHash);
+	KSI_HashChainLinkList_free(links);
+	KSI_AggregationHashChain_free(tmp);
+
+	return res;
+}
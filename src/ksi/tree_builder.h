@@ -215,6 +215,104 @@ int KSI_TreeBuilder_addMetaData(KSI_TreeBuilder *builder, KSI_MetaData *metaData
  */
 int KSI_TreeBuilder_close(KSI_TreeBuilder *builder);
 
+/**
+ * An alternative to #KSI_TreeBuilder for very large trees. Instead of a #KSI_TreeNode object per
+ * node, the nodes are stored in contiguous arrays and referred to by their index. The builder
+ * runs the same leaf processors and produces the same aggregation hash chains as #KSI_TreeBuilder.
+ */
+typedef struct KSI_FlatTreeBuilder_st KSI_FlatTreeBuilder;
+
+/**
+ * Constructor for the #KSI_FlatTreeBuilder object.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	algo		Algorithm used for the internal nodes.
+ * \param[out]	builder		Pointer to the receiving pointer.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ * \see #KSI_FlatTreeBuilder_free
+ */
+int KSI_FlatTreeBuilder_new(KSI_CTX *ctx, KSI_HashAlgorithm algo, KSI_FlatTreeBuilder **builder);
+
+/**
+ * Destructor for the #KSI_FlatTreeBuilder object.
+ * \param[in]	builder		Pointer to the object.
+ * \see #KSI_FlatTreeBuilder_new
+ */
+void KSI_FlatTreeBuilder_free(KSI_FlatTreeBuilder *builder);
+
+/**
+ * Appends a leaf processor to the builder. The processors are executed for every added leaf
+ * in the order they were added, exactly as with #KSI_TreeBuilder. The builder does not take
+ * ownership of the processor, it must stay valid until the builder is freed.
+ * \param[in]	builder		The builder.
+ * \param[in]	processor	The leaf processor.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ */
+int KSI_FlatTreeBuilder_addLeafProcessor(KSI_FlatTreeBuilder *builder, KSI_TreeBuilderLeafProcessor *processor);
+
+/**
+ * Switches the builder to the streaming mode. The nodes that have been joined into their parents
+ * are written to a spill file, so only the roots of the complete binary trees waiting
+ * to be joined and a window of the most recent nodes are kept in memory, regardless of the size of
+ * the tree. The aggregation hash chains are read back from the spill file.
+ * \param[in]	builder		The builder.
+ * \param[in]	path		Path of the spill file, if \c NULL, temporary files are used. The external
+ * values (meta-data and oversized hash values) are written to a second file with the suffix \c .values.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ * \note The function must be called before adding any leaves. The spill files are removed when the
+ * builder is freed.
+ */
+int KSI_FlatTreeBuilder_setSpillFile(KSI_FlatTreeBuilder *builder, const char *path);
+
+/**
+ * Adds a new leaf to the tree.
+ * \param[in]	builder		The builder.
+ * \param[in]	hsh			The data hash of the leaf.
+ * \param[in]	level		The level of the leaf.
+ * \param[out]	leafId		Output parameter for the leaf index, may be \c NULL.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ * \see #KSI_FlatTreeBuilder_getAggregationChain
+ */
+int KSI_FlatTreeBuilder_addDataHash(KSI_FlatTreeBuilder *builder, KSI_DataHash *hsh, int level, size_t *leafId);
+
+/**
+ * Adds a new leaf containing a meta-data value instead of the data hash as in #KSI_FlatTreeBuilder_addDataHash.
+ * \param[in]	builder		The builder.
+ * \param[in]	metaData	The meta-data of the leaf.
+ * \param[in]	level		The level of the leaf.
+ * \param[out]	leafId		Output parameter for the leaf index, may be \c NULL.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ */
+int KSI_FlatTreeBuilder_addMetaData(KSI_FlatTreeBuilder *builder, KSI_MetaData *metaData, int level, size_t *leafId);
+
+/**
+ * This function finalizes the building of the tree. After calling this function no more leafs
+ * may be added to the computation and doing so would result in an error. Closing an already
+ * closed tree has no effect.
+ * \param[in]	builder 	The builder.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ */
+int KSI_FlatTreeBuilder_close(KSI_FlatTreeBuilder *builder);
+
+/**
+ * Returns the root hash and level of a closed tree. The root hash must be freed by the caller.
+ * \param[in]	builder		The builder.
+ * \param[out]	hsh			Pointer to the receiving pointer of the root hash.
+ * \param[out]	level		Output parameter for the root level, may be \c NULL.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ */
+int KSI_FlatTreeBuilder_getRoot(const KSI_FlatTreeBuilder *builder, KSI_DataHash **hsh, int *level);
+
+/**
+ * Generates an aggregation hash chain starting from the leaf with the given index. The resulting
+ * object must be freed by the caller.
+ * \param[in]	builder		The builder.
+ * \param[in]	leafId		The leaf index as returned by #KSI_FlatTreeBuilder_addDataHash or #KSI_FlatTreeBuilder_addMetaData.
+ * \param[out]	chain		Pointer to the receiving pointer.
+ * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+ * \see #KSI_AggregationHashChain_free.
+ */
+int KSI_FlatTreeBuilder_getAggregationChain(const KSI_FlatTreeBuilder *builder, size_t leafId, KSI_AggregationHashChain **chain);
+
 /**
  * @}
  */
@@ -27,6 +27,7 @@
 #include "net.h"
 #include "net_async.h"
 #include "tlv_element.h"
+#include "fast_tlv.h"
 
 #include "internal.h"
 
@@ -432,6 +433,50 @@ cleanup:
 	return res;
 }
 
+/**
+ * Looks up the element from an already nested TLV element without allocating a result list.
+ */
+static int metaDataElement_hasElement(KSI_TlvElement *impl, unsigned tag) {
+	size_t i;
+
+	for (i = 0; i < KSI_TlvElementList_length(impl->subList); i++) {
+		KSI_TlvElement *el = NULL;
+		if (KSI_TlvElementList_elementAt(impl->subList, i, &el) == KSI_OK && el != NULL && el->ftlv.tag == tag) return 1;
+	}
+
+	return 0;
+}
+
+int KSI_MetaDataElement_writeTlv(KSI_CTX *ctx, const KSI_MetaDataElement *data, unsigned KSI_UNUSED(tag), int KSI_UNUSED(isNonCritical), int KSI_UNUSED(isForward), unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TlvElement *el = NULL;
+
+	if (ctx == NULL || data == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Make sure the required elements are present. */
+	if (!metaDataElement_hasElement(data->impl, 0x01)) {
+		res = KSI_TlvElement_getElement(data->impl, 0x01, &el);
+		if (res != KSI_OK || el == NULL) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+	}
+
+	res = KSI_TlvElement_serialize(data->impl, buf, buf_size, len, opt);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_TlvElement_free(el);
+
+	return res;
+}
+
 int KSI_MetaDataElement_fromTlv(KSI_TLV *tlv, KSI_MetaDataElement **metaData) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_MetaDataElement *tmp = NULL;
@@ -1061,6 +1106,48 @@ cleanup:
 	return res;
 }
 
+int KSI_ExtendPdu_verify(const KSI_ExtendPdu *pdu, const char *pass) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Header *header = NULL;
+	KSI_DataHash *respHmac = NULL;
+
+	if (pdu == NULL || pass == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(pdu->ctx);
+
+	res = KSI_ExtendPdu_getHeader(pdu, &header);
+	if (res != KSI_OK) {
+		KSI_pushError(pdu->ctx, res, NULL);
+		goto cleanup;
+	}
+	if (header == NULL){
+		KSI_pushError(pdu->ctx, res = KSI_INVALID_FORMAT, "A successful extension response must have a Header.");
+		goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_getHmac(pdu, &respHmac);
+	if (res != KSI_OK) {
+		KSI_pushError(pdu->ctx, res, NULL);
+		goto cleanup;
+	}
+	if (respHmac == NULL){
+		KSI_pushError(pdu->ctx, res = KSI_INVALID_FORMAT, "A successful extension response must have a HMAC.");
+		goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_verifyHmac(pdu, pass);
+	if (res != KSI_OK) {
+		KSI_pushError(pdu->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+	return res;
+}
+
 int KSI_ExtendPdu_verifyHmac(const KSI_ExtendPdu *pdu, const char *pass) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_DataHash *respHmac = NULL;
@@ -1159,47 +1246,28 @@ cleanup:
 	return res;
 }
 
-int KSI_ExtendReq_enclose(KSI_ExtendReq *req, const char *loginId, const char *key, KSI_ExtendPdu **pdu) {
+int KSI_ExtendReq_encloseWithHeader(KSI_ExtendReq *req, KSI_Header *hdr, const char *key, KSI_ExtendPdu **pdu) {
 	int res;
 	KSI_ExtendPdu *tmp = NULL;
-	KSI_Header *hdr = NULL;
 	KSI_DataHash *hash = NULL;
-	size_t loginLen;
 	KSI_HashAlgorithm alg_id;
 	KSI_CTX *ctx = NULL;
 
-	if (req == NULL || loginId == NULL || key == NULL || pdu == NULL) {
+	if (req == NULL || hdr == NULL || key == NULL || pdu == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 	ctx = req->ctx;
 	KSI_ERR_clearErrors(ctx);
 
-	loginLen = strlen(loginId);
-	if (loginLen > UINT_MAX){
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
 	/* Create the pdu. */
 	res = KSI_ExtendPdu_new(ctx, &tmp);
 	if (res != KSI_OK) goto cleanup;
 
-	/* Create header and initialize it with the loginId provided. */
-	res = KSI_Header_new(ctx, &hdr);
-	if (res != KSI_OK) goto cleanup;
-
-	res = KSI_Utf8String_new(ctx, loginId, (unsigned)loginLen + 1, &hdr->loginId);
+	/* Set header. */
+	res = KSI_ExtendPdu_setHeader(tmp, hdr);
 	if (res != KSI_OK) goto cleanup;
 
-	tmp->header = hdr;
-	hdr = NULL;
-	/* Every request must have a header, and at this point, this is guaranteed. */
-	if (ctx->requestHeaderCB != NULL) {
-		res = ctx->requestHeaderCB(tmp->header);
-		if (res != KSI_OK) goto cleanup;
-	}
-
 	/* Add request. */
 	if (req->config != NULL && ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
 		tmp->confRequest = KSI_Config_ref(req->config);
@@ -1239,13 +1307,56 @@ int KSI_ExtendReq_enclose(KSI_ExtendReq *req, const char *loginId, const char *k
 
 cleanup:
 
-	/* Make sure we won't free the request on failure. */
-	KSI_ExtendPdu_setRequest(tmp, NULL);
+	/* Make sure we won't free input parameters on failure. */
+	if (tmp != NULL) {
+		KSI_ExtendPdu_setHeader(tmp, NULL);
+		KSI_ExtendPdu_setRequest(tmp, NULL);
+	}
 	/* The interface takes ownership over the request resource. */
 	if (res == KSI_OK) KSI_ExtendReq_free(req);
 
 	KSI_ExtendPdu_free(tmp);
-	KSI_Header_free(hdr);
+
+	return res;
+}
+
+int KSI_ExtendReq_enclose(KSI_ExtendReq *req, const char *loginId, const char *key, KSI_ExtendPdu **pdu) {
+	int res;
+	KSI_Header *tmp = NULL;
+	size_t loginLen;
+
+	if (req == NULL || loginId == NULL || key == NULL || pdu == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	loginLen = strlen(loginId);
+	if (loginLen > UINT_MAX){
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	/* Create header and initialize it with the loginId provided. */
+	res = KSI_Header_new(req->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(req->ctx, loginId, (unsigned)loginLen + 1, &tmp->loginId);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Every request must have a header, and at this point, this is guaranteed. */
+	if (req->ctx->requestHeaderCB != NULL) {
+		res = req->ctx->requestHeaderCB(tmp);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_ExtendReq_encloseWithHeader(req, tmp, key, pdu);
+	if (res != KSI_OK) goto cleanup;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+	KSI_Header_free(tmp);
 
 	return res;
 }
@@ -1316,27 +1427,64 @@ cleanup:
 	return res;
 }
 
-int KSI_ExtendPdu_serialize(const KSI_ExtendPdu *t, unsigned char **raw, size_t *len) {
-	int res = KSI_UNKNOWN_ERROR;
-	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
+static int extendPdu_getTemplate(const KSI_ExtendPdu *t, unsigned *tag, const KSI_TlvTemplate **tmpl) {
 	if (t->ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
-		res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x300, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendPdu), raw, len);
+		*tag = 0x300;
+		*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendPdu);
 	} else if (t->ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
 		if (t->request != NULL || t->confRequest != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x320, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendReqPdu), raw, len);
+			*tag = 0x320;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendReqPdu);
 		} else if (t->response != NULL || t->confResponse != NULL || t->error != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x321, 0, 0, KSI_TLV_TEMPLATE(KSI_ExtendRespPdu), raw, len);
+			*tag = 0x321;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_ExtendRespPdu);
 		} else {
-			res = KSI_INVALID_FORMAT;
+			return KSI_INVALID_FORMAT;
 		}
 	} else {
-		res = KSI_INVALID_FORMAT;
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
+int KSI_ExtendPdu_serialize(const KSI_ExtendPdu *t, unsigned char **raw, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_TlvTemplate *tmpl = NULL;
+	unsigned tag = 0;
+
+	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = extendPdu_getTemplate(t, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_serializeObject(t->ctx, t, tag, 0, 0, tmpl, raw, len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+KSI_DEFINE_WRITE_BYTES(KSI_ExtendPdu) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_TlvTemplate *tmpl = NULL;
+	unsigned tag = 0;
+
+	if (o == NULL || o->ctx == NULL || (buf == NULL && buf_size != 0) || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
+	res = extendPdu_getTemplate(o, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_writeBytes(o->ctx, o, tag, 0, 0, tmpl, buf, buf_size, buf_len, opt);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -1731,27 +1879,64 @@ cleanup:
 	return res;
 }
 
-int KSI_AggregationPdu_serialize(const KSI_AggregationPdu *t, unsigned char **raw, size_t *len) {
-	int res = KSI_UNKNOWN_ERROR;
-	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
+static int aggregationPdu_getTemplate(const KSI_AggregationPdu *t, unsigned *tag, const KSI_TlvTemplate **tmpl) {
 	if (t->ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
-		res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x200, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationPdu), raw, len);
+		*tag = 0x200;
+		*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationPdu);
 	} else if (t->ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
 		if (t->request != NULL || t->confRequest != NULL || t->ackRequest != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x220, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationReqPdu), raw, len);
+			*tag = 0x220;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationReqPdu);
 		} else if (t->response != NULL || t->confResponse != NULL || t->ackResponse != NULL) {
-			res = KSI_TlvTemplate_serializeObject(t->ctx, t, 0x221, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), raw, len);
+			*tag = 0x221;
+			*tmpl = KSI_TLV_TEMPLATE(KSI_AggregationRespPdu);
 		} else {
-			res = KSI_INVALID_FORMAT;
+			return KSI_INVALID_FORMAT;
 		}
 	} else {
-		res = KSI_INVALID_FORMAT;
+		return KSI_INVALID_FORMAT;
+	}
+
+	return KSI_OK;
+}
+
+int KSI_AggregationPdu_serialize(const KSI_AggregationPdu *t, unsigned char **raw, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_TlvTemplate *tmpl = NULL;
+	unsigned tag = 0;
+
+	if (t == NULL || t->ctx == NULL || raw == NULL || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = aggregationPdu_getTemplate(t, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_serializeObject(t->ctx, t, tag, 0, 0, tmpl, raw, len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+KSI_DEFINE_WRITE_BYTES(KSI_AggregationPdu) {
+	int res = KSI_UNKNOWN_ERROR;
+	const KSI_TlvTemplate *tmpl = NULL;
+	unsigned tag = 0;
+
+	if (o == NULL || o->ctx == NULL || (buf == NULL && buf_size != 0) || buf_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
+	res = aggregationPdu_getTemplate(o, &tag, &tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_writeBytes(o->ctx, o, tag, 0, 0, tmpl, buf, buf_size, buf_len, opt);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -1817,6 +2002,7 @@ cleanup:
 }
 KSI_IMPLEMENT_FROMTLV(KSI_Header, 0x01, FROMTLV_ADD_RAW(raw, 0););
 KSI_IMPLEMENT_TOTLV(KSI_Header);
+KSI_IMPLEMENT_WRITE_TLV(KSI_Header);
 
 KSI_IMPLEMENT_GETTER(KSI_Header, KSI_Integer*, instanceId, InstanceId);
 KSI_IMPLEMENT_GETTER(KSI_Header, KSI_Integer*, messageId, MessageId);
@@ -2026,6 +2212,39 @@ cleanup:
 	return res;
 }
 
+int KSI_AggregationReq_writeTlv(KSI_CTX *ctx, const KSI_AggregationReq *data, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || data == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_AggregationReq), buf, buf_size, len, opt);
+	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
+		if (data->requestHash != NULL) {
+			res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_AggregationReq_v2), buf, buf_size, len, opt);
+		} else {
+			*len = 0;
+			res = KSI_FTLV_writeHeader(tag, isNonCritical, isForward, buf, buf_size, len, opt);
+		}
+	} else {
+		res = KSI_INVALID_FORMAT;
+	}
+
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 KSI_IMPLEMENT_GETTER(KSI_AggregationReq, KSI_Integer*, requestId, RequestId);
 KSI_IMPLEMENT_GETTER(KSI_AggregationReq, KSI_DataHash*, requestHash, RequestHash);
 KSI_IMPLEMENT_GETTER(KSI_AggregationReq, KSI_Integer*, requestLevel, RequestLevel);
@@ -2263,6 +2482,34 @@ cleanup:
 	return res;
 }
 
+int KSI_AggregationResp_writeTlv(KSI_CTX *ctx, const KSI_AggregationResp *data, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || data == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_1) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_AggregationResp), buf, buf_size, len, opt);
+	} else if (ctx->options[KSI_OPT_AGGR_PDU_VER] == KSI_PDU_VERSION_2) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_AggregationResp_v2), buf, buf_size, len, opt);
+	} else {
+		res = KSI_INVALID_FORMAT;
+	}
+
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 KSI_IMPLEMENT_GETTER(KSI_AggregationResp, KSI_Integer*, requestId, RequestId);
 KSI_IMPLEMENT_GETTER(KSI_AggregationResp, KSI_Integer*, status, Status);
 KSI_IMPLEMENT_GETTER(KSI_AggregationResp, KSI_Utf8String*, errorMsg, ErrorMsg);
@@ -2417,6 +2664,35 @@ cleanup:
 	return res;
 }
 
+int KSI_ExtendReq_writeTlv(KSI_CTX *ctx, const KSI_ExtendReq *data, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || data == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_ExtendReq), buf, buf_size, len, opt);
+	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, (data->config == NULL) ?
+				KSI_TLV_TEMPLATE(KSI_ExtendReq) : KSI_TLV_TEMPLATE(KSI_ConfigReq), buf, buf_size, len, opt);
+	} else {
+		res = KSI_INVALID_FORMAT;
+	}
+
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 KSI_IMPLEMENT_GETTER(KSI_ExtendReq, KSI_Integer*, requestId, RequestId);
 KSI_IMPLEMENT_GETTER(KSI_ExtendReq, KSI_Integer*, aggregationTime, AggregationTime);
 KSI_IMPLEMENT_GETTER(KSI_ExtendReq, KSI_Integer*, publicationTime, PublicationTime);
@@ -2639,6 +2915,34 @@ cleanup:
 	return res;
 }
 
+int KSI_ExtendResp_writeTlv(KSI_CTX *ctx, const KSI_ExtendResp *data, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || data == NULL || (buf == NULL && buf_size != 0) || len == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_1) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_ExtendResp), buf, buf_size, len, opt);
+	} else if (ctx->options[KSI_OPT_EXT_PDU_VER] == KSI_PDU_VERSION_2) {
+		res = KSI_TlvTemplate_writeBytes(ctx, data, tag, isNonCritical, isForward, KSI_TLV_TEMPLATE(KSI_ExtendResp_v2), buf, buf_size, len, opt);
+	} else {
+		res = KSI_INVALID_FORMAT;
+	}
+
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 KSI_IMPLEMENT_GETTER(KSI_ExtendResp, KSI_Integer*, requestId, RequestId);
 KSI_IMPLEMENT_GETTER(KSI_ExtendResp, KSI_Integer*, status, Status);
 KSI_IMPLEMENT_GETTER(KSI_ExtendResp, KSI_Utf8String*, errorMsg, ErrorMsg);
@@ -511,6 +511,7 @@ int KSI_MetaDataElement_setMachineId(KSI_MetaDataElement *t, KSI_Utf8String *mac
 int KSI_MetaDataElement_setSequenceNr(KSI_MetaDataElement *t, KSI_Integer *sequenceNr);
 int KSI_MetaDataElement_setRequestTimeInMicros(KSI_MetaDataElement *t, KSI_Integer *reqTime);
 int KSI_MetaDataElement_toTlv(KSI_CTX *ctx, const KSI_MetaDataElement *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_MetaDataElement);
 int KSI_MetaDataElement_fromTlv(KSI_TLV *tlv, KSI_MetaDataElement **metaData);
 KSI_DEFINE_REF(KSI_MetaDataElement);
 
@@ -571,6 +572,7 @@ KSI_DEFINE_REF(KSI_MetaData);
  */
 void KSI_ExtendPdu_free(KSI_ExtendPdu *t);
 int KSI_ExtendPdu_new(KSI_CTX *ctx, KSI_ExtendPdu **t);
+int KSI_ExtendPdu_verify(const KSI_ExtendPdu *pdu, const char *pass);
 int KSI_ExtendPdu_verifyHmac(const KSI_ExtendPdu *pdu, const char *pass);
 int KSI_ExtendPdu_calculateHmac(const KSI_ExtendPdu *t, KSI_HashAlgorithm algo_id, const char *key, KSI_DataHash **hmac);
 int KSI_ExtendPdu_updateHmac(KSI_ExtendPdu *pdu, KSI_HashAlgorithm algo_id, const char *key);
@@ -588,10 +590,12 @@ int KSI_ExtendPdu_setConfRequest(KSI_ExtendPdu *t, KSI_Config *confRequest);
 int KSI_ExtendPdu_setConfResponse(KSI_ExtendPdu *t, KSI_Config *confResponse);
 int KSI_ExtendPdu_setHmac(KSI_ExtendPdu *t, KSI_DataHash *hamc);
 int KSI_ExtendPdu_setError( KSI_ExtendPdu *t, KSI_ErrorPdu *error);
+int KSI_ExtendReq_encloseWithHeader(KSI_ExtendReq *req, KSI_Header *hdr, const char *key, KSI_ExtendPdu **pdu);
 int KSI_ExtendReq_enclose(KSI_ExtendReq *req, const char *loginId, const char *key, KSI_ExtendPdu **pdu);
 
 KSI_DEFINE_OBJECT_PARSE(KSI_ExtendPdu);
 KSI_DEFINE_OBJECT_SERIALIZE(KSI_ExtendPdu);
+KSI_DEFINE_WRITE_BYTES(KSI_ExtendPdu);
 
 /*
  * KSI_ErrorPdu
@@ -635,6 +639,7 @@ int KSI_AggregationReq_encloseWithHeader(KSI_AggregationReq *req, KSI_Header *hd
 int KSI_AggregationReq_enclose(KSI_AggregationReq *req, const char *loginId, const char *key, KSI_AggregationPdu **pdu);
 KSI_DEFINE_OBJECT_PARSE(KSI_AggregationPdu);
 KSI_DEFINE_OBJECT_SERIALIZE(KSI_AggregationPdu);
+KSI_DEFINE_WRITE_BYTES(KSI_AggregationPdu);
 
 /*
  * KSI_Header
@@ -651,6 +656,7 @@ KSI_DEFINE_GET_CTX(KSI_Header);
 
 int KSI_Header_fromTlv(KSI_TLV *tlv, KSI_Header **data);
 int KSI_Header_toTlv (KSI_CTX *ctx, const KSI_Header *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_Header);
 /*
  * KSI_Config
  */
@@ -699,6 +705,7 @@ int KSI_AggregationReq_setRequestLevel(KSI_AggregationReq *t, KSI_Integer *reque
 int KSI_AggregationReq_setConfig(KSI_AggregationReq *t, KSI_Config *config);
 int KSI_AggregationReq_fromTlv (KSI_TLV *tlv, KSI_AggregationReq **data);
 int KSI_AggregationReq_toTlv (KSI_CTX *ctx, const KSI_AggregationReq *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_AggregationReq);
 
 KSI_DEFINE_REF(KSI_AggregationReq);
 
@@ -761,6 +768,7 @@ int KSI_AggregationResp_setBaseTlv (KSI_AggregationResp *o, KSI_TLV *baseTlv);
 
 int KSI_AggregationResp_fromTlv (KSI_TLV *tlv, KSI_AggregationResp **data);
 int KSI_AggregationResp_toTlv (KSI_CTX *ctx, const KSI_AggregationResp *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_AggregationResp);
 
 KSI_DEFINE_GET_CTX(KSI_AggregationResp);
 
@@ -787,6 +795,7 @@ int KSI_ExtendReq_setPublicationTime(KSI_ExtendReq *t, KSI_Integer *publicationT
 int KSI_ExtendReq_setConfig(KSI_ExtendReq *t, KSI_Config *config);
 int KSI_ExtendReq_fromTlv (KSI_TLV *tlv, KSI_ExtendReq **data);
 int KSI_ExtendReq_toTlv (KSI_CTX *ctx, const KSI_ExtendReq *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_ExtendReq);
 
 KSI_DEFINE_REF(KSI_ExtendReq);
 
@@ -809,6 +818,7 @@ int KSI_ExtendResp_setConfig(KSI_ExtendResp *t, KSI_Config *config);
 int KSI_ExtendResp_setCalendarHashChain(KSI_ExtendResp *t, KSI_CalendarHashChain *calendarHashChain);
 int KSI_ExtendResp_fromTlv (KSI_TLV *tlv, KSI_ExtendResp **data);
 int KSI_ExtendResp_toTlv (KSI_CTX *ctx, const KSI_ExtendResp *data, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
+KSI_DEFINE_FN_WRITE_TLV(KSI_ExtendResp);
 
 /**
  * Verifies that the response is a correct response to the concrete request.
@@ -22,12 +22,15 @@
 
 #include "internal.h"
 #include "tlv.h"
+#include "fast_tlv.h"
 
 struct KSI_OctetString_st {
 	KSI_CTX *ctx;
 	size_t ref;
 	unsigned char *data;
 	size_t data_len;
+	/* Flag indicating the data is not owned by the object (see #KSI_TLV_parseBlobView). */
+	int isView;
 };
 
 struct KSI_Integer_st {
@@ -92,7 +95,7 @@ KSI_IMPLEMENT_LIST(KSI_OctetString, KSI_OctetString_free);
  */
 void KSI_OctetString_free(KSI_OctetString *o) {
 	if (o != NULL && --o->ref == 0) {
-		KSI_free(o->data);
+		if (!o->isView) KSI_free(o->data);
 		KSI_free(o);
 	}
 }
@@ -117,6 +120,7 @@ int KSI_OctetString_new(KSI_CTX *ctx, const unsigned char *data, size_t data_len
 	tmp->data = NULL;
 	tmp->data_len = data_len;
 	tmp->ref = 1;
+	tmp->isView = 0;
 
 	if (data_len > 0) {
 		tmp->data = KSI_malloc(data_len);
@@ -163,6 +167,90 @@ int KSI_OctetString_equals(const KSI_OctetString *left, const KSI_OctetString *r
 			((left == right) || (left->data_len == right->data_len && !memcmp(left->data, right->data, left->data_len)));
 }
 
+static int KSI_OctetString_newView(KSI_CTX *ctx, const unsigned char *data, size_t data_len, KSI_OctetString **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_OctetString *tmp = NULL;
+
+	tmp = KSI_new(KSI_OctetString);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->data = (unsigned char *)data;
+	tmp->data_len = data_len;
+	tmp->ref = 1;
+	tmp->isView = 1;
+
+	*o = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_OctetString_free(tmp);
+
+	return res;
+}
+
+int KSI_OctetString_parseValue(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, int opt, KSI_OctetString **o) {
+	return KSI_OctetString_new(ctx, raw, raw_len, o);
+}
+
+/**
+ * Writes the raw value as a TLV into the target buffer (see #KSI_FTLV_writeHeader).
+ */
+static int writeRawTlv(unsigned tag, int isNc, int isFwd, const void *raw, size_t raw_len, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t tmp_len = raw_len;
+
+	if ((raw == NULL && raw_len != 0) || (buf == NULL && buf_size != 0) || len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (buf != NULL) {
+		if (buf_size < raw_len) {
+			res = KSI_BUFFER_OVERFLOW;
+			goto cleanup;
+		}
+		if (raw_len > 0) memcpy(buf + buf_size - raw_len, raw, raw_len);
+	}
+
+	res = KSI_FTLV_writeHeader(tag, isNc, isFwd, buf, buf_size, &tmp_len, opt);
+	if (res != KSI_OK) goto cleanup;
+
+	*len = tmp_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_OctetString_writeTlv(KSI_CTX *ctx, const KSI_OctetString *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || o == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = writeRawTlv(tag, isNonCritical, isForward, o->data, o->data_len, buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 int KSI_OctetString_fromTlv(KSI_TLV *tlv, KSI_OctetString **o) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ctx = NULL;
@@ -183,7 +271,12 @@ int KSI_OctetString_fromTlv(KSI_TLV *tlv, KSI_OctetString **o) {
 		goto cleanup;
 	}
 
-	res = KSI_OctetString_new(ctx, raw, raw_len, &tmp);
+	/* Avoid copying the value, if the caller guarantees the lifetime of the memory. */
+	if (KSI_TLV_isView(tlv)) {
+		res = KSI_OctetString_newView(ctx, raw, raw_len, &tmp);
+	} else {
+		res = KSI_OctetString_new(ctx, raw, raw_len, &tmp);
+	}
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -421,6 +514,35 @@ const char *KSI_Utf8String_cstr(const KSI_Utf8String *o) {
 	return o == NULL ? NULL : o->value;
 }
 
+int KSI_Utf8String_parseValue(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, int opt, KSI_Utf8String **o) {
+	return KSI_Utf8String_new(ctx, (const char *)raw, raw_len, o);
+}
+
+int KSI_Utf8String_writeTlv(KSI_CTX *ctx, const KSI_Utf8String *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || o == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (o->len > 0xffff){
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "UTF8 string too long for TLV conversion.");
+		goto cleanup;
+	}
+
+	res = writeRawTlv(tag, isNonCritical, isForward, o->value, o->len, buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 int KSI_Utf8String_fromTlv(KSI_TLV *tlv, KSI_Utf8String **o) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ctx = NULL;
@@ -570,6 +692,31 @@ cleanup:
 	return res;
 }
 
+int KSI_Utf8StringNZ_writeTlv(KSI_CTX *ctx, const KSI_Utf8String *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || o == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (o->len == 0 || (o->len == 1 && o->value[0] == 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Empty string value not allowed.");
+		goto cleanup;
+	}
+
+	res = KSI_Utf8String_writeTlv(ctx, o, tag, isNonCritical, isForward, buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 void KSI_Integer_free(KSI_Integer *o) {
 	if (o != NULL && o->value >= integerPoolSize && --o->ref == 0) {
 		KSI_free(o);
@@ -652,41 +799,31 @@ cleanup:
 	return res;
 }
 
-int KSI_Integer_fromTlv(KSI_TLV *tlv, KSI_Integer **o) {
+int KSI_Integer_parseValue(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, int opt, KSI_Integer **o) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_CTX *ctx = NULL;
 	KSI_Integer *tmp = NULL;
-	const unsigned char *raw = NULL;
-	size_t len;
 	size_t i;
 	KSI_uint64_t val = 0;
 
-	ctx = KSI_TLV_getCtx(tlv);
 	KSI_ERR_clearErrors(ctx);
-	if (tlv == NULL || o == NULL) {
+	if (ctx == NULL || (raw == NULL && raw_len != 0) || o == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	res = KSI_TLV_getRawValue(tlv, &raw, &len);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
-
-	if (len > 8) {
+	if (raw_len > 8) {
 		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Integer larger than 64bit.");
 		goto cleanup;
 	}
 
 	/* Encode the up-to 64bit unsigned integer. */
-	for (i = 0; i < len; i++) {
+	for (i = 0; i < raw_len; i++) {
 		val = val << 8 | raw[i];
 	}
 
 	/* Make sure the integer was coded properly. */
-	if (len > 0 && len != KSI_UINT64_MINSIZE(val)) {
-		KSI_LOG_debug(ctx, "Integer not properly formated: %llu (len=%d).", (unsigned long long)val, (unsigned)len);
+	if (raw_len > 0 && raw_len != KSI_UINT64_MINSIZE(val)) {
+		KSI_LOG_debug(ctx, "Integer not properly formated: %llu (len=%d).", (unsigned long long)val, (unsigned)raw_len);
 		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Integer not properly formated.");
 		goto cleanup;
 	}
@@ -702,6 +839,44 @@ int KSI_Integer_fromTlv(KSI_TLV *tlv, KSI_Integer **o) {
 
 	res = KSI_OK;
 
+cleanup:
+
+	KSI_Integer_free(tmp);
+
+	return res;
+}
+
+int KSI_Integer_fromTlv(KSI_TLV *tlv, KSI_Integer **o) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	KSI_Integer *tmp = NULL;
+	const unsigned char *raw = NULL;
+	size_t len;
+
+	ctx = KSI_TLV_getCtx(tlv);
+	KSI_ERR_clearErrors(ctx);
+	if (tlv == NULL || o == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_getRawValue(tlv, &raw, &len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Integer_parseValue(ctx, raw, len, 0, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*o = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
 cleanup:
 
 	KSI_nofree(ctx);
@@ -710,6 +885,37 @@ cleanup:
 	return res;
 }
 
+int KSI_Integer_writeTlv(KSI_CTX *ctx, const KSI_Integer *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char raw[8];
+	unsigned raw_len = 0;
+	KSI_uint64_t val;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || o == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	val = o->value;
+
+	/* Encode the integer value - zero is encoded as an empty value. */
+	while (val != 0) {
+		raw[7 - raw_len++] = val & 0xff;
+		val >>= 8;
+	}
+
+	res = writeRawTlv(tag, isNonCritical, isForward, raw + 8 - raw_len, raw_len, buf, buf_size, len, opt);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
 int KSI_Integer_toTlv(KSI_CTX *ctx, const KSI_Integer *o, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_TLV *tmp = NULL;
@@ -38,6 +38,37 @@ extern "C" {
 */ \
 int typ##_fromTlv(KSI_TLV *tlv, typ **o);
 
+#define KSI_DEFINE_FN_PARSE_VALUE(typ) \
+/*!
+	Function to create a \ref typ from the raw value of a TLV (i.e. without the header). Used
+	by the streaming template decoder, which does not create intermediate #KSI_TLV objects.
+	\param[in]	ctx		KSI context.
+	\param[in]	raw		Pointer to the raw value.
+	\param[in]	raw_len	Length of the raw value.
+	\param[in]	opt		Parser option (ignored).
+	\param[out]	o		Pointer to receiving pointer.
+	\return status code (\c KSI_OK, when operation succeeded, otherwise an error code).
+	\see \ref typ##_fromTlv
+*/ \
+int typ##_parseValue(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, int opt, typ **o);
+
+#define KSI_DEFINE_FN_WRITE_TLV(typ) \
+/*!
+	Function to write a \ref typ as a TLV directly into a buffer, without creating a #KSI_TLV object.
+	\param[in]	ctx				KSI context.
+	\param[in]	o				Pointer to \ref typ
+	\param[in]	tag				Tag of the TLV.
+	\param[in]	isNonCritical	TLV non-critical-flag.
+	\param[in]	isForward		TLV forward-flag.
+	\param[in]	buf				Pointer to the target buffer, or \c NULL to only calculate the length.
+	\param[in]	buf_size		Size of the target buffer.
+	\param[out]	len				Length of the serialized TLV.
+	\param[in]	opt				Options (see #KSI_Serialize_Opt_en).
+	\return status code (\c KSI_OK, when operation succeeded, otherwise an error code).
+	\see \ref typ##_toTlv
+*/ \
+int typ##_writeTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt);
+
 #define KSI_DEFINE_FN_TO_TLV(typ) \
 /*!
 	Function to convert a \ref typ to a plain #KSI_TLV object.
@@ -223,6 +254,8 @@ int typ##_toTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int
 
 	KSI_DEFINE_REF(KSI_Integer);
 	KSI_DEFINE_FN_FROM_TLV(KSI_Integer);
+	KSI_DEFINE_FN_PARSE_VALUE(KSI_Integer);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_Integer);
 	KSI_DEFINE_FN_TO_TLV(KSI_Integer);
 
 	/**
@@ -251,6 +284,8 @@ int typ##_toTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int
 
 	KSI_DEFINE_REF(KSI_OctetString);
 	KSI_DEFINE_FN_FROM_TLV(KSI_OctetString);
+	KSI_DEFINE_FN_PARSE_VALUE(KSI_OctetString);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_OctetString);
 	KSI_DEFINE_FN_TO_TLV(KSI_OctetString);
 
 	char* KSI_OctetString_toString(const KSI_OctetString *id, char separator, char *buf, size_t buf_len);
@@ -294,6 +329,8 @@ int typ##_toTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int
 
 	KSI_DEFINE_REF(KSI_Utf8String);
 	KSI_DEFINE_FN_FROM_TLV(KSI_Utf8String);
+	KSI_DEFINE_FN_PARSE_VALUE(KSI_Utf8String);
+	KSI_DEFINE_FN_WRITE_TLV(KSI_Utf8String);
 	KSI_DEFINE_FN_TO_TLV(KSI_Utf8String);
 
 	/**
@@ -318,6 +355,22 @@ int typ##_toTlv(KSI_CTX *ctx, const typ *o, unsigned tag, int isNonCritical, int
 	 */
 	int KSI_Utf8StringNZ_toTlv(KSI_CTX *ctx, const KSI_Utf8String *o, unsigned tag, int isNonCritical, int isForward, KSI_TLV **tlv);
 
+	/**
+	 * Functions as #KSI_Utf8String_writeTlv, but adds constraint to the content not
+	 * being empty.
+	 * \param[in]	ctx					KSI context.
+	 * \param[in]	o					String to be encoded as TLV.
+	 * \param[in]	tag					Tag of the TLV.
+	 * \param[in]	isNonCritical		Is-non-critical flag.
+	 * \param[in]	isForward			Is-forward flag.
+	 * \param[in]	buf					Pointer to the target buffer, or \c NULL to only calculate the length.
+	 * \param[in]	buf_size			Size of the target buffer.
+	 * \param[out]	len					Length of the serialized TLV.
+	 * \param[in]	opt					Options (see #KSI_Serialize_Opt_en).
+	 * \return status code (\c KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Utf8StringNZ_writeTlv(KSI_CTX *ctx, const KSI_Utf8String *o, unsigned tag, int isNonCritical, int isForward, unsigned char *buf, size_t buf_size, size_t *len, int opt);
+
 
 	/*
 	 * Helper functions
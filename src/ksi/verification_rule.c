@@ -17,6 +17,8 @@
  * reserves and retains all trademark rights.
  */
 
+#include <string.h>
+
 #include "hashchain.h"
 #include "net.h"
 #include "pkitruststore.h"
@@ -2650,56 +2652,17 @@ cleanup:
 	return res;
 }
 
-static int initExtendedCalendarHashChain(KSI_VerificationContext *info, KSI_Integer *endTime) {
+/* Requests the calendar hash chain from the extender. */
+static int extendCalendarHashChain(KSI_CTX *ctx, KSI_Integer *startTime, KSI_Integer *endTime, KSI_CalendarHashChain **chain) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_CTX *ctx = NULL;
-	const KSI_Signature *sig = NULL;
-	KSI_Integer *startTime = NULL;
 	KSI_ExtendReq *req = NULL;
 	KSI_RequestHandle *handle = NULL;
 	KSI_ExtendResp *resp = NULL;
 	KSI_Integer *status = NULL;
 	KSI_CalendarHashChain *tmp = NULL;
-	KSI_AggregationHashChain *aggr = NULL;
-	VerificationTempData *tempData = NULL;
 	KSI_Integer *respReqId = NULL;
 	KSI_Integer *reqReqId = NULL;
 
-	if (info == NULL || info->ctx == NULL || info->signature == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-
-
-	ctx = info->ctx;
-	sig = info->signature;
-	KSI_ERR_clearErrors(ctx);
-
-	tempData = info->tempData;
-	if (tempData == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_STATE, "Verification context not properly initialized.");
-		goto cleanup;
-	}
-
-	/* Extract start time. */
-	if (sig->calendarChain != NULL) {
-		res = KSI_CalendarHashChain_getAggregationTime(sig->calendarChain, &startTime);
-		if (res != KSI_OK) {
-			KSI_pushError(ctx,res, NULL);
-			goto cleanup;
-		}
-	} else {
-		/* Take the first aggregation hash chain, as all of the chain should have the same value for "aggregation time". */
-		res = (KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &aggr));
-		if (res != KSI_OK) goto cleanup;
-
-		res = KSI_AggregationHashChain_getAggregationTime(aggr, &startTime);
-		if (res != KSI_OK) {
-			KSI_pushError(ctx,res, NULL);
-			goto cleanup;
-		}
-	}
-
 	/* Clone the start time object. */
 	KSI_Integer_ref(startTime);
 
@@ -2767,10 +2730,7 @@ static int initExtendedCalendarHashChain(KSI_VerificationContext *info, KSI_Inte
 		goto cleanup;
 	}
 
-	if (tempData->calendarChain != NULL) {
-		KSI_CalendarHashChain_free(tempData->calendarChain);
-	}
-	tempData->calendarChain = tmp;
+	*chain = tmp;
 	tmp = NULL;
 
 	res = KSI_OK;
@@ -2785,6 +2745,86 @@ cleanup:
 	return res;
 }
 
+static int initExtendedCalendarHashChain(KSI_VerificationContext *info, KSI_Integer *endTime) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	const KSI_Signature *sig = NULL;
+	KSI_Integer *startTime = NULL;
+	KSI_CalendarHashChain *tmp = NULL;
+	KSI_AggregationHashChain *aggr = NULL;
+	VerificationTempData *tempData = NULL;
+
+	if (info == NULL || info->ctx == NULL || info->signature == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+
+	ctx = info->ctx;
+	sig = info->signature;
+	KSI_ERR_clearErrors(ctx);
+
+	tempData = info->tempData;
+	if (tempData == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_STATE, "Verification context not properly initialized.");
+		goto cleanup;
+	}
+
+	/* Extract start time. */
+	if (sig->calendarChain != NULL) {
+		res = KSI_CalendarHashChain_getAggregationTime(sig->calendarChain, &startTime);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx,res, NULL);
+			goto cleanup;
+		}
+	} else {
+		/* Take the first aggregation hash chain, as all of the chain should have the same value for "aggregation time". */
+		res = (KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &aggr));
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationHashChain_getAggregationTime(aggr, &startTime);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx,res, NULL);
+			goto cleanup;
+		}
+	}
+
+	/* The extension to a publication does not change over time, thus it can be shared between the signatures. */
+	if (endTime != NULL) {
+		res = KSI_CalendarChainCache_get(ctx, KSI_Integer_getUInt64(startTime), KSI_Integer_getUInt64(endTime), &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (tmp == NULL) {
+		res = extendCalendarHashChain(ctx, startTime, endTime, &tmp);
+		if (res != KSI_OK) goto cleanup;
+
+		if (endTime != NULL) {
+			res = KSI_CalendarChainCache_add(ctx, KSI_Integer_getUInt64(startTime), KSI_Integer_getUInt64(endTime), tmp);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+	}
+
+	if (tempData->calendarChain != NULL) {
+		KSI_CalendarHashChain_free(tempData->calendarChain);
+	}
+	tempData->calendarChain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+	KSI_CalendarHashChain_free(tmp);
+
+	return res;
+}
+
 static int getExtendedCalendarHashChain(KSI_VerificationContext *info, KSI_Integer *pubTime, KSI_CalendarHashChain **chain) {
 	int res = KSI_UNKNOWN_ERROR;
 	VerificationTempData *tempData = NULL;
@@ -3167,6 +3207,9 @@ static int initPublicationsFile(KSI_VerificationContext *info) {
 
 	if (info->userPublicationsFile != NULL) {
 		tmp = KSI_PublicationsFile_ref(info->userPublicationsFile);
+	} else if (tempData->batch != NULL && tempData->batch->publicationsFile != NULL) {
+		/* Already verified for a previous signature of the batch. */
+		tmp = KSI_PublicationsFile_ref(tempData->batch->publicationsFile);
 	} else {
 		res = KSI_receivePublicationsFile(info->ctx, &tmp);
 		if (res != KSI_OK) goto cleanup;
@@ -3175,6 +3218,10 @@ static int initPublicationsFile(KSI_VerificationContext *info) {
 
 		res = KSI_verifyPublicationsFile(info->ctx, tmp);
 		if (res != KSI_OK) goto cleanup;
+
+		if (tempData->batch != NULL) {
+			tempData->batch->publicationsFile = KSI_PublicationsFile_ref(tmp);
+		}
 	}
 
 	KSI_PublicationsFile_free(tempData->publicationsFile);
@@ -3404,6 +3451,217 @@ cleanup:
 	return res;
 }
 
+typedef struct PKISignatureCacheEntry_st {
+	/* Fingerprint of the key. */
+	KSI_uint64_t hash;
+	/* Signature algorithm, signed data, signature value and certificate. */
+	unsigned char *key;
+	size_t key_len;
+} PKISignatureCacheEntry;
+
+struct KSI_PKISignatureCache_st {
+	/* Direct mapped slots, a new signature replaces the one with the same slot. */
+	PKISignatureCacheEntry *slots;
+	size_t size;
+	size_t mask;
+	size_t hits;
+	size_t misses;
+};
+
+void KSI_PKISignatureCache_free(KSI_PKISignatureCache *cache) {
+	if (cache != NULL) {
+		size_t i;
+
+		for (i = 0; i <= cache->mask; i++) {
+			KSI_free(cache->slots[i].key);
+		}
+		KSI_free(cache->slots);
+		KSI_free(cache);
+	}
+}
+
+/* Returns the context cache, (re)creating it if the configured size has changed. */
+static int pkiSignatureCache_prepare(KSI_CTX *ctx, KSI_PKISignatureCache **cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PKISignatureCache *tmp = NULL;
+	size_t size = ctx->options[KSI_OPT_PKI_SIGNATURE_CACHE_SIZE];
+	size_t nofSlots = 1;
+
+	if (ctx->pkiSignatureCache != NULL && ctx->pkiSignatureCache->size != size) {
+		KSI_PKISignatureCache_free(ctx->pkiSignatureCache);
+		ctx->pkiSignatureCache = NULL;
+	}
+
+	if (ctx->pkiSignatureCache == NULL && size > 0) {
+		while (nofSlots < size) nofSlots <<= 1;
+
+		tmp = KSI_new(KSI_PKISignatureCache);
+		if (tmp == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		tmp->size = size;
+		tmp->mask = nofSlots - 1;
+		tmp->hits = 0;
+		tmp->misses = 0;
+		tmp->slots = KSI_calloc(nofSlots, sizeof(PKISignatureCacheEntry));
+		if (tmp->slots == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		ctx->pkiSignatureCache = tmp;
+		tmp = NULL;
+	}
+
+	*cache = ctx->pkiSignatureCache;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) {
+		KSI_free(tmp->slots);
+		KSI_free(tmp);
+	}
+
+	return res;
+}
+
+/**
+ * Serializes everything the outcome of the PKI signature verification depends on. The certificate
+ * is included as a whole, thus a cached result is never reused for a different certificate, even if
+ * it has the same id.
+ */
+static int pkiSignatureCache_makeKey(const char *algoOid, const unsigned char *data, size_t data_len,
+		const unsigned char *signature, size_t signature_len, const KSI_PKICertificate *cert,
+		unsigned char **key, size_t *key_len, KSI_uint64_t *hash) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *der = NULL;
+	size_t der_len = 0;
+	unsigned char *tmp = NULL;
+	size_t len = 0;
+	size_t algo_len = strlen(algoOid);
+	KSI_uint64_t h = 0xcbf29ce484222325ull;
+	size_t i;
+
+	res = KSI_PKICertificate_serialize(cert, &der, &der_len);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp = KSI_malloc(4 * sizeof(size_t) + algo_len + data_len + signature_len + der_len);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+#define PKI_SIGNATURE_CACHE_APPEND(ptr, ptr_len) \
+	memcpy(tmp + len, &(ptr_len), sizeof(size_t)); \
+	len += sizeof(size_t); \
+	memcpy(tmp + len, (ptr), (ptr_len)); \
+	len += (ptr_len)
+
+	PKI_SIGNATURE_CACHE_APPEND(algoOid, algo_len);
+	PKI_SIGNATURE_CACHE_APPEND(data, data_len);
+	PKI_SIGNATURE_CACHE_APPEND(signature, signature_len);
+	PKI_SIGNATURE_CACHE_APPEND(der, der_len);
+
+#undef PKI_SIGNATURE_CACHE_APPEND
+
+	/* FNV-1a. */
+	for (i = 0; i < len; i++) {
+		h ^= tmp[i];
+		h *= 0x100000001b3ull;
+	}
+
+	*key = tmp;
+	*key_len = len;
+	*hash = h;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(der);
+	KSI_free(tmp);
+
+	return res;
+}
+
+/* Verifies the PKI signature, unless the same signature has already been verified successfully. */
+static int verifyRawSignatureCached(KSI_CTX *ctx, const unsigned char *data, size_t data_len, const char *algoOid,
+		const unsigned char *signature, size_t signature_len, const KSI_PKICertificate *cert) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PKISignatureCache *cache = NULL;
+	PKISignatureCacheEntry *slot = NULL;
+	unsigned char *key = NULL;
+	size_t key_len = 0;
+	KSI_uint64_t key_hash = 0;
+
+	if (algoOid != NULL && data != NULL && signature != NULL && cert != NULL) {
+		res = pkiSignatureCache_prepare(ctx, &cache);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (cache != NULL) {
+		res = pkiSignatureCache_makeKey(algoOid, data, data_len, signature, signature_len, cert, &key, &key_len, &key_hash);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		slot = &cache->slots[key_hash & cache->mask];
+		if (slot->key != NULL && slot->hash == key_hash && slot->key_len == key_len && memcmp(slot->key, key, key_len) == 0) {
+			KSI_LOG_debug(ctx, "PKI signature found in the cache.");
+			cache->hits++;
+			res = KSI_OK;
+			goto cleanup;
+		}
+		cache->misses++;
+	}
+
+	res = KSI_PKITruststore_verifyRawSignature(ctx, data, data_len, algoOid, signature, signature_len, cert);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Only successful verifications are remembered. */
+	if (slot != NULL) {
+		KSI_free(slot->key);
+		slot->hash = key_hash;
+		slot->key = key;
+		slot->key_len = key_len;
+		key = NULL;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(key);
+
+	return res;
+}
+
+int KSI_CTX_getPKISignatureCacheStats(KSI_CTX *ctx, size_t *hits, size_t *misses) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL || (hits == NULL && misses == NULL)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (hits != NULL) *hits = ctx->pkiSignatureCache != NULL ? ctx->pkiSignatureCache->hits : 0;
+	if (misses != NULL) *misses = ctx->pkiSignatureCache != NULL ? ctx->pkiSignatureCache->misses : 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_VerificationRule_CalendarAuthenticationRecordSignatureVerification(KSI_VerificationContext *info, KSI_RuleVerificationResult *result) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ctx = NULL;
@@ -3520,8 +3778,8 @@ int KSI_VerificationRule_CalendarAuthenticationRecordSignatureVerification(KSI_V
 		goto cleanup;
 	}
 
-	res = KSI_PKITruststore_verifyRawSignature(ctx, rawData, rawData_len, KSI_Utf8String_cstr(sigtype),
-											   rawSignature, rawSignature_len, cert);
+	res = verifyRawSignatureCached(ctx, rawData, rawData_len, KSI_Utf8String_cstr(sigtype),
+								   rawSignature, rawSignature_len, cert);
 	if (res != KSI_OK) {
 		KSI_LOG_info(ctx, "Failed to verify raw signature.");
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ksi/ksi.h>
+
+/* Number of messages hashed with each method. */
+static size_t hashCount = 1000000;
+
+/* Messages per batch call. */
+#define BATCH_SIZE 256
+
+/* Size of a tree node join input: two SHA-256 imprints and the level byte. */
+#define MSG_LEN (2 * 33 + 1)
+
+static void printStats(const char *name, size_t count, clock_t start, clock_t end) {
+	double sec = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("Hashed %llu messages (%s) in %0.2f seconds. (one in %0.1f ns)\n", (unsigned long long)count, name, sec, sec * 1e9 / count);
+}
+
+int main(int argc, char **argv) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ksi = NULL;
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *hsh = NULL;
+	unsigned char *msgs = NULL;
+	const void *data[BATCH_SIZE];
+	size_t data_len[BATCH_SIZE];
+	unsigned char imprints[BATCH_SIZE * 33];
+	const unsigned char *imprint = NULL;
+	size_t imprint_len;
+	clock_t start;
+	clock_t end;
+	size_t count;
+	size_t i;
+
+	if (argc > 1) hashCount = (size_t)atol(argv[1]);
+	if (hashCount < BATCH_SIZE) {
+		fprintf(stderr, "Usage: %s [count >= %d]\n", argv[0], BATCH_SIZE);
+		goto cleanup;
+	}
+	hashCount -= hashCount % BATCH_SIZE;
+
+	res = KSI_CTX_new(&ksi);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to create KSI context.\n");
+		goto cleanup;
+	}
+
+	msgs = malloc(BATCH_SIZE * MSG_LEN);
+	if (msgs == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	for (i = 0; i < BATCH_SIZE * MSG_LEN; i++) {
+		msgs[i] = (unsigned char)(i * 31 + 7);
+	}
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		data[i] = msgs + i * MSG_LEN;
+		data_len[i] = MSG_LEN;
+	}
+
+	/* A new data hash object for every message. */
+	start = clock();
+	for (count = 0; count < hashCount; count++) {
+		res = KSI_DataHash_create(ksi, data[count % BATCH_SIZE], MSG_LEN, KSI_HASHALG_SHA2_256, &hsh);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+	end = clock();
+	printStats("KSI_DataHash_create", hashCount, start, end);
+
+	/* A single hasher, reset for every message. */
+	res = KSI_DataHasher_open(ksi, KSI_HASHALG_SHA2_256, &hsr);
+	if (res != KSI_OK) goto cleanup;
+
+	start = clock();
+	for (count = 0; count < hashCount; count++) {
+		res = KSI_DataHasher_reset(hsr);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_DataHasher_add(hsr, data[count % BATCH_SIZE], MSG_LEN);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_DataHasher_close(hsr, &hsh);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+	end = clock();
+	printStats("reused KSI_DataHasher", hashCount, start, end);
+
+	/* Batches of independent messages. */
+	start = clock();
+	for (count = 0; count < hashCount; count += BATCH_SIZE) {
+		res = KSI_DataHash_createBatch(ksi, KSI_HASHALG_SHA2_256, data, data_len, BATCH_SIZE, imprints, sizeof(imprints));
+		if (res != KSI_OK) goto cleanup;
+	}
+	end = clock();
+	printStats("KSI_DataHash_createBatch", hashCount, start, end);
+
+	/* Sanity check: the last message of the batch must match the hasher output. */
+	res = KSI_DataHash_create(ksi, data[BATCH_SIZE - 1], MSG_LEN, KSI_HASHALG_SHA2_256, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (imprint_len != 33 || memcmp(imprint, imprints + (BATCH_SIZE - 1) * 33, 33) != 0) {
+		fprintf(stderr, "Batch hash mismatch.\n");
+		res = KSI_UNKNOWN_ERROR;
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK && ksi != NULL) KSI_ERR_statusDump(ksi, stderr);
+
+	KSI_DataHash_free(hsh);
+	KSI_DataHasher_free(hsr);
+	free(msgs);
+	KSI_CTX_free(ksi);
+
+	return res;
+}
@@ -20,9 +20,11 @@
 #include <string.h>
 #include <ksi/ksi.h>
 #include <ksi/blocksigner.h>
+#include <ksi/net_async.h>
 
 #include "cutest/CuTest.h"
 #include "all_tests.h"
+#include "test_mock_async.h"
 
 #include "../src/ksi/impl/ctx_impl.h"
 #include "../src/ksi/impl/net_http_impl.h"
@@ -205,6 +207,115 @@ static void testMedaData(CuTest *tc) {
 #undef TEST_AGGR_RESPONSE_FILE
 }
 
+typedef struct {
+	unsigned char *raw[4];
+	size_t raw_len[4];
+	size_t calls;
+	int fail;
+} ExportState;
+
+static int exportWriter(void *userCtx, size_t index, const unsigned char *raw, size_t raw_len) {
+	ExportState *state = userCtx;
+
+	if (state->fail) return KSI_IO_ERROR;
+	if (index >= 4 || index != state->calls) return KSI_INVALID_STATE;
+
+	state->raw[index] = KSI_malloc(raw_len);
+	if (state->raw[index] == NULL) return KSI_OUT_OF_MEMORY;
+
+	memcpy(state->raw[index], raw, raw_len);
+	state->raw_len[index] = raw_len;
+	state->calls++;
+
+	return KSI_OK;
+}
+
+static void testExportSignatures(CuTest *tc) {
+#define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/test_meta_data_response.tlv"
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	KSI_MetaData *md = NULL;
+	char data[] = "LAPTOP";
+	char *clientId[] = { "Alice", "Bob", "Claire", NULL };
+	KSI_DataHash *hsh = NULL;
+	KSI_BlockSignerHandle *hndl[] = {NULL, NULL, NULL};
+	KSI_Signature *sig = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	ExportState state;
+	size_t i;
+
+	memset(&state, 0, sizeof(state));
+
+	res = KSI_DataHash_create(ctx, data, strlen(data), KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	for (i = 0; clientId[i] != NULL; i++) {
+		res = createMetaData(clientId[i], &md);
+		CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+		res = KSI_BlockSigner_addLeaf(bs, hsh, 0, md, &hndl[i]);
+		CuAssert(tc, "Unable to add leaf to the block signer.", res == KSI_OK && hndl[i] != NULL);
+
+		KSI_MetaData_free(md);
+		md = NULL;
+	}
+
+	res = KSI_BlockSignerHandle_exportSignatures(hndl, 3, exportWriter, &state);
+	CuAssert(tc, "Signatures of an unsigned block may not be exported.", res == KSI_INVALID_STATE && state.calls == 0);
+
+	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set aggregator file URI.", res == KSI_OK);
+
+	res = KSI_BlockSigner_closeAndSign(bs);
+	CuAssert(tc, "Unable to close the blocksigner.", res == KSI_OK);
+
+	res = KSI_BlockSignerHandle_exportSignatures(hndl, 3, exportWriter, &state);
+	CuAssert(tc, "Unable to export the signatures.", res == KSI_OK && state.calls == 3);
+
+	/* The exported signatures must be identical to the ones built one by one. */
+	for (i = 0; i < 3; i++) {
+		res = KSI_BlockSignerHandle_getSignature(hndl[i], &sig);
+		CuAssert(tc, "Unable to extract signature.", res == KSI_OK && sig != NULL);
+
+		res = KSI_Signature_serialize(sig, &raw, &raw_len);
+		CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw != NULL);
+
+		CuAssert(tc, "Exported signature mismatch.", raw_len == state.raw_len[i] && !memcmp(raw, state.raw[i], raw_len));
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+
+		res = KSI_Signature_parse(ctx, state.raw[i], state.raw_len[i], &sig);
+		CuAssert(tc, "Unable to parse the exported signature.", res == KSI_OK && sig != NULL);
+
+		res = KSI_verifySignature(ctx, sig);
+		CuAssert(tc, "Unable to verify the exported signature.", res == KSI_OK);
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+		KSI_free(raw);
+		raw = NULL;
+	}
+
+	/* Errors of the writer abort the export. */
+	state.fail = 1;
+	res = KSI_BlockSignerHandle_exportSignatures(hndl, 3, exportWriter, &state);
+	CuAssert(tc, "Writer error not returned.", res == KSI_IO_ERROR);
+
+	for (i = 0; i < 3; i++) {
+		KSI_free(state.raw[i]);
+		KSI_BlockSignerHandle_free(hndl[i]);
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_BlockSigner_free(bs);
+#undef TEST_AGGR_RESPONSE_FILE
+}
+
 static void testIdentityMedaData(CuTest *tc) {
 #define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/test_meta_data_response.tlv"
 	int res = KSI_UNKNOWN_ERROR;
@@ -387,6 +498,55 @@ static void testReset(CuTest *tc) {
 #undef TEST_AGGR_RESPONSE_FILE
 }
 
+static void testSpillFile(CuTest *tc) {
+#define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv"
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_BlockSignerHandle *h = NULL;
+	KSI_Signature *sig = NULL;
+
+	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set aggregator file URI.", res == KSI_OK);
+
+	res = KSITest_DataHash_fromStr(ctx, "0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	res = KSI_BlockSigner_setSpillFile(bs, "blocksigner_spill_test");
+	CuAssert(tc, "Unable to set the spill file prefix.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, NULL);
+	CuAssert(tc, "Unable to add mock hash to the blocksigner.", res == KSI_OK);
+
+	/* The next block must also be spilled. */
+	res = KSI_BlockSigner_reset(bs);
+	CuAssert(tc, "Unable to reset the block signer.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &h);
+	CuAssert(tc, "Unable to add actual hash to the blocksigner.", res == KSI_OK && h != NULL);
+
+	res = KSI_BlockSigner_setSpillFile(bs, "blocksigner_spill_test");
+	CuAssert(tc, "Spill file prefix may not be applied to a block with leaves.", res == KSI_INVALID_STATE);
+
+	res = KSI_BlockSigner_closeAndSign(bs);
+	CuAssert(tc, "Unable to close blocksigner.", res == KSI_OK);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Unable to extract signature from the blocksigner.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_verifyWithPolicy(sig, hsh, 0, KSI_VERIFICATION_POLICY_INTERNAL, NULL);
+	CuAssert(tc, "Signature of a spilled block does not verify.", res == KSI_OK);
+
+	KSI_BlockSignerHandle_free(h);
+	KSI_Signature_free(sig);
+	KSI_BlockSigner_free(bs);
+	KSI_DataHash_free(hsh);
+#undef TEST_AGGR_RESPONSE_FILE
+}
+
 static void testCreateBlockSigner(CuTest *tc) {
 	static const unsigned char diceRolls[] = {0xd5, 0x58, 0xaf, 0xfa, 0x80, 0x67, 0xf4, 0x2c, 0xd9, 0x48, 0x36, 0x21, 0xd1, 0xab,
 			0xae, 0x23, 0xed, 0xd6, 0xca, 0x04, 0x72, 0x7e, 0xcf, 0xc7, 0xdb, 0xc7, 0x6b, 0xde, 0x34, 0x77, 0x1e, 0x53};
@@ -462,6 +622,387 @@ static void testAddDeprecatedLeaf(CuTest *tc) {
 	KSI_DataHash_free(hsh);
 }
 
+static void testAddLeaves(CuTest *tc) {
+#define TEST_LEAVES 300
+	static const unsigned char ivBytes[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *serial = NULL;
+	KSI_BlockSigner *batch = NULL;
+	KSI_OctetString *iv = NULL;
+	KSI_DataHash *zero = NULL;
+	KSI_DataHash *hashes[TEST_LEAVES];
+	KSI_BlockSignerHandle *handles[TEST_LEAVES];
+	KSI_DataHash *serialPrev = NULL;
+	KSI_DataHash *batchPrev = NULL;
+	KSI_MetaData *md = NULL;
+	char buf[32];
+	size_t i;
+
+	res = KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &zero);
+	CuAssert(tc, "Unable to create zero hash.", res == KSI_OK && zero != NULL);
+
+	res = KSI_OctetString_new(ctx, ivBytes, sizeof(ivBytes), &iv);
+	CuAssert(tc, "Unable to create initial vector.", res == KSI_OK && iv != NULL);
+
+	res = createMetaData("Batch", &md);
+	CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, zero, iv, &serial);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && serial != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, zero, iv, &batch);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && batch != NULL);
+
+	res = KSI_BlockSigner_setWorkerCount(batch, 4);
+	CuAssert(tc, "Unable to set the worker count.", res == KSI_OK);
+
+	for (i = 0; i < TEST_LEAVES; i++) {
+		KSI_snprintf(buf, sizeof(buf), "leaf%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hashes[i]);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hashes[i] != NULL);
+
+		res = KSI_BlockSigner_addLeaf(serial, hashes[i], 0, md, NULL);
+		CuAssert(tc, "Unable to add leaf to the block signer.", res == KSI_OK);
+	}
+
+	/* Add a single leaf first, so the batch does not start with an empty tree. */
+	res = KSI_BlockSigner_addLeaves(batch, hashes, 1, 0, md, handles);
+	CuAssert(tc, "Unable to add a batch of leaves.", res == KSI_OK && handles[0] != NULL);
+
+	res = KSI_BlockSigner_addLeaves(batch, hashes + 1, TEST_LEAVES - 1, 0, md, handles + 1);
+	CuAssert(tc, "Unable to add a batch of leaves.", res == KSI_OK);
+
+	for (i = 0; i < TEST_LEAVES; i++) {
+		CuAssert(tc, "Missing leaf handle.", handles[i] != NULL);
+	}
+
+	/* The masking chains must match. */
+	res = KSI_BlockSigner_getPrevLeaf(serial, &serialPrev);
+	CuAssert(tc, "Unable to get the previous leaf.", res == KSI_OK && serialPrev != NULL);
+
+	res = KSI_BlockSigner_getPrevLeaf(batch, &batchPrev);
+	CuAssert(tc, "Unable to get the previous leaf.", res == KSI_OK && batchPrev != NULL);
+
+	CuAssert(tc, "Previous leaf mismatch.", KSI_DataHash_equals(serialPrev, batchPrev));
+
+	for (i = 0; i < TEST_LEAVES; i++) {
+		KSI_BlockSignerHandle_free(handles[i]);
+		KSI_DataHash_free(hashes[i]);
+	}
+
+	KSI_DataHash_free(serialPrev);
+	KSI_DataHash_free(batchPrev);
+	KSI_MetaData_free(md);
+	KSI_OctetString_free(iv);
+	KSI_DataHash_free(zero);
+	KSI_BlockSigner_free(serial);
+	KSI_BlockSigner_free(batch);
+#undef TEST_LEAVES
+}
+
+static void testCheckpoint(CuTest *tc) {
+#define TEST_AGGR_RESPONSE_FILE  "resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv"
+#define TEST_CHECKPOINT_FILE "blocksigner_checkpoint_test.ckp"
+	static const unsigned char ivBytes[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *orig = NULL;
+	KSI_BlockSigner *restored = NULL;
+	KSI_OctetString *iv = NULL;
+	KSI_DataHash *zero = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *origPrev = NULL;
+	KSI_DataHash *restoredPrev = NULL;
+	KSI_MetaData *md = NULL;
+	KSI_BlockSignerHandle *h = NULL;
+	KSI_Signature *sig = NULL;
+	FILE *f = NULL;
+	size_t count = 0;
+	char buf[32];
+	size_t i;
+
+	res = KSI_DataHash_createZero(ctx, KSI_HASHALG_SHA2_256, &zero);
+	CuAssert(tc, "Unable to create zero hash.", res == KSI_OK && zero != NULL);
+
+	res = KSI_OctetString_new(ctx, ivBytes, sizeof(ivBytes), &iv);
+	CuAssert(tc, "Unable to create initial vector.", res == KSI_OK && iv != NULL);
+
+	res = createMetaData("Checkpoint", &md);
+	CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, zero, iv, &orig);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && orig != NULL);
+
+	/* Continue the masking chain in the restored signer. */
+	for (i = 0; i < 11; i++) {
+		if (i == 5) {
+			res = KSI_BlockSigner_checkpoint(orig, TEST_CHECKPOINT_FILE, KSI_BLOCK_SIGNER_SYNC_FULL);
+			CuAssert(tc, "Unable to write the checkpoint.", res == KSI_OK);
+
+			res = KSI_BlockSigner_restore(ctx, TEST_CHECKPOINT_FILE, &restored);
+			CuAssert(tc, "Unable to restore the checkpoint.", res == KSI_OK && restored != NULL);
+
+			res = KSI_BlockSigner_getLeafCount(restored, &count);
+			CuAssert(tc, "Leaf count not restored.", res == KSI_OK && count == 5);
+		}
+
+		KSI_snprintf(buf, sizeof(buf), "leaf%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_BlockSigner_addLeaf(orig, hsh, 0, md, NULL);
+		CuAssert(tc, "Unable to add leaf to the block signer.", res == KSI_OK);
+
+		if (restored != NULL) {
+			res = KSI_BlockSigner_addLeaf(restored, hsh, 0, md, NULL);
+			CuAssert(tc, "Unable to add leaf to the restored block signer.", res == KSI_OK);
+		}
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	res = KSI_BlockSigner_getPrevLeaf(orig, &origPrev);
+	CuAssert(tc, "Unable to get the previous leaf.", res == KSI_OK && origPrev != NULL);
+
+	res = KSI_BlockSigner_getPrevLeaf(restored, &restoredPrev);
+	CuAssert(tc, "Unable to get the previous leaf.", res == KSI_OK && restoredPrev != NULL);
+
+	CuAssert(tc, "Previous leaf mismatch.", KSI_DataHash_equals(origPrev, restoredPrev));
+
+	res = KSI_BlockSigner_getLeafCount(restored, &count);
+	CuAssert(tc, "Unexpected leaf count.", res == KSI_OK && count == 11);
+
+	/* The temporary file is renamed over the checkpoint. */
+	f = fopen(TEST_CHECKPOINT_FILE ".tmp", "rb");
+	CuAssert(tc, "Temporary checkpoint file not removed.", f == NULL);
+
+	KSI_BlockSigner_free(orig);
+	orig = NULL;
+	KSI_BlockSigner_free(restored);
+	restored = NULL;
+
+	/* A block restored from a checkpoint can be signed. */
+	res = KSI_CTX_setAggregator(ctx, getFullResourcePathUri(TEST_AGGR_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set aggregator file URI.", res == KSI_OK);
+
+	res = KSITest_DataHash_fromStr(ctx, "0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, &orig);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && orig != NULL);
+
+	res = KSI_BlockSigner_checkpoint(orig, TEST_CHECKPOINT_FILE, KSI_BLOCK_SIGNER_SYNC_NONE);
+	CuAssert(tc, "Unable to replace the checkpoint.", res == KSI_OK);
+
+	res = KSI_BlockSigner_restore(ctx, TEST_CHECKPOINT_FILE, &restored);
+	CuAssert(tc, "Unable to restore the checkpoint.", res == KSI_OK && restored != NULL);
+
+	res = KSI_BlockSigner_addLeaf(restored, hsh, 0, NULL, &h);
+	CuAssert(tc, "Unable to add hash to the blocksigner.", res == KSI_OK && h != NULL);
+
+	res = KSI_BlockSigner_closeAndSign(restored);
+	CuAssert(tc, "Unable to close blocksigner.", res == KSI_OK);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Unable to extract signature from the blocksigner.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_verifyWithPolicy(sig, hsh, 0, KSI_VERIFICATION_POLICY_INTERNAL, NULL);
+	CuAssert(tc, "Signature of a restored block does not verify.", res == KSI_OK);
+
+	remove(TEST_CHECKPOINT_FILE);
+
+	res = KSI_BlockSigner_restore(ctx, TEST_CHECKPOINT_FILE, &orig);
+	CuAssert(tc, "Missing checkpoint may not be restored.", res == KSI_IO_ERROR);
+
+	KSI_BlockSignerHandle_free(h);
+	KSI_Signature_free(sig);
+	KSI_DataHash_free(origPrev);
+	KSI_DataHash_free(restoredPrev);
+	KSI_DataHash_free(hsh);
+	KSI_MetaData_free(md);
+	KSI_OctetString_free(iv);
+	KSI_DataHash_free(zero);
+	KSI_BlockSigner_free(orig);
+	KSI_BlockSigner_free(restored);
+#undef TEST_CHECKPOINT_FILE
+#undef TEST_AGGR_RESPONSE_FILE
+}
+
+typedef struct {
+	size_t calls;
+	size_t blockId;
+	int status;
+} AsyncCallbackState;
+
+static int asyncCallback(KSI_BlockSigner *signer, size_t blockId, int status, void *userCtx) {
+	AsyncCallbackState *state = userCtx;
+
+	if (signer == NULL || state == NULL) return KSI_INVALID_ARGUMENT;
+
+	state->calls++;
+	state->blockId = blockId;
+	state->status = status;
+
+	return KSI_OK;
+}
+
+static void testCloseAndSignAsync(CuTest *tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
+	};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	KSI_AsyncService *as = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *docHsh = NULL;
+	KSI_BlockSignerHandle *h = NULL;
+	KSI_BlockSignerHandle *next = NULL;
+	KSI_Signature *sig = NULL;
+	AsyncCallbackState state = {0, 0, KSI_UNKNOWN_ERROR};
+	size_t blockId = 1;
+	size_t pending = 1;
+	size_t i;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 1, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSITest_DataHash_fromStr(ctx, "0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	res = KSI_BlockSigner_setAsyncCallback(bs, asyncCallback, &state);
+	CuAssert(tc, "Unable to set the callback.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &h);
+	CuAssert(tc, "Unable to add leaf to the block signer.", res == KSI_OK && h != NULL);
+
+	res = KSI_BlockSigner_closeAndSignAsync(bs, as, &blockId);
+	CuAssert(tc, "Unable to submit the block.", res == KSI_OK && blockId == 0);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Signature must not be available before the response.", res == KSI_ASYNC_NOT_FINISHED && sig == NULL);
+
+	/* The signer must accept the leaves of the next block while the previous one is being signed. */
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &next);
+	CuAssert(tc, "Unable to add leaf to the next block.", res == KSI_OK && next != NULL);
+
+	for (i = 0; i < 10 && pending > 0; i++) {
+		res = KSI_BlockSigner_runAsync(bs, as, &pending);
+		CuAssert(tc, "Unable to run the async block signer.", res == KSI_OK);
+	}
+	CuAssert(tc, "Block is still pending.", pending == 0);
+	CuAssert(tc, "Callback not called for the block.", state.calls == 1 && state.blockId == 0 && state.status == KSI_OK);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Unable to extract signature from the blocksigner.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_getDocumentHash(sig, &docHsh);
+	CuAssert(tc, "Document hash mismatch.", res == KSI_OK && KSI_DataHash_equals(docHsh, hsh));
+
+	res = KSI_Signature_verifyWithPolicy(sig, hsh, 0, KSI_VERIFICATION_POLICY_INTERNAL, NULL);
+	CuAssert(tc, "Unable to verify the leaf signature.", res == KSI_OK);
+
+	KSI_Signature_free(sig);
+	sig = NULL;
+
+	res = KSI_BlockSignerHandle_getSignature(next, &sig);
+	CuAssert(tc, "The next block is not closed.", res == KSI_INVALID_STATE && sig == NULL);
+
+	KSI_BlockSignerHandle_free(h);
+	KSI_BlockSignerHandle_free(next);
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+}
+
+
+static void testCloseAndSignAsync_retryCacheFull(CuTest *tc) {
+	static const char *TEST_AGGR_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_01h.tlv",
+		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-aggr_resp-req_id_0100000001h.tlv",
+	};
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *bs = NULL;
+	KSI_AsyncService *as = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_BlockSignerHandle *first = NULL;
+	KSI_BlockSignerHandle *second = NULL;
+	KSI_Signature *sig = NULL;
+	AsyncCallbackState state = {0, 0, KSI_UNKNOWN_ERROR};
+	size_t blockId = 0;
+	size_t pending = 1;
+	size_t i;
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	/* The response to the resubmitted block is made available only after the first one has been received. */
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 1, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_DataHash_create(ctx, "Guardtime", strlen("Guardtime"), KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, &bs);
+	CuAssert(tc, "Unable to create block signer instance.", res == KSI_OK && bs != NULL);
+
+	res = KSI_BlockSigner_setAsyncCallback(bs, asyncCallback, &state);
+	CuAssert(tc, "Unable to set the callback.", res == KSI_OK);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &first);
+	CuAssert(tc, "Unable to add leaf to the block signer.", res == KSI_OK && first != NULL);
+
+	res = KSI_BlockSigner_closeAndSignAsync(bs, as, &blockId);
+	CuAssert(tc, "Unable to submit the first block.", res == KSI_OK && blockId == 0);
+
+	res = KSI_BlockSigner_addLeaf(bs, hsh, 0, NULL, &second);
+	CuAssert(tc, "Unable to add leaf to the next block.", res == KSI_OK && second != NULL);
+
+	/* The default request cache holds a single request. */
+	res = KSI_BlockSigner_closeAndSignAsync(bs, as, &blockId);
+	CuAssert(tc, "Request cache should be full.", res == KSI_ASYNC_REQUEST_CACHE_FULL);
+
+	for (i = 0; i < 10 && pending > 0; i++) {
+		res = KSI_BlockSigner_runAsync(bs, as, &pending);
+		CuAssert(tc, "Unable to run the async block signer.", res == KSI_OK);
+	}
+	CuAssert(tc, "First block is still pending.", pending == 0 && state.calls == 1 && state.blockId == 0);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_AGGR_RESPONSE_FILES, 2, TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	/* The closed block must be accepted once the cache has room again. */
+	res = KSI_BlockSigner_closeAndSignAsync(bs, as, &blockId);
+	CuAssert(tc, "Unable to resubmit the second block.", res == KSI_OK && blockId == 1);
+
+	pending = 1;
+	for (i = 0; i < 10 && pending > 0; i++) {
+		res = KSI_BlockSigner_runAsync(bs, as, &pending);
+		CuAssert(tc, "Unable to run the async block signer.", res == KSI_OK);
+	}
+	CuAssert(tc, "Second block is still pending.", pending == 0);
+	CuAssert(tc, "Callback not called for the second block.", state.calls == 2 && state.blockId == 1 && state.status == KSI_OK);
+
+	res = KSI_BlockSignerHandle_getSignature(second, &sig);
+	CuAssert(tc, "Unable to extract signature of the second block.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_verifyWithPolicy(sig, hsh, 0, KSI_VERIFICATION_POLICY_INTERNAL, NULL);
+	CuAssert(tc, "Unable to verify the signature of the second block.", res == KSI_OK);
+
+	KSI_Signature_free(sig);
+	KSI_BlockSignerHandle_free(first);
+	KSI_BlockSignerHandle_free(second);
+	KSI_BlockSigner_free(bs);
+	KSI_AsyncService_free(as);
+	KSI_DataHash_free(hsh);
+}
 
 static void preTest(void) {
 	ctx->netProvider->requestCount = 0;
@@ -475,10 +1016,16 @@ CuSuite* KSITest_Blocksigner_getSuite(void) {
 	SUITE_ADD_TEST(suite, testFreeBeforeClose);
 	SUITE_ADD_TEST(suite, testMedaData);
 	SUITE_ADD_TEST(suite, testIdentityMedaData);
+	SUITE_ADD_TEST(suite, testExportSignatures);
 	SUITE_ADD_TEST(suite, testSingle);
 	SUITE_ADD_TEST(suite, testReset);
+	SUITE_ADD_TEST(suite, testSpillFile);
 	SUITE_ADD_TEST(suite, testCreateBlockSigner);
 	SUITE_ADD_TEST(suite, testAddDeprecatedLeaf);
+	SUITE_ADD_TEST(suite, testAddLeaves);
+	SUITE_ADD_TEST(suite, testCheckpoint);
+	SUITE_ADD_TEST(suite, testCloseAndSignAsync);
+	SUITE_ADD_TEST(suite, testCloseAndSignAsync_retryCacheFull);
 
 	return suite;
 }
@@ -690,6 +690,56 @@ static void testAddToCloseAndReset(CuTest *tc) {
 
 }
 
+static void testBatchHashing(CuTest *tc) {
+	int res;
+	const char *msgs[] = {"correct horse battery staple", "", "I'll be Bach", "correct horse battery staple"};
+	const void *data[4];
+	size_t data_len[4];
+	unsigned char imprints[4 * (KSI_MAX_IMPRINT_LEN + 1)];
+	KSI_HashAlgorithm algos[] = {KSI_HASHALG_SHA2_256, KSI_HASHALG_SHA1, KSI_HASHALG_SHA2_512};
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	size_t a;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 4; i++) {
+		data[i] = msgs[i];
+		data_len[i] = strlen(msgs[i]);
+	}
+
+	for (a = 0; a < sizeof(algos) / sizeof(*algos); a++) {
+		size_t len = KSI_getHashLength(algos[a]) + 1;
+
+		/* Run twice to make sure the reused hashing context is reset properly. */
+		res = KSI_DataHash_createBatch(ctx, algos[a], data, data_len, 4, imprints, sizeof(imprints));
+		CuAssert(tc, "Unable to hash a batch.", res == KSI_OK);
+
+		res = KSI_DataHash_createBatch(ctx, algos[a], data, data_len, 4, imprints, sizeof(imprints));
+		CuAssert(tc, "Unable to hash a batch.", res == KSI_OK);
+
+		for (i = 0; i < 4; i++) {
+			res = KSI_DataHash_create(ctx, data[i], data_len[i], algos[a], &hsh);
+			KSITest_assertCreateCall(tc, "Unable to create data hash", res, hsh);
+
+			res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+			CuAssert(tc, "Unable to get imprint.", res == KSI_OK && imprint_len == len);
+			CuAssert(tc, "Batch imprint mismatch.", !memcmp(imprint, imprints + i * len, len));
+
+			KSI_DataHash_free(hsh);
+			hsh = NULL;
+		}
+	}
+
+	res = KSI_DataHash_createBatch(ctx, KSI_HASHALG_SHA2_256, data, data_len, 4, imprints, 4 * 33 - 1);
+	CuAssert(tc, "Too small imprint buffer must be detected.", res == KSI_BUFFER_OVERFLOW);
+
+	res = KSI_DataHash_createBatch(ctx, KSI_HASHALG_SHA2_256, NULL, NULL, 0, NULL, 0);
+	CuAssert(tc, "Empty batch should succeed.", res == KSI_OK);
+}
+
 CuSuite* KSITest_Hash_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
@@ -702,6 +752,7 @@ CuSuite* KSITest_Hash_getSuite(void) {
 	SUITE_ADD_TEST(suite, testSHA256GetImprint);
 	SUITE_ADD_TEST(suite, testSHA256fromImprint);
 	SUITE_ADD_TEST(suite, testParallelHashing);
+	SUITE_ADD_TEST(suite, testBatchHashing);
 	SUITE_ADD_TEST(suite, testHashGetAlgByName);
 	SUITE_ADD_TEST(suite, testHashAlgorithmDeprecatedDates);
 	SUITE_ADD_TEST(suite, testHashAlgorithmObsoleteDates);
@@ -21,8 +21,10 @@
 #include <string.h>
 #include <ksi/tlv.h>
 #include <ksi/hashchain.h>
+#include <ksi/signature.h>
 
 #include "all_tests.h"
+#include "../src/ksi/impl/signature_impl.h"
 
 extern KSI_CTX *ctx;
 
@@ -193,6 +195,157 @@ static void testCalChainBuild(CuTest* tc) {
 	KSI_HashChainLinkList_free(chn);
 }
 
+static void testCalChainAlgorithmChange(CuTest* tc) {
+	static const char *siblings[] = {
+		"01f20c6082041dd7a2c25378180b5316498ae001c75171c0f007eefbeaab75d693",
+		"000101010101010101010101010101010101010101",
+		"01bc90b6d9576e0c71531a87902e7c75c9f87953b3259de73cfcc6e32f9bc8b278",
+		"010000000000000000000000000000000000000000000000000000000000000000",
+		"0108399c114fe431fd3473747db1ccda24cb029b3e074d92c4b18a36377fe2c42a"
+	};
+	static const int isLeft[] = { 0, 1, 0, 1, 0 };
+	KSI_LIST(KSI_HashChainLink) *chn = NULL;
+	KSI_DataHash *in = NULL;
+	KSI_DataHash *out = NULL;
+	KSI_DataHash *exp = NULL;
+	KSI_DataHash *tmp = NULL;
+	KSI_DataHasher *hsr = NULL;
+	KSI_HashAlgorithm algo_id = KSI_HASHALG_SHA2_256;
+	unsigned char buf[1024];
+	size_t buf_len;
+	unsigned char level = 0xff;
+	size_t i;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSITest_decodeHexStr("019e03cd3829beb2f9d4001f17070e25d9a4d3ef25adc39e8907ce3cdca7bebbb3", buf, sizeof(buf), &buf_len);
+	CuAssert(tc, "Unable to decode input hash.", res == KSI_OK);
+
+	res = KSI_DataHash_fromImprint(ctx, buf, buf_len, &in);
+	CuAssert(tc, "Unable to create input data hash.", res == KSI_OK && in != NULL);
+
+	/* Compute the expected output, switching the algorithm on every left link. */
+	exp = KSI_DataHash_ref(in);
+	for (i = 0; i < sizeof(isLeft) / sizeof(*isLeft); i++) {
+		KSI_DataHash *sibling = NULL;
+
+		buildHashChain(tc, siblings[i], isLeft[i], 0, &chn);
+
+		res = KSITest_decodeHexStr(siblings[i], buf, sizeof(buf), &buf_len);
+		CuAssert(tc, "Unable to decode sibling hash.", res == KSI_OK);
+
+		res = KSI_DataHash_fromImprint(ctx, buf, buf_len, &sibling);
+		CuAssert(tc, "Unable to create sibling hash.", res == KSI_OK && sibling != NULL);
+
+		if (isLeft[i]) algo_id = (KSI_HashAlgorithm)buf[0];
+
+		res = KSI_DataHasher_open(ctx, algo_id, &hsr);
+		CuAssert(tc, "Unable to open hasher.", res == KSI_OK && hsr != NULL);
+
+		res = KSI_DataHasher_addImprint(hsr, isLeft[i] ? exp : sibling);
+		CuAssert(tc, "Unable to add imprint.", res == KSI_OK);
+
+		res = KSI_DataHasher_addImprint(hsr, isLeft[i] ? sibling : exp);
+		CuAssert(tc, "Unable to add imprint.", res == KSI_OK);
+
+		res = KSI_DataHasher_add(hsr, &level, 1);
+		CuAssert(tc, "Unable to add level.", res == KSI_OK);
+
+		res = KSI_DataHasher_close(hsr, &tmp);
+		CuAssert(tc, "Unable to close hasher.", res == KSI_OK && tmp != NULL);
+
+		KSI_DataHash_free(exp);
+		exp = tmp;
+		tmp = NULL;
+
+		KSI_DataHasher_free(hsr);
+		hsr = NULL;
+		KSI_DataHash_free(sibling);
+	}
+
+	/* Evaluate twice, the second run reuses the cached hashers. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_HashChain_aggregateCalendar(ctx, chn, in, &out);
+		CuAssert(tc, "Unable to aggregate calendar chain.", res == KSI_OK && out != NULL);
+
+		CuAssert(tc, "Calendar chain output hash mismatch.", KSI_DataHash_equals(out, exp));
+
+		KSI_DataHash_free(out);
+		out = NULL;
+	}
+
+	KSI_DataHash_free(exp);
+	KSI_DataHash_free(in);
+	KSI_HashChainLinkList_free(chn);
+}
+
+static void testCalChainRootSharedBetweenSignatures(CuTest* tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+	KSI_Signature *sig[3] = {NULL, NULL, NULL};
+	KSI_CalendarHashChain *cal = NULL;
+	KSI_DataHash *root[3] = {NULL, NULL, NULL};
+	size_t i;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	/* Each signature has its own copy of the same calendar hash chain. */
+	for (i = 0; i < 3; i++) {
+		if (i == 2) {
+			res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_ROOT_CACHE_SIZE, (void *)0);
+			CuAssert(tc, "Unable to disable calendar root cache.", res == KSI_OK);
+		}
+
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig[i] != NULL);
+
+		cal = sig[i]->calendarChain;
+		CuAssert(tc, "Signature should have a calendar hash chain.", cal != NULL);
+
+		res = KSI_CalendarHashChain_aggregate(cal, &root[i]);
+		CuAssert(tc, "Unable to aggregate calendar hash chain.", res == KSI_OK && root[i] != NULL);
+	}
+
+	CuAssert(tc, "Root hash should be shared between the chains.", root[0] == root[1]);
+	CuAssert(tc, "Root hash should be recomputed with the cache disabled.", root[2] != root[0] && KSI_DataHash_equals(root[2], root[0]));
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_ROOT_CACHE_SIZE, (void *)KSI_CTX_CALENDAR_ROOT_CACHE_DEFAULT_SIZE);
+	CuAssert(tc, "Unable to restore calendar root cache.", res == KSI_OK);
+
+	for (i = 0; i < 3; i++) {
+		KSI_DataHash_free(root[i]);
+		KSI_Signature_free(sig[i]);
+	}
+#undef TEST_SIGNATURE_FILE
+}
+
+static void testCalChainRootHugeCacheSize(CuTest* tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+	KSI_Signature *sig = NULL;
+	KSI_DataHash *root = NULL;
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	/* The size is truncated to the maximum instead of failing to allocate the cache. */
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_ROOT_CACHE_SIZE, (void *)(size_t)-1);
+	CuAssert(tc, "Unable to set calendar root cache size.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig != NULL && sig->calendarChain != NULL);
+
+	res = KSI_CalendarHashChain_aggregate(sig->calendarChain, &root);
+	CuAssert(tc, "Unable to aggregate calendar hash chain.", res == KSI_OK && root != NULL);
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_ROOT_CACHE_SIZE, (void *)KSI_CTX_CALENDAR_ROOT_CACHE_DEFAULT_SIZE);
+	CuAssert(tc, "Unable to restore calendar root cache.", res == KSI_OK);
+
+	KSI_DataHash_free(root);
+	KSI_Signature_free(sig);
+#undef TEST_SIGNATURE_FILE
+}
+
 static void testAggrChainBuilt(CuTest *tc) {
 	int res;
 	unsigned char buf[1024];
@@ -422,6 +575,9 @@ CuSuite* KSITest_HashChain_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
 	SUITE_ADD_TEST(suite, testCalChainBuild);
+	SUITE_ADD_TEST(suite, testCalChainAlgorithmChange);
+	SUITE_ADD_TEST(suite, testCalChainRootSharedBetweenSignatures);
+	SUITE_ADD_TEST(suite, testCalChainRootHugeCacheSize);
 	SUITE_ADD_TEST(suite, testAggrChainBuilt);
 	SUITE_ADD_TEST(suite, testAggrChainBuiltWithMetaData);
 	SUITE_ADD_TEST(suite, testAggrChain_LegacyId_siblingContainsLegacyId_verifyErrorResult);
@@ -19,14 +19,24 @@
 
 #include <string.h>
 
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <poll.h>
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#endif
+
 #include <ksi/hash.h>
 #include <ksi/net.h>
 #include <ksi/net_async.h>
+#include <ksi/net_uri.h>
 
 #include "cutest/CuTest.h"
 
 #include "all_tests.h"
 #include "test_mock_async.h"
+#include "../src/ksi/impl/net_impl.h"
 
 
 extern KSI_CTX *ctx;
@@ -142,6 +152,7 @@ void Test_AsyncSingningService_verifyOptions(CuTest* tc) {
 	verifyOption(tc, as, KSI_ASYNC_OPT_SND_TIMEOUT, 10, 15);
 	verifyOption(tc, as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, 1, 15);
 	verifyOption(tc, as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, 1, 15);
+	verifyOption(tc, as, KSI_ASYNC_OPT_CONNECTION_COUNT, 1, 15);
 
 	KSI_AsyncService_free(as);
 }
@@ -329,6 +340,552 @@ static void Test_AsyncSingningService_verifyRequestCacheFull(CuTest* tc) {
 	KSI_AsyncService_free(as);
 }
 
+static void Test_AsyncSingningService_verifyReqIdReuse(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncHandle *added[3] = {NULL, NULL, NULL};
+	KSI_uint64_t reqIds[3] = {0, 0, 0};
+	KSI_uint64_t reqId = 0;
+	size_t cacheSize = 3;
+	size_t waiting = 0;
+	size_t i;
+	int err = KSI_OK;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)cacheSize);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)cacheSize);
+	CuAssert(tc, "Unable to set maximum request count.", res == KSI_OK);
+
+	/* Every sent request will time out immediately. */
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_RCV_TIMEOUT, (void *)0);
+	CuAssert(tc, "Unable to set receive timeout.", res == KSI_OK);
+
+	for (i = 0; i < cacheSize; i++) {
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &added[i]);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && added[i] != NULL);
+
+		res = KSI_AsyncService_addRequest(as, added[i]);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getRequestId(added[i], &reqIds[i]);
+		CuAssert(tc, "Unable to get handle request id.", res == KSI_OK && reqIds[i] != 0);
+	}
+
+	/* The finalized requests are returned in the order they were sent. */
+	for (i = 0; i < cacheSize; i++) {
+		handle = NULL;
+		res = KSI_AsyncService_run(as, &handle, &waiting);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+		CuAssert(tc, "Wrong handle returned.", handle == added[i]);
+
+		res = KSI_AsyncHandle_getError(handle, &err);
+		CuAssert(tc, "Wrong handle error.", res == KSI_OK && err == KSI_NETWORK_RECIEVE_TIMEOUT);
+
+		KSI_AsyncHandle_free(handle);
+		added[i] = NULL;
+	}
+	CuAssert(tc, "There should be no more requests waiting.", waiting == 0);
+
+	/* The released cache slots are reused with a new request id. */
+	for (i = 0; i < cacheSize; i++) {
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+		res = KSI_AsyncService_addRequest(as, handle);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getRequestId(handle, &reqId);
+		CuAssert(tc, "Unable to get handle request id.", res == KSI_OK);
+		CuAssert(tc, "Request id should not be reused.", reqId != reqIds[i]);
+		CuAssert(tc, "Request cache slot should be reused.", (reqId & 0xffffffff) == (reqIds[i] & 0xffffffff));
+	}
+
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncSingningService_pollFdsAndTimeout(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncPollFd fd;
+	size_t count = 1;
+	long timeout = 0;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, NULL, 0, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Idle service should have no timeout.", res == KSI_OK && timeout < 0);
+
+	/* Waiting on an idle service must not block. */
+	res = KSI_AsyncService_wait(as, -1);
+	CuAssert(tc, "Unable to wait on idle service.", res == KSI_OK);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, handle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	/* The mock transport does not expose any descriptors, thus it has to be polled. */
+	res = KSI_AsyncService_getPollFds(as, &fd, 1, &count);
+	CuAssert(tc, "Mock transport should have no descriptors.", res == KSI_OK && count == 0);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Service with requests in process should be polled.", res == KSI_OK && timeout == 0);
+
+	res = KSI_AsyncService_wait(as, -1);
+	CuAssert(tc, "Unable to wait on service.", res == KSI_OK);
+
+	KSI_AsyncService_free(as);
+}
+
+#ifndef _WIN32
+static void Test_AsyncSingningService_tcpPollFds(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncPollFd fd;
+	struct pollfd pfd;
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int srv = -1;
+	char uri[64];
+	size_t count = 0;
+	long timeout = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	/* Local listener standing in for the aggregator. */
+	srv = socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to open listening socket.", srv >= 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	CuAssert(tc, "Unable to bind listening socket.", bind(srv, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	CuAssert(tc, "Unable to listen.", listen(srv, 1) == 0);
+	CuAssert(tc, "Unable to get port.", getsockname(srv, (struct sockaddr *)&addr, &addrLen) == 0);
+
+	KSI_snprintf(uri, sizeof(uri), "ksi+tcp://127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSI_AsyncService_setEndpoint(as, uri, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_RCV_TIMEOUT, (void *)10);
+	CuAssert(tc, "Unable to set receive timeout.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)3);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_getPollFds(as, NULL, 0, &count);
+	CuAssert(tc, "Connection should not be opened yet.", res == KSI_OK && count == 0);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Idle service should have no timeout.", res == KSI_OK && timeout < 0);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, handle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Connection should be opened right away.", res == KSI_OK && timeout == 0);
+
+	/* Open the connection and send the request. */
+	for (i = 0; i < 10; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+		if (state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) break;
+
+		res = KSI_AsyncService_getPollFds(as, NULL, 0, &count);
+		CuAssert(tc, "Buffer overflow expected.", res == KSI_BUFFER_OVERFLOW && count == 1);
+
+		res = KSI_AsyncService_getPollFds(as, &fd, 1, &count);
+		CuAssert(tc, "Unable to get descriptors.", res == KSI_OK && count == 1);
+		CuAssert(tc, "Should wait for the request to be sent.", fd.events == (KSI_ASYNC_EVENT_READ | KSI_ASYNC_EVENT_WRITE));
+
+		pfd.fd = fd.fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		CuAssert(tc, "Connection not established.", poll(&pfd, 1, 5000) == 1);
+	}
+	CuAssert(tc, "Request should be sent.", state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
+
+	res = KSI_AsyncService_getPollFds(as, &fd, 1, &count);
+	CuAssert(tc, "Unable to get descriptors.", res == KSI_OK && count == 1);
+	CuAssert(tc, "Should only wait for the response.", fd.events == KSI_ASYNC_EVENT_READ);
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Timeout should be bound by the receive timeout.", res == KSI_OK && timeout > 0 && timeout <= 11 * 1000);
+
+	/* No response is sent by the listener, thus the wait has to time out. */
+	res = KSI_AsyncService_wait(as, 50);
+	CuAssert(tc, "Unable to wait on service.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &handle, NULL);
+	CuAssert(tc, "No response expected.", res == KSI_OK && handle == NULL);
+
+	/* A queued request that can not be dispatched anymore must not keep the timeout at 0. */
+	res = KSITest_createAggrAsyncHandle(ctx, 2, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, handle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	KSI_AsyncHandle_setState(handle, KSI_ASYNC_STATE_UNDEFINED);
+	handle = NULL;
+
+	res = KSI_AsyncService_getTimeout(as, &timeout);
+	CuAssert(tc, "Timeout should not be 0 for a request that is not dispatched.", res == KSI_OK && timeout > 0 && timeout <= 11 * 1000);
+
+	KSI_AsyncService_free(as);
+	close(srv);
+}
+
+static void Test_AsyncSingningService_tcpConnectionPool(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle[2] = {NULL, NULL};
+	KSI_AsyncPollFd fds[2];
+	struct pollfd pfds[2];
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int srv = -1;
+	int peer[2] = {-1, -1};
+	char uri[64];
+	unsigned char buf[1024];
+	size_t count = 0;
+	size_t optVal = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t i;
+	size_t j;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	/* Local listener standing in for the aggregator. */
+	srv = socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to open listening socket.", srv >= 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	CuAssert(tc, "Unable to bind listening socket.", bind(srv, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	CuAssert(tc, "Unable to listen.", listen(srv, 2) == 0);
+	CuAssert(tc, "Unable to get port.", getsockname(srv, (struct sockaddr *)&addr, &addrLen) == 0);
+
+	KSI_snprintf(uri, sizeof(uri), "ksi+tcp://127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSI_AsyncService_setEndpoint(as, uri, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)2);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)2);
+	CuAssert(tc, "Unable to set maximum request count.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)2);
+	CuAssert(tc, "Unable to set connection count.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)1);
+	CuAssert(tc, "Connection count may not be decreased.", res == KSI_INVALID_ARGUMENT);
+
+	res = KSI_AsyncService_getOption(as, KSI_ASYNC_OPT_CONNECTION_COUNT, (void *)&optVal);
+	CuAssert(tc, "Connection count mismatch.", res == KSI_OK && optVal == 2);
+
+	for (j = 0; j < 2; j++) {
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle[j]);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle[j] != NULL);
+
+		res = KSI_AsyncService_addRequest(as, handle[j]);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+
+	/* Open the connections and send the requests. */
+	for (i = 0; i < 10; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		for (j = 0; j < 2; j++) {
+			res = KSI_AsyncHandle_getState(handle[j], &state);
+			CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+			if (state != KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) break;
+		}
+		if (j == 2) break;
+
+		res = KSI_AsyncService_getPollFds(as, fds, 2, &count);
+		CuAssert(tc, "Both connections should be open.", res == KSI_OK && count == 2);
+
+		for (j = 0; j < 2; j++) {
+			pfds[j].fd = fds[j].fd;
+			pfds[j].events = POLLOUT;
+			pfds[j].revents = 0;
+		}
+		CuAssert(tc, "Connections not established.", poll(pfds, 2, 5000) > 0);
+	}
+	CuAssert(tc, "Requests should be sent.", state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
+
+	res = KSI_AsyncService_getPollFds(as, fds, 2, &count);
+	CuAssert(tc, "Unable to get descriptors.", res == KSI_OK && count == 2);
+
+	/* Each of the connections should have been given one of the requests. */
+	for (j = 0; j < 2; j++) {
+		peer[j] = accept(srv, NULL, NULL);
+		CuAssert(tc, "Unable to accept connection.", peer[j] >= 0);
+
+		pfds[j].fd = peer[j];
+		pfds[j].events = POLLIN;
+		pfds[j].revents = 0;
+		CuAssert(tc, "Request not received.", poll(&pfds[j], 1, 5000) == 1);
+		CuAssert(tc, "Unable to read request.", recv(peer[j], buf, sizeof(buf), 0) > 0);
+	}
+
+	KSI_AsyncService_free(as);
+	for (j = 0; j < 2; j++) close(peer[j]);
+	close(srv);
+}
+
+static int openLoopbackListener(unsigned *port) {
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0) return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0 ||
+			getsockname(fd, (struct sockaddr *)&addr, &addrLen) != 0) {
+		close(fd);
+		return -1;
+	}
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+static void Test_AsyncSingningService_multiEndpointFailover(CuTest* tc) {
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle = NULL;
+	KSI_AsyncPollFd fds[2];
+	struct pollfd pfd;
+	int srv[2] = {-1, -1};
+	int peer[2] = {-1, -1};
+	unsigned port[2];
+	char uri[2][64];
+	const char *uris[2];
+	unsigned char buf[2][1024];
+	ssize_t len[2];
+	size_t count = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	/* Local listeners standing in for the aggregator gateways. */
+	for (i = 0; i < 2; i++) {
+		srv[i] = openLoopbackListener(&port[i]);
+		CuAssert(tc, "Unable to open listening socket.", srv[i] >= 0);
+		KSI_snprintf(uri[i], sizeof(uri[i]), "ksi+tcp://127.0.0.1:%u", port[i]);
+		uris[i] = uri[i];
+	}
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSI_AsyncService_setEndpoints(as, uris, 2, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoints.", res == KSI_OK);
+
+	res = KSI_AsyncService_setEndpoint(as, uris[0], "anon", "anon");
+	CuAssert(tc, "Endpoint may not be set repeatedly.", res == KSI_INVALID_STATE);
+
+	res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, handle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	/* The request is sent to the first endpoint, as none of the endpoints have been measured yet. */
+	for (i = 0; i < 10; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+		if (state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) break;
+
+		res = KSI_AsyncService_getPollFds(as, fds, 2, &count);
+		CuAssert(tc, "Only the first endpoint should be connected.", res == KSI_OK && count == 1);
+
+		pfd.fd = fds[0].fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		CuAssert(tc, "Connection not established.", poll(&pfd, 1, 5000) == 1);
+	}
+	CuAssert(tc, "Request should be sent.", state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
+
+	peer[0] = accept(srv[0], NULL, NULL);
+	CuAssert(tc, "Unable to accept connection.", peer[0] >= 0);
+	len[0] = recv(peer[0], buf[0], sizeof(buf[0]), 0);
+	CuAssert(tc, "Unable to read request.", len[0] > 0);
+
+	/* Drop the connection without responding. */
+	close(peer[0]);
+	peer[0] = -1;
+
+	/* The request has to be resubmitted to the second endpoint. */
+	pfd.fd = srv[1];
+	pfd.events = POLLIN;
+	for (i = 0; i < 50; i++) {
+		res = KSI_AsyncService_wait(as, 100);
+		CuAssert(tc, "Unable to wait on service.", res == KSI_OK);
+
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		res = KSI_AsyncHandle_getState(handle, &state);
+		CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+		CuAssert(tc, "Request should not fail.", state != KSI_ASYNC_STATE_ERROR);
+
+		pfd.revents = 0;
+		if (state == KSI_ASYNC_STATE_WAITING_FOR_RESPONSE && poll(&pfd, 1, 0) == 1) break;
+	}
+
+	peer[1] = accept(srv[1], NULL, NULL);
+	CuAssert(tc, "Unable to accept connection.", peer[1] >= 0);
+	pfd.fd = peer[1];
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	CuAssert(tc, "Request not resubmitted.", poll(&pfd, 1, 5000) == 1);
+	len[1] = recv(peer[1], buf[1], sizeof(buf[1]), 0);
+	CuAssert(tc, "Resubmitted request mismatch.", len[1] == len[0] && memcmp(buf[0], buf[1], (size_t)len[0]) == 0);
+
+	KSI_AsyncService_free(as);
+	close(peer[1]);
+	for (i = 0; i < 2; i++) close(srv[i]);
+}
+
+static void Test_AsyncSingningService_tcpBatchedSend(CuTest* tc) {
+#define BATCH_REQUEST_COUNT 32
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *handle[BATCH_REQUEST_COUNT];
+	KSI_AsyncPollFd fd;
+	struct pollfd pfd;
+	int srv = -1;
+	int peer = -1;
+	unsigned port;
+	char uri[64];
+	unsigned char buf[1024];
+	size_t count = 0;
+	size_t callCount = 0;
+	size_t sendCount = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	size_t i;
+	size_t j;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	srv = openLoopbackListener(&port);
+	CuAssert(tc, "Unable to open listening socket.", srv >= 0);
+	KSI_snprintf(uri, sizeof(uri), "ksi+tcp://127.0.0.1:%u", port);
+
+	res = KSI_SigningAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSI_AsyncService_setEndpoint(as, uri, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_REQUEST_CACHE_SIZE, (void *)BATCH_REQUEST_COUNT);
+	CuAssert(tc, "Unable to set request cache size.", res == KSI_OK);
+
+	res = KSI_AsyncService_setOption(as, KSI_ASYNC_OPT_MAX_REQUEST_COUNT, (void *)BATCH_REQUEST_COUNT);
+	CuAssert(tc, "Unable to set maximum request count.", res == KSI_OK);
+
+	for (j = 0; j < BATCH_REQUEST_COUNT; j++) {
+		res = KSITest_createAggrAsyncHandle(ctx, 1, (unsigned char *)"0111a700b0c8066c47ecba05ed37bc14dcadb238552d86c659342d1d7e87b8772d", 0, KSI_HASHALG_INVALID, NULL, 0, 0, &handle[j]);
+		CuAssert(tc, "Unable to create async handle.", res == KSI_OK && handle[j] != NULL);
+
+		res = KSI_AsyncService_addRequest(as, handle[j]);
+		CuAssert(tc, "Unable to add request.", res == KSI_OK);
+	}
+
+	/* Open the connection and send the requests. */
+	for (i = 0; i < 10; i++) {
+		res = KSI_AsyncService_run(as, NULL, NULL);
+		CuAssert(tc, "Failed to run async service.", res == KSI_OK);
+
+		for (j = 0; j < BATCH_REQUEST_COUNT; j++) {
+			res = KSI_AsyncHandle_getState(handle[j], &state);
+			CuAssert(tc, "Unable to get request state.", res == KSI_OK);
+			if (state != KSI_ASYNC_STATE_WAITING_FOR_RESPONSE) break;
+		}
+		if (j == BATCH_REQUEST_COUNT) break;
+
+		res = KSI_AsyncService_getPollFds(as, &fd, 1, &count);
+		CuAssert(tc, "Unable to get descriptors.", res == KSI_OK && count == 1);
+
+		pfd.fd = fd.fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		CuAssert(tc, "Connection not established.", poll(&pfd, 1, 5000) == 1);
+	}
+	CuAssert(tc, "Requests should be sent.", j == BATCH_REQUEST_COUNT);
+
+	/* The requests should have been coalesced into fewer system calls than there are requests. */
+	res = as->getOption(as->impl, KSI_ASYNC_PRIVOPT_SEND_REQUEST_COUNT, (void *)&sendCount);
+	CuAssert(tc, "Unable to get send request count.", res == KSI_OK && sendCount == BATCH_REQUEST_COUNT);
+
+	res = as->getOption(as->impl, KSI_ASYNC_PRIVOPT_SEND_CALL_COUNT, (void *)&callCount);
+	CuAssert(tc, "Unable to get send call count.", res == KSI_OK && callCount > 0 && callCount < BATCH_REQUEST_COUNT);
+
+	peer = accept(srv, NULL, NULL);
+	CuAssert(tc, "Unable to accept connection.", peer >= 0);
+	pfd.fd = peer;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	CuAssert(tc, "Requests not received.", poll(&pfd, 1, 5000) == 1);
+	CuAssert(tc, "Unable to read requests.", recv(peer, buf, sizeof(buf), 0) > 0);
+
+	KSI_AsyncService_free(as);
+	close(peer);
+	close(srv);
+#undef BATCH_REQUEST_COUNT
+}
+#endif
+
 static void Test_AsyncSign_oneRequest_verifyReqCtx(CuTest* tc) {
 	static const char *TEST_AGGR_RESPONSE_FILES[] = {
 		"resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv",
@@ -1493,6 +2050,226 @@ static void Test_AsyncSign_multipleRequests_collect_aggrResp301(CuTest* tc) {
 	KSI_AsyncService_free(as);
 }
 
+static void Test_AsyncExtend_oneRequest_verifySignature(CuTest* tc) {
+#define TEST_SIGNATURE_FILE     "resource/tlv/ok-sig-2014-04-30.1.ksig"
+#define TEST_EXT_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1-extended.ksig"
+	static const char *TEST_EXT_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response.tlv",
+	};
+	static const size_t TEST_EXT_RESP_COUNT = sizeof(TEST_EXT_RESPONSE_FILES) / sizeof(TEST_EXT_RESPONSE_FILES[0]);
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	KSI_Signature *expExt = NULL;
+	KSI_PublicationRecord *pubRec = NULL;
+	KSI_PublicationRecord *pubRecClone = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_Integer *reqId = NULL;
+	KSI_uint64_t hReqId = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char *expected = NULL;
+	size_t expected_len = 0;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	res = KSI_ExtendingAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_EXT_RESPONSE_FILES, TEST_EXT_RESP_COUNT, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncSignatureExtendHandle_new(ctx, sig, NULL, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	res = KSI_AsyncHandle_getExtendReq(reqHandle, &req);
+	CuAssert(tc, "Unable to get extend request.", res == KSI_OK && req != NULL);
+
+	res = KSI_ExtendReq_getRequestId(req, &reqId);
+	CuAssert(tc, "Unable to get request id.", res == KSI_OK && reqId != NULL);
+
+	res = KSI_AsyncHandle_getRequestId(reqHandle, &hReqId);
+	CuAssert(tc, "Request id mismatch.", res == KSI_OK && hReqId == KSI_Integer_getUInt64(reqId));
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	res = KSI_AsyncHandle_getExtendResp(respHandle, &resp);
+	CuAssert(tc, "Unable to get extend response.", res == KSI_OK && resp != NULL);
+
+	res = KSI_AsyncHandle_getSignature(respHandle, &ext);
+	CuAssert(tc, "Unable to extract extended signature.", res == KSI_OK && ext != NULL);
+
+	/* The expected signature has also been given the publication record it has been extended to. */
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_EXT_SIGNATURE_FILE), &expExt);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && expExt != NULL);
+
+	res = KSI_Signature_getPublicationRecord(expExt, &pubRec);
+	CuAssert(tc, "Unable to get publication record.", res == KSI_OK && pubRec != NULL);
+
+	res = KSI_PublicationRecord_clone(pubRec, &pubRecClone);
+	CuAssert(tc, "Unable to clone publication record.", res == KSI_OK && pubRecClone != NULL);
+
+	res = KSI_Signature_replacePublicationRecord(ext, pubRecClone);
+	CuAssert(tc, "Unable to set publication record.", res == KSI_OK);
+
+	res = KSI_Signature_serialize(ext, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw != NULL && raw_len > 0);
+
+	res = KSI_Signature_serialize(expExt, &expected, &expected_len);
+	CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && expected != NULL && expected_len > 0);
+
+	CuAssert(tc, "Serialized signature length mismatch.", expected_len == raw_len);
+	CuAssert(tc, "Serialized signature content mismatch.", !memcmp(expected, raw, raw_len));
+
+	KSI_free(raw);
+	KSI_free(expected);
+
+	KSI_Signature_free(expExt);
+	KSI_Signature_free(ext);
+	KSI_Signature_free(sig);
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+
+#undef TEST_SIGNATURE_FILE
+#undef TEST_EXT_SIGNATURE_FILE
+}
+
+static void Test_AsyncExtend_oneRequest_noSignature(CuTest* tc) {
+	static const char *TEST_EXT_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response.tlv",
+	};
+	static const size_t TEST_EXT_RESP_COUNT = sizeof(TEST_EXT_RESPONSE_FILES) / sizeof(TEST_EXT_RESPONSE_FILES[0]);
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_CalendarHashChain *chain = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_ExtendingAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_EXT_RESPONSE_FILES, TEST_EXT_RESP_COUNT, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1.ksig"), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_getSigningTime(sig, &aggrTime);
+	CuAssert(tc, "Unable to get signing time.", res == KSI_OK && aggrTime != NULL);
+
+	res = KSI_createExtendRequest(ctx, aggrTime, NULL, &req);
+	CuAssert(tc, "Unable to create extend request.", res == KSI_OK && req != NULL);
+
+	res = KSI_AsyncExtendHandle_new(ctx, req, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_RESPONSE_RECEIVED);
+
+	res = KSI_AsyncHandle_getExtendResp(respHandle, &resp);
+	CuAssert(tc, "Unable to get extend response.", res == KSI_OK && resp != NULL);
+
+	res = KSI_ExtendResp_getCalendarHashChain(resp, &chain);
+	CuAssert(tc, "Calendar hash chain missing.", res == KSI_OK && chain != NULL);
+
+	res = KSI_AsyncHandle_getSignature(respHandle, &ext);
+	CuAssert(tc, "There is no signature to extend.", res == KSI_INVALID_STATE && ext == NULL);
+
+	KSI_Signature_free(sig);
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+}
+
+static void Test_AsyncExtend_oneRequest_errorStatus(CuTest* tc) {
+#define TEST_SIGNATURE_FILE     "resource/tlv/ok-sig-2014-04-30.1.ksig"
+	static const char *TEST_EXT_RESPONSE_FILES[] = {
+		"resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response-with-status-301.tlv",
+	};
+	static const size_t TEST_EXT_RESP_COUNT = sizeof(TEST_EXT_RESPONSE_FILES) / sizeof(TEST_EXT_RESPONSE_FILES[0]);
+
+	int res;
+	KSI_AsyncService *as = NULL;
+	KSI_AsyncHandle *reqHandle = NULL;
+	KSI_AsyncHandle *respHandle = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	int error = 0;
+	long errorExt = 0;
+	int state = KSI_ASYNC_STATE_UNDEFINED;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	res = KSI_ExtendingAsyncService_new(ctx, &as);
+	CuAssert(tc, "Unable to create new async service object.", res == KSI_OK && as != NULL);
+
+	res = KSITest_MockAsyncService_setEndpoint(as, TEST_EXT_RESPONSE_FILES, TEST_EXT_RESP_COUNT, "anon", "anon");
+	CuAssert(tc, "Unable to configure service endpoint.", res == KSI_OK);
+
+	res = KSI_AsyncSignatureExtendHandle_new(ctx, sig, NULL, &reqHandle);
+	CuAssert(tc, "Unable to create async handle.", res == KSI_OK && reqHandle != NULL);
+
+	res = KSI_AsyncService_addRequest(as, reqHandle);
+	CuAssert(tc, "Unable to add request.", res == KSI_OK);
+
+	res = KSI_AsyncService_run(as, &respHandle, NULL);
+	CuAssert(tc, "Failed to run async service.", res == KSI_OK && respHandle != NULL);
+	CuAssert(tc, "Handle mismatch.",  respHandle == reqHandle);
+
+	res = KSI_AsyncHandle_getState(respHandle, &state);
+	CuAssert(tc, "Unable to get request state.", res == KSI_OK && state == KSI_ASYNC_STATE_ERROR);
+
+	res = KSI_AsyncHandle_getError(respHandle, &error);
+	CuAssert(tc, "Extending should have failed.", res == KSI_OK && error != KSI_OK);
+
+	res = KSI_AsyncHandle_getExtError(respHandle, &errorExt);
+	CuAssert(tc, "There should be external error.", res == KSI_OK && errorExt == 0x301);
+
+	res = KSI_AsyncHandle_getSignature(respHandle, &ext);
+	CuAssert(tc, "No signature in error state.", res == KSI_INVALID_STATE && ext == NULL);
+
+	KSI_Signature_free(sig);
+	KSI_AsyncHandle_free(respHandle);
+	KSI_AsyncService_free(as);
+
+#undef TEST_SIGNATURE_FILE
+}
+
 CuSuite* KSITest_NetAsync_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
@@ -1503,6 +2280,14 @@ CuSuite* KSITest_NetAsync_getSuite(void) {
 	SUITE_ADD_TEST(suite, Test_AsyncSingningService_runEmpty);
 	SUITE_ADD_TEST(suite, Test_AsyncSingningService_verifyReqId);
 	SUITE_ADD_TEST(suite, Test_AsyncSingningService_verifyRequestCacheFull);
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_verifyReqIdReuse);
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_pollFdsAndTimeout);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_tcpPollFds);
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_tcpConnectionPool);
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_multiEndpointFailover);
+	SUITE_ADD_TEST(suite, Test_AsyncSingningService_tcpBatchedSend);
+#endif
 
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifyReqCtx);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_oneRequest_verifySignature);
@@ -1525,5 +2310,9 @@ CuSuite* KSITest_NetAsync_getSuite(void) {
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_collect);
 	SUITE_ADD_TEST(suite, Test_AsyncSign_multipleRequests_collect_aggrResp301);
 
+	SUITE_ADD_TEST(suite, Test_AsyncExtend_oneRequest_verifySignature);
+	SUITE_ADD_TEST(suite, Test_AsyncExtend_oneRequest_noSignature);
+	SUITE_ADD_TEST(suite, Test_AsyncExtend_oneRequest_errorStatus);
+
 	return suite;
 }
@@ -1745,6 +1745,179 @@ static void TestCalendarBasedPolicy_OK_WithPublicationRecord(CuTest* tc) {
 #undef TEST_EXT_RESPONSE_FILE
 }
 
+static void TestCalendarBasedPolicy_OK_WithPublicationRecord_cachedExtension(CuTest* tc) {
+#define TEST_SIGNATURE_FILE    "resource/tlv/ok-sig-2014-04-30.1-extended.ksig"
+#define TEST_EXT_RESPONSE_FILE "resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response.tlv"
+#define TEST_EXT_NOK_RESPONSE_FILE "resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-nok-extend_response-1.tlv"
+	int res;
+	KSI_VerificationContext context;
+	KSI_PolicyVerificationResult *result = NULL;
+	KSI_Signature *signature = NULL;
+	size_t hits = 0;
+	size_t misses = 0;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE, (void *)4);
+	CuAssert(tc, "Unable to set calendar chain cache size.", res == KSI_OK);
+
+	res = KSI_VerificationContext_init(&context, ctx);
+	CuAssert(tc, "Verification context creation failed.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &signature);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && signature != NULL);
+	context.signature = signature;
+
+	res = KSI_CTX_setExtender(ctx, getFullResourcePathUri(TEST_EXT_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set extender file URI.", res == KSI_OK);
+
+	res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_CALENDAR_BASED, &context, &result);
+	CuAssert(tc, "Policy verification failed.", res == KSI_OK && result->finalResult.resultCode == KSI_VER_RES_OK);
+	KSI_PolicyVerificationResult_free(result);
+	result = NULL;
+
+	res = KSI_CTX_getCalendarChainCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "First extension should be sent to the extender.", res == KSI_OK && hits == 0 && misses == 1);
+
+	/* The extender would now return an invalid chain, but it should not be asked again. */
+	res = KSI_CTX_setExtender(ctx, getFullResourcePathUri(TEST_EXT_NOK_RESPONSE_FILE), "anon", "anon");
+	CuAssert(tc, "Unable to set extender file URI.", res == KSI_OK);
+
+	res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_CALENDAR_BASED, &context, &result);
+	CuAssert(tc, "Policy verification failed.", res == KSI_OK && result->finalResult.resultCode == KSI_VER_RES_OK);
+	CuAssert(tc, "Unexpected verification property.", SuccessfulProperty(&result->finalResult, KSI_VERIFY_CALCHAIN_ONLINE));
+
+	res = KSI_CTX_getCalendarChainCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "Second extension should be served from the cache.", res == KSI_OK && hits == 1 && misses == 1);
+
+	/* Disabling the cache drops the cached chains. */
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE, (void *)0);
+	CuAssert(tc, "Unable to set calendar chain cache size.", res == KSI_OK);
+	KSI_PolicyVerificationResult_free(result);
+	result = NULL;
+
+	/* The response file expects the first request id. */
+	preTest();
+
+	res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_CALENDAR_BASED, &context, &result);
+	CuAssert(tc, "Policy verification failed.", res == KSI_OK && result->finalResult.resultCode == KSI_VER_RES_FAIL);
+
+	res = KSI_CTX_getCalendarChainCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "Disabled cache should have no statistics.", res == KSI_OK && hits == 0 && misses == 0);
+
+	KSI_PolicyVerificationResult_free(result);
+	KSI_Signature_free(signature);
+	KSI_VerificationContext_clean(&context);
+
+#undef TEST_SIGNATURE_FILE
+#undef TEST_EXT_RESPONSE_FILE
+#undef TEST_EXT_NOK_RESPONSE_FILE
+}
+
+static void TestCalendarBasedPolicy_OK_WithPublicationRecord_hugeChainCacheSize(CuTest* tc) {
+#define TEST_SIGNATURE_FILE    "resource/tlv/ok-sig-2014-04-30.1-extended.ksig"
+#define TEST_EXT_RESPONSE_FILE "resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response.tlv"
+	int res;
+	KSI_VerificationContext context;
+	KSI_PolicyVerificationResult *result = NULL;
+	KSI_Signature *signature = NULL;
+	size_t hits = 0;
+	size_t misses = 0;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	KSI_ERR_clearErrors(ctx);
+
+	/* The size is truncated to the maximum instead of failing to allocate the cache. */
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE, (void *)(size_t)-1);
+	CuAssert(tc, "Unable to set calendar chain cache size.", res == KSI_OK);
+
+	res = KSI_VerificationContext_init(&context, ctx);
+	CuAssert(tc, "Verification context creation failed.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &signature);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && signature != NULL);
+	context.signature = signature;
+
+	res = KSI_CTX_setExtender(ctx, getFullResourcePathUri(TEST_EXT_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set extender file URI.", res == KSI_OK);
+
+	res = KSI_SignatureVerifier_verify(KSI_VERIFICATION_POLICY_CALENDAR_BASED, &context, &result);
+	CuAssert(tc, "Policy verification failed.", res == KSI_OK && result->finalResult.resultCode == KSI_VER_RES_OK);
+
+	res = KSI_CTX_getCalendarChainCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "Extension should be sent to the extender.", res == KSI_OK && hits == 0 && misses == 1);
+
+	res = KSI_CTX_setOption(ctx, KSI_OPT_CALENDAR_CHAIN_CACHE_SIZE, (void *)0);
+	CuAssert(tc, "Unable to set calendar chain cache size.", res == KSI_OK);
+
+	KSI_PolicyVerificationResult_free(result);
+	KSI_Signature_free(signature);
+	KSI_VerificationContext_clean(&context);
+
+#undef TEST_SIGNATURE_FILE
+#undef TEST_EXT_RESPONSE_FILE
+}
+
+static void TestCalendarBasedPolicy_OK_WithPublicationRecord_batch(CuTest* tc) {
+#define TEST_SIGNATURE_FILE    "resource/tlv/ok-sig-2014-04-30.1-extended.ksig"
+#define TEST_EXT_RESPONSE_FILE "resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-extend_response.tlv"
+#define TEST_BATCH_SIZE 3
+	int res;
+	KSI_VerificationContext context;
+	KSI_PolicyVerificationResult *results[TEST_BATCH_SIZE];
+	KSI_Signature *signatures[TEST_BATCH_SIZE];
+	KSI_RuleVerificationResult expected = {
+		KSI_VER_RES_OK,
+		KSI_VER_ERR_NONE,
+		"KSI_VerificationRule_ExtendedSignatureCalendarChainAggregationTime"
+	};
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t i;
+
+	KSI_LOG_debug(ctx, "%s", __FUNCTION__);
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_VerificationContext_init(&context, ctx);
+	CuAssert(tc, "Verification context creation failed.", res == KSI_OK);
+
+	for (i = 0; i < TEST_BATCH_SIZE; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &signatures[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && signatures[i] != NULL);
+	}
+
+	res = KSI_CTX_setExtender(ctx, getFullResourcePathUri(TEST_EXT_RESPONSE_FILE), TEST_USER, TEST_PASS);
+	CuAssert(tc, "Unable to set extender file URI.", res == KSI_OK);
+
+	res = KSI_SignatureVerifier_verifyBatch(KSI_VERIFICATION_POLICY_CALENDAR_BASED, &context, signatures, NULL, TEST_BATCH_SIZE, results);
+	CuAssert(tc, "Policy verification failed.", res == KSI_OK);
+
+	for (i = 0; i < TEST_BATCH_SIZE; i++) {
+		CuAssert(tc, "Unexpected verification result.", results[i] != NULL && ResultsMatch(&expected, &results[i]->finalResult));
+		CuAssert(tc, "Unexpected verification property.", SuccessfulProperty(&results[i]->finalResult, KSI_VERIFY_CALCHAIN_ONLINE));
+		KSI_PolicyVerificationResult_free(results[i]);
+		KSI_Signature_free(signatures[i]);
+	}
+
+	/* The signatures share the extension, thus the extender should have been asked only once. */
+	CuAssert(tc, "Extender should be asked only once.", ctx->netProvider->requestCount == 1);
+	CuAssert(tc, "Template context should be restored.", context.signature == NULL && context.documentHash == NULL);
+
+	/* The chains cached for the batch are dropped, as the context cache is disabled. */
+	res = KSI_CTX_getCalendarChainCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "Batch cache should be dropped.", res == KSI_OK && hits == 0 && misses == 0);
+
+	KSI_VerificationContext_clean(&context);
+
+#undef TEST_SIGNATURE_FILE
+#undef TEST_EXT_RESPONSE_FILE
+#undef TEST_BATCH_SIZE
+}
+
 static void TestCalendarBasedPolicy_FAIL_WithPublicationRecord(CuTest* tc) {
 	#define TEST_SIGNATURE_FILE    "resource/tlv/ok-sig-2014-04-30.1-extended.ksig"
 	#define TEST_EXT_RESPONSE_FILE "resource/tlv/" TEST_RESOURCE_EXT_VER "/ok-sig-2014-04-30.1-nok-extend_response-1.tlv"
@@ -3744,6 +3917,9 @@ CuSuite* KSITest_Policy_getSuite(void) {
 	SUITE_ADD_TEST(suite, TestInternalPolicy_FAIL_SignatureAggreChainSameIndexChangedChainOrder);
 	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_NA_ExtenderErrors);
 	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithPublicationRecord);
+	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithPublicationRecord_cachedExtension);
+	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithPublicationRecord_hugeChainCacheSize);
+	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithPublicationRecord_batch);
 	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_FAIL_WithPublicationRecord);
 	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithoutPublicationRecord);
 	SUITE_ADD_TEST(suite, TestCalendarBasedPolicy_OK_WithoutCalendarHashChain);
@@ -119,6 +119,55 @@ static void testVerifyPublicationsFile(CuTest *tc) {
 	KSI_PublicationsFile_free(pubFile);
 }
 
+static void testVerifyPublicationsFileRepeatedly(CuTest *tc) {
+	int res;
+	KSI_PublicationsFile *pubFile = NULL;
+	KSI_PKITruststore *pki = NULL;
+	KSI_CTX *ctx = NULL;
+	KSI_CertConstraint cnstr[2];
+
+	cnstr[0].oid = KSI_CERT_EMAIL;
+	cnstr[0].val = "publications@guardtime.com";
+	cnstr[1].oid = NULL;
+	cnstr[1].val = NULL;
+
+	res = KSI_CTX_new(&ctx);
+	CuAssert(tc, "Unable to create KSI ctx.", res == KSI_OK && ctx != NULL);
+
+	res = KSI_PublicationsFile_fromFile(ctx, getFullResourcePath(TEST_PUBLICATIONS_FILE), &pubFile);
+	CuAssert(tc, "Unable to read publications file.", res == KSI_OK && pubFile != NULL);
+
+	res = KSI_PKITruststore_new(ctx, 0, &pki);
+	CuAssert(tc, "Unable to get PKI truststore from context.", res == KSI_OK && pki != NULL);
+
+	res = KSI_CTX_setPKITruststore(ctx, pki);
+	CuAssert(tc, "Unable to set new pki truststrore for ksi context.", res == KSI_OK);
+
+	res = KSI_PKITruststore_addLookupFile(pki, getFullResourcePath("resource/crt/mock.crt"));
+	CuAssert(tc, "Unable to read certificate.", res == KSI_OK);
+
+	res = KSI_CTX_setDefaultPubFileCertConstraints(ctx, cnstr);
+	CuAssert(tc, "Unable to set verification certificate constraints.", res == KSI_OK);
+
+	/* The second verification uses the already verified certificate chain. */
+	res = KSI_PublicationsFile_verify(pubFile, ctx);
+	CuAssert(tc, "Publications file should verify with mock certificate.", res == KSI_OK);
+
+	res = KSI_PublicationsFile_verify(pubFile, ctx);
+	CuAssert(tc, "Publications file should verify again with mock certificate.", res == KSI_OK);
+
+	/* The constraints must still be checked for a known certificate chain. */
+	cnstr[0].val = "publications@guardtime.co";
+	res = KSI_CTX_setDefaultPubFileCertConstraints(ctx, cnstr);
+	CuAssert(tc, "Unable to set verification certificate constraints.", res == KSI_OK);
+
+	res = KSI_PublicationsFile_verify(pubFile, ctx);
+	CuAssert(tc, "Publications file may not verify with a value prefix.", res != KSI_OK);
+
+	KSI_PublicationsFile_free(pubFile);
+	KSI_CTX_free(ctx);
+}
+
 /**
  * To generate new certificate chain one must, generate N x new key pairs, create
  * certificate requests (Containing e.g. email, organization, name ...) for every
@@ -1017,6 +1066,7 @@ CuSuite* KSITest_Publicationsfile_getSuite(void) {
 	SUITE_ADD_TEST(suite, testLoadPublicationsFileWithNoCerts);
 	SUITE_ADD_TEST(suite, testLoadPublicationsFileContainsInvalidSignatureAndUnknownElement);
 	SUITE_ADD_TEST(suite, testVerifyPublicationsFile);
+	SUITE_ADD_TEST(suite, testVerifyPublicationsFileRepeatedly);
 	SUITE_ADD_TEST(suite, testVerifyPublicationsFileContainsIntermediateCerts);
 	SUITE_ADD_TEST(suite, testPublicationStringEncodingAndDecoding);
 	SUITE_ADD_TEST(suite, testFindPublicationByPubStr);
@@ -400,6 +400,65 @@ static void testSerializeSignature(CuTest *tc) {
 #undef TEST_SIGNATURE_FILE
 }
 
+static void testParseSignatureView(CuTest *tc) {
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
+
+	int res;
+
+	unsigned char in[0x1ffff];
+	unsigned char orig[0x1ffff];
+	size_t in_len = 0;
+
+	unsigned char *out = NULL;
+	size_t out_len = 0;
+
+	FILE *f = NULL;
+
+	KSI_Signature *sig = NULL;
+	KSI_Signature *clone = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	f = fopen(getFullResourcePath(TEST_SIGNATURE_FILE), "rb");
+	CuAssert(tc, "Unable to open signature file.", f != NULL);
+
+	in_len = (unsigned)fread(in, 1, sizeof(in), f);
+	CuAssert(tc, "Nothing read from signature file.", in_len > 0);
+
+	fclose(f);
+	memcpy(orig, in, in_len);
+
+	res = KSI_Signature_parseView(ctx, in, in_len, &sig);
+	CuAssert(tc, "Failed to parse signature.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_serialize(sig, &out, &out_len);
+	CuAssert(tc, "Failed to serialize signature.", res == KSI_OK);
+	CuAssert(tc, "Serialized signature length mismatch.", in_len == out_len);
+	CuAssert(tc, "Serialized signature content mismatch.", !memcmp(orig, out, in_len));
+	KSI_free(out);
+	out = NULL;
+
+	res = KSI_Signature_clone(sig, &clone);
+	CuAssert(tc, "Failed to clone signature.", res == KSI_OK && clone != NULL);
+
+	/* The clone may not depend on the input buffer. */
+	KSI_Signature_free(sig);
+	memset(in, 0, in_len);
+
+	res = KSI_Signature_serialize(clone, &out, &out_len);
+	CuAssert(tc, "Failed to serialize cloned signature.", res == KSI_OK);
+	CuAssert(tc, "Cloned signature length mismatch.", in_len == out_len);
+	CuAssert(tc, "Cloned signature content mismatch.", !memcmp(orig, out, in_len));
+
+	res = KSI_verifySignature(ctx, clone);
+	CuAssert(tc, "Unable to verify cloned signature.", res == KSI_OK);
+
+	KSI_free(out);
+	KSI_Signature_free(clone);
+
+#undef TEST_SIGNATURE_FILE
+}
+
 static void testVerifyDocument(CuTest *tc) {
 #define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
 
@@ -1031,6 +1090,7 @@ CuSuite* KSITest_Signature_getSuite(void) {
 	SUITE_ADD_TEST(suite, testSignatureSigningTime);
 	SUITE_ADD_TEST(suite, testSignatureSigningTimeNoCalendarChain);
 	SUITE_ADD_TEST(suite, testSerializeSignature);
+	SUITE_ADD_TEST(suite, testParseSignatureView);
 	SUITE_ADD_TEST(suite, testVerifyDocument);
 	SUITE_ADD_TEST(suite, testVerifyDocumentHash);
 	SUITE_ADD_TEST(suite, testVerifySignatureNew);
@@ -413,6 +413,7 @@ static void testMissingMandatoryTagError(CuTest* tc) {
 }
 
 KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationRespPdu);
+KSI_IMPORT_TLV_TEMPLATE(KSI_Header);
 
 static void testUnknownCriticalTagErrorPduVer2(CuTest* tc) {
 	testErrorMessage(tc, "Unknown critical tag: [0x221]->[0x03]aggr_err->[0x01]",
@@ -432,6 +433,189 @@ static void testMissingMandatoryTagErrorPduVer2(CuTest* tc) {
 			);
 }
 
+static void readSample(CuTest *tc, const char *sample, unsigned char *buf, size_t buf_size, size_t *len) {
+	FILE *f = NULL;
+
+	f = fopen(getFullResourcePath(sample), "rb");
+	CuAssert(tc, "Unable to open sample file.", f != NULL);
+
+	*len = fread(buf, 1, buf_size, f);
+	fclose(f);
+	CuAssert(tc, "Unable to read sample file.", *len > 0);
+}
+
+static void testTemplateParseMatchesExtract(CuTest *tc) {
+	int res;
+	unsigned char in[0xffff + 4];
+	size_t in_len = 0;
+	KSI_TLV *tlv = NULL;
+	KSI_LIST(KSI_TLV) *nested = NULL;
+	KSI_AggregationPdu *parsed = NULL;
+	KSI_AggregationPdu *extracted = NULL;
+	unsigned char *parsedRaw = NULL;
+	size_t parsedRaw_len = 0;
+	unsigned char *extractedRaw = NULL;
+	size_t extractedRaw_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+
+	readSample(tc, "resource/tlv/v2/aggr_response.tlv", in, sizeof(in), &in_len);
+
+	/* Decode straight from the raw data. */
+	res = KSI_AggregationPdu_new(ctx, &parsed);
+	CuAssert(tc, "Unable to create PDU.", res == KSI_OK && parsed != NULL);
+
+	res = KSI_TlvTemplate_parse(ctx, in, in_len, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), parsed);
+	CuAssert(tc, "Unable to parse PDU.", res == KSI_OK);
+
+	/* Extract from an already expanded TLV tree. */
+	res = KSI_TLV_parseBlob(ctx, in, in_len, &tlv);
+	CuAssert(tc, "Unable to parse TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_TLV_getNestedList(tlv, &nested);
+	CuAssert(tc, "Unable to expand TLV.", res == KSI_OK && KSI_TLV_isNested(tlv));
+
+	res = KSI_AggregationPdu_new(ctx, &extracted);
+	CuAssert(tc, "Unable to create PDU.", res == KSI_OK && extracted != NULL);
+
+	res = KSI_TlvTemplate_extract(ctx, extracted, tlv, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu));
+	CuAssert(tc, "Unable to extract PDU.", res == KSI_OK);
+
+	res = KSI_TlvTemplate_serializeObject(ctx, parsed, 0x221, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), &parsedRaw, &parsedRaw_len);
+	CuAssert(tc, "Unable to serialize parsed PDU.", res == KSI_OK);
+
+	res = KSI_TlvTemplate_serializeObject(ctx, extracted, 0x221, 0, 0, KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), &extractedRaw, &extractedRaw_len);
+	CuAssert(tc, "Unable to serialize extracted PDU.", res == KSI_OK);
+
+	CuAssert(tc, "Serialized length mismatch.", parsedRaw_len == in_len && extractedRaw_len == in_len);
+	CuAssert(tc, "Serialized content mismatch.", !memcmp(parsedRaw, in, in_len) && !memcmp(extractedRaw, in, in_len));
+
+	KSI_free(parsedRaw);
+	KSI_free(extractedRaw);
+	KSI_AggregationPdu_free(parsed);
+	KSI_AggregationPdu_free(extracted);
+	KSI_TLV_free(tlv);
+}
+
+static void testTemplateParseTruncatedNested(CuTest *tc) {
+	int res;
+	/* Header with a nested TLV claiming more data than available: [0x221]->[0x01] */
+	unsigned char in[] = {0x82, 0x21, 0x00, 0x04, 0x01, 0x05, 0x01, 0x01};
+	KSI_AggregationPdu *pdu = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_AggregationPdu_new(ctx, &pdu);
+	CuAssert(tc, "Unable to create PDU.", res == KSI_OK && pdu != NULL);
+
+	res = KSI_TlvTemplate_parse(ctx, in, sizeof(in), KSI_TLV_TEMPLATE(KSI_AggregationRespPdu), pdu);
+	CuAssert(tc, "Truncated nested TLV must not be parsed.", res == KSI_INVALID_FORMAT);
+
+	KSI_AggregationPdu_free(pdu);
+}
+
+static void testTemplateParseTagLookup(CuTest *tc) {
+	int res;
+	/* Header elements in reverse order: [0x03]message_id, [0x01]login_id, [0x02]instance_id. */
+	unsigned char in[] = {0x01, 0x0a, 0x03, 0x01, 0x07, 0x01, 0x02, 'a', 0x00, 0x02, 0x01, 0x05};
+	/* Header with a repeated unique [0x03]message_id. */
+	unsigned char dup[] = {0x01, 0x0a, 0x01, 0x02, 'a', 0x00, 0x03, 0x01, 0x07, 0x03, 0x01, 0x08};
+	KSI_Header *hdr = NULL;
+	KSI_Integer *val = NULL;
+	int i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	/* Parse twice, to use both a freshly compiled and a cached template. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_Header_new(ctx, &hdr);
+		CuAssert(tc, "Unable to create header.", res == KSI_OK && hdr != NULL);
+
+		res = KSI_TlvTemplate_parse(ctx, in, sizeof(in), KSI_TLV_TEMPLATE(KSI_Header), hdr);
+		CuAssert(tc, "Unable to parse header.", res == KSI_OK);
+
+		res = KSI_Header_getMessageId(hdr, &val);
+		CuAssert(tc, "Message id mismatch.", res == KSI_OK && KSI_Integer_equalsUInt(val, 7));
+
+		res = KSI_Header_getInstanceId(hdr, &val);
+		CuAssert(tc, "Instance id mismatch.", res == KSI_OK && KSI_Integer_equalsUInt(val, 5));
+
+		KSI_Header_free(hdr);
+		hdr = NULL;
+	}
+
+	res = KSI_Header_new(ctx, &hdr);
+	CuAssert(tc, "Unable to create header.", res == KSI_OK && hdr != NULL);
+
+	res = KSI_TlvTemplate_parse(ctx, dup, sizeof(dup), KSI_TLV_TEMPLATE(KSI_Header), hdr);
+	CuAssert(tc, "Repeated unique tag must not be parsed.", res == KSI_INVALID_FORMAT);
+
+	KSI_Header_free(hdr);
+}
+
+KSI_IMPORT_TLV_TEMPLATE(KSI_Signature);
+
+static void testTemplateWriteBytes(CuTest *tc) {
+	int res;
+	unsigned char in[0xffff + 4];
+	size_t in_len = 0;
+	unsigned char out[0xffff + 4];
+	size_t out_len = 0;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_TLV *tlv = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	ctx->options[KSI_OPT_AGGR_PDU_VER] = KSI_PDU_VERSION_1;
+
+	readSample(tc, "resource/tlv/v1/aggr_response.tlv", in, sizeof(in), &in_len);
+
+	res = KSI_AggregationPdu_parse(ctx, in, in_len, &pdu);
+	CuAssert(tc, "Unable to parse PDU.", res == KSI_OK && pdu != NULL);
+
+	res = KSI_AggregationPdu_writeBytes(pdu, NULL, 0, &out_len, 0);
+	CuAssert(tc, "Unable to calculate serialized length.", res == KSI_OK && out_len == in_len);
+
+	res = KSI_AggregationPdu_writeBytes(pdu, out, sizeof(out), &out_len, 0);
+	CuAssert(tc, "Unable to serialize PDU.", res == KSI_OK && out_len == in_len);
+	CuAssert(tc, "Serialized PDU mismatch.", !memcmp(out, in, in_len));
+
+	res = KSI_AggregationPdu_writeBytes(pdu, out, sizeof(out), &out_len, KSI_TLV_OPT_NO_MOVE);
+	CuAssert(tc, "Unable to serialize PDU.", res == KSI_OK && out_len == in_len);
+	CuAssert(tc, "PDU not serialized to the end of the buffer.", !memcmp(out + sizeof(out) - in_len, in, in_len));
+
+	res = KSI_AggregationPdu_writeBytes(pdu, out, in_len - 1, &out_len, 0);
+	CuAssert(tc, "Too small buffer must not be accepted.", res == KSI_BUFFER_OVERFLOW);
+
+	ctx->options[KSI_OPT_AGGR_PDU_VER] = KSI_AGGREGATION_PDU_VERSION;
+
+	/* Signature with legacy id links - the writer output must match the TLV tree. */
+	readSample(tc, "resource/tlv/ok-sig-2014-04-30.1.ksig", in, sizeof(in), &in_len);
+
+	res = KSI_Signature_parse(ctx, in, in_len, &sig);
+	CuAssert(tc, "Unable to parse signature.", res == KSI_OK && sig != NULL);
+
+	/* Serialize the signature via the intermediate TLV tree. */
+	res = KSI_TLV_new(ctx, 0x0800, 0, 0, &tlv);
+	CuAssert(tc, "Unable to create TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_TlvTemplate_construct(ctx, tlv, sig, KSI_TLV_TEMPLATE(KSI_Signature));
+	CuAssert(tc, "Unable to construct signature TLV.", res == KSI_OK);
+
+	res = KSI_TLV_serialize_ex(tlv, in, sizeof(in), &in_len);
+	CuAssert(tc, "Unable to serialize signature TLV.", res == KSI_OK);
+
+	res = KSI_TlvTemplate_writeBytes(ctx, sig, 0x0800, 0, 0, KSI_TLV_TEMPLATE(KSI_Signature), out, sizeof(out), &out_len, 0);
+	CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && out_len == in_len);
+	CuAssert(tc, "Serialized signature mismatch.", !memcmp(out, in, in_len));
+
+	KSI_TLV_free(tlv);
+
+	KSI_Signature_free(sig);
+	KSI_AggregationPdu_free(pdu);
+}
+
 CuSuite* KSITest_TLV_Sample_getSuite(void)
 {
 	CuSuite* suite = CuSuiteNew();
@@ -448,6 +632,10 @@ CuSuite* KSITest_TLV_Sample_getSuite(void)
 	SUITE_ADD_TEST(suite, testMissingMandatoryTagError);
 	SUITE_ADD_TEST(suite, testUnknownCriticalTagErrorPduVer2);
 	SUITE_ADD_TEST(suite, testMissingMandatoryTagErrorPduVer2);
+	SUITE_ADD_TEST(suite, testTemplateParseMatchesExtract);
+	SUITE_ADD_TEST(suite, testTemplateParseTruncatedNested);
+	SUITE_ADD_TEST(suite, testTemplateParseTagLookup);
+	SUITE_ADD_TEST(suite, testTemplateWriteBytes);
 
 	return suite;
 }
@@ -412,6 +412,172 @@ static void testTlvSerializeNested(CuTest* tc) {
 
 }
 
+static void testTlvSetRawNestedResize(CuTest* tc) {
+	int res;
+	unsigned char raw[] = "\x01\x08" "\x02\x02" "\xaa\xbb" "\x03\x02" "\xcc\xdd";
+	unsigned char expLong[] = "\x01\x0c" "\x02\x06" "\x00\x11\x22\x33\x44\x55" "\x03\x02" "\xcc\xdd";
+	unsigned char expShort[] = "\x01\x07" "\x02\x01" "\x66" "\x03\x02" "\xcc\xdd";
+	unsigned char longVal[] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+	unsigned char shortVal[] = {0x66};
+	unsigned char *buf = NULL;
+	size_t buf_len;
+	const unsigned char *val = NULL;
+	size_t val_len = 0;
+	KSI_TLV *tlv = NULL;
+	KSI_TLV *nested = NULL;
+	KSI_LIST(KSI_TLV) *list = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	res = KSI_TLV_parseBlob(ctx, raw, sizeof(raw) - 1, &tlv);
+	CuAssert(tc, "Failed to create TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_TLV_getNestedList(tlv, &list);
+	CuAssert(tc, "Unable to get nested list from TLV.", res == KSI_OK && list != NULL);
+
+	res = KSI_TLVList_elementAt(list, 0, &nested);
+	CuAssert(tc, "Unable to read nested TLV.", res == KSI_OK && nested != NULL);
+
+	/* Grow the nested value beyond its original storage. */
+	res = KSI_TLV_setRawValue(nested, longVal, sizeof(longVal));
+	CuAssert(tc, "Failed to set raw value.", res == KSI_OK);
+
+	res = KSI_TLV_serialize(tlv, &buf, &buf_len);
+	CuAssert(tc, "Failed to serialize TLV.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "Serialized value mismatch.", buf_len == sizeof(expLong) - 1 && !KSITest_memcmp(buf, expLong, buf_len));
+	KSI_free(buf);
+	buf = NULL;
+
+	/* Shrink the nested value - the existing storage should be reused. */
+	res = KSI_TLV_setRawValue(nested, shortVal, sizeof(shortVal));
+	CuAssert(tc, "Failed to set raw value.", res == KSI_OK);
+
+	/* Collapse the nested structure into a raw value of the exact size. */
+	res = KSI_TLV_getRawValue(tlv, &val, &val_len);
+	CuAssert(tc, "Failed to get raw value.", res == KSI_OK);
+	CuAssert(tc, "Raw value mismatch.", val_len == sizeof(expShort) - 3 && !memcmp(val, expShort + 2, val_len));
+
+	res = KSI_TLV_serialize(tlv, &buf, &buf_len);
+	CuAssert(tc, "Failed to serialize TLV.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "Serialized value mismatch.", buf_len == sizeof(expShort) - 1 && !KSITest_memcmp(buf, expShort, buf_len));
+
+	KSI_free(buf);
+	KSI_TLV_free(tlv);
+}
+
+static void testTlvNestedDetachedOutlivesParent(CuTest* tc) {
+	int res;
+	unsigned char raw[] = "\x01\x0a" "\x02\x08" "\x03\x02" "\xaa\xbb" "\x04\x02" "\xcc\xdd";
+	unsigned char expParsed[] = "\x03\x02" "\xaa\xbb";
+	unsigned char expSet[] = "\x04\x03" "\x11\x22\x33";
+	unsigned char val[] = {0x11, 0x22, 0x33};
+	unsigned char *buf = NULL;
+	size_t buf_len;
+	KSI_TLV *tlv = NULL;
+	KSI_TLV *nested = NULL;
+	KSI_TLV *parsed = NULL;
+	KSI_TLV *set = NULL;
+	KSI_LIST(KSI_TLV) *list = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	res = KSI_TLV_parseBlob(ctx, raw, sizeof(raw) - 1, &tlv);
+	CuAssert(tc, "Failed to create TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_TLV_getNestedList(tlv, &list);
+	CuAssert(tc, "Unable to get nested list from TLV.", res == KSI_OK && list != NULL);
+
+	res = KSI_TLVList_elementAt(list, 0, &nested);
+	CuAssert(tc, "Unable to read nested TLV.", res == KSI_OK && nested != NULL);
+
+	res = KSI_TLV_getNestedList(nested, &list);
+	CuAssert(tc, "Unable to get nested list from TLV.", res == KSI_OK && list != NULL);
+
+	/* The second value is stored in the arena of the tree. */
+	res = KSI_TLVList_elementAt(list, 1, &set);
+	CuAssert(tc, "Unable to read nested TLV.", res == KSI_OK && set != NULL);
+
+	res = KSI_TLV_setRawValue(set, val, sizeof(val));
+	CuAssert(tc, "Failed to set raw value.", res == KSI_OK);
+
+	/* Detach both values and free the rest of the tree. */
+	res = KSI_TLVList_remove(list, 1, &set);
+	CuAssert(tc, "Unable to detach nested TLV.", res == KSI_OK && set != NULL);
+
+	res = KSI_TLVList_remove(list, 0, &parsed);
+	CuAssert(tc, "Unable to detach nested TLV.", res == KSI_OK && parsed != NULL);
+
+	KSI_TLV_free(tlv);
+	tlv = NULL;
+
+	res = KSI_TLV_serialize(parsed, &buf, &buf_len);
+	CuAssert(tc, "Failed to serialize TLV.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "Serialized value mismatch.", buf_len == sizeof(expParsed) - 1 && !KSITest_memcmp(buf, expParsed, buf_len));
+	KSI_free(buf);
+	buf = NULL;
+
+	res = KSI_TLV_serialize(set, &buf, &buf_len);
+	CuAssert(tc, "Failed to serialize TLV.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "Serialized value mismatch.", buf_len == sizeof(expSet) - 1 && !KSITest_memcmp(buf, expSet, buf_len));
+
+	/* The detached values may still allocate new storage. */
+	res = KSI_TLV_setRawValue(parsed, val, sizeof(val));
+	CuAssert(tc, "Failed to set raw value.", res == KSI_OK);
+
+	KSI_free(buf);
+	KSI_TLV_free(parsed);
+	KSI_TLV_free(set);
+}
+
+static void testTlvSerializeEmptyRaw(CuTest* tc) {
+	int res;
+	unsigned char exp[] = "\x05\x00";
+	unsigned char buf[2];
+	size_t buf_len = 0;
+	KSI_TLV *tlv = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	res = KSI_TLV_new(ctx, 0x05, 0, 0, &tlv);
+	CuAssert(tc, "Failed to create TLV.", res == KSI_OK && tlv != NULL);
+
+	res = KSI_TLV_serialize_ex(tlv, buf, sizeof(buf), &buf_len);
+	CuAssert(tc, "Failed to serialize empty TLV.", res == KSI_OK);
+	CuAssert(tc, "Serialized value mismatch.", buf_len == sizeof(exp) - 1 && !KSITest_memcmp(buf, exp, buf_len));
+
+	KSI_TLV_free(tlv);
+}
+
+static void testTlvSerializePayloadTooLong(CuTest* tc) {
+	int res;
+	static unsigned char chunk[0x8000];
+	unsigned char *buf = NULL;
+	size_t buf_len;
+	KSI_TLV *tlv = NULL;
+	KSI_TLV *nested = NULL;
+	int i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_TLV_new(ctx, 0x01, 0, 0, &tlv);
+	CuAssert(tc, "Failed to create TLV.", res == KSI_OK && tlv != NULL);
+
+	/* Two nested values together exceed the maximum payload size. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_TLV_new(ctx, 0x02, 0, 0, &nested);
+		CuAssert(tc, "Failed to create TLV.", res == KSI_OK && nested != NULL);
+
+		res = KSI_TLV_setRawValue(nested, chunk, sizeof(chunk));
+		CuAssert(tc, "Failed to set raw value.", res == KSI_OK);
+
+		res = KSI_TLV_appendNestedTlv(tlv, nested);
+		CuAssert(tc, "Failed to append nested TLV.", res == KSI_OK);
+		nested = NULL;
+	}
+
+	res = KSI_TLV_serialize(tlv, &buf, &buf_len);
+	CuAssert(tc, "Serializing a too long payload must fail.", res == KSI_BUFFER_OVERFLOW && buf == NULL);
+
+	KSI_TLV_free(tlv);
+}
+
 KSI_IMPORT_TLV_TEMPLATE(KSI_Signature);
 
 static void testTlvSerializeMandatoryListObjectEmpty(CuTest *tc) {
@@ -678,6 +844,10 @@ CuSuite* KSITest_TLV_getSuite(void)
 	SUITE_ADD_TEST(suite, testTlvSerializeString);
 	SUITE_ADD_TEST(suite, testTlvSerializeUint);
 	SUITE_ADD_TEST(suite, testTlvSerializeNested);
+	SUITE_ADD_TEST(suite, testTlvSetRawNestedResize);
+	SUITE_ADD_TEST(suite, testTlvNestedDetachedOutlivesParent);
+	SUITE_ADD_TEST(suite, testTlvSerializeEmptyRaw);
+	SUITE_ADD_TEST(suite, testTlvSerializePayloadTooLong);
 	SUITE_ADD_TEST(suite, testTlvSerializeMandatoryListObjectEmpty);
 	SUITE_ADD_TEST(suite, testTlvLenientFlag);
 	SUITE_ADD_TEST(suite, testTlvForwardFlag);
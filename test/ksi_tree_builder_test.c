@@ -26,6 +26,9 @@
 #include <ksi/tree_builder.h>
 #include <ksi/hashchain.h>
 
+#include "../src/ksi/impl/hash_impl.h"
+#include "../src/ksi/impl/tree_builder_impl.h"
+
 extern KSI_CTX *ctx;
 
 static void testCreateTreeBuilder(CuTest* tc) {
@@ -124,6 +127,853 @@ static void testGetAggregationChain(CuTest* tc) {
 }
 
 
+/* Adds a meta-data sibling to every third leaf. */
+static int testMetaDataProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+	size_t *counter = c;
+	KSI_MetaData *md = NULL;
+	KSI_Utf8String *cId = NULL;
+	int res = KSI_OK;
+
+	*out = NULL;
+	if ((*counter)++ % 3 != 0) goto cleanup;
+
+	res = KSI_MetaData_new(ctx, &md);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(ctx, "flat", 5, &cId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_MetaData_setClientId(md, cId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TreeNode_new(ctx, NULL, md, in->level, out);
+
+cleanup:
+
+	KSI_Utf8String_free(cId);
+	KSI_MetaData_free(md);
+
+	return res;
+}
+
+/* Adds a sibling derived from the input hash, similar to the block signer masking. */
+static int testMaskingProcessor(KSI_TreeNode *in, void KSI_UNUSED(*c), KSI_TreeNode **out) {
+	KSI_DataHash *mask = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	int res;
+
+	*out = NULL;
+	if (in->hash == NULL) return KSI_OK;
+
+	res = KSI_DataHash_getImprint(in->hash, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_create(ctx, imprint, imprint_len, KSI_HASHALG_SHA2_256, &mask);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TreeNode_new(ctx, mask, NULL, in->level, out);
+
+cleanup:
+
+	KSI_DataHash_free(mask);
+
+	return res;
+}
+
+static void assertChainsEqual(CuTest *tc, KSI_AggregationHashChain *exp, KSI_AggregationHashChain *act) {
+	int res;
+	KSI_LIST(KSI_HashChainLink) *expLinks = NULL;
+	KSI_LIST(KSI_HashChainLink) *actLinks = NULL;
+	KSI_DataHash *expHsh = NULL;
+	KSI_DataHash *actHsh = NULL;
+	size_t i;
+
+	res = KSI_AggregationHashChain_getInputHash(exp, &expHsh);
+	CuAssert(tc, "Unable to get input hash.", res == KSI_OK);
+	res = KSI_AggregationHashChain_getInputHash(act, &actHsh);
+	CuAssert(tc, "Unable to get input hash.", res == KSI_OK);
+	CuAssert(tc, "Input hash mismatch.", (expHsh == NULL && actHsh == NULL) || KSI_DataHash_equals(expHsh, actHsh));
+
+	res = KSI_AggregationHashChain_getChain(exp, &expLinks);
+	CuAssert(tc, "Unable to get chain links.", res == KSI_OK && expLinks != NULL);
+	res = KSI_AggregationHashChain_getChain(act, &actLinks);
+	CuAssert(tc, "Unable to get chain links.", res == KSI_OK && actLinks != NULL);
+	CuAssert(tc, "Chain length mismatch.", KSI_HashChainLinkList_length(expLinks) == KSI_HashChainLinkList_length(actLinks));
+
+	for (i = 0; i < KSI_HashChainLinkList_length(expLinks); i++) {
+		KSI_HashChainLink *expLink = NULL;
+		KSI_HashChainLink *actLink = NULL;
+		KSI_Integer *expCorr = NULL;
+		KSI_Integer *actCorr = NULL;
+		KSI_MetaDataElement *expMd = NULL;
+		KSI_MetaDataElement *actMd = NULL;
+		int expLeft;
+		int actLeft;
+
+		res = KSI_HashChainLinkList_elementAt(expLinks, i, &expLink);
+		CuAssert(tc, "Unable to get link.", res == KSI_OK && expLink != NULL);
+		res = KSI_HashChainLinkList_elementAt(actLinks, i, &actLink);
+		CuAssert(tc, "Unable to get link.", res == KSI_OK && actLink != NULL);
+
+		KSI_HashChainLink_getIsLeft(expLink, &expLeft);
+		KSI_HashChainLink_getIsLeft(actLink, &actLeft);
+		CuAssert(tc, "Link direction mismatch.", !expLeft == !actLeft);
+
+		KSI_HashChainLink_getLevelCorrection(expLink, &expCorr);
+		KSI_HashChainLink_getLevelCorrection(actLink, &actCorr);
+		CuAssert(tc, "Level correction mismatch.", KSI_Integer_getUInt64(expCorr) == KSI_Integer_getUInt64(actCorr));
+
+		KSI_HashChainLink_getImprint(expLink, &expHsh);
+		KSI_HashChainLink_getImprint(actLink, &actHsh);
+		CuAssert(tc, "Link imprint mismatch.", (expHsh == NULL && actHsh == NULL) || KSI_DataHash_equals(expHsh, actHsh));
+
+		KSI_HashChainLink_getMetaData(expLink, &expMd);
+		KSI_HashChainLink_getMetaData(actLink, &actMd);
+		CuAssert(tc, "Link meta-data mismatch.", (expMd == NULL) == (actMd == NULL));
+	}
+}
+
+static void testFlatTreeBuilderMatchesTreeBuilder(CuTest* tc) {
+#define FLAT_TEST_LEAVES 37
+	int res;
+	KSI_TreeBuilder *builder = NULL;
+	KSI_FlatTreeBuilder *flat = NULL;
+	KSI_TreeLeafHandle *handles[FLAT_TEST_LEAVES];
+	size_t leafIds[FLAT_TEST_LEAVES];
+	size_t counters[2] = {0, 0};
+	KSI_TreeBuilderLeafProcessor masking = {testMaskingProcessor, NULL};
+	KSI_TreeBuilderLeafProcessor metaData[2] = {{testMetaDataProcessor, &counters[0]}, {testMetaDataProcessor, &counters[1]}};
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *root = NULL;
+	KSI_DataHash *flatRoot = NULL;
+	KSI_DataHash *tmp = NULL;
+	KSI_MetaData *md = NULL;
+	KSI_Utf8String *cId = NULL;
+	KSI_AggregationHashChain *chn = NULL;
+	KSI_AggregationHashChain *flatChn = NULL;
+	int flatLevel = 0;
+	char buf[32];
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &flat);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && flat != NULL);
+
+	res = KSI_TreeBuilderLeafProcessorList_append(builder->cbList, &masking);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+	res = KSI_TreeBuilderLeafProcessorList_append(builder->cbList, &metaData[0]);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_addLeafProcessor(flat, &masking);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+	res = KSI_FlatTreeBuilder_addLeafProcessor(flat, &metaData[1]);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	for (i = 0; i < FLAT_TEST_LEAVES; i++) {
+		/* Mix in leaves with shorter and longer hashes, higher levels and a meta-data leaf. */
+		int level = (i % 5 == 3) ? 2 : 0;
+		KSI_HashAlgorithm algo = (i % 4 == 1) ? KSI_HASHALG_SHA1 : (i % 7 == 2) ? KSI_HASHALG_SHA2_512 : KSI_HASHALG_SHA2_256;
+
+		if (i == 10) {
+			res = KSI_MetaData_new(ctx, &md);
+			CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+			res = KSI_Utf8String_new(ctx, "leaf", 5, &cId);
+			CuAssert(tc, "Unable to create client id.", res == KSI_OK && cId != NULL);
+
+			res = KSI_MetaData_setClientId(md, cId);
+			CuAssert(tc, "Unable to set client id.", res == KSI_OK);
+
+			KSI_Utf8String_free(cId);
+			cId = NULL;
+
+			res = KSI_TreeBuilder_addMetaData(builder, md, level, &handles[i]);
+			CuAssert(tc, "Unable to add meta-data to the tree builder.", res == KSI_OK);
+
+			res = KSI_FlatTreeBuilder_addMetaData(flat, md, level, &leafIds[i]);
+			CuAssert(tc, "Unable to add meta-data to the flat tree builder.", res == KSI_OK);
+
+			KSI_MetaData_free(md);
+			md = NULL;
+			continue;
+		}
+
+		KSI_snprintf(buf, sizeof(buf), "leaf%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), algo, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_TreeBuilder_addDataHash(builder, hsh, level, &handles[i]);
+		CuAssert(tc, "Unable to add data hash to the tree builder.", res == KSI_OK);
+
+		res = KSI_FlatTreeBuilder_addDataHash(flat, hsh, level, &leafIds[i]);
+		CuAssert(tc, "Unable to add data hash to the flat tree builder.", res == KSI_OK);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	res = KSI_FlatTreeBuilder_getRoot(flat, &flatRoot, NULL);
+	CuAssert(tc, "Root of an open tree must not be available.", res == KSI_INVALID_STATE);
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_close(flat);
+	CuAssert(tc, "Unable to close a valid flat builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_addDataHash(flat, root, 0, NULL);
+	CuAssert(tc, "Leaves may not be added to a closed tree.", res != KSI_OK);
+
+	res = KSI_FlatTreeBuilder_getRoot(flat, &flatRoot, &flatLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && flatRoot != NULL);
+
+	root = KSI_DataHash_ref(builder->rootNode->hash);
+	CuAssert(tc, "Root hash mismatch.", KSI_DataHash_equals(root, flatRoot));
+	CuAssert(tc, "Root level mismatch.", flatLevel == (int)builder->rootNode->level);
+
+	for (i = 0; i < FLAT_TEST_LEAVES; i++) {
+		res = KSI_TreeLeafHandle_getAggregationChain(handles[i], &chn);
+		CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && chn != NULL);
+
+		res = KSI_FlatTreeBuilder_getAggregationChain(flat, leafIds[i], &flatChn);
+		CuAssert(tc, "Unable to extract flat aggregation chain.", res == KSI_OK && flatChn != NULL);
+
+		assertChainsEqual(tc, chn, flatChn);
+
+		if (i != 10) {
+			res = KSI_AggregationHashChain_aggregate(flatChn, (i % 5 == 3) ? 2 : 0, NULL, &tmp);
+			CuAssert(tc, "Unable to aggregate the aggregation hash chain.", res == KSI_OK && tmp != NULL);
+			CuAssert(tc, "Root hashes mismatch.", KSI_DataHash_equals(root, tmp));
+
+			KSI_DataHash_free(tmp);
+			tmp = NULL;
+		}
+
+		KSI_AggregationHashChain_free(chn);
+		chn = NULL;
+		KSI_AggregationHashChain_free(flatChn);
+		flatChn = NULL;
+
+		KSI_TreeLeafHandle_free(handles[i]);
+	}
+
+	KSI_DataHash_free(root);
+	KSI_DataHash_free(flatRoot);
+	KSI_FlatTreeBuilder_free(flat);
+	KSI_TreeBuilder_free(builder);
+#undef FLAT_TEST_LEAVES
+}
+
+
+typedef struct {
+	KSI_DataHash *prev;
+	KSI_MetaData *md;
+} TestChainState;
+
+/* Calculates a mask that depends on all the previous leaves, similar to the block signer. */
+static int testNextMask(TestChainState *st, const KSI_DataHash *leaf, KSI_DataHash **mask) {
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *tmp = NULL;
+	int res;
+
+	res = KSI_DataHasher_open(ctx, KSI_HASHALG_SHA2_256, &hsr);
+	if (res != KSI_OK) goto cleanup;
+
+	if (st->prev != NULL) {
+		res = KSI_DataHasher_addImprint(hsr, st->prev);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_DataHasher_addImprint(hsr, leaf);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_close(hsr, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_DataHash_free(st->prev);
+	st->prev = KSI_DataHash_ref(tmp);
+
+	*mask = tmp;
+	tmp = NULL;
+
+cleanup:
+
+	KSI_DataHash_free(tmp);
+	KSI_DataHasher_free(hsr);
+
+	return res;
+}
+
+static int testChainMaskingProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+	KSI_DataHash *mask = NULL;
+	int res;
+
+	res = testNextMask(c, in->hash, &mask);
+	if (res != KSI_OK) return res;
+
+	res = KSI_TreeNode_new(ctx, mask, NULL, in->level, out);
+	KSI_DataHash_free(mask);
+
+	return res;
+}
+
+static int testChainMetaDataProcessor(KSI_TreeNode *in, void *c, KSI_TreeNode **out) {
+	TestChainState *st = c;
+	return KSI_TreeNode_new(ctx, NULL, st->md, in->level, out);
+}
+
+static int testBatchMask(void *c, const KSI_DataHash *leaf, int KSI_UNUSED(level), KSI_DataHash *mask) {
+	KSI_DataHash *tmp = NULL;
+	int res;
+
+	res = testNextMask(c, leaf, &tmp);
+	if (res != KSI_OK) return res;
+
+	*mask = *tmp;
+	KSI_DataHash_free(tmp);
+
+	return KSI_OK;
+}
+
+static void testFlatTreeBatchMatchesTreeBuilder(CuTest* tc) {
+#define BATCH_TEST_WORKERS 3
+	static const size_t batchSizes[] = {1, 3, 100, 1, 257, 64, 5, 0};
+	static const int batchLevels[] = {0, 0, 0, 1, 0, 0, 2, 0};
+	int res;
+	KSI_TreeBuilder *builder = NULL;
+	KSI_FlatTreeBuilder *flat = NULL;
+	KSI_CTX *workerCtx[BATCH_TEST_WORKERS];
+	KSI_DataHasher *workerHsr[BATCH_TEST_WORKERS];
+	KSI_TreeLeafHandle **handles = NULL;
+	size_t *leafIds = NULL;
+	KSI_DataHash **hashes = NULL;
+	TestChainState refState = {NULL, NULL};
+	TestChainState batchState = {NULL, NULL};
+	KSI_TreeBuilderLeafProcessor masking = {testChainMaskingProcessor, &refState};
+	KSI_TreeBuilderLeafProcessor metaData = {testChainMetaDataProcessor, &refState};
+	KSI_MetaData *md = NULL;
+	KSI_Utf8String *cId = NULL;
+	KSI_DataHash *root = NULL;
+	KSI_DataHash *flatRoot = NULL;
+	KSI_AggregationHashChain *chn = NULL;
+	KSI_AggregationHashChain *flatChn = NULL;
+	int flatLevel = 0;
+	size_t total = 0;
+	size_t first;
+	size_t b;
+	size_t i;
+	char buf[32];
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (b = 0; batchSizes[b] != 0; b++) total += batchSizes[b];
+
+	hashes = KSI_calloc(total, sizeof(*hashes));
+	handles = KSI_calloc(total, sizeof(*handles));
+	leafIds = KSI_calloc(total, sizeof(*leafIds));
+	CuAssert(tc, "Out of memory.", hashes != NULL && handles != NULL && leafIds != NULL);
+
+	for (i = 0; i < BATCH_TEST_WORKERS; i++) {
+		res = KSI_CTX_new(&workerCtx[i]);
+		CuAssert(tc, "Unable to create worker context.", res == KSI_OK);
+
+		res = KSI_DataHasher_open(workerCtx[i], KSI_HASHALG_SHA2_256, &workerHsr[i]);
+		CuAssert(tc, "Unable to open worker hasher.", res == KSI_OK);
+	}
+
+	res = KSI_MetaData_new(ctx, &md);
+	CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+	res = KSI_Utf8String_new(ctx, "batch", 6, &cId);
+	CuAssert(tc, "Unable to create client id.", res == KSI_OK && cId != NULL);
+
+	res = KSI_MetaData_setClientId(md, cId);
+	CuAssert(tc, "Unable to set client id.", res == KSI_OK);
+
+	refState.md = md;
+
+	for (i = 0; i < total; i++) {
+		/* Mix in leaves with shorter and longer hashes. */
+		KSI_HashAlgorithm algo = (i % 4 == 1) ? KSI_HASHALG_SHA1 : (i % 7 == 2) ? KSI_HASHALG_SHA2_512 : KSI_HASHALG_SHA2_256;
+
+		KSI_snprintf(buf, sizeof(buf), "leaf%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), algo, &hashes[i]);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hashes[i] != NULL);
+	}
+
+	res = KSI_TreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &builder);
+	CuAssert(tc, "Unable to create tree builder.", res == KSI_OK && builder != NULL);
+
+	res = KSI_TreeBuilderLeafProcessorList_append(builder->cbList, &masking);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+	res = KSI_TreeBuilderLeafProcessorList_append(builder->cbList, &metaData);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &flat);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && flat != NULL);
+
+	for (b = 0, first = 0; batchSizes[b] != 0; first += batchSizes[b++]) {
+		for (i = first; i < first + batchSizes[b]; i++) {
+			res = KSI_TreeBuilder_addDataHash(builder, hashes[i], batchLevels[b], &handles[i]);
+			CuAssert(tc, "Unable to add data hash to the tree builder.", res == KSI_OK);
+		}
+
+		res = KSI_FlatTreeBuilder_addBatch(flat, hashes + first, batchSizes[b], batchLevels[b], testBatchMask, &batchState, md,
+				workerHsr, BATCH_TEST_WORKERS, leafIds + first);
+		CuAssert(tc, "Unable to add a batch to the flat tree builder.", res == KSI_OK);
+	}
+
+	res = KSI_TreeBuilder_close(builder);
+	CuAssert(tc, "Unable to close a valid builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_close(flat);
+	CuAssert(tc, "Unable to close a valid flat builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_getRoot(flat, &flatRoot, &flatLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && flatRoot != NULL);
+
+	root = KSI_DataHash_ref(builder->rootNode->hash);
+	CuAssert(tc, "Root hash mismatch.", KSI_DataHash_equals(root, flatRoot));
+	CuAssert(tc, "Root level mismatch.", flatLevel == (int)builder->rootNode->level);
+	CuAssert(tc, "Mask chain mismatch.", KSI_DataHash_equals(refState.prev, batchState.prev));
+
+	for (i = 0; i < total; i++) {
+		res = KSI_TreeLeafHandle_getAggregationChain(handles[i], &chn);
+		CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && chn != NULL);
+
+		res = KSI_FlatTreeBuilder_getAggregationChain(flat, leafIds[i], &flatChn);
+		CuAssert(tc, "Unable to extract flat aggregation chain.", res == KSI_OK && flatChn != NULL);
+
+		assertChainsEqual(tc, chn, flatChn);
+
+		KSI_AggregationHashChain_free(chn);
+		chn = NULL;
+		KSI_AggregationHashChain_free(flatChn);
+		flatChn = NULL;
+	}
+
+	for (i = 0; i < total; i++) {
+		KSI_TreeLeafHandle_free(handles[i]);
+		KSI_DataHash_free(hashes[i]);
+	}
+
+	for (i = 0; i < BATCH_TEST_WORKERS; i++) {
+		KSI_DataHasher_free(workerHsr[i]);
+		KSI_CTX_free(workerCtx[i]);
+	}
+
+	KSI_free(handles);
+	KSI_free(hashes);
+	KSI_free(leafIds);
+	KSI_Utf8String_free(cId);
+	KSI_MetaData_free(md);
+	KSI_DataHash_free(refState.prev);
+	KSI_DataHash_free(batchState.prev);
+	KSI_DataHash_free(root);
+	KSI_DataHash_free(flatRoot);
+	KSI_FlatTreeBuilder_free(flat);
+	KSI_TreeBuilder_free(builder);
+#undef BATCH_TEST_WORKERS
+}
+
+
+static void testFlatTreeSpillMatchesInMemory(CuTest* tc) {
+#define SPILL_TEST_LEAVES 3000
+#define SPILL_TEST_BATCH 700
+#define SPILL_TEST_FILE "flat_tree_spill_test.tmp"
+	int res;
+	KSI_FlatTreeBuilder *mem = NULL;
+	KSI_FlatTreeBuilder *spill = NULL;
+	size_t memIds[SPILL_TEST_LEAVES];
+	size_t spillIds[SPILL_TEST_LEAVES];
+	size_t counters[2] = {0, 0};
+	KSI_TreeBuilderLeafProcessor masking = {testMaskingProcessor, NULL};
+	KSI_TreeBuilderLeafProcessor metaData[2] = {{testMetaDataProcessor, &counters[0]}, {testMetaDataProcessor, &counters[1]}};
+	TestChainState memState = {NULL, NULL};
+	TestChainState spillState = {NULL, NULL};
+	KSI_DataHash *hashes[SPILL_TEST_BATCH];
+	KSI_DataHash *memRoot = NULL;
+	KSI_DataHash *spillRoot = NULL;
+	KSI_MetaData *md = NULL;
+	KSI_Utf8String *cId = NULL;
+	KSI_AggregationHashChain *memChn = NULL;
+	KSI_AggregationHashChain *spillChn = NULL;
+	int memLevel = 0;
+	int spillLevel = 0;
+	FILE *f = NULL;
+	char buf[32];
+	size_t pass;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_MetaData_new(ctx, &md);
+	CuAssert(tc, "Unable to create meta-data.", res == KSI_OK && md != NULL);
+
+	res = KSI_Utf8String_new(ctx, "spill", 6, &cId);
+	CuAssert(tc, "Unable to create client id.", res == KSI_OK && cId != NULL);
+
+	res = KSI_MetaData_setClientId(md, cId);
+	CuAssert(tc, "Unable to set client id.", res == KSI_OK);
+
+	/* The first pass adds the leaves one by one through the leaf processors, the second one in batches. */
+	for (pass = 0; pass < 2; pass++) {
+		res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &mem);
+		CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && mem != NULL);
+
+		res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &spill);
+		CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && spill != NULL);
+
+		res = KSI_FlatTreeBuilder_setSpillFile(spill, pass == 0 ? SPILL_TEST_FILE : NULL);
+		CuAssert(tc, "Unable to set the spill file.", res == KSI_OK);
+
+		if (pass == 0) {
+			res = KSI_FlatTreeBuilder_addLeafProcessor(mem, &masking);
+			CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+			res = KSI_FlatTreeBuilder_addLeafProcessor(mem, &metaData[0]);
+			CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+			res = KSI_FlatTreeBuilder_addLeafProcessor(spill, &masking);
+			CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+			res = KSI_FlatTreeBuilder_addLeafProcessor(spill, &metaData[1]);
+			CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+			for (i = 0; i < SPILL_TEST_LEAVES; i++) {
+				/* Mix in longer hashes, higher levels and meta-data leaves. */
+				int level = (i % 5 == 3) ? 2 : 0;
+				KSI_HashAlgorithm algo = (i % 7 == 2) ? KSI_HASHALG_SHA2_512 : KSI_HASHALG_SHA2_256;
+
+				if (i % 1000 == 10) {
+					res = KSI_FlatTreeBuilder_addMetaData(mem, md, level, &memIds[i]);
+					CuAssert(tc, "Unable to add meta-data.", res == KSI_OK);
+
+					res = KSI_FlatTreeBuilder_addMetaData(spill, md, level, &spillIds[i]);
+					CuAssert(tc, "Unable to add meta-data.", res == KSI_OK);
+					continue;
+				}
+
+				KSI_snprintf(buf, sizeof(buf), "spill%u", (unsigned)i);
+
+				res = KSI_DataHash_create(ctx, buf, strlen(buf), algo, &hashes[0]);
+				CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hashes[0] != NULL);
+
+				res = KSI_FlatTreeBuilder_addDataHash(mem, hashes[0], level, &memIds[i]);
+				CuAssert(tc, "Unable to add data hash.", res == KSI_OK);
+
+				res = KSI_FlatTreeBuilder_addDataHash(spill, hashes[0], level, &spillIds[i]);
+				CuAssert(tc, "Unable to add data hash.", res == KSI_OK);
+
+				KSI_DataHash_free(hashes[0]);
+				hashes[0] = NULL;
+			}
+		} else {
+			size_t first;
+
+			for (first = 0; first + SPILL_TEST_BATCH <= SPILL_TEST_LEAVES; first += SPILL_TEST_BATCH) {
+				for (i = 0; i < SPILL_TEST_BATCH; i++) {
+					KSI_snprintf(buf, sizeof(buf), "batch%u", (unsigned)(first + i));
+
+					res = KSI_DataHash_create(ctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hashes[i]);
+					CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hashes[i] != NULL);
+				}
+
+				res = KSI_FlatTreeBuilder_addBatch(mem, hashes, SPILL_TEST_BATCH, 0, testBatchMask, &memState, md, NULL, 0, memIds + first);
+				CuAssert(tc, "Unable to add batch.", res == KSI_OK);
+
+				res = KSI_FlatTreeBuilder_addBatch(spill, hashes, SPILL_TEST_BATCH, 0, testBatchMask, &spillState, md, NULL, 0, spillIds + first);
+				CuAssert(tc, "Unable to add batch.", res == KSI_OK);
+
+				for (i = 0; i < SPILL_TEST_BATCH; i++) {
+					KSI_DataHash_free(hashes[i]);
+					hashes[i] = NULL;
+				}
+			}
+		}
+
+		res = KSI_FlatTreeBuilder_setSpillFile(spill, NULL);
+		CuAssert(tc, "Spill file may not be changed after adding leaves.", res == KSI_INVALID_STATE);
+
+		res = KSI_FlatTreeBuilder_close(mem);
+		CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+		res = KSI_FlatTreeBuilder_close(spill);
+		CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+		res = KSI_FlatTreeBuilder_getRoot(mem, &memRoot, &memLevel);
+		CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && memRoot != NULL);
+
+		res = KSI_FlatTreeBuilder_getRoot(spill, &spillRoot, &spillLevel);
+		CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && spillRoot != NULL);
+
+		CuAssert(tc, "Root hash mismatch.", KSI_DataHash_equals(memRoot, spillRoot));
+		CuAssert(tc, "Root level mismatch.", memLevel == spillLevel);
+
+		for (i = 0; i < (pass == 0 ? SPILL_TEST_LEAVES : SPILL_TEST_LEAVES - SPILL_TEST_LEAVES % SPILL_TEST_BATCH); i++) {
+			/* The spilled batches are split into parts, which changes the node layout, but not the tree. */
+			CuAssert(tc, "Leaf index mismatch.", pass != 0 || memIds[i] == spillIds[i]);
+
+			res = KSI_FlatTreeBuilder_getAggregationChain(mem, memIds[i], &memChn);
+			CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && memChn != NULL);
+
+			res = KSI_FlatTreeBuilder_getAggregationChain(spill, spillIds[i], &spillChn);
+			CuAssert(tc, "Unable to extract spilled aggregation chain.", res == KSI_OK && spillChn != NULL);
+
+			assertChainsEqual(tc, memChn, spillChn);
+
+			KSI_AggregationHashChain_free(memChn);
+			memChn = NULL;
+			KSI_AggregationHashChain_free(spillChn);
+			spillChn = NULL;
+		}
+
+		if (pass == 0) {
+			/* Make sure the nodes really were written out. */
+			f = fopen(SPILL_TEST_FILE, "rb");
+			CuAssert(tc, "Spill file not created.", f != NULL);
+			fseek(f, 0, SEEK_END);
+			CuAssert(tc, "Nothing was spilled.", ftell(f) > 0);
+			fclose(f);
+			f = NULL;
+		}
+
+		KSI_DataHash_free(memRoot);
+		memRoot = NULL;
+		KSI_DataHash_free(spillRoot);
+		spillRoot = NULL;
+		KSI_FlatTreeBuilder_free(mem);
+		mem = NULL;
+		KSI_FlatTreeBuilder_free(spill);
+		spill = NULL;
+	}
+
+	/* The spill files are removed with the builder. */
+	f = fopen(SPILL_TEST_FILE, "rb");
+	CuAssert(tc, "Spill file not removed.", f == NULL);
+
+	KSI_DataHash_free(memState.prev);
+	KSI_DataHash_free(spillState.prev);
+	KSI_Utf8String_free(cId);
+	KSI_MetaData_free(md);
+#undef SPILL_TEST_FILE
+#undef SPILL_TEST_BATCH
+#undef SPILL_TEST_LEAVES
+}
+
+static void testFlatTreeSpillWithinBatch(CuTest* tc) {
+#define SPILL_TEST_LEAVES 10000
+#define SPILL_TEST_FILE "flat_tree_spill_batch_test.tmp"
+	int res;
+	KSI_FlatTreeBuilder *mem = NULL;
+	KSI_FlatTreeBuilder *spill = NULL;
+	KSI_DataHash **hashes = NULL;
+	size_t *memIds = NULL;
+	size_t *spillIds = NULL;
+	KSI_DataHash *memRoot = NULL;
+	KSI_DataHash *spillRoot = NULL;
+	KSI_AggregationHashChain *memChn = NULL;
+	KSI_AggregationHashChain *spillChn = NULL;
+	int memLevel = 0;
+	int spillLevel = 0;
+	FILE *f = NULL;
+	char buf[32];
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	hashes = KSI_calloc(SPILL_TEST_LEAVES, sizeof(*hashes));
+	memIds = KSI_calloc(SPILL_TEST_LEAVES, sizeof(*memIds));
+	spillIds = KSI_calloc(SPILL_TEST_LEAVES, sizeof(*spillIds));
+	CuAssert(tc, "Out of memory.", hashes != NULL && memIds != NULL && spillIds != NULL);
+
+	for (i = 0; i < SPILL_TEST_LEAVES; i++) {
+		KSI_snprintf(buf, sizeof(buf), "big%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hashes[i]);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hashes[i] != NULL);
+	}
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &mem);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && mem != NULL);
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &spill);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && spill != NULL);
+
+	res = KSI_FlatTreeBuilder_setSpillFile(spill, SPILL_TEST_FILE);
+	CuAssert(tc, "Unable to set the spill file.", res == KSI_OK);
+
+	/* A single batch larger than the spill window. */
+	res = KSI_FlatTreeBuilder_addBatch(mem, hashes, SPILL_TEST_LEAVES, 0, NULL, NULL, NULL, NULL, 0, memIds);
+	CuAssert(tc, "Unable to add batch.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_addBatch(spill, hashes, SPILL_TEST_LEAVES, 0, NULL, NULL, NULL, NULL, 0, spillIds);
+	CuAssert(tc, "Unable to add batch.", res == KSI_OK);
+
+	/* The nodes of the batch must be spilled before the tree is closed. */
+	f = fopen(SPILL_TEST_FILE, "rb");
+	CuAssert(tc, "Spill file not created.", f != NULL);
+	fseek(f, 0, SEEK_END);
+	CuAssert(tc, "Nothing was spilled within the batch.", ftell(f) > 0);
+	fclose(f);
+	f = NULL;
+
+	res = KSI_FlatTreeBuilder_close(mem);
+	CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_close(spill);
+	CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_getRoot(mem, &memRoot, &memLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && memRoot != NULL);
+
+	res = KSI_FlatTreeBuilder_getRoot(spill, &spillRoot, &spillLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && spillRoot != NULL);
+
+	CuAssert(tc, "Root hash mismatch.", KSI_DataHash_equals(memRoot, spillRoot));
+	CuAssert(tc, "Root level mismatch.", memLevel == spillLevel);
+
+	for (i = 0; i < SPILL_TEST_LEAVES; i += 97) {
+		res = KSI_FlatTreeBuilder_getAggregationChain(mem, memIds[i], &memChn);
+		CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && memChn != NULL);
+
+		res = KSI_FlatTreeBuilder_getAggregationChain(spill, spillIds[i], &spillChn);
+		CuAssert(tc, "Unable to extract spilled aggregation chain.", res == KSI_OK && spillChn != NULL);
+
+		assertChainsEqual(tc, memChn, spillChn);
+
+		KSI_AggregationHashChain_free(memChn);
+		memChn = NULL;
+		KSI_AggregationHashChain_free(spillChn);
+		spillChn = NULL;
+	}
+
+	for (i = 0; i < SPILL_TEST_LEAVES; i++) {
+		KSI_DataHash_free(hashes[i]);
+	}
+
+	KSI_free(hashes);
+	KSI_free(memIds);
+	KSI_free(spillIds);
+	KSI_DataHash_free(memRoot);
+	KSI_DataHash_free(spillRoot);
+	KSI_FlatTreeBuilder_free(mem);
+	KSI_FlatTreeBuilder_free(spill);
+#undef SPILL_TEST_FILE
+#undef SPILL_TEST_LEAVES
+}
+
+static void testFlatTreeFrontierResume(CuTest* tc) {
+#define FRONTIER_TEST_BEFORE 23
+#define FRONTIER_TEST_AFTER 14
+	int res;
+	KSI_FlatTreeBuilder *full = NULL;
+	KSI_FlatTreeBuilder *resumed = NULL;
+	KSI_TreeBuilderLeafProcessor masking = {testMaskingProcessor, NULL};
+	KSI_DataHash *roots[KSI_TREE_BUILDER_STACK_LEN];
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *fullRoot = NULL;
+	KSI_DataHash *resumedRoot = NULL;
+	KSI_AggregationHashChain *fullChn = NULL;
+	KSI_AggregationHashChain *resumedChn = NULL;
+	size_t fullIds[FRONTIER_TEST_AFTER];
+	size_t resumedIds[FRONTIER_TEST_AFTER];
+	int fullLevel = 0;
+	int resumedLevel = 0;
+	char buf[32];
+	size_t i;
+	size_t j;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &full);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && full != NULL);
+
+	res = KSI_FlatTreeBuilder_new(ctx, KSI_HASHALG_SHA2_256, &resumed);
+	CuAssert(tc, "Unable to create flat tree builder.", res == KSI_OK && resumed != NULL);
+
+	res = KSI_FlatTreeBuilder_addLeafProcessor(full, &masking);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_addLeafProcessor(resumed, &masking);
+	CuAssert(tc, "Unable to add leaf processor.", res == KSI_OK);
+
+	for (i = 0; i < FRONTIER_TEST_BEFORE + FRONTIER_TEST_AFTER; i++) {
+		if (i == FRONTIER_TEST_BEFORE) {
+			res = KSI_FlatTreeBuilder_getFrontier(full, roots);
+			CuAssert(tc, "Unable to get the frontier.", res == KSI_OK);
+
+			res = KSI_FlatTreeBuilder_setFrontier(resumed, roots);
+			CuAssert(tc, "Unable to set the frontier.", res == KSI_OK);
+
+			res = KSI_FlatTreeBuilder_setFrontier(resumed, roots);
+			CuAssert(tc, "Frontier may only be set on an empty tree.", res == KSI_INVALID_STATE);
+
+			for (j = 0; j < KSI_TREE_BUILDER_STACK_LEN; j++) KSI_DataHash_free(roots[j]);
+		}
+
+		KSI_snprintf(buf, sizeof(buf), "frontier%u", (unsigned)i);
+
+		res = KSI_DataHash_create(ctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_FlatTreeBuilder_addDataHash(full, hsh, (i % 4 == 1) ? 1 : 0, i < FRONTIER_TEST_BEFORE ? NULL : &fullIds[i - FRONTIER_TEST_BEFORE]);
+		CuAssert(tc, "Unable to add data hash.", res == KSI_OK);
+
+		if (i >= FRONTIER_TEST_BEFORE) {
+			res = KSI_FlatTreeBuilder_addDataHash(resumed, hsh, (i % 4 == 1) ? 1 : 0, &resumedIds[i - FRONTIER_TEST_BEFORE]);
+			CuAssert(tc, "Unable to add data hash.", res == KSI_OK);
+		}
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	res = KSI_FlatTreeBuilder_close(full);
+	CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_close(resumed);
+	CuAssert(tc, "Unable to close the builder.", res == KSI_OK);
+
+	res = KSI_FlatTreeBuilder_getFrontier(full, roots);
+	CuAssert(tc, "Frontier of a closed tree may not be returned.", res == KSI_INVALID_STATE);
+
+	res = KSI_FlatTreeBuilder_getRoot(full, &fullRoot, &fullLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && fullRoot != NULL);
+
+	res = KSI_FlatTreeBuilder_getRoot(resumed, &resumedRoot, &resumedLevel);
+	CuAssert(tc, "Unable to get the root hash.", res == KSI_OK && resumedRoot != NULL);
+
+	CuAssert(tc, "Root hash mismatch.", KSI_DataHash_equals(fullRoot, resumedRoot));
+	CuAssert(tc, "Root level mismatch.", fullLevel == resumedLevel);
+
+	for (i = 0; i < FRONTIER_TEST_AFTER; i++) {
+		res = KSI_FlatTreeBuilder_getAggregationChain(full, fullIds[i], &fullChn);
+		CuAssert(tc, "Unable to extract aggregation chain.", res == KSI_OK && fullChn != NULL);
+
+		res = KSI_FlatTreeBuilder_getAggregationChain(resumed, resumedIds[i], &resumedChn);
+		CuAssert(tc, "Unable to extract resumed aggregation chain.", res == KSI_OK && resumedChn != NULL);
+
+		assertChainsEqual(tc, fullChn, resumedChn);
+
+		KSI_AggregationHashChain_free(fullChn);
+		fullChn = NULL;
+		KSI_AggregationHashChain_free(resumedChn);
+		resumedChn = NULL;
+	}
+
+	KSI_DataHash_free(fullRoot);
+	KSI_DataHash_free(resumedRoot);
+	KSI_FlatTreeBuilder_free(full);
+	KSI_FlatTreeBuilder_free(resumed);
+#undef FRONTIER_TEST_AFTER
+#undef FRONTIER_TEST_BEFORE
+}
 
 CuSuite* KSITest_TreeBuilder_getSuite(void)
 {
@@ -132,6 +982,11 @@ CuSuite* KSITest_TreeBuilder_getSuite(void)
 	SUITE_ADD_TEST(suite, testCreateTreeBuilder);
 	SUITE_ADD_TEST(suite, testTreeBuilderAddLeafs);
 	SUITE_ADD_TEST(suite, testGetAggregationChain);
+	SUITE_ADD_TEST(suite, testFlatTreeBuilderMatchesTreeBuilder);
+	SUITE_ADD_TEST(suite, testFlatTreeBatchMatchesTreeBuilder);
+	SUITE_ADD_TEST(suite, testFlatTreeSpillMatchesInMemory);
+	SUITE_ADD_TEST(suite, testFlatTreeSpillWithinBatch);
+	SUITE_ADD_TEST(suite, testFlatTreeFrontierResume);
 
 	return suite;
 }
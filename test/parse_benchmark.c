@@ -18,20 +18,124 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <ksi/ksi.h>
 
+#if KSI_AGGREGATION_PDU_VERSION == 2
+#	define	TEST_RESOURCE_AGGR_VER "v2"
+#	define	TEST_AGGR_PDU_VER KSI_PDU_VERSION_2
+#else
+#	define	TEST_RESOURCE_AGGR_VER "v1"
+#	define	TEST_AGGR_PDU_VER KSI_PDU_VERSION_1
+#endif
+
+#if KSI_EXTENDING_PDU_VERSION == 2
+#	define	TEST_RESOURCE_EXT_VER "v2"
+#	define	TEST_EXT_PDU_VER KSI_PDU_VERSION_2
+#else
+#	define	TEST_RESOURCE_EXT_VER "v1"
+#	define	TEST_EXT_PDU_VER KSI_PDU_VERSION_1
+#endif
+
 static size_t parseCount = 1000000;
 
-int main() {
+typedef int (*parser_t)(KSI_CTX *, const unsigned char *, size_t, const KSI_Policy *, KSI_VerificationContext *, KSI_Signature **);
+
+static int benchmark(KSI_CTX *ksi, const char *name, parser_t parse, const unsigned char *raw, size_t len) {
+	int res = KSI_UNKNOWN_ERROR;
+	clock_t start;
+	clock_t end;
+	size_t count = 0;
+	KSI_Signature *sig = NULL;
+
+	start = clock();
+
+	for (count = 0; count < parseCount; count++) {
+		res = parse(ksi, raw, len, KSI_VERIFICATION_POLICY_INTERNAL, NULL, &sig);
+		if (res != KSI_OK) {
+			KSI_ERR_statusDump(ksi, stderr);
+			fprintf(stderr, "Failed to parse signature.\n");
+			goto cleanup;
+		}
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	end = clock();
+
+	printf("%s: parsed %llu signatures in %0.2f seconds. (one in %0.4f ms)\n", name, (unsigned long long)parseCount,
+			(double)(end - start) / CLOCKS_PER_SEC, (double)(end - start) * 1000 / CLOCKS_PER_SEC / parseCount);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Signature_free(sig);
+
+	return res;
+}
+
+typedef int (*object_parser_t)(KSI_CTX *, const unsigned char *, size_t, void **);
+typedef void (*object_free_t)(void *);
+
+/* Objects parsed directly by their templates. */
+static const struct {
+	const char *name;
+	const char *resource;
+	object_parser_t parse;
+	object_free_t free;
+} templateBenchmarks[] = {
+	{"aggregation pdu", "test/resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv", (object_parser_t)KSI_AggregationPdu_parse, (object_free_t)KSI_AggregationPdu_free},
+	{"extend pdu", "test/resource/tlv/" TEST_RESOURCE_EXT_VER "/extend_response.tlv", (object_parser_t)KSI_ExtendPdu_parse, (object_free_t)KSI_ExtendPdu_free},
+	{NULL, NULL, NULL, NULL}
+};
+
+static int benchmarkObject(KSI_CTX *ksi, const char *name, object_parser_t parse, object_free_t free_fn, const unsigned char *raw, size_t len) {
+	int res = KSI_UNKNOWN_ERROR;
+	clock_t start;
+	clock_t end;
+	size_t count = 0;
+	void *obj = NULL;
+
+	start = clock();
+
+	for (count = 0; count < parseCount; count++) {
+		res = parse(ksi, raw, len, &obj);
+		if (res != KSI_OK) {
+			KSI_ERR_statusDump(ksi, stderr);
+			fprintf(stderr, "Failed to parse %s.\n", name);
+			goto cleanup;
+		}
+
+		free_fn(obj);
+		obj = NULL;
+	}
+
+	end = clock();
+
+	printf("%s: parsed %llu objects in %0.2f seconds. (one in %0.4f ms)\n", name, (unsigned long long)parseCount,
+			(double)(end - start) / CLOCKS_PER_SEC, (double)(end - start) * 1000 / CLOCKS_PER_SEC / parseCount);
+
+	res = KSI_OK;
+
+cleanup:
+
+	free_fn(obj);
+
+	return res;
+}
+
+int main(int argc, char **argv) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ksi = NULL;
 	unsigned char raw[0xffff];
 	unsigned len;
+	size_t i;
 	FILE *f = NULL;
-	time_t start;
-	time_t end;
-	size_t count = 0;
-	KSI_Signature *sig = NULL;
+
+	if (argc > 1) parseCount = strtoul(argv[1], NULL, 10);
 
 	res = KSI_CTX_new(&ksi);
 	if (res != KSI_OK) {
@@ -49,30 +153,50 @@ int main() {
 
 	printf("Len = %d\n", len);
 
-	time(&start);
+	res = benchmark(ksi, "parse", KSI_Signature_parseWithPolicy, raw, len);
+	if (res != KSI_OK) goto cleanup;
 
-	for (count = 0; count < parseCount; count++) {
-		res = KSI_Signature_parse(ksi, raw, len, &sig);
-		if (res != KSI_OK) {
-			KSI_ERR_statusDump(ksi, stderr);
-			fprintf(stderr, "Failed to parse signature.\n");
-			goto cleanup;
-		}
+	/* The same signature without copying the values out of the raw buffer. */
+	res = benchmark(ksi, "parseView", KSI_Signature_parseViewWithPolicy, raw, len);
+	if (res != KSI_OK) goto cleanup;
 
-		KSI_Signature_free(sig);
-		sig = NULL;
+	fclose(f);
+	f = NULL;
+
+	/* Make sure the PDU versions match the test resources. */
+	res = KSI_CTX_setOption(ksi, KSI_OPT_AGGR_PDU_VER, (void *)TEST_AGGR_PDU_VER);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to set PDU version.\n");
+		goto cleanup;
+	}
 
+	res = KSI_CTX_setOption(ksi, KSI_OPT_EXT_PDU_VER, (void *)TEST_EXT_PDU_VER);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to set PDU version.\n");
+		goto cleanup;
 	}
 
-	time(&end);
+	for (i = 0; templateBenchmarks[i].name != NULL; i++) {
+		f = fopen(templateBenchmarks[i].resource, "rb");
+		if (f == NULL) {
+			fprintf(stderr, "Unable to open input.\n");
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
 
-	printf("Parsed %llu signatures in %lld seconds. (one in %0.2f ms)\n", (unsigned long long)parseCount, (unsigned long long)end - start, (double)(end - start) * 1000 / parseCount);
+		len = fread(raw, 1, sizeof(raw), f);
+
+		fclose(f);
+		f = NULL;
+
+		res = benchmarkObject(ksi, templateBenchmarks[i].name, templateBenchmarks[i].parse, templateBenchmarks[i].free, raw, len);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_Signature_free(sig);
 	KSI_CTX_free(ksi);
 	if (f != NULL) fclose(f);
 
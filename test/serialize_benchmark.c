@@ -18,17 +18,225 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ksi/ksi.h>
+#include <ksi/tlv.h>
+#include <ksi/tlv_template.h>
+#include <ksi/compatibility.h>
+
+#ifndef _WIN32
+#  include <sys/resource.h>
+#endif
 
 #if KSI_AGGREGATION_PDU_VERSION == 2
 #	define	TEST_RESOURCE_AGGR_VER "v2"
+#	define	TEST_AGGR_PDU_VER KSI_PDU_VERSION_2
+#	define	TEST_AGGR_REQ_TAG 0x220
+#	define	TEST_AGGR_REQ_TEMPLATE KSI_TLV_TEMPLATE(KSI_AggregationReqPdu)
+#	define	TEST_AGGR_RESP_TAG 0x221
+#	define	TEST_AGGR_RESP_TEMPLATE KSI_TLV_TEMPLATE(KSI_AggregationRespPdu)
 #else
 #	define	TEST_RESOURCE_AGGR_VER "v1"
+#	define	TEST_AGGR_PDU_VER KSI_PDU_VERSION_1
+#	define	TEST_AGGR_REQ_TAG 0x200
+#	define	TEST_AGGR_REQ_TEMPLATE KSI_TLV_TEMPLATE(KSI_AggregationPdu)
+#	define	TEST_AGGR_RESP_TAG 0x200
+#	define	TEST_AGGR_RESP_TEMPLATE KSI_TLV_TEMPLATE(KSI_AggregationPdu)
 #endif
 
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationPdu);
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationReqPdu);
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationRespPdu);
+KSI_IMPORT_TLV_TEMPLATE(KSI_Signature);
+
 static size_t parseCount = 1000000;
 
-int main() {
+/* Heap usage statistics - only available with glibc, where the allocator can be interposed. */
+static size_t allocCount = 0;
+static size_t allocBytes = 0;
+
+#ifdef __GLIBC__
+#  define HAVE_ALLOC_STATS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+	allocCount++;
+	allocBytes += size;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+	allocCount++;
+	allocBytes += num * size;
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	allocCount++;
+	allocBytes += size;
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+static long getPeakRss(void) {
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;
+#endif
+	return -1;
+}
+
+static void printStats(const char *name, size_t count, time_t start, time_t end, size_t allocs, size_t bytes) {
+	printf("Serialized %llu %s in %lld seconds. (one in %0.2f ms)\n", (unsigned long long)count, name, (unsigned long long)end - start, (double)(end - start) * 1000 / count);
+#ifdef HAVE_ALLOC_STATS
+	printf("  allocations per object: %0.2f, bytes allocated per object: %0.2f\n", (double)allocs / count, (double)bytes / count);
+#else
+	(void)allocs;
+	(void)bytes;
+#endif
+	printf("  peak RSS: %ld KiB\n", getPeakRss());
+}
+
+/* An object together with the template used for serializing it. */
+typedef struct {
+	KSI_CTX *ctx;
+	const void *obj;
+	unsigned tag;
+	const KSI_TlvTemplate *tmpl;
+} TemplateObject;
+
+typedef int (*serializer_t)(const TemplateObject *, unsigned char *, size_t, size_t *);
+
+/* Serialization via an intermediate KSI_TLV tree. */
+static int serializeTree(const TemplateObject *o, unsigned char *buf, size_t buf_size, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *tlv = NULL;
+	unsigned char *tmp = NULL;
+	size_t tmp_len = 0;
+
+	res = KSI_TLV_new(o->ctx, o->tag, 0, 0, &tlv);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_construct(o->ctx, tlv, o->obj, o->tmpl);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TLV_serialize(tlv, &tmp, &tmp_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (tmp_len > buf_size) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	memcpy(buf, tmp, tmp_len);
+	*len = tmp_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+	KSI_TLV_free(tlv);
+
+	return res;
+}
+
+/* Direct serialization into a heap buffer of the exact size. */
+static int serializeObject(const TemplateObject *o, unsigned char *buf, size_t buf_size, size_t *len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *tmp = NULL;
+	size_t tmp_len = 0;
+
+	res = KSI_TlvTemplate_serializeObject(o->ctx, o->obj, o->tag, 0, 0, o->tmpl, &tmp, &tmp_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (tmp_len > buf_size) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	memcpy(buf, tmp, tmp_len);
+	*len = tmp_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+/* Direct serialization into the caller's buffer. */
+static int writeBytes(const TemplateObject *o, unsigned char *buf, size_t buf_size, size_t *len) {
+	return KSI_TlvTemplate_writeBytes(o->ctx, o->obj, o->tag, 0, 0, o->tmpl, buf, buf_size, len, 0);
+}
+
+static int benchmark(const char *name, const TemplateObject *o) {
+	int res = KSI_UNKNOWN_ERROR;
+	static const struct {
+		const char *name;
+		serializer_t fn;
+	} serializers[] = {
+		{"tlv tree", serializeTree},
+		{"direct", serializeObject},
+		{"direct into buffer", writeBytes},
+		{NULL, NULL}
+	};
+	unsigned char expected[0xffff + 4];
+	size_t expected_len = 0;
+	unsigned char buf[0xffff + 4];
+	size_t len = 0;
+	time_t start;
+	time_t end;
+	size_t count;
+	size_t allocs;
+	size_t bytes;
+	size_t i;
+	char title[100];
+
+	for (i = 0; serializers[i].name != NULL; i++) {
+		time(&start);
+		allocs = allocCount;
+		bytes = allocBytes;
+
+		for (count = 0; count < parseCount; count++) {
+			res = serializers[i].fn(o, buf, sizeof(buf), &len);
+			if (res != KSI_OK) {
+				KSI_ERR_statusDump(o->ctx, stderr);
+				fprintf(stderr, "Failed to serialize %s (%s).\n", name, serializers[i].name);
+				goto cleanup;
+			}
+		}
+
+		time(&end);
+
+		KSI_snprintf(title, sizeof(title), "%s (%s)", name, serializers[i].name);
+		printStats(title, parseCount, start, end, allocCount - allocs, allocBytes - bytes);
+
+		/* All the serializers must produce the same output. */
+		if (i == 0) {
+			memcpy(expected, buf, len);
+			expected_len = len;
+		} else if (len != expected_len || memcmp(expected, buf, len) != 0) {
+			fprintf(stderr, "Serialization mismatch: %s (%s).\n", name, serializers[i].name);
+			res = KSI_UNKNOWN_ERROR;
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int main(int argc, char **argv) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *ksi = NULL;
 	unsigned char raw[0xffff];
@@ -38,8 +246,23 @@ int main() {
 	time_t end;
 	size_t count = 0;
 	KSI_AggregationPdu *pdu = NULL;
+	KSI_AggregationReq *req = NULL;
+	KSI_AggregationPdu *reqPdu = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *reqId = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *clone = NULL;
 	unsigned char *serialized = NULL;
 	size_t serialized_len;
+	size_t allocs;
+	size_t bytes;
+	TemplateObject obj;
+
+	if (argc > 1) parseCount = (size_t)atol(argv[1]);
+	if (parseCount == 0) {
+		fprintf(stderr, "Usage: %s [count]\n", argv[0]);
+		goto cleanup;
+	}
 
 	res = KSI_CTX_new(&ksi);
 	if (res != KSI_OK) {
@@ -47,6 +270,47 @@ int main() {
 		goto cleanup;
 	}
 
+	/* Make sure the PDU version matches the test resource. */
+	res = KSI_CTX_setOption(ksi, KSI_OPT_AGGR_PDU_VER, (void *)TEST_AGGR_PDU_VER);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to set PDU version.\n");
+		goto cleanup;
+	}
+
+	/* Aggregation request, as composed for every signing request. */
+	res = KSI_DataHash_create(ksi, "benchmark", 9, KSI_HASHALG_SHA2_256, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_new(ksi, &req);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_setRequestHash(req, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	res = KSI_Integer_new(ksi, 1, &reqId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_setRequestId(req, reqId);
+	if (res != KSI_OK) goto cleanup;
+	reqId = NULL;
+
+	res = KSI_AggregationReq_enclose(req, "anon", "anon", &reqPdu);
+	if (res != KSI_OK) {
+		KSI_ERR_statusDump(ksi, stderr);
+		fprintf(stderr, "Failed to create request PDU.\n");
+		goto cleanup;
+	}
+	req = NULL;
+
+	obj.ctx = ksi;
+	obj.obj = reqPdu;
+	obj.tag = TEST_AGGR_REQ_TAG;
+	obj.tmpl = TEST_AGGR_REQ_TEMPLATE;
+
+	res = benchmark("request PDUs", &obj);
+	if (res != KSI_OK) goto cleanup;
+
 	f = fopen("test/resource/tlv/" TEST_RESOURCE_AGGR_VER "/ok-sig-2014-07-01.1-aggr_response.tlv", "rb");
 	if (f == NULL) {
 		fprintf(stderr, "Unable to open input.\n");
@@ -65,6 +329,8 @@ int main() {
 	}
 
 	time(&start);
+	allocs = allocCount;
+	bytes = allocBytes;
 
 	for (count = 0; count < parseCount; count++) {
 		res = KSI_AggregationPdu_serialize(pdu, &serialized, &serialized_len);
@@ -81,14 +347,81 @@ int main() {
 
 	time(&end);
 
-	printf("Serialized %llu PDUs in %lld seconds. (one in %0.2f ms)\n", (unsigned long long)parseCount, (unsigned long long)end - start, (double)(end - start) * 1000 / parseCount);
+	printStats("PDUs", parseCount, start, end, allocCount - allocs, allocBytes - bytes);
+
+	obj.obj = pdu;
+	obj.tag = TEST_AGGR_RESP_TAG;
+	obj.tmpl = TEST_AGGR_RESP_TEMPLATE;
+
+	res = benchmark("response PDUs", &obj);
+	if (res != KSI_OK) goto cleanup;
+
+	fclose(f);
+	f = fopen("test/resource/tlv/ok-sig-2014-04-30.1.ksig", "rb");
+	if (f == NULL) {
+		fprintf(stderr, "Unable to open input.\n");
+		goto cleanup;
+	}
+
+	len = fread(raw, 1, sizeof(raw), f);
+
+	res = KSI_Signature_parse(ksi, raw, len, &sig);
+	if (res != KSI_OK) {
+		KSI_ERR_statusDump(ksi, stderr);
+		fprintf(stderr, "Failed to parse signature.\n");
+		goto cleanup;
+	}
+
+	time(&start);
+	allocs = allocCount;
+	bytes = allocBytes;
+
+	for (count = 0; count < parseCount; count++) {
+		res = KSI_Signature_clone(sig, &clone);
+		if (res != KSI_OK) {
+			KSI_ERR_statusDump(ksi, stderr);
+			fprintf(stderr, "Failed to clone signature.\n");
+			goto cleanup;
+		}
+
+		res = KSI_Signature_serialize(clone, &serialized, &serialized_len);
+		if (res != KSI_OK) {
+			KSI_ERR_statusDump(ksi, stderr);
+			fprintf(stderr, "Failed to serialize signature.\n");
+			goto cleanup;
+		}
+
+		KSI_free(serialized);
+		serialized = NULL;
+
+		KSI_Signature_free(clone);
+		clone = NULL;
+	}
+
+	time(&end);
+
+	printStats("signatures (clone + serialize)", parseCount, start, end, allocCount - allocs, allocBytes - bytes);
+
+	/* Serialize the signature from its object model instead of the parsed TLV tree. */
+	obj.obj = sig;
+	obj.tag = 0x0800;
+	obj.tmpl = KSI_TLV_TEMPLATE(KSI_Signature);
+
+	res = benchmark("signatures", &obj);
+	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
 
 cleanup:
 
 	KSI_free(serialized);
+	KSI_Signature_free(clone);
+	KSI_Signature_free(sig);
 	KSI_AggregationPdu_free(pdu);
+	KSI_AggregationPdu_free(reqPdu);
+	KSI_AggregationReq_free(req);
+	KSI_DataHash_free(hsh);
+	KSI_Integer_free(reqId);
 	KSI_CTX_free(ksi);
 	if (f != NULL) fclose(f);
 
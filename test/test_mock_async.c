@@ -70,7 +70,7 @@ static void reqQueue_clearWithError(KSI_LIST(KSI_AsyncHandle) *reqQueue, int err
 		if (res != KSI_OK || req == NULL) return;
 
 		/* Update request state. */
-		req->state = KSI_ASYNC_STATE_ERROR;
+		KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_ERROR);
 		req->err = err;
 		req->errExt = ext;
 
@@ -126,7 +126,7 @@ static int dispatch(KSITest_FileAsyncClientCtx *clientCtx) {
 			req->sentCount = 0;
 
 			/* Update state. */
-			req->state = KSI_ASYNC_STATE_WAITING_FOR_RESPONSE;
+			KSI_AsyncHandle_setState(req, KSI_ASYNC_STATE_WAITING_FOR_RESPONSE);
 			/* Start receive timeout. */
 			req->sndTime = curTime;
 			/* The request has been successfully dispatched. Remove it from the request queue. */
@@ -214,7 +214,7 @@ static int addToSendQueue(KSITest_FileAsyncClientCtx *clientCtx, KSI_AsyncHandle
 		goto cleanup;
 	}
 
-	request->state = KSI_ASYNC_STATE_WAITING_FOR_DISPATCH;
+	KSI_AsyncHandle_setState(request, KSI_ASYNC_STATE_WAITING_FOR_DISPATCH);
 	/* Start send timeout. */
 	time(&request->reqTime);
 
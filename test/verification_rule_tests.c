@@ -3293,6 +3293,84 @@ static void testRule_CalendarAuthenticationRecordSignatureVerification(CuTest *t
 #undef TEST_CERT_FILE
 }
 
+static void testRule_CalendarAuthenticationRecordSignatureVerification_cached(CuTest *tc) {
+#define TEST_SIGNATURE_FILE    "resource/tlv/ok-sig-2014-06-2.ksig"
+#define TEST_PUBLICATIONS_FILE "resource/tlv/publications.tlv"
+#define TEST_CERT_FILE         "resource/crt/mock.crt"
+
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationContext verCtx;
+	KSI_RuleVerificationResult verRes;
+	KSI_PKITruststore *pki = NULL;
+	const KSI_CertConstraint certCnst[] = {
+		{KSI_CERT_EMAIL, "publications@guardtime.com"},
+		{NULL, NULL}
+	};
+	VerificationTempData tempData;
+	KSI_CTX *ctx = NULL;
+	KSI_Signature *signature = NULL;
+	KSI_PublicationsFile *userPublicationsFile = NULL;
+	size_t hits = 0;
+	size_t misses = 0;
+	int i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSITest_CTX_clone(&ctx);
+	CuAssert(tc, "Unable to create new context.", res == KSI_OK && ctx != NULL);
+
+	res = KSI_VerificationContext_init(&verCtx, ctx);
+	CuAssert(tc, "Unable to create verification context.", res == KSI_OK);
+	memset(&tempData, 0, sizeof(tempData));
+	verCtx.tempData = &tempData;
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &signature);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && signature != NULL);
+	verCtx.signature = signature;
+
+	res = KSI_PublicationsFile_fromFile(ctx, getFullResourcePath(TEST_PUBLICATIONS_FILE), &userPublicationsFile);
+	CuAssert(tc, "Unable to read publications file.", res == KSI_OK && userPublicationsFile != NULL);
+	verCtx.userPublicationsFile = userPublicationsFile;
+
+	res = KSI_CTX_setDefaultPubFileCertConstraints(ctx, certCnst);
+	CuAssert(tc, "Unable to set cert constraints.", res == KSI_OK);
+
+	res = KSI_CTX_setPKITruststore(ctx, NULL);
+	CuAssert(tc, "Unable to set clear PKI truststrore for KSI context.", res == KSI_OK);
+
+	res = KSI_PKITruststore_new(ctx, 0, &pki);
+	CuAssert(tc, "Unable to get PKI truststore from context.", res == KSI_OK && pki != NULL);
+
+	res = KSI_PKITruststore_addLookupFile(pki, getFullResourcePath(TEST_CERT_FILE));
+	CuAssert(tc, "Unable to read certificate.", res == KSI_OK);
+
+	res = KSI_CTX_setPKITruststore(ctx, pki);
+	CuAssert(tc, "Unable to set new PKI truststrore for KSI context.", res == KSI_OK);
+
+	/* The second verification of the same authentication record must be served from the cache. */
+	for (i = 0; i < 2; i++) {
+		TEST_VERIFICATION_STEP_INIT;
+
+		res = KSI_VerificationRule_CalendarAuthenticationRecordSignatureVerification(&verCtx, &verRes);
+		CuAssert(tc, "Failed to verify calendar authentication record signature.", res == KSI_OK && verRes.resultCode == KSI_VER_RES_OK);
+
+		TEST_ASSERT_VERIFICATION_STEP_SUCCEEDED(KSI_VERIFY_CALAUTHREC_WITH_SIGNATURE);
+	}
+
+	res = KSI_CTX_getPKISignatureCacheStats(ctx, &hits, &misses);
+	CuAssert(tc, "Unable to get PKI signature cache statistics.", res == KSI_OK);
+	CuAssert(tc, "Second verification should have been served from the cache.", hits == 1 && misses == 1);
+
+	KSI_PublicationsFile_free(userPublicationsFile);
+	KSI_Signature_free(signature);
+	KSI_VerificationContext_clean(&verCtx);
+	KSI_CTX_free(ctx);
+
+#undef TEST_SIGNATURE_FILE
+#undef TEST_PUBLICATIONS_FILE
+#undef TEST_CERT_FILE
+}
+
 static void testRule_CalendarAuthenticationRecordSignatureVerification_verifyErrorResult(CuTest *tc) {
 #define TEST_SIGNATURE_FILE    "resource/tlv/signature-cal-auth-wrong-signing-value.ksig"
 #define TEST_PUBLICATIONS_FILE "resource/tlv/publications.tlv"
@@ -5335,6 +5413,7 @@ CuSuite* KSITest_VerificationRules_getSuite(void) {
 	SUITE_ADD_TEST(suite, testRule_CertificateValidity);
 	SUITE_ADD_TEST(suite, testRule_CertificateValidity_verifyErrorResult);
 	SUITE_ADD_TEST(suite, testRule_CalendarAuthenticationRecordSignatureVerification);
+	SUITE_ADD_TEST(suite, testRule_CalendarAuthenticationRecordSignatureVerification_cached);
 	SUITE_ADD_TEST(suite, testRule_CalendarAuthenticationRecordSignatureVerification_verifyErrorResult);
 	SUITE_ADD_TEST(suite, testRule_PublicationsFileContainsSignaturePublication);
 	SUITE_ADD_TEST(suite, testRule_PublicationsFileContainsSignaturePublication_verifyErrorResult);